@@ -0,0 +1,56 @@
+#include "binlog.h"
+#include <stdio.h>
+#include <string.h>
+
+// binlog_decode - expand the firmware's `log dump` output back into text.
+// Site formats come from binlog.c, so build this from the same tree as the
+// firmware that produced the dump.
+
+#define BINLOG_MARKER   "BINLOG: "
+
+int main(int argc, char **argv) {
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-' && argv[1][1] != '\0')) {
+        fprintf(stderr, "usage: %s [monitor.log]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = stdin;
+    if (argc == 2 && strcmp(argv[1], "-") != 0) {
+        in = fopen(argv[1], "r");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    char line[256];
+    char text[160];
+    while (fgets(line, sizeof(line), in)) {
+        char *p = strstr(line, BINLOG_MARKER);
+        if (p == NULL) continue;
+        p += strlen(BINLOG_MARKER);
+
+        unsigned long timestamp_ms;
+        unsigned site, suppressed;
+        long args[BINLOG_MAX_ARGS];
+        if (sscanf(p, "%lu %u %u %ld %ld %ld %ld", &timestamp_ms, &site, &suppressed,
+                   &args[0], &args[1], &args[2], &args[3]) != 3 + BINLOG_MAX_ARGS) {
+            continue;
+        }
+
+        binlog_entry_t entry = {
+            .timestamp_ms = (uint32_t)timestamp_ms,
+            .site = (uint8_t)site,
+            .suppressed = (uint8_t)suppressed,
+        };
+        for (int i = 0; i < BINLOG_MAX_ARGS; i++) {
+            entry.args[i] = (int32_t)args[i];
+        }
+
+        binlog_format_entry(&entry, text, sizeof(text));
+        printf("%9lu.%03lu  %s\n", timestamp_ms / 1000, timestamp_ms % 1000, text);
+    }
+
+    if (in != stdin) fclose(in);
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include "hal.h"
+#include "hal_host.h"
+#include <string.h>
+
+// Native HAL: virtual clock, simulated GPIO levels and an in-memory
+// key-value store. Single threaded - there is one implicit task.
+
+#define HOST_GPIO_COUNT     40
+#define HOST_KV_SLOTS       16
+#define HOST_KV_NAME_MAX    16
+#define HOST_KV_VALUE_MAX   256
+
+typedef struct {
+    char ns[HOST_KV_NAME_MAX];
+    char key[HOST_KV_NAME_MAX];
+    uint8_t value[HOST_KV_VALUE_MAX];
+    size_t len;
+    bool used;
+} host_kv_entry_t;
+
+static uint64_t now_us = 0;
+static uint64_t gpio_levels = ~0ULL;    // Pull-ups: every pin idles high
+static uint32_t pending_notifications = 0;
+static uint32_t notify_count = 0;
+static host_kv_entry_t kv[HOST_KV_SLOTS];
+static uint32_t kv_writes = 0;
+
+// The single host "task" - any non-NULL handle works
+static int host_task_token;
+
+void hal_host_reset(void) {
+    now_us = 0;
+    gpio_levels = ~0ULL;
+    pending_notifications = 0;
+    notify_count = 0;
+    memset(kv, 0, sizeof(kv));
+    kv_writes = 0;
+}
+
+void hal_host_set_time_us(uint64_t time_us) {
+    now_us = time_us;
+}
+
+void hal_host_advance_ms(uint32_t ms) {
+    now_us += (uint64_t)ms * 1000;
+}
+
+void hal_host_set_pin(int pin, int level) {
+    if (pin < 0 || pin >= HOST_GPIO_COUNT) return;
+
+    if (level) {
+        gpio_levels |= 1ULL << pin;
+    } else {
+        gpio_levels &= ~(1ULL << pin);
+    }
+}
+
+void hal_host_set_sensor_mask(const int *pins, size_t count, uint8_t mask) {
+    // Active-LOW sensors: a set bit pulls the pin low
+    for (size_t i = 0; i < count; i++) {
+        hal_host_set_pin(pins[i], (mask >> i) & 1 ? 0 : 1);
+    }
+}
+
+uint32_t hal_host_notify_count(void) {
+    return notify_count;
+}
+
+uint32_t hal_host_kv_writes(void) {
+    return kv_writes;
+}
+
+uint64_t hal_time_us(void) {
+    return now_us;
+}
+
+uint32_t hal_time_ms(void) {
+    return (uint32_t)(now_us / 1000);
+}
+
+void hal_delay_ms(uint32_t ms) {
+    hal_host_advance_ms(ms);
+}
+
+bool hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size, unsigned priority, hal_task_t *handle) {
+    // No threads on the host; callers fall back to doing the work inline
+    (void)fn;
+    (void)name;
+    (void)stack_size;
+    (void)priority;
+    (void)handle;
+    return false;
+}
+
+hal_task_t hal_task_current(void) {
+    return &host_task_token;
+}
+
+const char *hal_task_name(hal_task_t task) {
+    return task ? "host" : NULL;
+}
+
+void hal_task_notify(hal_task_t task) {
+    if (task == NULL) return;
+
+    notify_count++;
+    pending_notifications++;
+}
+
+bool hal_task_wait(uint32_t timeout_ms) {
+    if (pending_notifications > 0) {
+        pending_notifications = 0;
+        return true;
+    }
+
+    if (timeout_ms != HAL_WAIT_FOREVER) {
+        hal_host_advance_ms(timeout_ms);
+    }
+    return false;
+}
+
+void hal_lock(hal_lock_t *lock) {
+    while (atomic_flag_test_and_set_explicit(&lock->flag, memory_order_acquire)) {
+    }
+}
+
+void hal_unlock(hal_lock_t *lock) {
+    atomic_flag_clear_explicit(&lock->flag, memory_order_release);
+}
+
+void hal_gpio_config_input(uint64_t pin_mask, bool pull_up) {
+    (void)pin_mask;
+    (void)pull_up;
+}
+
+void hal_gpio_config_output(uint64_t pin_mask) {
+    (void)pin_mask;
+}
+
+int hal_gpio_get(int pin) {
+    if (pin < 0 || pin >= HOST_GPIO_COUNT) return 0;
+
+    return (int)((gpio_levels >> pin) & 1);
+}
+
+void hal_gpio_set(int pin, int level) {
+    hal_host_set_pin(pin, level);
+}
+
+uint64_t hal_gpio_read_inputs(void) {
+    return gpio_levels;
+}
+
+static host_kv_entry_t *host_kv_find(const char *ns, const char *key) {
+    for (int i = 0; i < HOST_KV_SLOTS; i++) {
+        if (kv[i].used && strcmp(kv[i].ns, ns) == 0 && strcmp(kv[i].key, key) == 0) {
+            return &kv[i];
+        }
+    }
+    return NULL;
+}
+
+bool hal_kv_init(void) {
+    return true;
+}
+
+bool hal_kv_get_blob(const char *ns, const char *key, void *buf, size_t *len) {
+    host_kv_entry_t *entry = host_kv_find(ns, key);
+    if (entry == NULL || len == NULL) return false;
+
+    if (buf == NULL) {
+        *len = entry->len;
+        return true;
+    }
+    if (*len < entry->len) return false;
+
+    memcpy(buf, entry->value, entry->len);
+    *len = entry->len;
+    return true;
+}
+
+bool hal_kv_set_blob(const char *ns, const char *key, const void *buf, size_t len) {
+    if (len > HOST_KV_VALUE_MAX || strlen(ns) >= HOST_KV_NAME_MAX || strlen(key) >= HOST_KV_NAME_MAX) {
+        return false;
+    }
+
+    host_kv_entry_t *entry = host_kv_find(ns, key);
+    for (int i = 0; entry == NULL && i < HOST_KV_SLOTS; i++) {
+        if (!kv[i].used) {
+            entry = &kv[i];
+            entry->used = true;
+            strcpy(entry->ns, ns);
+            strcpy(entry->key, key);
+        }
+    }
+    if (entry == NULL) return false;
+
+    memcpy(entry->value, buf, len);
+    entry->len = len;
+    kv_writes++;
+    return true;
+}
+
+bool hal_kv_erase(const char *ns, const char *key) {
+    host_kv_entry_t *entry = host_kv_find(ns, key);
+    if (entry == NULL) return false;
+
+    memset(entry, 0, sizeof(*entry));
+    return true;
+}
@@ -0,0 +1,20 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hal.h"
+
+// Controls for the host HAL used by tests and tools. Time only moves when
+// told to (or through hal_delay_ms / hal_task_wait timeouts), so runs are
+// deterministic and as fast as the CPU allows.
+
+void hal_host_reset(void);
+void hal_host_set_time_us(uint64_t now_us);
+void hal_host_advance_ms(uint32_t ms);
+void hal_host_set_pin(int pin, int level);
+void hal_host_set_sensor_mask(const int *pins, size_t count, uint8_t mask);
+uint32_t hal_host_notify_count(void);
+uint32_t hal_host_kv_writes(void);
+
+#endif // HAL_HOST_H
@@ -0,0 +1,205 @@
+#include "tank_sim.h"
+#include "tank_monitor.h"
+#include "sensor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// tank_sim - replay a sensor trace through the monitor core for a grid of
+// stability/settle/debounce settings and print one result row per combination.
+
+#define SIM_MAX_VALUES      16
+#define SIM_FILE_TAIL_MS    600000u     // Replay past the last sample of a file trace
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options] (--scenario NAME | TRACE.csv)\n"
+            "  -s LIST        settle windows while flapping in ms, comma separated (default %d)\n"
+            "  -m LIST        settle windows after a lone change in ms (default %d)\n"
+            "  -d LIST        debounce delays in ms, comma separated (default %d)\n"
+            "  --scenario N   synthetic trace: fill, slosh or stuck\n"
+            "  --hours H      synthetic trace length (default 24)\n"
+            "  --seed N       synthetic trace seed (default 1)\n"
+            "  --dump         print the trace as CSV instead of replaying it\n"
+            "\n"
+            "Trace CSV lines are 't_ms,mask[,truth_mask]'; masks use the sensor bit\n"
+            "order (0 grey 1/3 .. 5 black full) and may be hex. '#' starts a comment.\n",
+            prog, STABILITY_DURATION, STABILITY_DURATION_MIN, DEBOUNCE_DELAY_MS);
+}
+
+static size_t parse_list(const char *arg, uint32_t *values) {
+    size_t count = 0;
+    char *end;
+
+    while (*arg && count < SIM_MAX_VALUES) {
+        values[count++] = (uint32_t)strtoul(arg, &end, 0);
+        if (end == arg) return 0;
+        arg = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+static bool load_trace(const char *path, tank_sim_trace_t *trace) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char line[128];
+    unsigned line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+        char *end;
+        unsigned long t_ms = strtoul(p, &end, 10);
+        if (*end != ',') goto bad_line;
+        unsigned long mask = strtoul(end + 1, &end, 0);
+        long truth = TANK_SIM_NO_TRUTH;
+        if (*end == ',') {
+            truth = (long)strtoul(end + 1, &end, 0);
+        }
+        if (mask > 0x3F || truth > 0x3F) goto bad_line;
+        if (trace->count > 0 && t_ms < trace->samples[trace->count - 1].t_ms) goto bad_line;
+
+        tank_sim_trace_append(trace, (uint32_t)t_ms, (uint8_t)mask, (int16_t)truth);
+        continue;
+
+    bad_line:
+        fprintf(stderr, "%s:%u: expected 't_ms,mask[,truth]' in time order\n", path, line_no);
+        fclose(f);
+        return false;
+    }
+
+    fclose(f);
+    trace->end_ms += SIM_FILE_TAIL_MS;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint32_t stability[SIM_MAX_VALUES] = { STABILITY_DURATION };
+    uint32_t settle_min[SIM_MAX_VALUES] = { STABILITY_DURATION_MIN };
+    uint32_t debounce[SIM_MAX_VALUES] = { DEBOUNCE_DELAY_MS };
+    size_t stability_count = 1, settle_min_count = 1, debounce_count = 1;
+    const char *scenario_name = NULL;
+    const char *path = NULL;
+    double hours = 24;
+    uint32_t seed = 1;
+    bool dump = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(arg, "-s") == 0 && has_value) {
+            stability_count = parse_list(argv[++i], stability);
+        } else if (strcmp(arg, "-m") == 0 && has_value) {
+            settle_min_count = parse_list(argv[++i], settle_min);
+        } else if (strcmp(arg, "-d") == 0 && has_value) {
+            debounce_count = parse_list(argv[++i], debounce);
+        } else if (strcmp(arg, "--scenario") == 0 && has_value) {
+            scenario_name = argv[++i];
+        } else if (strcmp(arg, "--hours") == 0 && has_value) {
+            hours = atof(argv[++i]);
+        } else if (strcmp(arg, "--seed") == 0 && has_value) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(arg, "--dump") == 0) {
+            dump = true;
+        } else if (arg[0] != '-' && path == NULL) {
+            path = arg;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if ((scenario_name == NULL) == (path == NULL) || stability_count == 0 || settle_min_count == 0 ||
+        debounce_count == 0 ||
+        hours <= 0 || hours > 1000) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    tank_sim_trace_t trace;
+    tank_sim_trace_init(&trace);
+
+    if (scenario_name) {
+        tank_sim_scenario_t scenario;
+        if (!tank_sim_scenario_from_name(scenario_name, &scenario)) {
+            fprintf(stderr, "unknown scenario '%s'\n", scenario_name);
+            return 2;
+        }
+        if (!tank_sim_generate(scenario, seed, (uint32_t)(hours * 3600000.0), &trace)) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    } else if (!load_trace(path, &trace)) {
+        return 1;
+    }
+
+    if (dump) {
+        printf("# t_ms,mask,truth_mask\n");
+        for (size_t i = 0; i < trace.count; i++) {
+            const tank_sim_sample_t *s = &trace.samples[i];
+            if (s->truth == TANK_SIM_NO_TRUTH) {
+                printf("%lu,0x%02x\n", (unsigned long)s->t_ms, s->mask);
+            } else {
+                printf("%lu,0x%02x,0x%02x\n", (unsigned long)s->t_ms, s->mask, (unsigned)s->truth);
+            }
+        }
+        tank_sim_trace_free(&trace);
+        return 0;
+    }
+
+    printf("# %s: %zu samples, %.2f h simulated\n", scenario_name ? scenario_name : path,
+           trace.count, trace.end_ms / 3600000.0);
+    printf("%10s %10s %11s %8s %12s %11s %7s %7s %7s %9s %10s\n",
+           "stable_ms", "settle_min", "debounce_ms", "settles", "mean_settle", "max_settle",
+           "alerts", "false", "notify", "wakeups", "wall_ms");
+
+    double total_wall_s = 0;
+    double total_sim_s = 0;
+
+    // One row per combination, debounce varying fastest
+    size_t runs = stability_count * settle_min_count * debounce_count;
+    for (size_t run = 0; run < runs; run++) {
+        tank_sim_params_t params = {
+            .stability_ms = stability[run / (settle_min_count * debounce_count)],
+            .settle_min_ms = settle_min[run / debounce_count % settle_min_count],
+            .debounce_ms = debounce[run % debounce_count],
+        };
+        tank_sim_result_t result;
+
+        clock_t start = clock();
+        tank_sim_run(&trace, &params, &result);
+        double wall_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+        total_wall_s += wall_s;
+        total_sim_s += trace.end_ms / 1000.0;
+
+        char false_alerts[16];
+        if (result.has_truth) {
+            snprintf(false_alerts, sizeof(false_alerts), "%lu", (unsigned long)result.false_alerts);
+        } else {
+            strcpy(false_alerts, "n/a");
+        }
+
+        printf("%10lu %10lu %11lu %8lu %11.1fs %10.1fs %7lu %7s %7lu %9lu %10.2f\n",
+               (unsigned long)params.stability_ms, (unsigned long)params.settle_min_ms,
+               (unsigned long)params.debounce_ms,
+               (unsigned long)result.settle_count,
+               result.settle_count ? result.settle_total_ms / 1000.0 / result.settle_count : 0.0,
+               result.settle_max_ms / 1000.0,
+               (unsigned long)result.alerts, false_alerts, (unsigned long)result.notifications,
+               (unsigned long)result.wakeups, wall_s * 1000);
+    }
+
+    if (total_wall_s > 0) {
+        printf("# %.0fx faster than real time\n", total_sim_s / total_wall_s);
+    }
+
+    tank_sim_trace_free(&trace);
+    return 0;
+}
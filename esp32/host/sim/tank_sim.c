@@ -0,0 +1,332 @@
+#include "tank_sim.h"
+#include "tank_monitor.h"
+#include "tank_payload.h"
+#include "edge_capture.h"
+#include "hal_host.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *scenario_names[TANK_SIM_SCENARIO_COUNT] = {
+    [TANK_SIM_SCENARIO_FILL] = "fill",
+    [TANK_SIM_SCENARIO_SLOSH] = "slosh",
+    [TANK_SIM_SCENARIO_STUCK] = "stuck",
+};
+
+void tank_sim_trace_init(tank_sim_trace_t *trace) {
+    memset(trace, 0, sizeof(*trace));
+}
+
+void tank_sim_trace_free(tank_sim_trace_t *trace) {
+    free(trace->samples);
+    tank_sim_trace_init(trace);
+}
+
+bool tank_sim_trace_append(tank_sim_trace_t *trace, uint32_t t_ms, uint8_t mask, int16_t truth) {
+    if (trace->count == trace->capacity) {
+        size_t capacity = trace->capacity ? trace->capacity * 2 : 256;
+        tank_sim_sample_t *samples = realloc(trace->samples, capacity * sizeof(*samples));
+        if (samples == NULL) return false;
+
+        trace->samples = samples;
+        trace->capacity = capacity;
+    }
+
+    trace->samples[trace->count++] = (tank_sim_sample_t){ .t_ms = t_ms, .mask = mask, .truth = truth };
+    if (t_ms > trace->end_ms) {
+        trace->end_ms = t_ms;
+    }
+    return true;
+}
+
+const char *tank_sim_scenario_name(tank_sim_scenario_t scenario) {
+    return scenario < TANK_SIM_SCENARIO_COUNT ? scenario_names[scenario] : "unknown";
+}
+
+bool tank_sim_scenario_from_name(const char *name, tank_sim_scenario_t *scenario) {
+    for (int i = 0; i < TANK_SIM_SCENARIO_COUNT; i++) {
+        if (strcmp(name, scenario_names[i]) == 0) {
+            *scenario = (tank_sim_scenario_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// xorshift32 - small, deterministic, good enough for synthetic noise
+static uint32_t sim_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static uint32_t sim_rand_range(uint32_t *rng, uint32_t min, uint32_t max) {
+    return min + sim_rand(rng) % (max - min + 1);
+}
+
+// Grey 1/3, 2/3 and Full cross their thresholds at 1/4, 2/4 and 3/4 of the
+// run, each with a burst of contact bounce. stuck_mask bits are held active.
+static bool sim_generate_fill(uint32_t *rng, uint32_t duration_ms, uint8_t stuck_mask, tank_sim_trace_t *trace) {
+    static const int fill_order[] = { SENSOR_GREY_1_3, SENSOR_GREY_2_3, SENSOR_GREY_FULL };
+    uint8_t mask = stuck_mask;
+    uint8_t truth = 0;
+
+    if (!tank_sim_trace_append(trace, 0, mask, truth)) return false;
+
+    for (int k = 0; k < 3; k++) {
+        uint8_t bit = 1u << fill_order[k];
+        uint32_t t = duration_ms / 4 * (k + 1);
+        uint32_t toggles = 2 * sim_rand_range(rng, 2, 7) + 1;
+
+        truth |= bit;
+        if (stuck_mask & bit) continue;
+
+        for (uint32_t i = 0; i < toggles; i++) {
+            mask ^= bit;
+            if (!tank_sim_trace_append(trace, t, mask, truth)) return false;
+            t += sim_rand_range(rng, 1, 30);
+        }
+    }
+
+    trace->end_ms = duration_ms;
+    return true;
+}
+
+// Driving for 20 minutes, parked for 10, repeated. While driving, waves push
+// one upper sensor across its threshold for up to 1.5 s every 0.5-4.5 s, and
+// now and then a long grade holds grey Full wet for 20-120 s.
+static bool sim_generate_slosh(uint32_t *rng, uint32_t duration_ms, tank_sim_trace_t *trace) {
+    const uint8_t truth = (1u << SENSOR_GREY_1_3) | (1u << SENSOR_GREY_2_3) | (1u << SENSOR_BLACK_1_3);
+    const uint32_t drive_ms = 20 * 60 * 1000;
+    const uint32_t park_ms = 10 * 60 * 1000;
+    static const struct { int sensor; bool wet; } waves[] = {
+        { SENSOR_GREY_FULL, true },
+        { SENSOR_GREY_2_3, false },
+        { SENSOR_BLACK_2_3, true },
+    };
+
+    if (!tank_sim_trace_append(trace, 0, truth, truth)) return false;
+
+    for (uint32_t leg = 0; leg < duration_ms; leg += drive_ms + park_ms) {
+        uint32_t leg_end = leg + drive_ms < duration_ms ? leg + drive_ms : duration_ms;
+        uint32_t t = leg;
+
+        while (t < leg_end) {
+            t += sim_rand_range(rng, 500, 4500);
+            uint32_t hold = sim_rand_range(rng, 200, 1500);
+            uint8_t mask = truth;
+
+            if (sim_rand(rng) % 100 < 2) {
+                // Long grade: grey reads Full with no sloshing on top
+                mask |= 1u << SENSOR_GREY_FULL;
+                hold = sim_rand_range(rng, 20000, 120000);
+            } else {
+                int w = (int)(sim_rand(rng) % 3);
+                uint8_t bit = 1u << waves[w].sensor;
+                mask = waves[w].wet ? (mask | bit) : (mask & ~bit);
+            }
+
+            if (t + hold >= leg_end) break;
+            if (!tank_sim_trace_append(trace, t, mask, truth)) return false;
+            t += hold;
+            if (!tank_sim_trace_append(trace, t, truth, truth)) return false;
+        }
+    }
+
+    trace->end_ms = duration_ms;
+    return true;
+}
+
+bool tank_sim_generate(tank_sim_scenario_t scenario, uint32_t seed, uint32_t duration_ms, tank_sim_trace_t *trace) {
+    uint32_t rng = seed ? seed : 1;
+
+    switch (scenario) {
+    case TANK_SIM_SCENARIO_FILL:
+        return sim_generate_fill(&rng, duration_ms, 0, trace);
+    case TANK_SIM_SCENARIO_SLOSH:
+        return sim_generate_slosh(&rng, duration_ms, trace);
+    case TANK_SIM_SCENARIO_STUCK:
+        return sim_generate_fill(&rng, duration_ms, 1u << SENSOR_GREY_FULL, trace);
+    default:
+        return false;
+    }
+}
+
+// Observer state for one replay. Tanks are indexed 0 grey, 1 black.
+typedef struct {
+    tank_sim_result_t *result;
+    uint8_t last_state[3];      // v2 state bytes, the notifier's change key
+    bool was_stable[2];
+    uint32_t unstable_since_ms[2];
+    uint32_t first_edge_ms[2];  // First edge of the current burst per tank
+    tank_level_t reported[2];   // Last stable level per tank
+    tank_level_t last_level[2];
+    int16_t truth;
+} sim_observer_t;
+
+static tank_level_t sim_truth_level(int16_t truth, bool is_grey) {
+    sensor_data_t sensors = { .mask = (uint8_t)truth };
+    return tank_monitor_determine_level(&sensors, is_grey);
+}
+
+// Mirror what the notifier and the app would do with the published state
+static void sim_observe(sim_observer_t *obs) {
+    tank_snapshot_t snap;
+    uint32_t now_ms = hal_time_ms();
+    tank_monitor_get_snapshot(&snap);
+
+    tank_payload_fields_t fields = {
+        .raw_mask = snap.raw_mask,
+        .grey_enabled = snap.grey_enabled,
+        .black_enabled = snap.black_enabled,
+        .system_stable = snap.system_stable,
+        .grey_stable = snap.grey_stable,
+        .black_stable = snap.black_stable,
+        .in_motion = snap.in_motion,
+        .grey_fault = snap.inconsistent_mask & (1u << SENSOR_STATS_TANK_GREY),
+        .black_fault = snap.inconsistent_mask & (1u << SENSOR_STATS_TANK_BLACK),
+    };
+    uint8_t payload[TANK_PAYLOAD_V2_LEN];
+    tank_payload_encode(TANK_PAYLOAD_V2, &fields, payload);
+    if (memcmp(payload, obs->last_state, sizeof(obs->last_state)) != 0) {
+        memcpy(obs->last_state, payload, sizeof(obs->last_state));
+        obs->result->notifications++;
+    }
+
+    tank_level_t levels[2] = { snap.grey_level, snap.black_level };
+    bool stable[2] = { snap.grey_stable, snap.black_stable };
+
+    for (int tank = 0; tank < 2; tank++) {
+        if (levels[tank] != obs->last_level[tank]) {
+            obs->last_level[tank] = levels[tank];
+            obs->result->level_changes++;
+        }
+
+        if (stable[tank] && !obs->was_stable[tank]) {
+            uint32_t settle_ms = now_ms - obs->unstable_since_ms[tank];
+            obs->result->settle_count++;
+            obs->result->settle_total_ms += settle_ms;
+            if (settle_ms > obs->result->settle_max_ms) {
+                obs->result->settle_max_ms = settle_ms;
+            }
+        } else if (!stable[tank] && obs->was_stable[tank]) {
+            // Count from the sensor edge, so debounce time is included
+            obs->unstable_since_ms[tank] = obs->first_edge_ms[tank];
+        }
+        obs->was_stable[tank] = stable[tank];
+
+        // The app alerts per tank as soon as that tank settles
+        if (!stable[tank] || levels[tank] == obs->reported[tank]) continue;
+
+        obs->reported[tank] = levels[tank];
+        if (levels[tank] == LEVEL_EMPTY) continue;
+
+        obs->result->alerts++;
+        if (obs->truth != TANK_SIM_NO_TRUTH && levels[tank] != sim_truth_level(obs->truth, tank == 0)) {
+            obs->result->false_alerts++;
+        }
+    }
+}
+
+// Same deadline rule as tank_monitor_task: next debounce settle, stability
+// expiry or sensor-statistics change
+static uint32_t sim_next_wait_ms(const edge_debouncer_t *debouncer) {
+    uint32_t wait = HAL_WAIT_FOREVER;
+
+    uint32_t settle_us = edge_debouncer_time_to_settle_us(debouncer, (uint32_t)hal_time_us());
+    if (settle_us != UINT32_MAX) {
+        wait = settle_us / 1000 + 1;
+    }
+
+    uint32_t stable_ms = tank_monitor_ms_until_next_check();
+    if (stable_ms != UINT32_MAX && stable_ms + 1 < wait) {
+        wait = stable_ms + 1;
+    }
+
+    return wait;
+}
+
+void tank_sim_run(const tank_sim_trace_t *trace, const tank_sim_params_t *params, tank_sim_result_t *result) {
+    sim_observer_t obs = {
+        .result = result,
+        .reported = { LEVEL_EMPTY, LEVEL_EMPTY },
+        .last_level = { LEVEL_EMPTY, LEVEL_EMPTY },
+        .truth = TANK_SIM_NO_TRUTH,
+    };
+    memset(result, 0, sizeof(*result));
+
+    hal_host_reset();
+    tank_monitor_set_listener(NULL);
+    tank_monitor_set_task(NULL);
+    tank_monitor_set_stability_window(params->settle_min_ms, params->stability_ms);
+    tank_monitor_set_enabled(true, true);
+    tank_monitor_init();
+    tank_monitor_apply_enable_request();
+
+    size_t next = 0;
+    uint8_t mask = 0;
+    if (trace->count > 0 && trace->samples[0].t_ms == 0) {
+        mask = trace->samples[0].mask;
+        obs.truth = trace->samples[0].truth;
+        next = 1;
+    }
+    for (size_t i = 0; i < trace->count && !result->has_truth; i++) {
+        result->has_truth = trace->samples[i].truth != TANK_SIM_NO_TRUTH;
+    }
+
+    edge_debouncer_t debouncer;
+    edge_debouncer_init(&debouncer, mask, params->debounce_ms * 1000);
+    sensor_data_t sensors = { .mask = mask };
+    tank_monitor_update_levels(&sensors);
+    tank_monitor_check_stability();
+    sim_observe(&obs);
+
+    while (1) {
+        uint32_t now_ms = hal_time_ms();
+        uint32_t wait = sim_next_wait_ms(&debouncer);
+        uint64_t deadline = wait == HAL_WAIT_FOREVER ? UINT64_MAX : (uint64_t)now_ms + wait;
+
+        if (next < trace->count && trace->samples[next].t_ms <= deadline) {
+            // Sensor edge interrupt(s)
+            const tank_sim_sample_t *sample = &trace->samples[next++];
+            hal_host_set_time_us((uint64_t)sample->t_ms * 1000);
+
+            uint8_t changed = mask ^ sample->mask;
+            for (int tank = 0; tank < 2; tank++) {
+                uint8_t tank_bits = (uint8_t)(0x07u << (tank * 3));
+                if ((changed & tank_bits) && !(debouncer.dirty_mask & tank_bits)) {
+                    obs.first_edge_ms[tank] = sample->t_ms;
+                }
+            }
+
+            for (int i = 0; i < SENSOR_COUNT; i++) {
+                if (!(changed & (1u << i))) continue;
+
+                sensor_edge_t edge = {
+                    .timestamp_us = (uint32_t)hal_time_us(),
+                    .sensor = (uint8_t)i,
+                    .level = (sample->mask >> i) & 1,
+                };
+                edge_debouncer_feed(&debouncer, &edge);
+            }
+            mask = sample->mask;
+            obs.truth = sample->truth;
+        } else if (deadline < trace->end_ms) {
+            hal_host_set_time_us(deadline * 1000);
+        } else {
+            break;
+        }
+
+        result->wakeups++;
+        if (edge_debouncer_settle(&debouncer, (uint32_t)hal_time_us())) {
+            sensors.mask = debouncer.stable_mask;
+            tank_monitor_update_levels(&sensors);
+        }
+        tank_monitor_check_stability();
+        sim_observe(&obs);
+    }
+
+    tank_monitor_set_stability_window(STABILITY_DURATION_MIN, STABILITY_DURATION);
+}
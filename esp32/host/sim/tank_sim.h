@@ -0,0 +1,70 @@
+#ifndef TANK_SIM_H
+#define TANK_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Replays six-channel sensor traces through the real monitor core on the
+// host HAL's virtual clock, the same way tank_monitor_task drives it in edge
+// capture mode: edges go through the debouncer, settled masks through
+// tank_monitor_update_levels() and every wakeup through
+// tank_monitor_check_stability().
+
+#define TANK_SIM_NO_TRUTH   (-1)
+
+// One trace line: the raw sensor mask from t_ms until the next sample, and
+// optionally the mask a perfect sensor would have reported (ground truth)
+typedef struct {
+    uint32_t t_ms;
+    uint8_t mask;
+    int16_t truth;          // Truth mask, or TANK_SIM_NO_TRUTH
+} tank_sim_sample_t;
+
+typedef struct {
+    tank_sim_sample_t *samples;
+    size_t count;
+    size_t capacity;
+    uint32_t end_ms;        // Replay runs until this time
+} tank_sim_trace_t;
+
+// Filter parameters under test
+typedef struct {
+    uint32_t stability_ms;      // Settle window while flapping (and at boot)
+    uint32_t settle_min_ms;     // Settle window after a lone change
+    uint32_t debounce_ms;
+} tank_sim_params_t;
+
+typedef struct {
+    uint32_t settle_count;      // Unstable -> stable transitions, per tank
+    uint64_t settle_total_ms;   // Summed time from the first sensor edge to stable
+    uint32_t settle_max_ms;
+    uint32_t alerts;            // Stable level reports the app would alert on
+    uint32_t false_alerts;      // Alerts that disagree with ground truth
+    bool has_truth;
+    uint32_t notifications;     // Payload changes the notifier would send
+    uint32_t level_changes;
+    uint32_t wakeups;           // Monitor task wakeups
+} tank_sim_result_t;
+
+typedef enum {
+    TANK_SIM_SCENARIO_FILL,     // Parked, grey tank slowly fills with contact bounce
+    TANK_SIM_SCENARIO_SLOSH,    // Driving with partly full tanks, waves flap the upper sensors
+    TANK_SIM_SCENARIO_STUCK,    // Grey Full sensor stuck active while the tank fills
+    TANK_SIM_SCENARIO_COUNT
+} tank_sim_scenario_t;
+
+// Trace helpers (heap-backed, grow as needed)
+void tank_sim_trace_init(tank_sim_trace_t *trace);
+void tank_sim_trace_free(tank_sim_trace_t *trace);
+bool tank_sim_trace_append(tank_sim_trace_t *trace, uint32_t t_ms, uint8_t mask, int16_t truth);
+
+// Synthetic scenarios, deterministic for a given seed
+const char *tank_sim_scenario_name(tank_sim_scenario_t scenario);
+bool tank_sim_scenario_from_name(const char *name, tank_sim_scenario_t *scenario);
+bool tank_sim_generate(tank_sim_scenario_t scenario, uint32_t seed, uint32_t duration_ms, tank_sim_trace_t *trace);
+
+// Replay
+void tank_sim_run(const tank_sim_trace_t *trace, const tank_sim_params_t *params, tank_sim_result_t *result);
+
+#endif // TANK_SIM_H
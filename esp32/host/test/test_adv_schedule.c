@@ -0,0 +1,104 @@
+#include "adv_schedule.h"
+#include "test_assert.h"
+
+static const uint8_t phone_a[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+static const uint8_t phone_b[6] = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void test_boot_runs_fast_then_slow(void) {
+    adv_schedule_t sched;
+    adv_schedule_init(&sched);
+
+    adv_schedule_boot(&sched, 1000);
+    TEST_ASSERT_EQ(ADV_TIER_FAST, sched.tier);
+    TEST_ASSERT_EQ(ADV_FAST_WINDOW_MS, adv_schedule_ms_to_next(&sched, 1000));
+    TEST_ASSERT(!adv_schedule_advance(&sched, 1000 + ADV_FAST_WINDOW_MS - 1));
+
+    TEST_ASSERT(adv_schedule_advance(&sched, 1000 + ADV_FAST_WINDOW_MS));
+    TEST_ASSERT_EQ(ADV_TIER_SLOW, sched.tier);
+    TEST_ASSERT_EQ(UINT32_MAX, adv_schedule_ms_to_next(&sched, 1000 + ADV_FAST_WINDOW_MS));
+    TEST_ASSERT(!adv_schedule_advance(&sched, 10000000));
+    TEST_ASSERT_EQ(ADV_FAST_WINDOW_MS, sched.tiers[ADV_TIER_FAST].advertised_ms);
+}
+
+static void test_bonded_peer_reconnects_on_directed(void) {
+    adv_schedule_t sched;
+    adv_schedule_init(&sched);
+    adv_schedule_boot(&sched, 0);
+    adv_schedule_connected(&sched, phone_a, false, 500);
+    TEST_ASSERT(!sched.active);
+
+    adv_schedule_disconnected(&sched, phone_a, true, 60000);
+    TEST_ASSERT_EQ(ADV_TIER_DIRECTED, sched.tier);
+    TEST_ASSERT(adv_schedule_connected(&sched, phone_a, true, 60090));
+
+    // Further clients are served by the slow tier
+    TEST_ASSERT_EQ(ADV_TIER_SLOW, sched.tier);
+    TEST_ASSERT_EQ(1, sched.tiers[ADV_TIER_DIRECTED].connects);
+    TEST_ASSERT_EQ(1, sched.reconnects);
+    TEST_ASSERT_EQ(90, sched.reconnect_last_ms);
+    TEST_ASSERT_EQ(90, adv_schedule_reconnect_avg_ms(&sched));
+}
+
+static void test_directed_falls_back_to_fast(void) {
+    adv_schedule_t sched;
+    adv_schedule_init(&sched);
+
+    adv_schedule_disconnected(&sched, phone_a, true, 0);
+    TEST_ASSERT(adv_schedule_advance(&sched, ADV_DIRECTED_WINDOW_MS));
+    TEST_ASSERT_EQ(ADV_TIER_FAST, sched.tier);
+
+    // Another phone connecting does not count as a reconnect
+    TEST_ASSERT(!adv_schedule_connected(&sched, phone_b, true, 2000));
+    TEST_ASSERT_EQ(ADV_TIER_FAST, sched.tier);
+    TEST_ASSERT(adv_schedule_connected(&sched, phone_a, true, 3000));
+    TEST_ASSERT_EQ(3000, sched.reconnect_last_ms);
+    TEST_ASSERT_EQ(2, sched.tiers[ADV_TIER_FAST].connects);
+}
+
+static void test_late_return_is_not_a_reconnect(void) {
+    adv_schedule_t sched;
+    adv_schedule_init(&sched);
+
+    adv_schedule_disconnected(&sched, phone_a, false, 0);
+    adv_schedule_advance(&sched, ADV_FAST_WINDOW_MS);
+    TEST_ASSERT(!adv_schedule_connected(&sched, phone_a, true, ADV_FAST_WINDOW_MS + 5000));
+    TEST_ASSERT_EQ(0, sched.reconnects);
+    TEST_ASSERT(!sched.awaiting_peer);
+}
+
+static void test_encode_layout(void) {
+    adv_schedule_t sched;
+    uint8_t buf[ADV_STATS_LEN];
+
+    adv_schedule_init(&sched);
+    adv_schedule_disconnected(&sched, phone_a, true, 0);
+    adv_schedule_connected(&sched, phone_a, true, 120);
+
+    TEST_ASSERT_EQ(ADV_STATS_LEN, adv_schedule_encode(&sched, 2, 1120, buf, sizeof(buf)));
+    TEST_ASSERT_EQ(ADV_STATS_VERSION, buf[0]);
+    TEST_ASSERT_EQ(ADV_TIER_SLOW, buf[1]);
+    TEST_ASSERT_EQ(2, buf[2]);
+    TEST_ASSERT_EQ(1, buf[3]);
+    TEST_ASSERT_EQ(1000, get_u32(buf + 4));
+    TEST_ASSERT_EQ(1, get_u32(buf + 8));                       // Directed starts
+    TEST_ASSERT_EQ(1, get_u32(buf + 12));                      // Directed connects
+    TEST_ASSERT_EQ(120, get_u32(buf + 16));                    // Directed time
+    TEST_ASSERT_EQ(1000, get_u32(buf + 8 + 12 * ADV_TIER_SLOW + 8)); // Slow time so far
+    TEST_ASSERT_EQ(1, get_u32(buf + 44));
+    TEST_ASSERT_EQ(120, get_u32(buf + 48));
+
+    TEST_ASSERT_EQ(0, adv_schedule_encode(&sched, 0, 0, buf, ADV_STATS_LEN - 1));
+}
+
+int main(void) {
+    RUN_TEST(test_boot_runs_fast_then_slow);
+    RUN_TEST(test_bonded_peer_reconnects_on_directed);
+    RUN_TEST(test_directed_falls_back_to_fast);
+    RUN_TEST(test_late_return_is_not_a_reconnect);
+    RUN_TEST(test_encode_layout);
+    return 0;
+}
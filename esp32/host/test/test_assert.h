@@ -0,0 +1,29 @@
+#ifndef TEST_ASSERT_H
+#define TEST_ASSERT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Minimal assertion helpers for the host test binaries
+#define TEST_ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #cond); \
+        exit(1); \
+    } \
+} while (0)
+
+#define TEST_ASSERT_EQ(expected, actual) do { \
+    long long _e = (long long)(expected), _a = (long long)(actual); \
+    if (_e != _a) { \
+        fprintf(stderr, "%s:%d: expected %s == %lld, got %lld\n", \
+                __FILE__, __LINE__, #actual, _e, _a); \
+        exit(1); \
+    } \
+} while (0)
+
+#define RUN_TEST(fn) do { \
+    fn(); \
+    printf("PASS %s\n", #fn); \
+} while (0)
+
+#endif // TEST_ASSERT_H
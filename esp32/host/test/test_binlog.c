@@ -0,0 +1,72 @@
+#include "binlog.h"
+#include "hal_host.h"
+#include "test_assert.h"
+#include <string.h>
+
+static void test_records_and_formats(void) {
+    hal_host_reset();
+    binlog_clear();
+
+    hal_host_set_time_us(5000000);
+    BINLOG(BINLOG_SENSORS, 0x09, 1, 2);
+
+    binlog_entry_t entries[2];
+    TEST_ASSERT_EQ(1, binlog_snapshot(entries, 2));
+    TEST_ASSERT_EQ(5000, entries[0].timestamp_ms);
+    TEST_ASSERT_EQ(BINLOG_SENSORS, entries[0].site);
+    TEST_ASSERT_EQ(0x09, entries[0].args[0]);
+    TEST_ASSERT_EQ(0, entries[0].args[3]);
+
+    char text[128];
+    binlog_format_entry(&entries[0], text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "Sensors - bits 0x09 Levels[G:1 B:2]") == 0);
+}
+
+static void test_rate_limit_counts_suppressed(void) {
+    hal_host_reset();
+    binlog_clear();
+    hal_host_set_time_us(60000000);
+
+    // GATT reads are limited to one entry per second
+    BINLOG(BINLOG_GATT_READ, 0, 42);
+    BINLOG(BINLOG_GATT_READ, 0, 42);
+    BINLOG(BINLOG_GATT_READ, 1, 42);
+    hal_host_advance_ms(1000);
+    BINLOG(BINLOG_GATT_READ, 1, 42);
+
+    // State-change sites are never limited
+    BINLOG(BINLOG_GATT_MTU, 0, 185);
+    BINLOG(BINLOG_GATT_MTU, 1, 185);
+
+    binlog_entry_t entries[8];
+    TEST_ASSERT_EQ(4, binlog_snapshot(entries, 8));
+    TEST_ASSERT_EQ(0, entries[0].suppressed);
+    TEST_ASSERT_EQ(2, entries[1].suppressed);
+    TEST_ASSERT_EQ(BINLOG_GATT_MTU, entries[2].site);
+    TEST_ASSERT_EQ(BINLOG_GATT_MTU, entries[3].site);
+
+    char text[128];
+    binlog_format_entry(&entries[1], text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "READ_EVT, conn_id 1, attr 42 (+2 suppressed)") == 0);
+}
+
+static void test_ring_keeps_newest(void) {
+    hal_host_reset();
+    binlog_clear();
+
+    for (int i = 0; i < BINLOG_RING_SIZE + 5; i++) {
+        BINLOG(BINLOG_SENSORS, i);
+    }
+
+    static binlog_entry_t entries[BINLOG_RING_SIZE];
+    TEST_ASSERT_EQ(BINLOG_RING_SIZE, binlog_snapshot(entries, BINLOG_RING_SIZE));
+    TEST_ASSERT_EQ(5, entries[0].args[0]);
+    TEST_ASSERT_EQ(BINLOG_RING_SIZE + 4, entries[BINLOG_RING_SIZE - 1].args[0]);
+}
+
+int main(void) {
+    RUN_TEST(test_records_and_formats);
+    RUN_TEST(test_rate_limit_counts_suppressed);
+    RUN_TEST(test_ring_keeps_newest);
+    return 0;
+}
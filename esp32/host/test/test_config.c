@@ -0,0 +1,149 @@
+#include "config.h"
+#include "sensor.h"
+#include "tank_monitor.h"
+#include "hal.h"
+#include "hal_host.h"
+#include "test_assert.h"
+#include <string.h>
+
+static void test_defaults_created_on_first_boot(void) {
+    tank_config_t config;
+    hal_host_reset();
+
+    tank_config_init_nvs();
+    tank_config_cache_init();
+    tank_config_get(&config);
+    TEST_ASSERT(config.grey_enabled);
+    TEST_ASSERT(config.black_enabled);
+    TEST_ASSERT(config.pin_set);
+    TEST_ASSERT(tank_config_check_pin((const uint8_t *)"000000", 6));
+    TEST_ASSERT_EQ(1, hal_host_kv_writes());
+}
+
+static void test_changes_persist_across_reload(void) {
+    tank_config_t config;
+    hal_host_reset();
+    tank_config_cache_init();
+
+    tank_config_set_pin((const uint8_t *)"123456");
+    tank_config_set_enabled(true, false);
+    TEST_ASSERT(tank_config_flush());
+
+    // Simulated reboot: reload the cache from storage
+    tank_config_cache_init();
+    tank_config_get(&config);
+    TEST_ASSERT(config.grey_enabled);
+    TEST_ASSERT(!config.black_enabled);
+    TEST_ASSERT(tank_config_check_pin((const uint8_t *)"123456", 6));
+    TEST_ASSERT(!tank_config_check_pin((const uint8_t *)"000000", 6));
+    TEST_ASSERT(!tank_config_check_pin((const uint8_t *)"12345", 5));
+}
+
+static void test_unchanged_enable_skips_write(void) {
+    hal_host_reset();
+    tank_config_cache_init();
+    uint32_t writes = hal_host_kv_writes();
+
+    tank_config_set_enabled(true, true);
+    TEST_ASSERT(tank_config_flush());
+    TEST_ASSERT_EQ(writes, hal_host_kv_writes());
+}
+
+static void test_erase_restores_defaults(void) {
+    tank_config_t config;
+    hal_host_reset();
+    tank_config_cache_init();
+    tank_config_set_enabled(false, false);
+
+    tank_config_erase();
+    tank_config_cache_init();
+    tank_config_get(&config);
+    TEST_ASSERT(config.grey_enabled);
+    TEST_ASSERT(config.black_enabled);
+}
+
+static void test_version0_blob_migrated(void) {
+    tank_config_t config;
+    hal_host_reset();
+
+    // Blob as written before timing was stored: flags, PIN, pin_set, zeroed reserved
+    uint8_t v0[TANK_CONFIG_V0_LEN] = { 1, 0, '4', '2', '4', '2', '4', '2', 0, 1 };
+    TEST_ASSERT(hal_kv_set_blob(NVS_NAMESPACE, NVS_KEY_CONFIG, v0, sizeof(v0)));
+    uint32_t writes = hal_host_kv_writes();
+
+    tank_config_cache_init();
+    tank_config_get(&config);
+    TEST_ASSERT(config.grey_enabled);
+    TEST_ASSERT(!config.black_enabled);
+    TEST_ASSERT(tank_config_check_pin((const uint8_t *)"424242", 6));
+    TEST_ASSERT_EQ(TANK_CONFIG_VERSION, config.version);
+    TEST_ASSERT_EQ(STABILITY_CHECK_INTERVAL, config.timing.sample_period_ms);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, config.timing.settle_min_ms);
+    TEST_ASSERT_EQ(STABILITY_DURATION, config.timing.settle_max_ms);
+    TEST_ASSERT_EQ(DEBOUNCE_DELAY_MS, config.timing.debounce_ms);
+
+    // Rewritten once in the new layout, then loaded without migrating again
+    TEST_ASSERT_EQ(writes + 1, hal_host_kv_writes());
+    size_t len = 0;
+    TEST_ASSERT(hal_kv_get_blob(NVS_NAMESPACE, NVS_KEY_CONFIG, NULL, &len));
+    TEST_ASSERT_EQ(sizeof(tank_config_t), len);
+    tank_config_cache_init();
+    TEST_ASSERT_EQ(writes + 1, hal_host_kv_writes());
+}
+
+static void test_timing_merged_validated_and_stored(void) {
+    tank_config_t config;
+    tank_timing_t applied;
+    hal_host_reset();
+    tank_config_cache_init();
+
+    // Zero fields keep their value
+    tank_timing_t update = { .sample_period_ms = 500, .debounce_ms = 250 };
+    TEST_ASSERT(tank_config_set_timing(&update, &applied));
+    TEST_ASSERT_EQ(500, applied.sample_period_ms);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, applied.settle_min_ms);
+    TEST_ASSERT_EQ(250, applied.debounce_ms);
+
+    // Checked as a whole: a minimum above the stored maximum is rejected...
+    tank_timing_t bad = { .settle_min_ms = STABILITY_DURATION + 1 };
+    TEST_ASSERT(!tank_config_set_timing(&bad, &applied));
+    bad = (tank_timing_t){ .sample_period_ms = TANK_CONFIG_SAMPLE_PERIOD_MIN_MS - 1 };
+    TEST_ASSERT(!tank_config_set_timing(&bad, &applied));
+    bad = (tank_timing_t){ .settle_max_ms = STABILITY_DURATION_LIMIT + 1 };
+    TEST_ASSERT(!tank_config_set_timing(&bad, &applied));
+
+    // ...but accepted with a larger maximum in the same write
+    update = (tank_timing_t){ .settle_min_ms = 120000, .settle_max_ms = 300000 };
+    TEST_ASSERT(tank_config_set_timing(&update, &applied));
+    TEST_ASSERT_EQ(500, applied.sample_period_ms);
+
+    tank_config_cache_init();
+    tank_config_get(&config);
+    TEST_ASSERT_EQ(500, config.timing.sample_period_ms);
+    TEST_ASSERT_EQ(120000, config.timing.settle_min_ms);
+    TEST_ASSERT_EQ(300000, config.timing.settle_max_ms);
+    TEST_ASSERT_EQ(250, config.timing.debounce_ms);
+}
+
+static void test_unchanged_timing_skips_write(void) {
+    tank_timing_t update;
+    hal_host_reset();
+    tank_config_cache_init();
+    uint32_t writes = hal_host_kv_writes();
+
+    tank_config_timing_defaults(&update);
+    TEST_ASSERT(tank_config_set_timing(&update, NULL));
+    TEST_ASSERT(tank_config_flush());
+    TEST_ASSERT_EQ(writes, hal_host_kv_writes());
+}
+
+int main(void) {
+    RUN_TEST(test_defaults_created_on_first_boot);
+    RUN_TEST(test_changes_persist_across_reload);
+    RUN_TEST(test_unchanged_enable_skips_write);
+    RUN_TEST(test_erase_restores_defaults);
+    RUN_TEST(test_version0_blob_migrated);
+    RUN_TEST(test_timing_merged_validated_and_stored);
+    RUN_TEST(test_unchanged_timing_skips_write);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "conn_policy.h"
+#include "test_assert.h"
+
+static void test_new_link_goes_active_then_idle(void) {
+    conn_policy_t policy;
+    conn_policy_init(&policy, 5000);
+
+    TEST_ASSERT_EQ(CONN_PROFILE_ACTIVE, conn_policy_evaluate(&policy, false, 5000));
+    TEST_ASSERT_EQ(CONN_PROFILE_NONE, conn_policy_evaluate(&policy, false, 6000));
+    TEST_ASSERT_EQ(CONN_POLICY_IDLE_MS - 1000, conn_policy_ms_to_idle(&policy, 6000));
+
+    TEST_ASSERT_EQ(CONN_PROFILE_IDLE, conn_policy_evaluate(&policy, false, 5000 + CONN_POLICY_IDLE_MS));
+    TEST_ASSERT_EQ(UINT32_MAX, conn_policy_ms_to_idle(&policy, 5000 + CONN_POLICY_IDLE_MS));
+    TEST_ASSERT_EQ(CONN_PROFILE_NONE, conn_policy_evaluate(&policy, false, 100000));
+}
+
+static void test_activity_returns_to_active(void) {
+    conn_policy_t policy;
+    conn_policy_init(&policy, 0);
+    conn_policy_evaluate(&policy, false, 0);
+    conn_policy_evaluate(&policy, false, CONN_POLICY_IDLE_MS);
+    TEST_ASSERT_EQ(CONN_PROFILE_IDLE, policy.requested);
+
+    conn_policy_note_activity(&policy, 30000);
+    TEST_ASSERT_EQ(CONN_PROFILE_ACTIVE, conn_policy_evaluate(&policy, false, 30000));
+
+    // A backfill in progress holds the link active however long it runs
+    TEST_ASSERT_EQ(CONN_PROFILE_NONE, conn_policy_evaluate(&policy, true, 30000 + 3 * CONN_POLICY_IDLE_MS));
+    TEST_ASSERT_EQ(CONN_PROFILE_IDLE, conn_policy_evaluate(&policy, false, 30000 + 4 * CONN_POLICY_IDLE_MS));
+}
+
+static void test_only_notify_bursts_count(void) {
+    conn_policy_t policy;
+    conn_policy_init(&policy, 0);
+    conn_policy_evaluate(&policy, false, 0);
+    conn_policy_evaluate(&policy, false, CONN_POLICY_IDLE_MS);
+
+    // One state change per window leaves the link idle
+    for (uint32_t t = 20000; t < 100000; t += CONN_POLICY_IDLE_MS) {
+        conn_policy_note_notify(&policy, t);
+        TEST_ASSERT_EQ(CONN_PROFILE_NONE, conn_policy_evaluate(&policy, false, t));
+    }
+
+    for (int i = 0; i < CONN_POLICY_NOTIFY_BUSY; i++) {
+        conn_policy_note_notify(&policy, 100000 + i * 100);
+    }
+    TEST_ASSERT_EQ(CONN_PROFILE_ACTIVE, conn_policy_evaluate(&policy, false, 101000));
+}
+
+static void test_update_results(void) {
+    conn_policy_t policy;
+    conn_policy_init(&policy, 0);
+    conn_policy_set_current(&policy, 36, 0, 500);
+
+    conn_policy_update_done(&policy, false, 0, 0, 0);
+    TEST_ASSERT_EQ(1, policy.rejects);
+    TEST_ASSERT_EQ(36, policy.interval);
+
+    conn_policy_update_done(&policy, true, CONN_IDLE_INT_MAX, CONN_IDLE_LATENCY, CONN_IDLE_TIMEOUT);
+    TEST_ASSERT_EQ(1, policy.updates);
+    TEST_ASSERT_EQ(CONN_IDLE_INT_MAX, policy.interval);
+    TEST_ASSERT_EQ(CONN_IDLE_LATENCY, policy.latency);
+
+    // Idle profile stays within iOS limits: max interval x (latency + 1) <= 2 s
+    // and the supervision timeout covers three such gaps
+    const conn_profile_params_t *idle = conn_policy_params(CONN_PROFILE_IDLE);
+    uint32_t gap_ms = idle->int_max * 125 / 100 * (idle->latency + 1);
+    TEST_ASSERT(gap_ms <= 2000);
+    TEST_ASSERT(idle->timeout * 10u > 3 * gap_ms);
+}
+
+int main(void) {
+    RUN_TEST(test_new_link_goes_active_then_idle);
+    RUN_TEST(test_activity_returns_to_active);
+    RUN_TEST(test_only_notify_bursts_count);
+    RUN_TEST(test_update_results);
+    return 0;
+}
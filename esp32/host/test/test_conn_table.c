@@ -0,0 +1,144 @@
+#include "conn_table.h"
+#include "test_assert.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Replays GATT connect/disconnect events for MAX_CONNECTIONS synthetic
+// clients in random order and checks the table against a simple model after
+// every event.
+
+typedef struct {
+    bool connected;
+    uint8_t bda[6];
+} model_client_t;
+
+static model_client_t model[CONN_TABLE_SLOTS];
+
+static void client_bda(uint16_t conn_id, unsigned generation, uint8_t bda[6]) {
+    static const uint8_t base[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x00};
+    memcpy(bda, base, 6);
+    bda[4] = (uint8_t)generation;
+    bda[5] = (uint8_t)conn_id;
+}
+
+static void check_against_model(conn_table_t *table) {
+    int expected = 0;
+    for (uint16_t id = 0; id < CONN_TABLE_SLOTS; id++) {
+        ble_conn_info_t *conn = conn_table_get(table, id);
+        if (model[id].connected) {
+            expected++;
+            TEST_ASSERT(conn != NULL);
+            TEST_ASSERT_EQ(id, conn->conn_id);
+            TEST_ASSERT(conn_table_find_bda(table, model[id].bda) == conn);
+        } else {
+            TEST_ASSERT(conn == NULL);
+        }
+    }
+    TEST_ASSERT_EQ(expected, table->count);
+
+    // Fan-out reaches every connected client exactly once, in conn_id order
+    int visited = 0;
+    int last = -1;
+    ble_conn_info_t *conn;
+    CONN_TABLE_FOREACH(table, conn) {
+        TEST_ASSERT(model[conn->conn_id].connected);
+        TEST_ASSERT((int)conn->conn_id > last);
+        last = conn->conn_id;
+        visited++;
+    }
+    TEST_ASSERT_EQ(expected, visited);
+}
+
+static void test_random_replay(void) {
+    conn_table_t table;
+    conn_table_init(&table);
+    memset(model, 0, sizeof(model));
+    srand(7);
+
+    unsigned generation = 0;
+    for (int event = 0; event < 5000; event++) {
+        uint16_t id = (uint16_t)(rand() % MAX_CONNECTIONS);
+
+        if (model[id].connected) {
+            TEST_ASSERT(conn_table_remove(&table, id));
+            model[id].connected = false;
+        } else {
+            generation++;
+            client_bda(id, generation, model[id].bda);
+            ble_conn_info_t *conn = conn_table_add(&table, id, model[id].bda);
+            TEST_ASSERT(conn != NULL);
+            TEST_ASSERT(conn->notifications_enabled);
+            TEST_ASSERT(!conn->is_encrypted);
+            TEST_ASSERT_EQ(BLE_DEFAULT_MTU, conn->mtu);
+            model[id].connected = true;
+        }
+        check_against_model(&table);
+    }
+}
+
+static void test_full_table_rejects_extra_client(void) {
+    conn_table_t table;
+    conn_table_init(&table);
+    uint8_t bda[6];
+
+    for (uint16_t id = 0; id < MAX_CONNECTIONS; id++) {
+        client_bda(id, 0, bda);
+        TEST_ASSERT(conn_table_add(&table, id, bda) != NULL);
+    }
+    client_bda(MAX_CONNECTIONS, 0, bda);
+    TEST_ASSERT(conn_table_add(&table, MAX_CONNECTIONS, bda) == NULL);
+    TEST_ASSERT(conn_table_add(&table, CONN_TABLE_SLOTS, bda) == NULL);
+    TEST_ASSERT_EQ(MAX_CONNECTIONS, table.count);
+
+    // A repeated connect on a live conn_id resets the slot without a new count
+    ble_conn_info_t *conn = conn_table_get(&table, 3);
+    conn->is_authenticated = true;
+    conn = conn_table_add(&table, 3, bda);
+    TEST_ASSERT(!conn->is_authenticated);
+    TEST_ASSERT_EQ(MAX_CONNECTIONS, table.count);
+
+    // Removing a middle client leaves the others in their slots
+    ble_conn_info_t *last = conn_table_get(&table, MAX_CONNECTIONS - 1);
+    TEST_ASSERT(conn_table_remove(&table, 2));
+    TEST_ASSERT(!conn_table_remove(&table, 2));
+    TEST_ASSERT(conn_table_get(&table, MAX_CONNECTIONS - 1) == last);
+    TEST_ASSERT(conn_table_add(&table, MAX_CONNECTIONS, bda) != NULL);
+}
+
+static void test_encode_links(void) {
+    conn_table_t table;
+    uint8_t buf[CONN_LINKS_MAX_LEN];
+    uint8_t bda[6];
+
+    conn_table_init(&table);
+    client_bda(1, 0, bda);
+    conn_table_add(&table, 1, bda);
+    client_bda(4, 0, bda);
+    ble_conn_info_t *conn = conn_table_add(&table, 4, bda);
+    conn_policy_init(&conn->policy, 1000);
+    conn_policy_evaluate(&conn->policy, false, 1000);
+    conn_policy_update_done(&conn->policy, true, 24, 0, 400);
+
+    TEST_ASSERT_EQ(4 + 2 * CONN_LINKS_ENTRY_LEN, conn_table_encode_links(&table, 71000, buf, sizeof(buf)));
+    TEST_ASSERT_EQ(CONN_LINKS_VERSION, buf[0]);
+    TEST_ASSERT_EQ(2, buf[1]);
+    TEST_ASSERT_EQ(CONN_LINKS_ENTRY_LEN, buf[2]);
+
+    // Entries follow conn_id order
+    const uint8_t *entry = buf + 4 + CONN_LINKS_ENTRY_LEN;
+    TEST_ASSERT_EQ(4, entry[0]);
+    TEST_ASSERT_EQ(CONN_PROFILE_ACTIVE, entry[1]);
+    TEST_ASSERT_EQ(24, entry[2] | (entry[3] << 8));
+    TEST_ASSERT_EQ(400, entry[6] | (entry[7] << 8));
+    TEST_ASSERT_EQ(1, entry[8]);
+    TEST_ASSERT_EQ(70000, entry[12] | (entry[13] << 8) | (entry[14] << 16));
+
+    TEST_ASSERT_EQ(0, conn_table_encode_links(&table, 0, buf, 4 + CONN_LINKS_ENTRY_LEN));
+}
+
+int main(void) {
+    RUN_TEST(test_random_replay);
+    RUN_TEST(test_full_table_rejects_extra_client);
+    RUN_TEST(test_encode_links);
+    return 0;
+}
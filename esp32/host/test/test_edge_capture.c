@@ -0,0 +1,138 @@
+#include "edge_capture.h"
+#include "test_assert.h"
+
+#define DEBOUNCE_US 100000
+
+static void push_edge(edge_ring_t *ring, uint32_t t_us, uint8_t sensor, uint8_t level) {
+    sensor_edge_t edge = { .timestamp_us = t_us, .sensor = sensor, .level = level };
+    edge_ring_push(ring, &edge);
+}
+
+static void drain(edge_ring_t *ring, edge_debouncer_t *deb) {
+    sensor_edge_t edge;
+    while (edge_ring_pop(ring, &edge)) {
+        edge_debouncer_feed(deb, &edge);
+    }
+}
+
+static void test_ring_preserves_order(void) {
+    edge_ring_t ring;
+    sensor_edge_t edge;
+    edge_ring_init(&ring);
+
+    for (uint32_t i = 0; i < 10; i++) {
+        push_edge(&ring, i * 10, (uint8_t)(i % SENSOR_COUNT), (uint8_t)(i & 1));
+    }
+    for (uint32_t i = 0; i < 10; i++) {
+        TEST_ASSERT(edge_ring_pop(&ring, &edge));
+        TEST_ASSERT_EQ(i * 10, edge.timestamp_us);
+        TEST_ASSERT_EQ(i % SENSOR_COUNT, edge.sensor);
+    }
+    TEST_ASSERT(!edge_ring_pop(&ring, &edge));
+}
+
+static void test_ring_overflow_counts_drops(void) {
+    edge_ring_t ring;
+    edge_ring_init(&ring);
+
+    for (uint32_t i = 0; i < EDGE_RING_SIZE + 5; i++) {
+        push_edge(&ring, i, 0, 1);
+    }
+    TEST_ASSERT_EQ(5, edge_ring_dropped(&ring));
+
+    // Indices keep working across many wrap-arounds of the storage
+    sensor_edge_t edge;
+    for (uint32_t round = 0; round < 1000; round++) {
+        while (edge_ring_pop(&ring, &edge)) {}
+        push_edge(&ring, round, 1, 0);
+        TEST_ASSERT(edge_ring_pop(&ring, &edge));
+        TEST_ASSERT_EQ(round, edge.timestamp_us);
+    }
+}
+
+static void test_bounce_burst_settles_once(void) {
+    edge_ring_t ring;
+    edge_debouncer_t deb;
+    edge_ring_init(&ring);
+    edge_debouncer_init(&deb, 0x00, DEBOUNCE_US);
+
+    // 20 edges of contact bounce on grey 1/3, ending triggered
+    uint32_t t = 1000;
+    for (int i = 0; i < 20; i++) {
+        t += 700;
+        push_edge(&ring, t, SENSOR_GREY_1_3, (uint8_t)((i & 1) == 0));
+    }
+    push_edge(&ring, t + 500, SENSOR_GREY_1_3, 1);
+    drain(&ring, &deb);
+
+    // Not yet quiet for the full window
+    TEST_ASSERT(!edge_debouncer_settle(&deb, t + 500 + DEBOUNCE_US - 1));
+    TEST_ASSERT_EQ(0x00, deb.stable_mask);
+    TEST_ASSERT_EQ(1, edge_debouncer_time_to_settle_us(&deb, t + 500 + DEBOUNCE_US - 1));
+
+    TEST_ASSERT(edge_debouncer_settle(&deb, t + 500 + DEBOUNCE_US));
+    TEST_ASSERT_EQ(1u << SENSOR_GREY_1_3, deb.stable_mask);
+    TEST_ASSERT_EQ(UINT32_MAX, edge_debouncer_time_to_settle_us(&deb, t + 500 + DEBOUNCE_US));
+
+    // Nothing pending, nothing changes
+    TEST_ASSERT(!edge_debouncer_settle(&deb, t + 10 * DEBOUNCE_US));
+}
+
+static void test_glitch_returning_to_original_is_ignored(void) {
+    edge_ring_t ring;
+    edge_debouncer_t deb;
+    edge_ring_init(&ring);
+    uint8_t initial = (1u << SENSOR_BLACK_1_3) | (1u << SENSOR_BLACK_2_3);
+    edge_debouncer_init(&deb, initial, DEBOUNCE_US);
+
+    push_edge(&ring, 5000, SENSOR_BLACK_2_3, 0);
+    push_edge(&ring, 5300, SENSOR_BLACK_2_3, 1);
+    drain(&ring, &deb);
+
+    TEST_ASSERT(!edge_debouncer_settle(&deb, 5300 + DEBOUNCE_US));
+    TEST_ASSERT_EQ(initial, deb.stable_mask);
+}
+
+static void test_independent_sensors_settle_separately(void) {
+    edge_ring_t ring;
+    edge_debouncer_t deb;
+    edge_ring_init(&ring);
+    edge_debouncer_init(&deb, 0x00, DEBOUNCE_US);
+
+    push_edge(&ring, 0, SENSOR_GREY_1_3, 1);
+    push_edge(&ring, 60000, SENSOR_BLACK_FULL, 1);
+    drain(&ring, &deb);
+
+    TEST_ASSERT_EQ(40000, edge_debouncer_time_to_settle_us(&deb, 60000));
+    TEST_ASSERT(edge_debouncer_settle(&deb, DEBOUNCE_US));
+    TEST_ASSERT_EQ(1u << SENSOR_GREY_1_3, deb.stable_mask);
+    TEST_ASSERT_EQ(60000, edge_debouncer_time_to_settle_us(&deb, DEBOUNCE_US));
+
+    TEST_ASSERT(edge_debouncer_settle(&deb, 60000 + DEBOUNCE_US));
+    TEST_ASSERT_EQ((1u << SENSOR_GREY_1_3) | (1u << SENSOR_BLACK_FULL), deb.stable_mask);
+}
+
+static void test_timestamp_wraparound(void) {
+    edge_ring_t ring;
+    edge_debouncer_t deb;
+    edge_ring_init(&ring);
+    edge_debouncer_init(&deb, 0x00, DEBOUNCE_US);
+
+    uint32_t t = UINT32_MAX - 30000;
+    push_edge(&ring, t, SENSOR_GREY_FULL, 1);
+    drain(&ring, &deb);
+
+    TEST_ASSERT(!edge_debouncer_settle(&deb, t + 50000));
+    TEST_ASSERT(edge_debouncer_settle(&deb, t + DEBOUNCE_US));
+    TEST_ASSERT_EQ(1u << SENSOR_GREY_FULL, deb.stable_mask);
+}
+
+int main(void) {
+    RUN_TEST(test_ring_preserves_order);
+    RUN_TEST(test_ring_overflow_counts_drops);
+    RUN_TEST(test_bounce_burst_settles_once);
+    RUN_TEST(test_glitch_returning_to_original_is_ignored);
+    RUN_TEST(test_independent_sensors_settle_separately);
+    RUN_TEST(test_timestamp_wraparound);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "metrics.h"
+#include "tank_monitor.h"
+#include "hal_host.h"
+#include "test_assert.h"
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void test_encode_layout(void) {
+    metrics_report_t report = {
+        .uptime_s = 3600,
+        .free_heap = 120000,
+        .min_free_heap = 98000,
+        .nvs_commits = 7,
+    };
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        report.counters[i] = 100 + i;
+    }
+    report.tasks[METRIC_TASK_NOTIFY].cpu_permille = 12;
+    report.tasks[METRIC_TASK_NOTIFY].stack_free_bytes = 640;
+
+    uint8_t buf[METRICS_BLOB_LEN];
+    TEST_ASSERT_EQ(0, metrics_encode(&report, buf, sizeof(buf) - 1));
+    TEST_ASSERT_EQ(METRICS_BLOB_LEN, metrics_encode(&report, buf, sizeof(buf)));
+
+    TEST_ASSERT_EQ(METRICS_BLOB_VERSION, buf[0]);
+    TEST_ASSERT_EQ(METRIC_COUNT, buf[1]);
+    TEST_ASSERT_EQ(METRIC_TASK_COUNT, buf[2]);
+    TEST_ASSERT_EQ(3600, get_u32(&buf[4]));
+    TEST_ASSERT_EQ(120000, get_u32(&buf[8]));
+    TEST_ASSERT_EQ(98000, get_u32(&buf[12]));
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        TEST_ASSERT_EQ(100 + i, get_u32(&buf[16 + 4 * i]));
+    }
+    TEST_ASSERT_EQ(7, get_u32(&buf[16 + 4 * METRIC_COUNT]));
+
+    const uint8_t *task = &buf[20 + 4 * METRIC_COUNT + 4 * METRIC_TASK_NOTIFY];
+    TEST_ASSERT_EQ(12, task[0] | (task[1] << 8));
+    TEST_ASSERT_EQ(640, task[2] | (task[3] << 8));
+}
+
+static void test_monitor_counts_samples_and_changes(void) {
+    hal_host_reset();
+    tank_monitor_init();
+    tank_monitor_set_enabled(true, true);
+
+    uint32_t samples = metrics_get(METRIC_SENSOR_SAMPLES);
+    uint32_t changes = metrics_get(METRIC_LEVEL_CHANGES);
+
+    // The first sample only sets the boot level
+    sensor_data_t sensors = { .mask = 0 };
+    tank_monitor_update_levels(&sensors);
+    tank_monitor_check_stability();
+    sensors.mask = 1u << SENSOR_GREY_1_3;
+    tank_monitor_update_levels(&sensors);
+    tank_monitor_check_stability();
+    tank_monitor_update_levels(&sensors);
+    tank_monitor_check_stability();
+
+    TEST_ASSERT_EQ(samples + 3, metrics_get(METRIC_SENSOR_SAMPLES));
+    TEST_ASSERT_EQ(changes + 1, metrics_get(METRIC_LEVEL_CHANGES));
+}
+
+int main(void) {
+    RUN_TEST(test_encode_layout);
+    RUN_TEST(test_monitor_counts_samples_and_changes);
+    return 0;
+}
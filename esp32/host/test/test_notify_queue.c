@@ -0,0 +1,61 @@
+#include "notify_queue.h"
+#include "test_assert.h"
+
+static const uint8_t first[3] = {2, 0x01, 0x04};
+static const uint8_t second[3] = {2, 0x03, 0x04};
+
+static void test_send_records_latency(void) {
+    notify_queue_t queue;
+    notify_queue_init(&queue);
+    TEST_ASSERT(!notify_queue_ready(&queue));
+
+    notify_queue_put(&queue, first, sizeof(first), 1000);
+    TEST_ASSERT(notify_queue_ready(&queue));
+    notify_queue_sent(&queue, 1400);
+
+    TEST_ASSERT(!notify_queue_ready(&queue));
+    TEST_ASSERT_EQ(1, queue.sent);
+    TEST_ASSERT_EQ(400, queue.latency_max_us);
+    TEST_ASSERT_EQ(400, notify_queue_latency_avg_us(&queue));
+}
+
+static void test_congestion_keeps_latest_only(void) {
+    notify_queue_t queue;
+    notify_queue_init(&queue);
+
+    notify_queue_set_congested(&queue, true);
+    notify_queue_put(&queue, first, sizeof(first), 1000);
+    notify_queue_put(&queue, second, sizeof(second), 5000);
+    TEST_ASSERT(!notify_queue_ready(&queue));
+    TEST_ASSERT_EQ(1, queue.coalesced);
+    TEST_ASSERT_EQ(0x03, queue.data[1]);
+
+    // Latency runs from the first value that was held back
+    notify_queue_set_congested(&queue, false);
+    TEST_ASSERT(notify_queue_ready(&queue));
+    notify_queue_sent(&queue, 9000);
+    TEST_ASSERT_EQ(8000, queue.latency_max_us);
+}
+
+static void test_failed_send_stays_queued(void) {
+    notify_queue_t queue;
+    notify_queue_init(&queue);
+
+    notify_queue_put(&queue, first, sizeof(first), 0);
+    notify_queue_send_failed(&queue);
+    TEST_ASSERT(notify_queue_ready(&queue));
+    TEST_ASSERT_EQ(1, queue.send_errors);
+    TEST_ASSERT_EQ(0, queue.sent);
+
+    // Oversized values are rejected rather than truncated
+    uint8_t big[NOTIFY_QUEUE_MAX_LEN + 1] = {0};
+    notify_queue_put(&queue, big, sizeof(big), 0);
+    TEST_ASSERT_EQ(sizeof(first), queue.len);
+}
+
+int main(void) {
+    RUN_TEST(test_send_records_latency);
+    RUN_TEST(test_congestion_keeps_latest_only);
+    RUN_TEST(test_failed_send_stays_queued);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "sample_sched.h"
+#include "test_assert.h"
+
+#define PERIOD_US 200000
+
+static void test_grid_does_not_drift(void) {
+    sample_sched_t sched;
+    uint64_t now = 5000000;
+
+    sample_sched_init(&sched, PERIOD_US, now);
+    TEST_ASSERT_EQ(0, sample_sched_wait_ms(&sched, now));
+
+    // Each sample starts 3 ms late and takes 120 ms, yet the deadlines stay
+    // on the 200 ms grid instead of sliding by the work time
+    for (int i = 0; i < 10; i++) {
+        now = 5000000 + (uint64_t)i * PERIOD_US + 3000;
+        TEST_ASSERT_EQ(0, sample_sched_start(&sched, now));
+        TEST_ASSERT_EQ(5000000 + (uint64_t)(i + 1) * PERIOD_US, sched.next_us);
+        now += 120000;
+        TEST_ASSERT_EQ(77, sample_sched_wait_ms(&sched, now));
+    }
+
+    TEST_ASSERT_EQ(10, sched.wakes);
+    TEST_ASSERT_EQ(0, sched.missed);
+    TEST_ASSERT_EQ(PERIOD_US, sched.period_min_us);
+    TEST_ASSERT_EQ(PERIOD_US, sched.period_max_us);
+    TEST_ASSERT_EQ(PERIOD_US, sample_sched_period_avg_us(&sched));
+    TEST_ASSERT_EQ(3000, sched.late_max_us);
+}
+
+static void test_wait_rounds_up(void) {
+    sample_sched_t sched;
+
+    sample_sched_init(&sched, PERIOD_US, 1000);
+    sample_sched_start(&sched, 1000);
+    TEST_ASSERT_EQ(1, sample_sched_wait_ms(&sched, 1000 + PERIOD_US - 1));
+    TEST_ASSERT_EQ(0, sample_sched_wait_ms(&sched, 1000 + PERIOD_US));
+}
+
+static void test_overrun_skips_and_counts_missed(void) {
+    sample_sched_t sched;
+
+    sample_sched_init(&sched, PERIOD_US, 0);
+    sample_sched_start(&sched, 0);
+
+    // Blocked until 650 ms: this sample serves the 200 ms deadline 450 ms
+    // late, and the ones at 400 and 600 ms are skipped
+    TEST_ASSERT_EQ(2, sample_sched_start(&sched, 650000));
+    TEST_ASSERT_EQ(800000, sched.next_us);
+    TEST_ASSERT_EQ(2, sched.missed);
+    TEST_ASSERT_EQ(650000, sched.period_max_us);
+    TEST_ASSERT_EQ(450000, sched.late_max_us);
+
+    TEST_ASSERT_EQ(0, sample_sched_start(&sched, 800000));
+    TEST_ASSERT_EQ(150000, sched.period_min_us);
+}
+
+static void test_period_change_keeps_grid_anchor(void) {
+    sample_sched_t sched;
+
+    sample_sched_init(&sched, PERIOD_US, 0);
+    sample_sched_start(&sched, 0);
+    sample_sched_start(&sched, 200000);
+    TEST_ASSERT_EQ(400000, sched.next_us);
+
+    // The next deadline is one new period after the 200 ms sample's deadline
+    sample_sched_set_period(&sched, 50000);
+    TEST_ASSERT_EQ(250000, sched.next_us);
+    TEST_ASSERT_EQ(0, sample_sched_start(&sched, 250000));
+    TEST_ASSERT_EQ(300000, sched.next_us);
+
+    sample_sched_set_period(&sched, 1000000);
+    TEST_ASSERT_EQ(1250000, sched.next_us);
+}
+
+static void test_edge_deadlines(void) {
+    sample_sched_t sched;
+
+    sample_sched_init(&sched, 0, 0);
+    sample_sched_note_deadline(&sched, 1000000, 1008000);
+    sample_sched_note_deadline(&sched, 2000000, 1990000);
+    sample_sched_note_deadline(&sched, 3000000, 3000000 + SAMPLE_SCHED_MISS_SLACK_US + 1);
+
+    TEST_ASSERT_EQ(3, sched.wakes);
+    TEST_ASSERT_EQ(1, sched.missed);
+    TEST_ASSERT_EQ(0, sample_sched_period_avg_us(&sched));
+}
+
+static void test_percentiles(void) {
+    sample_sched_t sched;
+
+    sample_sched_init(&sched, 0, 0);
+    TEST_ASSERT_EQ(0, sample_sched_late_percentile_us(&sched, 50));
+
+    // 90 wakes within 500 us, 8 at 4 ms, 2 at 300 ms
+    for (int i = 0; i < 90; i++) sample_sched_note_deadline(&sched, 0, 200);
+    for (int i = 0; i < 8; i++) sample_sched_note_deadline(&sched, 0, 4000);
+    for (int i = 0; i < 2; i++) sample_sched_note_deadline(&sched, 0, 300000);
+
+    TEST_ASSERT_EQ(500, sample_sched_late_percentile_us(&sched, 50));
+    TEST_ASSERT_EQ(500, sample_sched_late_percentile_us(&sched, 90));
+    TEST_ASSERT_EQ(5000, sample_sched_late_percentile_us(&sched, 95));
+    TEST_ASSERT_EQ(300000, sample_sched_late_percentile_us(&sched, 99));
+    TEST_ASSERT_EQ(300000, sample_sched_late_percentile_us(&sched, 100));
+}
+
+static void test_encode_layout(void) {
+    sample_sched_t sched;
+    uint8_t buf[SAMPLE_SCHED_STATS_LEN];
+
+    sample_sched_init(&sched, PERIOD_US, 0);
+    sample_sched_start(&sched, 0);
+    sample_sched_start(&sched, 650000);
+
+    TEST_ASSERT_EQ(SAMPLE_SCHED_STATS_LEN, sample_sched_encode(&sched, buf, sizeof(buf)));
+    TEST_ASSERT_EQ(0, sample_sched_encode(&sched, buf, sizeof(buf) - 1));
+    TEST_ASSERT_EQ(SAMPLE_SCHED_STATS_VERSION, buf[0]);
+    TEST_ASSERT_EQ(0, buf[1]);
+    TEST_ASSERT_EQ(SAMPLE_SCHED_LATE_BINS, buf[2]);
+    TEST_ASSERT_EQ(PERIOD_US, buf[4] | (buf[5] << 8) | (buf[6] << 16));
+    TEST_ASSERT_EQ(2, buf[8]);
+    TEST_ASSERT_EQ(2, buf[12]);
+    TEST_ASSERT_EQ(650000, buf[24] | (buf[25] << 8) | (buf[26] << 16));
+    TEST_ASSERT_EQ(450000, buf[40] | (buf[41] << 8) | (buf[42] << 16));
+    TEST_ASSERT_EQ(1, buf[44]);
+    TEST_ASSERT_EQ(1, buf[44 + 4 * (SAMPLE_SCHED_LATE_BINS - 2)]);
+}
+
+int main(void) {
+    RUN_TEST(test_grid_does_not_drift);
+    RUN_TEST(test_wait_rounds_up);
+    RUN_TEST(test_overrun_skips_and_counts_missed);
+    RUN_TEST(test_period_change_keeps_grid_anchor);
+    RUN_TEST(test_edge_deadlines);
+    RUN_TEST(test_percentiles);
+    RUN_TEST(test_encode_layout);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "sensor_filter.h"
+#include "test_assert.h"
+
+static void test_single_glitch_is_rejected(void) {
+    sensor_vote_filter_t filter;
+    sensor_vote_init(&filter, 3, 5, 0x00);
+
+    TEST_ASSERT_EQ(0x00, sensor_vote_push(&filter, 1u << SENSOR_GREY_FULL));
+    TEST_ASSERT_EQ(0x00, sensor_vote_push(&filter, 0x00));
+    TEST_ASSERT_EQ(0x00, sensor_vote_push(&filter, 0x00));
+}
+
+static void test_change_accepted_after_threshold_samples(void) {
+    sensor_vote_filter_t filter;
+    uint8_t level = (1u << SENSOR_BLACK_1_3) | (1u << SENSOR_BLACK_2_3);
+    sensor_vote_init(&filter, 3, 5, 0x00);
+
+    TEST_ASSERT_EQ(0x00, sensor_vote_push(&filter, level));
+    TEST_ASSERT_EQ(0x00, sensor_vote_push(&filter, level));
+    TEST_ASSERT_EQ(level, sensor_vote_push(&filter, level));
+
+    // And the reverse needs the same majority
+    TEST_ASSERT_EQ(level, sensor_vote_push(&filter, 0x00));
+    TEST_ASSERT_EQ(level, sensor_vote_push(&filter, 0x00));
+    TEST_ASSERT_EQ(0x00, sensor_vote_push(&filter, 0x00));
+}
+
+static void test_sensors_vote_independently(void) {
+    sensor_vote_filter_t filter;
+    sensor_vote_init(&filter, 2, 3, 0x00);
+
+    TEST_ASSERT_EQ(0x00, sensor_vote_push(&filter, 0x01));
+    TEST_ASSERT_EQ(0x01, sensor_vote_push(&filter, 0x03));
+    TEST_ASSERT_EQ(0x03, sensor_vote_push(&filter, 0x02));
+    TEST_ASSERT_EQ(0x02, sensor_vote_push(&filter, 0x00));
+}
+
+static void test_invalid_parameters_fall_back_to_majority(void) {
+    sensor_vote_filter_t filter;
+    sensor_vote_init(&filter, 9, 0, SENSOR_MASK_ALL);
+
+    TEST_ASSERT_EQ(SENSOR_VOTE_HISTORY_MAX, filter.window);
+    TEST_ASSERT_EQ(SENSOR_VOTE_HISTORY_MAX / 2 + 1, filter.threshold);
+    TEST_ASSERT_EQ(SENSOR_MASK_ALL, filter.output);
+}
+
+int main(void) {
+    RUN_TEST(test_single_glitch_is_rejected);
+    RUN_TEST(test_change_accepted_after_threshold_samples);
+    RUN_TEST(test_sensors_vote_independently);
+    RUN_TEST(test_invalid_parameters_fall_back_to_majority);
+    return 0;
+}
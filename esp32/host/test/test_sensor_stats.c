@@ -0,0 +1,82 @@
+#include "sensor_stats.h"
+#include "test_assert.h"
+
+static sensor_stats_t stats;
+
+static void test_transitions_roll_out_of_window(void) {
+    sensor_stats_init(&stats, 0, 0);
+
+    sensor_stats_update(&stats, 1u << SENSOR_GREY_FULL, 1000);
+    sensor_stats_update(&stats, 0, 2000);
+    TEST_ASSERT_EQ(2, sensor_stats_recent(&stats, SENSOR_GREY_FULL));
+    TEST_ASSERT_EQ(2, stats.channels[SENSOR_GREY_FULL].transitions);
+    TEST_ASSERT_EQ(0, sensor_stats_recent(&stats, SENSOR_GREY_1_3));
+
+    // Still inside the window one bucket short of a full rotation
+    sensor_stats_update(&stats, 0, SENSOR_STATS_WINDOW_MS - 1);
+    TEST_ASSERT_EQ(2, sensor_stats_recent_total(&stats));
+
+    sensor_stats_update(&stats, 0, SENSOR_STATS_WINDOW_MS + 1);
+    TEST_ASSERT_EQ(0, sensor_stats_recent_total(&stats));
+    TEST_ASSERT_EQ(2, stats.channels[SENSOR_GREY_FULL].transitions);
+}
+
+static void test_dwell_histogram(void) {
+    sensor_stats_init(&stats, 0, 0);
+
+    sensor_stats_update(&stats, 1u << SENSOR_BLACK_1_3, 500);      // Dry for 0.5 s
+    sensor_stats_update(&stats, 0, 500 + 40000);                    // Wet for 40 s
+    sensor_stats_update(&stats, 1u << SENSOR_BLACK_1_3, 3600000);  // Dry for about an hour
+
+    const sensor_stats_channel_t *ch = &stats.channels[SENSOR_BLACK_1_3];
+    TEST_ASSERT_EQ(1, ch->dwell[0]);
+    TEST_ASSERT_EQ(1, ch->dwell[3]);
+    TEST_ASSERT_EQ(1, ch->dwell[SENSOR_STATS_DWELL_BINS - 1]);
+}
+
+static void test_motion_enters_and_leaves(void) {
+    uint32_t t = 0;
+    uint8_t mask = 1u << SENSOR_GREY_1_3;
+    sensor_stats_init(&stats, mask, 0);
+
+    // Waves wet grey Full every couple of seconds
+    for (int i = 0; i < SENSOR_STATS_MOTION_ENTER - 1; i++) {
+        t += 2000;
+        TEST_ASSERT(!sensor_stats_update(&stats, mask ^= 1u << SENSOR_GREY_FULL, t));
+    }
+    t += 2000;
+    TEST_ASSERT(sensor_stats_update(&stats, mask ^= 1u << SENSOR_GREY_FULL, t));
+    TEST_ASSERT(stats.in_motion);
+
+    // Leaves only once the window has drained
+    uint32_t wait = sensor_stats_ms_until_change(&stats, t);
+    TEST_ASSERT(wait <= SENSOR_STATS_BUCKET_MS);
+    TEST_ASSERT(!sensor_stats_update(&stats, mask, t + SENSOR_STATS_BUCKET_MS));
+    TEST_ASSERT(sensor_stats_update(&stats, mask, t + SENSOR_STATS_WINDOW_MS));
+    TEST_ASSERT(!stats.in_motion);
+}
+
+static void test_inconsistent_tank_flagged_after_delay(void) {
+    uint8_t stuck = (1u << SENSOR_GREY_FULL) | (1u << SENSOR_BLACK_1_3);
+    sensor_stats_init(&stats, 0, 0);
+
+    // Grey Full wet while 1/3 and 2/3 are dry; black reads a clean 1/3
+    TEST_ASSERT(!sensor_stats_update(&stats, stuck, 1000));
+    TEST_ASSERT_EQ(SENSOR_STATS_INCONSISTENT_MS, sensor_stats_ms_until_change(&stats, 1000));
+    TEST_ASSERT(!sensor_stats_update(&stats, stuck, 1000 + SENSOR_STATS_INCONSISTENT_MS - 1));
+    TEST_ASSERT(sensor_stats_update(&stats, stuck, 1000 + SENSOR_STATS_INCONSISTENT_MS));
+    TEST_ASSERT_EQ(1u << SENSOR_STATS_TANK_GREY, stats.inconsistent_mask);
+
+    // Tank fills up to the stuck sensor - readings agree again
+    uint8_t full = (1u << SENSOR_GREY_1_3) | (1u << SENSOR_GREY_2_3) | (1u << SENSOR_GREY_FULL);
+    TEST_ASSERT(sensor_stats_update(&stats, full, 200000));
+    TEST_ASSERT_EQ(0, stats.inconsistent_mask);
+}
+
+int main(void) {
+    RUN_TEST(test_transitions_roll_out_of_window);
+    RUN_TEST(test_dwell_histogram);
+    RUN_TEST(test_motion_enters_and_leaves);
+    RUN_TEST(test_inconsistent_tank_flagged_after_delay);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "tank_command.h"
+#include "test_assert.h"
+
+static void test_parse_splits_batch(void) {
+    static const uint8_t write[] = {
+        TANK_COMMAND_VERSION,
+        TANK_CMD_AUTH, 6, '1', '2', '3', '4', '5', '6',
+        TANK_CMD_SET_FORMAT, 1, 2,
+        TANK_CMD_SNAPSHOT, 0,
+    };
+    tank_command_op_t ops[TANK_COMMAND_MAX_OPS];
+
+    TEST_ASSERT_EQ(3, tank_command_parse(write, sizeof(write), ops, TANK_COMMAND_MAX_OPS));
+    TEST_ASSERT_EQ(TANK_CMD_AUTH, ops[0].type);
+    TEST_ASSERT_EQ(6, ops[0].len);
+    TEST_ASSERT_EQ('1', ops[0].value[0]);
+    TEST_ASSERT_EQ(TANK_CMD_SET_FORMAT, ops[1].type);
+    TEST_ASSERT_EQ(2, ops[1].value[0]);
+    TEST_ASSERT_EQ(TANK_CMD_SNAPSHOT, ops[2].type);
+    TEST_ASSERT_EQ(0, ops[2].len);
+}
+
+static void test_parse_rejects_malformed(void) {
+    tank_command_op_t ops[2];
+    static const uint8_t wrong_version[] = {9, TANK_CMD_SNAPSHOT, 0};
+    static const uint8_t empty[] = {TANK_COMMAND_VERSION};
+    static const uint8_t overrun[] = {TANK_COMMAND_VERSION, TANK_CMD_AUTH, 6, '1', '2'};
+    static const uint8_t dangling[] = {TANK_COMMAND_VERSION, TANK_CMD_SNAPSHOT, 0, TANK_CMD_SNAPSHOT};
+    static const uint8_t too_many[] = {TANK_COMMAND_VERSION, TANK_CMD_SNAPSHOT, 0,
+                                       TANK_CMD_SNAPSHOT, 0, TANK_CMD_SNAPSHOT, 0};
+
+    TEST_ASSERT_EQ(-1, tank_command_parse(wrong_version, sizeof(wrong_version), ops, 2));
+    TEST_ASSERT_EQ(-1, tank_command_parse(empty, sizeof(empty), ops, 2));
+    TEST_ASSERT_EQ(-1, tank_command_parse(overrun, sizeof(overrun), ops, 2));
+    TEST_ASSERT_EQ(-1, tank_command_parse(dangling, sizeof(dangling), ops, 2));
+    TEST_ASSERT_EQ(-1, tank_command_parse(too_many, sizeof(too_many), ops, 2));
+    TEST_ASSERT_EQ(-1, tank_command_parse(empty, 0, ops, 2));
+
+    // A second PIN guess in the same write
+    static const uint8_t two_auths[] = {TANK_COMMAND_VERSION,
+                                        TANK_CMD_AUTH, 6, '1', '2', '3', '4', '5', '6',
+                                        TANK_CMD_AUTH, 6, '0', '0', '0', '0', '0', '0'};
+    tank_command_op_t auth_ops[TANK_COMMAND_MAX_OPS];
+    TEST_ASSERT_EQ(-1, tank_command_parse(two_auths, sizeof(two_auths), auth_ops, TANK_COMMAND_MAX_OPS));
+}
+
+static void test_value_lengths(void) {
+    TEST_ASSERT_EQ(6, tank_command_value_len(TANK_CMD_AUTH));
+    TEST_ASSERT_EQ(2, tank_command_value_len(TANK_CMD_SET_CONFIG));
+    TEST_ASSERT_EQ(8, tank_command_value_len(TANK_CMD_SET_SAMPLING));
+    TEST_ASSERT_EQ(0, tank_command_value_len(TANK_CMD_SNAPSHOT));
+    TEST_ASSERT_EQ(-1, tank_command_value_len(0x7F));
+}
+
+static void test_result_entries_and_overflow(void) {
+    uint8_t buf[12];
+    static const uint8_t snapshot[] = {1, 2, 3, 4};
+    tank_command_result_t result;
+
+    tank_command_result_init(&result, buf, sizeof(buf));
+    TEST_ASSERT(tank_command_result_add(&result, TANK_CMD_AUTH, 0, NULL, 0));
+    TEST_ASSERT_EQ(5, result.len);
+
+    // 7 bytes left: a 5-byte value needs 8, a 4-byte value fills it exactly
+    TEST_ASSERT(!tank_command_result_add(&result, TANK_CMD_SNAPSHOT, 0, snapshot, 5));
+    TEST_ASSERT_EQ(5, result.len);
+    TEST_ASSERT(tank_command_result_add(&result, TANK_CMD_SNAPSHOT, 0, snapshot, 4));
+    TEST_ASSERT_EQ(12, result.len);
+    TEST_ASSERT(!tank_command_result_add(&result, TANK_CMD_AUTH, 0x89, NULL, 0));
+
+    TEST_ASSERT_EQ(TANK_COMMAND_VERSION, buf[0]);
+    TEST_ASSERT_EQ(2, buf[1]);
+    TEST_ASSERT_EQ(TANK_CMD_AUTH, buf[2]);
+    TEST_ASSERT_EQ(0, buf[3]);
+    TEST_ASSERT_EQ(TANK_CMD_SNAPSHOT, buf[5]);
+    TEST_ASSERT_EQ(4, buf[7]);
+    TEST_ASSERT_EQ(4, buf[11]);
+}
+
+static void test_result_max_holds_full_batch(void) {
+    uint8_t buf[TANK_COMMAND_RESULT_MAX];
+    static const uint8_t snapshot[15] = {0};
+    tank_command_result_t result;
+
+    // Every op's status always fits alongside two v2 snapshots
+    tank_command_result_init(&result, buf, sizeof(buf));
+    TEST_ASSERT(tank_command_result_add(&result, TANK_CMD_SNAPSHOT, 0, snapshot, sizeof(snapshot)));
+    TEST_ASSERT(tank_command_result_add(&result, TANK_CMD_SNAPSHOT, 0, snapshot, sizeof(snapshot)));
+    for (int i = 2; i < TANK_COMMAND_MAX_OPS; i++) {
+        TEST_ASSERT(tank_command_result_add(&result, TANK_CMD_AUTH, 0, NULL, 0));
+    }
+    TEST_ASSERT_EQ(TANK_COMMAND_MAX_OPS, buf[1]);
+}
+
+int main(void) {
+    RUN_TEST(test_parse_splits_batch);
+    RUN_TEST(test_parse_rejects_malformed);
+    RUN_TEST(test_value_lengths);
+    RUN_TEST(test_result_entries_and_overflow);
+    RUN_TEST(test_result_max_holds_full_batch);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "tank_history.h"
+#include "test_assert.h"
+
+static uint32_t get_u32_le(const uint8_t *buf) {
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static tank_history_t history;
+
+static void test_records_pack_levels_and_deltas(void) {
+    uint8_t buf[64];
+    uint32_t next_seq;
+    tank_history_init(&history);
+
+    TEST_ASSERT_EQ(0, tank_history_record(&history, 5000, 1, 2, TANK_HISTORY_FLAG_GREY_ENABLED));
+    TEST_ASSERT_EQ(1, tank_history_record(&history, 95000, 1, 2, TANK_HISTORY_FLAG_STABLE));
+
+    size_t len = tank_history_encode_chunk(&history, 0, 100000, buf, sizeof(buf), &next_seq);
+    TEST_ASSERT_EQ(TANK_HISTORY_CHUNK_HEADER_LEN + 2 * sizeof(tank_history_record_t), len);
+    TEST_ASSERT_EQ(0, get_u32_le(buf));
+    TEST_ASSERT_EQ(2, buf[4]);
+    TEST_ASSERT_EQ(95, get_u32_le(buf + 5));    // First record is 95 s old
+    TEST_ASSERT_EQ(2, next_seq);
+
+    const uint8_t *rec = buf + TANK_HISTORY_CHUNK_HEADER_LEN;
+    TEST_ASSERT_EQ(0, rec[0] | (rec[1] << 8));
+    TEST_ASSERT_EQ(1 | (2 << 2), rec[2]);
+    TEST_ASSERT_EQ(TANK_HISTORY_FLAG_GREY_ENABLED, rec[3]);
+    rec += sizeof(tank_history_record_t);
+    TEST_ASSERT_EQ(90, rec[0] | (rec[1] << 8));
+    TEST_ASSERT_EQ(TANK_HISTORY_FLAG_STABLE, rec[3]);
+}
+
+static void test_chunks_fit_buffer_and_resume(void) {
+    uint8_t buf[20];   // Default MTU payload: header plus two records
+    uint32_t next_seq;
+    tank_history_init(&history);
+
+    for (uint32_t i = 0; i < 5; i++) {
+        tank_history_record(&history, i * 1000, 0, 0, 0);
+    }
+
+    TEST_ASSERT_EQ(17, tank_history_encode_chunk(&history, 0, 5000, buf, sizeof(buf), &next_seq));
+    TEST_ASSERT_EQ(2, next_seq);
+    tank_history_encode_chunk(&history, next_seq, 5000, buf, sizeof(buf), &next_seq);
+    TEST_ASSERT_EQ(2, get_u32_le(buf));
+    TEST_ASSERT_EQ(3, get_u32_le(buf + 5));
+    tank_history_encode_chunk(&history, next_seq, 5000, buf, sizeof(buf), &next_seq);
+    TEST_ASSERT_EQ(1, buf[4]);
+
+    // Caught up: an empty chunk marks the end of the backfill
+    TEST_ASSERT_EQ(TANK_HISTORY_CHUNK_HEADER_LEN,
+                   tank_history_encode_chunk(&history, next_seq, 5000, buf, sizeof(buf), &next_seq));
+    TEST_ASSERT_EQ(0, buf[4]);
+    TEST_ASSERT_EQ(5, get_u32_le(buf));
+}
+
+static void test_overwritten_records_skip_to_oldest(void) {
+    uint8_t buf[64];
+    uint32_t next_seq;
+    tank_history_init(&history);
+
+    for (uint32_t i = 0; i < TANK_HISTORY_CAPACITY + 10; i++) {
+        tank_history_record(&history, i * 1000, 0, 0, 0);
+    }
+
+    TEST_ASSERT_EQ(10, tank_history_oldest_seq(&history));
+    tank_history_encode_chunk(&history, 3, TANK_HISTORY_CAPACITY * 1000 + 10000, buf, sizeof(buf), &next_seq);
+    TEST_ASSERT_EQ(10, get_u32_le(buf));
+
+    // A cursor past the end clamps to the next sequence number
+    tank_history_encode_chunk(&history, 100000, 0, buf, sizeof(buf), &next_seq);
+    TEST_ASSERT_EQ(TANK_HISTORY_CAPACITY + 10, get_u32_le(buf));
+    TEST_ASSERT_EQ(0, buf[4]);
+}
+
+static void test_long_gaps_split_into_filler_records(void) {
+    uint8_t buf[64];
+    uint32_t next_seq;
+    tank_history_init(&history);
+
+    tank_history_record(&history, 0, 2, 1, 0);
+    TEST_ASSERT_EQ(2, tank_history_record(&history, 70000u * 1000, 3, 3, 0));
+    tank_history_encode_chunk(&history, 0, 70000u * 1000, buf, sizeof(buf), &next_seq);
+
+    TEST_ASSERT_EQ(3, buf[4]);
+    TEST_ASSERT_EQ(70000, get_u32_le(buf + 5));
+    const uint8_t *rec = buf + TANK_HISTORY_CHUNK_HEADER_LEN + sizeof(tank_history_record_t);
+    TEST_ASSERT_EQ(0xFFFF, rec[0] | (rec[1] << 8));
+    TEST_ASSERT_EQ(2 | (1 << 2), rec[2]);
+    TEST_ASSERT_EQ(TANK_HISTORY_FLAG_GAP, rec[3]);
+    rec += sizeof(tank_history_record_t);
+    TEST_ASSERT_EQ(70000 - 0xFFFF, rec[0] | (rec[1] << 8));
+}
+
+int main(void) {
+    RUN_TEST(test_records_pack_levels_and_deltas);
+    RUN_TEST(test_chunks_fit_buffer_and_resume);
+    RUN_TEST(test_overwritten_records_skip_to_oldest);
+    RUN_TEST(test_long_gaps_split_into_filler_records);
+    return 0;
+}
@@ -0,0 +1,304 @@
+#include "tank_monitor.h"
+#include "sensor.h"
+#include "hal_host.h"
+#include "test_assert.h"
+
+// Runs the real monitor logic on the host HAL's virtual clock
+
+static void apply_mask(uint8_t mask) {
+    hal_host_set_sensor_mask(sensor_pins, SENSOR_COUNT, mask);
+    sensor_data_t sensors = { .mask = sensor_read_mask() };
+    tank_monitor_update_levels(&sensors);
+    tank_monitor_check_stability();
+}
+
+// Boot with the given sensors wet; the monitor task takes its first sample
+// right after init
+static void setup_with(uint8_t boot_mask) {
+    hal_host_reset();
+    hal_host_set_time_us(1000000);
+    tank_monitor_set_listener(NULL);
+    tank_monitor_set_task(NULL);
+    tank_monitor_set_enabled(true, true);
+    tank_monitor_init();
+    sensor_init_gpio();
+    apply_mask(boot_mask);
+}
+
+static void setup(void) {
+    setup_with(0);
+}
+
+static void test_sensor_mask_follows_gpio(void) {
+    setup();
+    hal_host_set_sensor_mask(sensor_pins, SENSOR_COUNT, 0x2A);
+    TEST_ASSERT_EQ(0x2A, sensor_read_mask());
+    TEST_ASSERT_EQ(0, hal_gpio_get(GREY_2_3_PIN));
+    TEST_ASSERT_EQ(1, hal_gpio_get(GREY_1_3_PIN));
+}
+
+static void test_lone_change_settles_after_min_window(void) {
+    tank_snapshot_t snap;
+    setup();
+
+    // Settle the boot reading first
+    hal_host_advance_ms(STABILITY_DURATION);
+    TEST_ASSERT(tank_monitor_check_stability());
+
+    apply_mask((1u << SENSOR_GREY_1_3) | (1u << SENSOR_BLACK_1_3) | (1u << SENSOR_BLACK_2_3));
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT_EQ(LEVEL_1_3, snap.grey_level);
+    TEST_ASSERT_EQ(LEVEL_2_3, snap.black_level);
+    TEST_ASSERT_EQ(0, snap.system_stable);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, tank_monitor_ms_until_stable());
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, tank_monitor_snapshot_ms_until_stable(&snap, tank_monitor_clock_ms()));
+
+    hal_host_advance_ms(STABILITY_DURATION_MIN - 1);
+    TEST_ASSERT(!tank_monitor_check_stability());
+    TEST_ASSERT_EQ(1, tank_monitor_ms_until_stable());
+
+    hal_host_advance_ms(1);
+    TEST_ASSERT(tank_monitor_check_stability());
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT_EQ(1, snap.system_stable);
+    TEST_ASSERT(snap.grey_stable && snap.black_stable);
+    TEST_ASSERT_EQ(UINT32_MAX, tank_monitor_ms_until_stable());
+    TEST_ASSERT_EQ(0, tank_monitor_snapshot_ms_until_stable(&snap, tank_monitor_clock_ms()));
+}
+
+static void test_boot_takes_full_window(void) {
+    tank_snapshot_t snap;
+
+    // A tank that is not empty at boot is not a lone change either
+    setup_with((1u << SENSOR_GREY_1_3) | (1u << SENSOR_BLACK_1_3));
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT_EQ(LEVEL_1_3, snap.grey_level);
+    TEST_ASSERT_EQ(LEVEL_1_3, snap.black_level);
+    TEST_ASSERT_EQ(STABILITY_DURATION, tank_monitor_ms_until_stable());
+    hal_host_advance_ms(STABILITY_DURATION - 1);
+    TEST_ASSERT(!tank_monitor_check_stability());
+    hal_host_advance_ms(1);
+    TEST_ASSERT(tank_monitor_check_stability());
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT(snap.grey_stable && snap.black_stable);
+}
+
+static void test_boot_uses_configured_window(void) {
+    // Stored timing is applied before init, as at boot
+    tank_timing_t timing = { .sample_period_ms = 1000, .settle_min_ms = 2000, .settle_max_ms = 20000, .debounce_ms = 40 };
+    tank_monitor_set_timing(&timing);
+    setup();
+
+    apply_mask(0);
+    TEST_ASSERT_EQ(20000, tank_monitor_ms_until_stable());
+    hal_host_advance_ms(20000 - 1);
+    TEST_ASSERT(!tank_monitor_check_stability());
+    hal_host_advance_ms(1);
+    TEST_ASSERT(tank_monitor_check_stability());
+
+    tank_config_timing_defaults(&timing);
+    tank_monitor_set_timing(&timing);
+}
+
+static void test_tanks_settle_independently(void) {
+    tank_snapshot_t snap;
+    setup();
+
+    apply_mask(1u << SENSOR_GREY_1_3);
+    hal_host_advance_ms(STABILITY_DURATION_MIN / 2);
+    apply_mask((1u << SENSOR_GREY_1_3) | (1u << SENSOR_BLACK_1_3));
+
+    // Grey settles on its own timer; black's change does not restart it
+    hal_host_advance_ms(STABILITY_DURATION_MIN / 2);
+    TEST_ASSERT(!tank_monitor_check_stability());
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT(snap.grey_stable);
+    TEST_ASSERT(!snap.black_stable);
+    TEST_ASSERT_EQ(0, snap.system_stable);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN / 2, tank_monitor_ms_until_stable());
+
+    hal_host_advance_ms(STABILITY_DURATION_MIN / 2);
+    TEST_ASSERT(tank_monitor_check_stability());
+}
+
+static void test_flapping_stretches_window(void) {
+    uint32_t step = (STABILITY_DURATION - STABILITY_DURATION_MIN) / STABILITY_FLAP_THRESHOLD;
+    setup();
+
+    // Let the boot window pass so only grey's timer is running
+    hal_host_advance_ms(STABILITY_DURATION);
+    TEST_ASSERT(tank_monitor_check_stability());
+
+    apply_mask(1u << SENSOR_GREY_1_3);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, tank_monitor_ms_until_stable());
+    hal_host_advance_ms(1000);
+    apply_mask(1u << SENSOR_GREY_2_3);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN + step, tank_monitor_ms_until_stable());
+    hal_host_advance_ms(1000);
+    apply_mask(1u << SENSOR_GREY_1_3);
+    hal_host_advance_ms(1000);
+    apply_mask(1u << SENSOR_GREY_2_3);
+    TEST_ASSERT_EQ(STABILITY_DURATION, tank_monitor_ms_until_stable());
+
+    // Once the look-back has passed (and the motion flag with it) the tank
+    // is treated as quiet again
+    hal_host_advance_ms(STABILITY_FLAP_WINDOW_MS);
+    tank_monitor_check_stability();
+    apply_mask(1u << SENSOR_GREY_FULL);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, tank_monitor_ms_until_stable());
+}
+
+static void test_flap_history_survives_32bit_wrap(void) {
+    tank_snapshot_t snap;
+    setup();
+
+    hal_host_advance_ms(STABILITY_DURATION);
+    tank_monitor_check_stability();
+    apply_mask(1u << SENSOR_GREY_1_3);
+    hal_host_advance_ms(1000);
+    apply_mask(1u << SENSOR_GREY_2_3);
+    hal_host_advance_ms(1000);
+    apply_mask(1u << SENSOR_GREY_1_3);
+
+    // Quiet for 2^32 ms plus a second: on a 32-bit clock the old changes
+    // would look a second old and stretch the window to the maximum
+    hal_host_advance_ms(STABILITY_FLAP_WINDOW_MS);
+    TEST_ASSERT(tank_monitor_check_stability());
+    hal_host_set_time_us(hal_time_us() + ((1ULL << 32) - STABILITY_FLAP_WINDOW_MS + 1000) * 1000);
+    tank_monitor_check_stability();
+
+    apply_mask(1u << SENSOR_GREY_FULL);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, tank_monitor_ms_until_stable());
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT(snap.last_change_ms > (1ULL << 32));
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, tank_monitor_snapshot_ms_until_stable(&snap, tank_monitor_clock_ms()));
+
+    hal_host_advance_ms(STABILITY_DURATION_MIN);
+    TEST_ASSERT(tank_monitor_check_stability());
+}
+
+static void test_timing_applied_live(void) {
+    setup();
+    hal_host_advance_ms(STABILITY_DURATION);
+    tank_monitor_check_stability();
+
+    tank_timing_t timing = { .sample_period_ms = 1000, .settle_min_ms = 5000, .settle_max_ms = 60000, .debounce_ms = 40 };
+    tank_monitor_set_timing(&timing);
+    TEST_ASSERT_EQ(1000, tank_monitor_sample_period_ms());
+    TEST_ASSERT_EQ(40, tank_monitor_debounce_ms());
+
+    apply_mask(1u << SENSOR_GREY_1_3);
+    TEST_ASSERT_EQ(5000, tank_monitor_ms_until_stable());
+
+    tank_config_timing_defaults(&timing);
+    tank_monitor_set_timing(&timing);
+}
+
+static void test_motion_and_fault_published(void) {
+    tank_snapshot_t snap;
+    setup();
+
+    // Grey Full stuck wet above dry 1/3 and 2/3 sensors
+    apply_mask(1u << SENSOR_GREY_FULL);
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT_EQ(0, snap.inconsistent_mask);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, tank_monitor_ms_until_next_check());
+
+    hal_host_advance_ms(SENSOR_STATS_INCONSISTENT_MS);
+    tank_monitor_check_stability();
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT_EQ(1u << SENSOR_STATS_TANK_GREY, snap.inconsistent_mask);
+    TEST_ASSERT(!snap.in_motion);
+
+    // Sloshing forces the full settle window
+    uint8_t mask = 1u << SENSOR_BLACK_1_3;
+    for (int i = 0; i < SENSOR_STATS_MOTION_ENTER; i++) {
+        hal_host_advance_ms(1000);
+        apply_mask(mask ^= 1u << SENSOR_BLACK_2_3);
+    }
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT(snap.in_motion);
+    TEST_ASSERT_EQ(0, snap.inconsistent_mask);
+    TEST_ASSERT_EQ(STABILITY_DURATION, tank_monitor_snapshot_ms_until_stable(&snap, tank_monitor_clock_ms()));
+}
+
+static void test_publishes_notify_listener(void) {
+    setup();
+    tank_monitor_set_listener(hal_task_current());
+    uint32_t before = hal_host_notify_count();
+
+    apply_mask(1u << SENSOR_BLACK_FULL);
+    TEST_ASSERT(hal_host_notify_count() > before);
+    TEST_ASSERT(hal_task_wait(0));
+
+    // Unchanged input publishes nothing
+    before = hal_host_notify_count();
+    apply_mask(1u << SENSOR_BLACK_FULL);
+    TEST_ASSERT_EQ(before, hal_host_notify_count());
+    tank_monitor_set_listener(NULL);
+}
+
+static void test_enable_request_applied_by_monitor(void) {
+    tank_snapshot_t snap;
+    setup();
+
+    tank_monitor_set_enabled(false, true);
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT(snap.grey_enabled);
+
+    tank_monitor_apply_enable_request();
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT(!snap.grey_enabled);
+    TEST_ASSERT(snap.black_enabled);
+
+    // Disabled tank keeps its last level
+    apply_mask(1u << SENSOR_GREY_1_3);
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT_EQ(LEVEL_EMPTY, snap.grey_level);
+
+    // Re-enabled, it catches up from the last sample without waiting for an
+    // edge, and settles like any other change
+    tank_monitor_set_enabled(true, true);
+    tank_monitor_apply_enable_request();
+    tank_monitor_get_snapshot(&snap);
+    TEST_ASSERT(snap.grey_enabled);
+    TEST_ASSERT_EQ(LEVEL_1_3, snap.grey_level);
+    TEST_ASSERT(!snap.grey_stable);
+    TEST_ASSERT_EQ(STABILITY_DURATION_MIN, tank_monitor_ms_until_stable());
+}
+
+static void test_history_records_changes(void) {
+    uint8_t buf[64];
+    uint32_t next_seq;
+    setup();
+
+    apply_mask(1u << SENSOR_GREY_1_3);
+    hal_host_advance_ms(STABILITY_DURATION);
+    tank_monitor_check_stability();
+
+    // Grey change, then both tanks stable in one record
+    size_t len = tank_monitor_history_chunk(0, buf, sizeof(buf), &next_seq);
+    TEST_ASSERT_EQ(TANK_HISTORY_CHUNK_HEADER_LEN + 2 * sizeof(tank_history_record_t), len);
+    TEST_ASSERT_EQ(2, next_seq);
+    const uint8_t *rec = buf + TANK_HISTORY_CHUNK_HEADER_LEN + sizeof(tank_history_record_t);
+    TEST_ASSERT_EQ(STABILITY_DURATION / 1000, rec[0] | (rec[1] << 8));
+    TEST_ASSERT(rec[3] & TANK_HISTORY_FLAG_STABLE);
+    TEST_ASSERT(rec[3] & TANK_HISTORY_FLAG_GREY_STABLE);
+    TEST_ASSERT(rec[3] & TANK_HISTORY_FLAG_BLACK_STABLE);
+}
+
+int main(void) {
+    RUN_TEST(test_sensor_mask_follows_gpio);
+    RUN_TEST(test_lone_change_settles_after_min_window);
+    RUN_TEST(test_boot_takes_full_window);
+    RUN_TEST(test_boot_uses_configured_window);
+    RUN_TEST(test_tanks_settle_independently);
+    RUN_TEST(test_flapping_stretches_window);
+    RUN_TEST(test_flap_history_survives_32bit_wrap);
+    RUN_TEST(test_timing_applied_live);
+    RUN_TEST(test_motion_and_fault_published);
+    RUN_TEST(test_publishes_notify_listener);
+    RUN_TEST(test_enable_request_applied_by_monitor);
+    RUN_TEST(test_history_records_changes);
+    return 0;
+}
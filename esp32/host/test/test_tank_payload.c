@@ -0,0 +1,92 @@
+#include "tank_payload.h"
+#include "sensor_filter.h"
+#include "test_assert.h"
+
+static const tank_payload_fields_t fields = {
+    .raw_mask = (1u << SENSOR_GREY_1_3) | (1u << SENSOR_BLACK_1_3) | (1u << SENSOR_BLACK_2_3),
+    .grey_enabled = true,
+    .black_enabled = false,
+    .system_stable = false,
+    .grey_stable = false,
+    .black_stable = true,
+    .sequence = 0x01020304,
+    .ms_since_change = 1500,
+    .ms_until_stable = 88500,
+};
+
+static void test_v1_layout_unchanged(void) {
+    uint8_t buf[TANK_PAYLOAD_MAX_LEN];
+    static const uint8_t expected[TANK_PAYLOAD_V1_LEN] = {1, 0, 0, 1, 1, 0, 1, 0, 0};
+
+    TEST_ASSERT_EQ(TANK_PAYLOAD_V1_LEN, tank_payload_encode(TANK_PAYLOAD_V1, &fields, buf));
+    for (int i = 0; i < TANK_PAYLOAD_V1_LEN; i++) {
+        TEST_ASSERT_EQ(expected[i], buf[i]);
+    }
+}
+
+static void test_v2_packs_bits_and_counters(void) {
+    uint8_t buf[TANK_PAYLOAD_MAX_LEN];
+
+    TEST_ASSERT_EQ(TANK_PAYLOAD_V2_LEN, tank_payload_encode(TANK_PAYLOAD_V2, &fields, buf));
+    TEST_ASSERT_EQ(TANK_PAYLOAD_V2, buf[0]);
+    TEST_ASSERT_EQ(fields.raw_mask, buf[1]);
+    TEST_ASSERT_EQ(TANK_PAYLOAD_FLAG_GREY_ENABLED | TANK_PAYLOAD_FLAG_BLACK_STABLE, buf[2]);
+    TEST_ASSERT_EQ(0x04, buf[3]);
+    TEST_ASSERT_EQ(0x01, buf[6]);
+    TEST_ASSERT_EQ(1500, buf[7] | (buf[8] << 8));
+    TEST_ASSERT_EQ(88500, buf[11] | (buf[12] << 8) | (buf[13] << 16));
+}
+
+static void test_adv_field_matches_v2_bits(void) {
+    uint8_t adv[TANK_ADV_LEN];
+    uint8_t v2[TANK_PAYLOAD_V2_LEN];
+
+    TEST_ASSERT_EQ(TANK_ADV_LEN, tank_payload_encode_adv(&fields, adv));
+    tank_payload_encode(TANK_PAYLOAD_V2, &fields, v2);
+    TEST_ASSERT_EQ(0xFF, adv[0]);
+    TEST_ASSERT_EQ(0xFF, adv[1]);
+    TEST_ASSERT_EQ(TANK_ADV_VERSION, adv[2]);
+    TEST_ASSERT_EQ(v2[1], adv[3]);
+    TEST_ASSERT_EQ(v2[2], adv[4]);
+    TEST_ASSERT_EQ(0x04, adv[5]);
+}
+
+static void test_version_validation(void) {
+    TEST_ASSERT(tank_payload_version_valid(TANK_PAYLOAD_V1));
+    TEST_ASSERT(tank_payload_version_valid(TANK_PAYLOAD_V2));
+    TEST_ASSERT(!tank_payload_version_valid(0));
+    TEST_ASSERT(!tank_payload_version_valid(3));
+}
+
+static void test_age_rebases_v2_timing(void) {
+    uint8_t v1[TANK_PAYLOAD_MAX_LEN];
+    uint8_t v2[TANK_PAYLOAD_MAX_LEN];
+    uint8_t expected_v1[TANK_PAYLOAD_V1_LEN];
+
+    tank_payload_encode(TANK_PAYLOAD_V1, &fields, v1);
+    tank_payload_encode(TANK_PAYLOAD_V1, &fields, expected_v1);
+    tank_payload_encode(TANK_PAYLOAD_V2, &fields, v2);
+
+    tank_payload_age(v2, TANK_PAYLOAD_V2_LEN, 2000);
+    TEST_ASSERT_EQ(3500, v2[7] | (v2[8] << 8));
+    TEST_ASSERT_EQ(86500, v2[11] | (v2[12] << 8) | (v2[13] << 16));
+    TEST_ASSERT_EQ(0x04, v2[3]);
+
+    // Counts down to 0 and stays there
+    tank_payload_age(v2, TANK_PAYLOAD_V2_LEN, 100000);
+    TEST_ASSERT_EQ(0, v2[11] | (v2[12] << 8) | (v2[13] << 16) | (v2[14] << 24));
+
+    tank_payload_age(v1, TANK_PAYLOAD_V1_LEN, 2000);
+    for (int i = 0; i < TANK_PAYLOAD_V1_LEN; i++) {
+        TEST_ASSERT_EQ(expected_v1[i], v1[i]);
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_v1_layout_unchanged);
+    RUN_TEST(test_v2_packs_bits_and_counters);
+    RUN_TEST(test_adv_field_matches_v2_bits);
+    RUN_TEST(test_version_validation);
+    RUN_TEST(test_age_rebases_v2_timing);
+    return 0;
+}
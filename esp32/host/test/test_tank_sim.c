@@ -0,0 +1,82 @@
+#include "tank_sim.h"
+#include "tank_monitor.h"
+#include "test_assert.h"
+
+static void test_clean_step_settles_once(void) {
+    tank_sim_trace_t trace;
+    tank_sim_result_t result;
+    tank_sim_params_t params = { .stability_ms = 90000, .settle_min_ms = 15000, .debounce_ms = 100 };
+    uint8_t grey_1_3 = 1u << SENSOR_GREY_1_3;
+
+    tank_sim_trace_init(&trace);
+    tank_sim_trace_append(&trace, 0, 0, 0);
+    tank_sim_trace_append(&trace, 200000, grey_1_3, grey_1_3);
+    trace.end_ms = 400000;
+
+    tank_sim_run(&trace, &params, &result);
+    TEST_ASSERT(result.has_truth);
+    TEST_ASSERT_EQ(3, result.settle_count);         // Both tanks at boot, then grey after the step
+    TEST_ASSERT(result.settle_total_ms >= 2 * 90000 + 15000 + 100);  // Debounce plus settle window
+    TEST_ASSERT(result.settle_total_ms <= 2 * 90000 + 15000 + 110);
+    TEST_ASSERT_EQ(1, result.alerts);
+    TEST_ASSERT_EQ(0, result.false_alerts);
+    TEST_ASSERT_EQ(1, result.level_changes);
+    tank_sim_trace_free(&trace);
+}
+
+static void test_bounce_shorter_than_debounce_is_filtered(void) {
+    tank_sim_trace_t trace;
+    tank_sim_result_t result;
+    tank_sim_params_t params = { .stability_ms = 90000, .settle_min_ms = 15000, .debounce_ms = 100 };
+
+    tank_sim_trace_init(&trace);
+    tank_sim_generate(TANK_SIM_SCENARIO_FILL, 7, 3600000, &trace);
+    tank_sim_run(&trace, &params, &result);
+    TEST_ASSERT_EQ(3, result.level_changes);
+    TEST_ASSERT_EQ(3, result.alerts);
+    TEST_ASSERT_EQ(0, result.false_alerts);
+
+    // With no debounce every bounce reaches the level logic
+    params.debounce_ms = 0;
+    tank_sim_run(&trace, &params, &result);
+    TEST_ASSERT(result.level_changes > 3);
+    tank_sim_trace_free(&trace);
+}
+
+static void test_short_window_alerts_on_slosh(void) {
+    tank_sim_trace_t trace;
+    tank_sim_result_t long_window, short_window;
+    tank_sim_params_t params = { .stability_ms = 90000, .settle_min_ms = 15000, .debounce_ms = 100 };
+
+    tank_sim_trace_init(&trace);
+    tank_sim_generate(TANK_SIM_SCENARIO_SLOSH, 1, 24 * 3600000u, &trace);
+    tank_sim_run(&trace, &params, &long_window);
+    params.stability_ms = 10000;
+    params.settle_min_ms = 10000;
+    tank_sim_run(&trace, &params, &short_window);
+
+    TEST_ASSERT(short_window.false_alerts > long_window.false_alerts);
+    TEST_ASSERT(short_window.notifications >= long_window.notifications);
+    tank_sim_trace_free(&trace);
+}
+
+static void test_stuck_sensor_reports_false_full(void) {
+    tank_sim_trace_t trace;
+    tank_sim_result_t result;
+    tank_sim_params_t params = { .stability_ms = 90000, .settle_min_ms = 15000, .debounce_ms = 100 };
+
+    tank_sim_trace_init(&trace);
+    tank_sim_generate(TANK_SIM_SCENARIO_STUCK, 3, 3600000, &trace);
+    tank_sim_run(&trace, &params, &result);
+    TEST_ASSERT_EQ(1, result.alerts);
+    TEST_ASSERT_EQ(1, result.false_alerts);
+    tank_sim_trace_free(&trace);
+}
+
+int main(void) {
+    RUN_TEST(test_clean_step_settles_once);
+    RUN_TEST(test_bounce_shorter_than_debounce_is_filtered);
+    RUN_TEST(test_short_window_alerts_on_slosh);
+    RUN_TEST(test_stuck_sensor_reports_false_full);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "trace.h"
+#include "hal_host.h"
+#include "test_assert.h"
+#include <string.h>
+
+static void test_records_in_order(void) {
+    hal_host_reset();
+    trace_clear();
+
+    hal_host_set_time_us(1000);
+    TRACE_BEGIN(TRACE_UPDATE_LEVELS, 0x05);
+    hal_host_set_time_us(1250);
+    TRACE_END(TRACE_UPDATE_LEVELS);
+    TRACE_INSTANT(TRACE_NOTIFY_WAKE, 1);
+
+    trace_event_t events[4];
+    TEST_ASSERT_EQ(3, trace_snapshot(events, 4));
+    TEST_ASSERT_EQ(TRACE_PH_BEGIN, events[0].phase);
+    TEST_ASSERT_EQ(TRACE_UPDATE_LEVELS, events[0].id);
+    TEST_ASSERT_EQ(0x05, events[0].arg);
+    TEST_ASSERT_EQ(1000, events[0].timestamp_us);
+    TEST_ASSERT_EQ(TRACE_PH_END, events[1].phase);
+    TEST_ASSERT_EQ(1250, events[1].timestamp_us);
+    TEST_ASSERT_EQ(TRACE_PH_INSTANT, events[2].phase);
+    TEST_ASSERT(events[2].task == hal_task_current());
+}
+
+static void test_ring_keeps_newest(void) {
+    hal_host_reset();
+    trace_clear();
+
+    for (int i = 0; i < TRACE_RING_SIZE + 10; i++) {
+        TRACE_INSTANT(TRACE_EDGE_SETTLE, i);
+    }
+
+    static trace_event_t events[TRACE_RING_SIZE];
+    TEST_ASSERT_EQ(TRACE_RING_SIZE, trace_snapshot(events, TRACE_RING_SIZE));
+    TEST_ASSERT_EQ(10, events[0].arg);
+    TEST_ASSERT_EQ(TRACE_RING_SIZE + 9, events[TRACE_RING_SIZE - 1].arg);
+
+    // A short buffer gets the newest events, still oldest first
+    TEST_ASSERT_EQ(2, trace_snapshot(events, 2));
+    TEST_ASSERT_EQ(TRACE_RING_SIZE + 8, events[0].arg);
+}
+
+static void test_format_line(void) {
+    trace_event_t event = {
+        .timestamp_us = 123456,
+        .task = hal_task_current(),
+        .arg = 20,
+        .phase = TRACE_PH_BEGIN,
+        .id = TRACE_GATT_EVENT,
+    };
+    char line[64];
+
+    trace_format_event(&event, line, sizeof(line));
+    TEST_ASSERT(strcmp(line, "123456 B gatt_event 20 host") == 0);
+}
+
+int main(void) {
+    RUN_TEST(test_records_in_order);
+    RUN_TEST(test_ring_keeps_newest);
+    RUN_TEST(test_format_line);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "wake_stats.h"
+#include "edge_capture.h"
+#include "tank_monitor.h"
+#include "sensor.h"
+#include "hal_host.h"
+#include "test_assert.h"
+
+// Runs an hour of the edge-capture monitor on the host HAL's virtual clock and
+// counts its wakeups. Debounce, stability and sensor-statistics deadlines come
+// from the firmware core; the loop around them mirrors tank_monitor_task and
+// the notifier's heartbeat.
+#define SIM_DURATION_MS     3600000u
+#define SIM_HEARTBEAT_MS    30000u      // BLE_HEARTBEAT_INTERVAL_MS
+
+typedef struct {
+    uint32_t at_ms;
+    uint8_t sensor;
+    uint8_t level;
+} sim_edge_t;
+
+// Grey tank reaches 1/3 ten minutes in, with contact bounce on the float switch
+static const sim_edge_t fill_edges[] = {
+    {600000, SENSOR_GREY_1_3, 1},
+    {600004, SENSOR_GREY_1_3, 0},
+    {600011, SENSOR_GREY_1_3, 1},
+};
+
+static void simulate_monitor(wake_stats_t *stats, const sim_edge_t *edges, size_t edge_count) {
+    edge_debouncer_t deb;
+    sensor_data_t sensors = {0};
+    size_t next_edge = 0;
+    uint32_t now = 0, last_sent = 0;
+
+    hal_host_reset();
+    hal_host_set_time_us(1000000);
+    tank_monitor_set_listener(hal_task_current());
+    tank_monitor_set_task(NULL);
+    tank_monitor_set_enabled(true, true);
+    tank_monitor_init();
+    tank_monitor_apply_enable_request();
+    sensor_init_gpio();
+
+    uint64_t start_us = hal_time_us();
+    edge_debouncer_init(&deb, 0, DEBOUNCE_DELAY_MS * 1000);
+    tank_monitor_update_levels(&sensors);
+    tank_monitor_check_stability();
+    hal_task_wait(0);
+
+    while (1) {
+        uint32_t wake = SIM_DURATION_MS;
+        wake_source_t source = WAKE_SRC_COUNT;
+
+        if (next_edge < edge_count && edges[next_edge].at_ms < wake) {
+            wake = edges[next_edge].at_ms;
+            source = WAKE_SRC_SENSOR_EVENT;
+        }
+
+        // Same deadlines as tank_monitor_next_wait()
+        uint32_t settle_us = edge_debouncer_time_to_settle_us(&deb, (uint32_t)hal_time_us());
+        if (settle_us != UINT32_MAX && now + settle_us / 1000 + 1 < wake) {
+            wake = now + settle_us / 1000 + 1;
+            source = WAKE_SRC_DEBOUNCE;
+        }
+
+        uint32_t stable_ms = tank_monitor_ms_until_next_check();
+        if (stable_ms != UINT32_MAX && now + stable_ms + 1 < wake) {
+            wake = now + stable_ms + 1;
+            source = WAKE_SRC_STABILITY;
+        }
+
+        if (last_sent + SIM_HEARTBEAT_MS < wake) {
+            wake = last_sent + SIM_HEARTBEAT_MS;
+            source = WAKE_SRC_HEARTBEAT;
+        }
+
+        if (source == WAKE_SRC_COUNT) break;
+
+        hal_host_advance_ms(wake - now);
+        now = (uint32_t)((hal_time_us() - start_us) / 1000);
+        wake_stats_note(stats, source);
+
+        if (source == WAKE_SRC_HEARTBEAT) {
+            last_sent = now;
+            continue;
+        }
+
+        if (source == WAKE_SRC_SENSOR_EVENT) {
+            sensor_edge_t edge = {
+                .timestamp_us = (uint32_t)hal_time_us(),
+                .sensor = edges[next_edge].sensor,
+                .level = edges[next_edge].level,
+            };
+            edge_debouncer_feed(&deb, &edge);
+            next_edge++;
+        }
+
+        if (edge_debouncer_settle(&deb, (uint32_t)hal_time_us())) {
+            sensors.mask = deb.stable_mask;
+            tank_monitor_update_levels(&sensors);
+        }
+        tank_monitor_check_stability();
+
+        // A published change wakes the notifier, which sends and restarts
+        // its heartbeat
+        if (hal_task_wait(0)) {
+            wake_stats_note(stats, WAKE_SRC_STATE_CHANGE);
+            last_sent = now;
+        }
+    }
+}
+
+static void test_idle_hour_is_heartbeat_bound(void) {
+    wake_stats_t stats;
+    wake_stats_init(&stats);
+
+    simulate_monitor(&stats, NULL, 0);
+
+    // One stability deadline after boot, otherwise only heartbeats
+    TEST_ASSERT_EQ(1, wake_stats_get(&stats, WAKE_SRC_STABILITY));
+    TEST_ASSERT_EQ(0, wake_stats_get(&stats, WAKE_SRC_DEBOUNCE));
+    TEST_ASSERT_EQ(1, wake_stats_get(&stats, WAKE_SRC_STATE_CHANGE));
+    TEST_ASSERT(wake_stats_get(&stats, WAKE_SRC_HEARTBEAT) <= SIM_DURATION_MS / SIM_HEARTBEAT_MS);
+}
+
+static void test_bounce_collapses_into_one_change(void) {
+    wake_stats_t stats;
+    wake_stats_init(&stats);
+
+    simulate_monitor(&stats, fill_edges, sizeof(fill_edges) / sizeof(fill_edges[0]));
+
+    // Bounces collapse into one debounce deadline and one level change,
+    // which settles on its own stability deadline
+    TEST_ASSERT_EQ(3, wake_stats_get(&stats, WAKE_SRC_SENSOR_EVENT));
+    TEST_ASSERT_EQ(1, wake_stats_get(&stats, WAKE_SRC_DEBOUNCE));
+    TEST_ASSERT_EQ(2, wake_stats_get(&stats, WAKE_SRC_STABILITY));
+    TEST_ASSERT_EQ(3, wake_stats_get(&stats, WAKE_SRC_STATE_CHANGE));
+
+    uint32_t per_hour = wake_stats_per_hour(wake_stats_total(&stats), (uint64_t)SIM_DURATION_MS * 1000);
+    printf("monitor and notifier wakeups/hour with one fill: %u\n", (unsigned)per_hour);
+    TEST_ASSERT(per_hour < 200);
+}
+
+static void test_per_hour_scaling(void) {
+    TEST_ASSERT_EQ(120, wake_stats_per_hour(60, 1800000000ULL));
+    TEST_ASSERT_EQ(0, wake_stats_per_hour(5, 0));
+}
+
+int main(void) {
+    RUN_TEST(test_idle_hour_is_heartbeat_bound);
+    RUN_TEST(test_bounce_collapses_into_one_change);
+    RUN_TEST(test_per_hour_scaling);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// trace_json - convert the firmware's serial `trace` dump into Chrome trace
+// JSON. Feed it a captured monitor log (other log lines are ignored) and load
+// the output in chrome://tracing or ui.perfetto.dev.
+
+#define TRACE_MARKER        "TRACE: "
+#define TRACE_MAX_TASKS     16
+#define TRACE_NAME_LEN      32
+
+static char task_names[TRACE_MAX_TASKS][TRACE_NAME_LEN];
+static int task_count = 0;
+
+// ESP_GATTS_*_EVT values from esp_gatts_api.h
+static const char *gatt_event_names[] = {
+    "REG", "READ", "WRITE", "EXEC_WRITE", "MTU", "CONF", "UNREG", "CREATE",
+    "ADD_INCL_SRVC", "ADD_CHAR", "ADD_CHAR_DESCR", "DELETE", "START", "STOP",
+    "CONNECT", "DISCONNECT", "OPEN", "CANCEL_OPEN", "CLOSE", "LISTEN", "CONGEST",
+};
+
+static int task_id(const char *name) {
+    for (int i = 0; i < task_count; i++) {
+        if (strcmp(task_names[i], name) == 0) return i + 1;
+    }
+    if (task_count == TRACE_MAX_TASKS) return TRACE_MAX_TASKS;
+
+    snprintf(task_names[task_count], TRACE_NAME_LEN, "%s", name);
+    return ++task_count;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-' && argv[1][1] != '\0')) {
+        fprintf(stderr, "usage: %s [monitor.log] > trace.json\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = stdin;
+    if (argc == 2 && strcmp(argv[1], "-") != 0) {
+        in = fopen(argv[1], "r");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    char line[256];
+    bool first = true;
+    bool have_last = false;
+    uint32_t last_ts = 0;
+    uint64_t wrap_base = 0;
+    uint64_t origin = 0;
+    unsigned events = 0;
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    while (fgets(line, sizeof(line), in)) {
+        char *p = strstr(line, TRACE_MARKER);
+        if (p == NULL) continue;
+        p += strlen(TRACE_MARKER);
+
+        // A new dump restarts the timeline
+        if (strncmp(p, "begin", 5) == 0) {
+            have_last = false;
+            wrap_base = 0;
+            continue;
+        }
+
+        unsigned long ts;
+        char phase;
+        char name[TRACE_NAME_LEN];
+        unsigned arg;
+        char task[TRACE_NAME_LEN];
+        if (sscanf(p, "%lu %c %31s %u %31s", &ts, &phase, name, &arg, task) != 5) continue;
+        if (phase != 'B' && phase != 'E' && phase != 'i') continue;
+
+        // Device timestamps are 32-bit microseconds; unwrap them in order
+        if (have_last && (uint32_t)ts < last_ts) {
+            wrap_base += 1ull << 32;
+        }
+        last_ts = (uint32_t)ts;
+        uint64_t ts64 = wrap_base + (uint32_t)ts;
+        if (!have_last) {
+            origin = ts64;
+        }
+        have_last = true;
+
+        printf("%s{\"name\":\"", first ? "" : ",\n");
+        if (phase != 'E' && strcmp(name, "gatt_event") == 0 &&
+            arg < sizeof(gatt_event_names) / sizeof(gatt_event_names[0])) {
+            printf("gatt %s", gatt_event_names[arg]);
+        } else {
+            printf("%s", name);
+        }
+        printf("\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%d",
+               phase, (unsigned long long)(ts64 - origin), task_id(task));
+        if (phase == 'i') {
+            printf(",\"s\":\"t\"");
+        }
+        if (phase != 'E') {
+            printf(",\"args\":{\"arg\":%u}", arg);
+        }
+        printf("}");
+        first = false;
+        events++;
+    }
+
+    for (int i = 0; i < task_count; i++) {
+        printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+               first ? "" : ",\n", i + 1, task_names[i]);
+        first = false;
+    }
+    printf("\n]}\n");
+
+    if (in != stdin) fclose(in);
+    fprintf(stderr, "%u events, %d tasks\n", events, task_count);
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "adv_schedule.h"
+#include <string.h>
+
+static const adv_tier_params_t tier_params[ADV_TIER_COUNT] = {
+    [ADV_TIER_DIRECTED] = {0, 0, ADV_DIRECTED_WINDOW_MS},
+    [ADV_TIER_FAST] = {ADV_FAST_INT_MIN, ADV_FAST_INT_MAX, ADV_FAST_WINDOW_MS},
+    [ADV_TIER_SLOW] = {ADV_SLOW_INT_MIN, ADV_SLOW_INT_MAX, 0},
+};
+
+static const char *tier_names[ADV_TIER_COUNT] = {
+    [ADV_TIER_DIRECTED] = "directed",
+    [ADV_TIER_FAST] = "fast",
+    [ADV_TIER_SLOW] = "slow",
+};
+
+void adv_schedule_init(adv_schedule_t *sched) {
+    if (sched == NULL) return;
+
+    memset(sched, 0, sizeof(*sched));
+    sched->tier = ADV_TIER_SLOW;
+}
+
+const adv_tier_params_t *adv_schedule_params(adv_tier_t tier) {
+    return tier < ADV_TIER_COUNT ? &tier_params[tier] : &tier_params[ADV_TIER_SLOW];
+}
+
+const char *adv_schedule_tier_name(adv_tier_t tier) {
+    return tier < ADV_TIER_COUNT ? tier_names[tier] : "unknown";
+}
+
+// Close the current advertised stretch, if any
+static void adv_schedule_account(adv_schedule_t *sched, uint32_t now_ms) {
+    if (sched->active) {
+        sched->tiers[sched->tier].advertised_ms += now_ms - sched->active_since_ms;
+        sched->active_since_ms = now_ms;
+    }
+}
+
+static void adv_schedule_enter(adv_schedule_t *sched, adv_tier_t tier, uint32_t now_ms) {
+    adv_schedule_account(sched, now_ms);
+    sched->tier = tier;
+    sched->tier_start_ms = now_ms;
+    sched->active = true;
+    sched->active_since_ms = now_ms;
+    sched->tiers[tier].starts++;
+}
+
+void adv_schedule_boot(adv_schedule_t *sched, uint32_t now_ms) {
+    if (sched == NULL) return;
+
+    adv_schedule_enter(sched, ADV_TIER_FAST, now_ms);
+}
+
+// A link closed: start over with directed advertising to that peer when the
+// caller found it in the bond list, otherwise with the fast window
+void adv_schedule_disconnected(adv_schedule_t *sched, const uint8_t peer[6], bool directed, uint32_t now_ms) {
+    if (sched == NULL) return;
+
+    sched->awaiting_peer = peer != NULL;
+    if (peer) {
+        memcpy(sched->peer, peer, sizeof(sched->peer));
+    }
+    sched->disconnect_ms = now_ms;
+
+    adv_schedule_enter(sched, directed ? ADV_TIER_DIRECTED : ADV_TIER_FAST, now_ms);
+}
+
+// A link opened. The controller stops advertising on connect, so the caller
+// says whether it restarts for further clients: a directed run ends in the
+// slow tier, a fast window carries on until it expires. Returns true when this
+// was the departed peer coming back on the fast path, which records a
+// reconnect latency.
+bool adv_schedule_connected(adv_schedule_t *sched, const uint8_t peer[6], bool keep_advertising, uint32_t now_ms) {
+    if (sched == NULL) return false;
+
+    adv_tier_t tier = sched->tier;
+    bool reconnected = false;
+
+    adv_schedule_account(sched, now_ms);
+    if (sched->active) {
+        sched->tiers[tier].connects++;
+    }
+
+    if (sched->awaiting_peer && peer && memcmp(peer, sched->peer, sizeof(sched->peer)) == 0) {
+        sched->awaiting_peer = false;
+
+        // A phone that comes back after the fast path ended is not a reconnect
+        if (sched->active && tier != ADV_TIER_SLOW) {
+            uint32_t latency = now_ms - sched->disconnect_ms;
+            if (sched->reconnects == 0 || latency < sched->reconnect_min_ms) {
+                sched->reconnect_min_ms = latency;
+            }
+            if (latency > sched->reconnect_max_ms) {
+                sched->reconnect_max_ms = latency;
+            }
+            sched->reconnect_last_ms = latency;
+            sched->reconnect_total_ms += latency;
+            sched->reconnects++;
+            reconnected = true;
+        }
+    }
+
+    if (!keep_advertising) {
+        sched->active = false;
+    } else if (tier == ADV_TIER_DIRECTED || !sched->active) {
+        adv_schedule_enter(sched, ADV_TIER_SLOW, now_ms);
+    }
+
+    return reconnected;
+}
+
+// Move on once the current tier's window has run out. Returns true if the
+// tier changed and advertising must be restarted with new parameters.
+bool adv_schedule_advance(adv_schedule_t *sched, uint32_t now_ms) {
+    if (sched == NULL || !sched->active) return false;
+
+    uint32_t window = tier_params[sched->tier].window_ms;
+    if (window == 0 || now_ms - sched->tier_start_ms < window) {
+        return false;
+    }
+
+    adv_schedule_enter(sched, sched->tier == ADV_TIER_DIRECTED ? ADV_TIER_FAST : ADV_TIER_SLOW, now_ms);
+    return true;
+}
+
+uint32_t adv_schedule_ms_to_next(const adv_schedule_t *sched, uint32_t now_ms) {
+    if (sched == NULL || !sched->active) return UINT32_MAX;
+
+    uint32_t window = tier_params[sched->tier].window_ms;
+    if (window == 0) return UINT32_MAX;
+
+    uint32_t elapsed = now_ms - sched->tier_start_ms;
+    return elapsed >= window ? 0 : window - elapsed;
+}
+
+uint32_t adv_schedule_reconnect_avg_ms(const adv_schedule_t *sched) {
+    if (sched == NULL || sched->reconnects == 0) return 0;
+
+    return (uint32_t)(sched->reconnect_total_ms / sched->reconnects);
+}
+
+static uint8_t *put_u32_le(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+    return p + 4;
+}
+
+// Blob layout, little-endian:
+//   0  version, current tier, bonded peers, advertising (u8 each)
+//   4  ms in the current tier (u32)
+//   8  per tier: starts, connects, ms advertised (u32 each, time saturates)
+//  44  reconnects, then last, min, max and mean latency in ms (u32 each)
+size_t adv_schedule_encode(const adv_schedule_t *sched, uint8_t bonded, uint32_t now_ms, uint8_t *buf, size_t buf_len) {
+    if (sched == NULL || buf == NULL || buf_len < ADV_STATS_LEN) return 0;
+
+    uint8_t *p = buf;
+    *p++ = ADV_STATS_VERSION;
+    *p++ = (uint8_t)sched->tier;
+    *p++ = bonded;
+    *p++ = sched->active;
+    p = put_u32_le(p, sched->active ? now_ms - sched->tier_start_ms : 0);
+    for (int i = 0; i < ADV_TIER_COUNT; i++) {
+        uint64_t advertised = sched->tiers[i].advertised_ms;
+        if (sched->active && sched->tier == (adv_tier_t)i) {
+            advertised += now_ms - sched->active_since_ms;
+        }
+        p = put_u32_le(p, sched->tiers[i].starts);
+        p = put_u32_le(p, sched->tiers[i].connects);
+        p = put_u32_le(p, advertised > UINT32_MAX ? UINT32_MAX : (uint32_t)advertised);
+    }
+    p = put_u32_le(p, sched->reconnects);
+    p = put_u32_le(p, sched->reconnect_last_ms);
+    p = put_u32_le(p, sched->reconnect_min_ms);
+    p = put_u32_le(p, sched->reconnect_max_ms);
+    p = put_u32_le(p, adv_schedule_reconnect_avg_ms(sched));
+
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,76 @@
+#ifndef ADV_SCHEDULE_H
+#define ADV_SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Tiered advertising. After a bonded phone drops the link, high-duty directed
+// advertising to it lets it reconnect within about 100 ms. After boot or any
+// other disconnect the device advertises fast for a short window, then
+// falls back to a slow interval until the next disconnect.
+typedef enum {
+    ADV_TIER_DIRECTED = 0,  // High-duty directed to the bonded peer that left
+    ADV_TIER_FAST,          // Open, short interval
+    ADV_TIER_SLOW,          // Open, long interval, no time limit
+    ADV_TIER_COUNT
+} adv_tier_t;
+
+// Intervals in 0.625 ms units. Directed high-duty advertising runs at the
+// controller's fixed 3.75 ms rate and is stopped by the controller at 1.28 s.
+#define ADV_FAST_INT_MIN        0x0020  // 20 ms
+#define ADV_FAST_INT_MAX        0x0030  // 30 ms
+#define ADV_SLOW_INT_MIN        0x0660  // 1022.5 ms
+#define ADV_SLOW_INT_MAX        0x0808  // 1285 ms
+
+#define ADV_DIRECTED_WINDOW_MS  1280
+#define ADV_FAST_WINDOW_MS      30000
+
+// Diagnostics blob (see adv_schedule_encode)
+#define ADV_STATS_VERSION       1
+#define ADV_STATS_LEN           (8 + 12 * ADV_TIER_COUNT + 20)
+
+typedef struct {
+    uint16_t int_min;
+    uint16_t int_max;
+    uint32_t window_ms;         // Time before moving to the next tier, 0 = no limit
+} adv_tier_params_t;
+
+typedef struct {
+    uint32_t starts;            // Times the tier was entered
+    uint32_t connects;          // Connections accepted while in the tier
+    uint64_t advertised_ms;     // Time spent advertising in the tier
+} adv_tier_stats_t;
+
+typedef struct {
+    adv_tier_t tier;
+    bool active;                // Advertising (or about to be)
+    uint32_t tier_start_ms;
+    uint32_t active_since_ms;   // Start of the current advertised stretch
+
+    // Reconnect latency runs from a disconnect to the same peer connecting again
+    bool awaiting_peer;
+    uint8_t peer[6];
+    uint32_t disconnect_ms;
+
+    adv_tier_stats_t tiers[ADV_TIER_COUNT];
+    uint32_t reconnects;
+    uint32_t reconnect_last_ms;
+    uint32_t reconnect_min_ms;
+    uint32_t reconnect_max_ms;
+    uint64_t reconnect_total_ms;
+} adv_schedule_t;
+
+// Function prototypes
+void adv_schedule_init(adv_schedule_t *sched);
+const adv_tier_params_t *adv_schedule_params(adv_tier_t tier);
+const char *adv_schedule_tier_name(adv_tier_t tier);
+void adv_schedule_boot(adv_schedule_t *sched, uint32_t now_ms);
+void adv_schedule_disconnected(adv_schedule_t *sched, const uint8_t peer[6], bool directed, uint32_t now_ms);
+bool adv_schedule_connected(adv_schedule_t *sched, const uint8_t peer[6], bool keep_advertising, uint32_t now_ms);
+bool adv_schedule_advance(adv_schedule_t *sched, uint32_t now_ms);
+uint32_t adv_schedule_ms_to_next(const adv_schedule_t *sched, uint32_t now_ms);
+uint32_t adv_schedule_reconnect_avg_ms(const adv_schedule_t *sched);
+size_t adv_schedule_encode(const adv_schedule_t *sched, uint8_t bonded, uint32_t now_ms, uint8_t *buf, size_t buf_len);
+
+#endif // ADV_SCHEDULE_H
@@ -0,0 +1,129 @@
+#include "binlog.h"
+#include "hal.h"
+#include "esp_log.h"
+#include <stdio.h>
+
+static const char *TAG = "BINLOG";
+
+typedef struct {
+    const char *tag;
+    const char *format;         // printf format taking BINLOG_MAX_ARGS longs
+    uint32_t min_interval_ms;   // 0 logs every call (state-change sites)
+} binlog_site_info_t;
+
+static const binlog_site_info_t sites[BINLOG_SITE_COUNT] = {
+    [BINLOG_SENSORS] = { "TANK_MONITOR", "Sensors - bits 0x%02lx Levels[G:%ld B:%ld]", 0 },
+    [BINLOG_LEVELS_CHANGED] = { "TANK_MONITOR", "Levels changed - Grey: %ld (settle %lds), Black: %ld (settle %lds)", 0 },
+    [BINLOG_BOTH_STABLE] = { "TANK_MONITOR", "Both tanks stable", 0 },
+    [BINLOG_GATT_READ] = { "BLE_GATT", "READ_EVT, conn_id %ld, attr %ld", 1000 },
+    [BINLOG_GATT_WRITE] = { "BLE_GATT", "WRITE_EVT, conn_id %ld, attr %ld, value len %ld", 1000 },
+    [BINLOG_GATT_MTU] = { "BLE_GATT", "MTU_EVT, conn_id %ld, mtu %ld", 0 },
+};
+
+static hal_lock_t binlog_lock = HAL_LOCK_INITIALIZER;
+static binlog_entry_t ring[BINLOG_RING_SIZE];
+static uint32_t head = 0;
+static uint32_t last_write_ms[BINLOG_SITE_COUNT];
+static bool written[BINLOG_SITE_COUNT];
+static uint8_t suppressed[BINLOG_SITE_COUNT];
+static bool verbose = BINLOG_VERBOSE_DEFAULT;
+
+void binlog_write(binlog_site_t site, const int32_t args[BINLOG_MAX_ARGS]) {
+    if (site >= BINLOG_SITE_COUNT) return;
+
+    uint32_t now_ms = hal_time_ms();
+    binlog_entry_t entry = { .timestamp_ms = now_ms, .site = (uint8_t)site };
+
+    hal_lock(&binlog_lock);
+    uint32_t interval = sites[site].min_interval_ms;
+    if (interval && written[site] && now_ms - last_write_ms[site] < interval) {
+        if (suppressed[site] < UINT8_MAX) {
+            suppressed[site]++;
+        }
+        hal_unlock(&binlog_lock);
+        return;
+    }
+
+    entry.suppressed = suppressed[site];
+    for (int i = 0; i < BINLOG_MAX_ARGS; i++) {
+        entry.args[i] = args[i];
+    }
+    ring[head++ & (BINLOG_RING_SIZE - 1)] = entry;
+    last_write_ms[site] = now_ms;
+    written[site] = true;
+    suppressed[site] = 0;
+    hal_unlock(&binlog_lock);
+
+    if (verbose) {
+        char text[128];
+        binlog_format_entry(&entry, text, sizeof(text));
+        ESP_LOGI(sites[site].tag, "%s", text);
+    }
+}
+
+// Copy out the newest entries that fit, oldest first. Returns the number copied.
+size_t binlog_snapshot(binlog_entry_t *entries, size_t max_entries) {
+    if (entries == NULL) return 0;
+
+    hal_lock(&binlog_lock);
+    uint32_t end = head;
+    hal_unlock(&binlog_lock);
+
+    uint32_t count = end < BINLOG_RING_SIZE ? end : BINLOG_RING_SIZE;
+    if (count > max_entries) {
+        count = (uint32_t)max_entries;
+    }
+
+    // One entry at a time, so writers are only held off for a short copy
+    for (uint32_t i = 0; i < count; i++) {
+        hal_lock(&binlog_lock);
+        entries[i] = ring[(end - count + i) & (BINLOG_RING_SIZE - 1)];
+        hal_unlock(&binlog_lock);
+    }
+    return count;
+}
+
+void binlog_clear(void) {
+    hal_lock(&binlog_lock);
+    head = 0;
+    hal_unlock(&binlog_lock);
+}
+
+void binlog_set_verbose(bool enable) {
+    verbose = enable;
+}
+
+bool binlog_is_verbose(void) {
+    return verbose;
+}
+
+// Expand an entry to its text form (without tag or timestamp)
+int binlog_format_entry(const binlog_entry_t *entry, char *buf, size_t buf_len) {
+    if (entry == NULL || buf == NULL || buf_len == 0) return 0;
+
+    if (entry->site >= BINLOG_SITE_COUNT) {
+        return snprintf(buf, buf_len, "unknown site %u", entry->site);
+    }
+
+    int len = snprintf(buf, buf_len, sites[entry->site].format,
+                       (long)entry->args[0], (long)entry->args[1],
+                       (long)entry->args[2], (long)entry->args[3]);
+    if (entry->suppressed && len >= 0 && (size_t)len < buf_len) {
+        len += snprintf(buf + len, buf_len - len, " (+%u suppressed)", entry->suppressed);
+    }
+    return len;
+}
+
+// One entry per line: "<timestamp_ms> <site> <suppressed> <arg0> .. <arg3>"
+void binlog_dump(void) {
+    static binlog_entry_t entries[BINLOG_RING_SIZE];
+
+    size_t count = binlog_snapshot(entries, BINLOG_RING_SIZE);
+    ESP_LOGI(TAG, "begin %u entries", (unsigned)count);
+    for (size_t i = 0; i < count; i++) {
+        const binlog_entry_t *e = &entries[i];
+        ESP_LOGI(TAG, "%lu %u %u %ld %ld %ld %ld", (unsigned long)e->timestamp_ms, e->site,
+                 e->suppressed, (long)e->args[0], (long)e->args[1], (long)e->args[2], (long)e->args[3]);
+    }
+    ESP_LOGI(TAG, "end");
+}
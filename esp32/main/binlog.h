@@ -0,0 +1,48 @@
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Compact log for frequent sites. Each call stores a site ID and up to four
+// integer arguments in a RAM ring instead of formatting text on the UART.
+// Sites can be rate limited. Entries dropped by the limit are counted on the
+// site's next entry. With verbose mode on (`log verbose` on the console), each
+// entry is also printed as text at INFO. `log dump` prints the ring as numeric
+// lines; host/binlog/binlog_decode turns those back into text.
+#define BINLOG_RING_SIZE        128     // Entries kept (power of two)
+#define BINLOG_MAX_ARGS         4
+#define BINLOG_VERBOSE_DEFAULT  false
+
+// Log sites; the table in binlog.c holds each site's tag, format and rate limit
+typedef enum {
+    BINLOG_SENSORS = 0,         // raw mask, grey level, black level
+    BINLOG_LEVELS_CHANGED,      // grey level, grey settle s, black level, black settle s
+    BINLOG_BOTH_STABLE,         // no arguments
+    BINLOG_GATT_READ,           // conn_id, attribute (tank_attr_t)
+    BINLOG_GATT_WRITE,          // conn_id, attribute (tank_attr_t), length
+    BINLOG_GATT_MTU,            // conn_id, mtu
+    BINLOG_SITE_COUNT
+} binlog_site_t;
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint8_t site;
+    uint8_t suppressed;         // Entries dropped by the rate limit before this one (saturates)
+    int32_t args[BINLOG_MAX_ARGS];
+} binlog_entry_t;
+
+// Function prototypes
+void binlog_write(binlog_site_t site, const int32_t args[BINLOG_MAX_ARGS]);
+size_t binlog_snapshot(binlog_entry_t *entries, size_t max_entries);
+void binlog_clear(void);
+void binlog_set_verbose(bool verbose);
+bool binlog_is_verbose(void);
+int binlog_format_entry(const binlog_entry_t *entry, char *buf, size_t buf_len);
+void binlog_dump(void);
+
+// BINLOG(site, a, b, ...) - unused arguments are zero
+#define BINLOG(site, ...) binlog_write((site), (const int32_t[BINLOG_MAX_ARGS]){ __VA_ARGS__ })
+
+#endif // BINLOG_H
@@ -1,894 +1,1489 @@
-#include "sdkconfig.h"
+#include "ble_gatt.h"
+#include "ble_transport.h"
+#include "tank_monitor.h"
+#include "tank_payload.h"
+#include "tank_command.h"
+#include "adv_schedule.h"
+#include "config.h"
+#include "metrics.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include "binlog.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_random.h"
+#include <stdatomic.h>
+#include <string.h>
+#include <stdio.h>
 
-// Fallback definitions for VS Code IntelliSense
-// These are only used if not already defined in sdkconfig.h
-#ifndef CONFIG_BT_LE_LL_RESOLV_LIST_SIZE
-#define CONFIG_BT_LE_LL_RESOLV_LIST_SIZE 4
-#endif
+// Tank service: connections, PIN authentication, config, history, read
+// caching, advertising tiers and link policy. Everything stack-specific goes
+// through ble_transport.h.
 
-#ifndef CONFIG_BT_LE_LL_DUP_SCAN_LIST_COUNT
-#define CONFIG_BT_LE_LL_DUP_SCAN_LIST_COUNT 16
-#endif
+static const char *TAG = "BLE_GATT";
 
-#ifndef CONFIG_BT_LE_LL_SCAN_DUPL_CACHE_SIZE
-#define CONFIG_BT_LE_LL_SCAN_DUPL_CACHE_SIZE 100
-#endif
+// Device name with unique identifier
+static char device_name[32];
 
-#ifndef CONFIG_BT_LE_LL_SCAN_DUPL_CACHE_REFRESH_PERIOD
-#define CONFIG_BT_LE_LL_SCAN_DUPL_CACHE_REFRESH_PERIOD 0
-#endif
+// Characteristics, in the order the backends declare them
+const tank_attr_def_t tank_attr_defs[TANK_ATTR_COUNT] = {
+    // A 1-byte write selects the wire format for this connection
+    [TANK_ATTR_DATA] = { TANK_DATA_CHAR_UUID, TANK_ATTR_READ | TANK_ATTR_WRITE | TANK_ATTR_NOTIFY },
+    [TANK_ATTR_AUTH] = { AUTH_CHAR_UUID, TANK_ATTR_WRITE },
+    [TANK_ATTR_CONFIG] = { CONFIG_CHAR_UUID, TANK_ATTR_WRITE },
+    [TANK_ATTR_PIN_CHANGE] = { PIN_CHANGE_CHAR_UUID, TANK_ATTR_WRITE },
+    [TANK_ATTR_HISTORY] = { HISTORY_CHAR_UUID, TANK_ATTR_WRITE | TANK_ATTR_NOTIFY },
+    [TANK_ATTR_METRICS] = { METRICS_CHAR_UUID, TANK_ATTR_READ },
+    [TANK_ATTR_ADV_STATS] = { ADV_STATS_CHAR_UUID, TANK_ATTR_READ },
+    [TANK_ATTR_LINKS] = { LINKS_CHAR_UUID, TANK_ATTR_READ },
+    // Batched operations; the result is indicated and stays readable
+    [TANK_ATTR_COMMAND] = { COMMAND_CHAR_UUID, TANK_ATTR_READ | TANK_ATTR_WRITE | TANK_ATTR_INDICATE },
+    [TANK_ATTR_SAMPLING] = { SAMPLING_CHAR_UUID, TANK_ATTR_READ },
+};
 
-#ifndef CONFIG_BT_LE_DFT_TX_POWER_LEVEL_DBM_EFF
-#define CONFIG_BT_LE_DFT_TX_POWER_LEVEL_DBM_EFF 9
+// Connection tracking
+static conn_table_t connections;
+
+// Tank data as encoded by the notifier at the last state change or heartbeat,
+// one buffer per wire format. Reads are answered from here so the BT task
+// only ages v2's timing fields and copies, without touching the monitor.
+static portMUX_TYPE read_cache_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t read_cache_v1[TANK_PAYLOAD_V1_LEN];
+static uint8_t read_cache_v2[TANK_PAYLOAD_V2_LEN];
+static uint32_t read_cache_ms;
+static bool read_cache_valid = false;
+
+// Command results are written by the BT task and indicated by the notifier
+static portMUX_TYPE command_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Advertising data and scan response are configured and advertising has
+// started; later adv data updates replace the payload in place
+static bool adv_setup_done = false;
+#if BLE_BROADCAST_ENABLE
+static uint8_t adv_manufacturer[TANK_ADV_LEN];
 #endif
 
-#ifndef CONFIG_BT_LE_CTRL_DFT_TX_POWER_LEVEL_EFF
-#define CONFIG_BT_LE_CTRL_DFT_TX_POWER_LEVEL_EFF 9
-#endif
+// Advertising tiers (fast, slow, directed to a returning bonded phone). The
+// timer wakes the notifier when a tier's window ends, which stops
+// advertising; the stop-complete event restarts it with the next tier's
+// parameters. The schedule is only changed on the BT task; adv_lock keeps
+// the notifier from seeing it, or adv_restart_pending, half updated.
+static adv_schedule_t adv_sched;
+static esp_timer_handle_t adv_timer = NULL;
+static uint8_t adv_peer_addr_type = 0;
+static bool adv_restart_pending = false;
+static portMUX_TYPE adv_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_bool adv_window_ended = false;
+
+// Fires when the next active link is due to drop to the idle profile.
+// Link activity is recorded by the BT task and the notifier under
+// policy_lock; evaluating the policy, requesting parameters and re-arming
+// the timer happen only on the notifier, which the BT task and the timer
+// wake through policy_check.
+static esp_timer_handle_t conn_policy_timer = NULL;
+static portMUX_TYPE policy_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_bool policy_check = false;
+
+// Task that streams history chunks (BLE notifier), woken on backfill requests
+static TaskHandle_t notify_task = NULL;
+
+// Stack cost, for comparing host stacks (see BLE_STACKS.md)
+static uint32_t heap_before_init;
+static uint32_t heap_after_init;
+static uint32_t heap_at_first_adv;
+static uint32_t first_adv_ms;
 
-#ifndef CONFIG_BT_LE_ENHANCED_CONN_UPDATE
-#define CONFIG_BT_LE_ENHANCED_CONN_UPDATE 1
-#endif
+static ble_conn_info_t *find_connection(uint16_t conn_id, const uint8_t *bda)
+{
+    ble_conn_info_t *conn = conn_table_get(&connections, conn_id);
+    if (conn)
+    {
+        return conn;
+    }
 
-#ifndef CONFIG_BT_LE_CONTROLLER_TASK_STACK_SIZE
-#define CONFIG_BT_LE_CONTROLLER_TASK_STACK_SIZE 4096
-#endif
+    if (bda)
+    {
+        conn = conn_table_find_bda(&connections, bda);
+        if (conn)
+        {
+            ESP_LOGW(TAG, "Connection lookup fallback matched by address for conn_id %d", conn_id);
+        }
+    }
 
-#ifndef CONFIG_BT_LE_CONTROLLER_TASK_PRIORITY
-#define CONFIG_BT_LE_CONTROLLER_TASK_PRIORITY 25
-#endif
+    return conn;
+}
 
-#ifndef CONFIG_BT_LE_MAX_CONNECTIONS
-#define CONFIG_BT_LE_MAX_CONNECTIONS 3
-#endif
+static uint32_t get_u32_le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
 
-#ifndef CONFIG_BT_LE_MAX_PERIODIC_ADVERTISER_LIST
-#define CONFIG_BT_LE_MAX_PERIODIC_ADVERTISER_LIST 5
-#endif
+static uint32_t ble_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
 
-#ifndef CONFIG_BT_LE_MAX_PERIODIC_SYNCS
-#define CONFIG_BT_LE_MAX_PERIODIC_SYNCS 1
-#endif
+// Start advertising with the current tier's parameters and arm the timer
+// for the end of its window
+static void ble_adv_start(void)
+{
+    const adv_tier_params_t *tier = adv_schedule_params(adv_sched.tier);
+    const uint8_t *peer = adv_sched.tier == ADV_TIER_DIRECTED ? adv_sched.peer : NULL;
 
-#ifndef CONFIG_BT_LE_MAX_EXT_ADV_INSTANCES
-#define CONFIG_BT_LE_MAX_EXT_ADV_INSTANCES 1
-#endif
+    ble_transport_adv_start(tier, peer, adv_peer_addr_type);
 
-#ifndef CONFIG_BT_LE_EXT_ADV_MAX_SIZE
-#define CONFIG_BT_LE_EXT_ADV_MAX_SIZE 31
-#endif
+    uint32_t window_ms = adv_schedule_ms_to_next(&adv_sched, ble_now_ms());
+    if (adv_timer)
+    {
+        esp_timer_stop(adv_timer);
+        if (window_ms != UINT32_MAX)
+        {
+            esp_timer_start_once(adv_timer, (uint64_t)window_ms * 1000);
+        }
+    }
+}
 
-#ifndef CONFIG_BT_LE_SCAN_RSP_DATA_MAX_LEN
-#define CONFIG_BT_LE_SCAN_RSP_DATA_MAX_LEN 31
-#endif
+// Apply a tier change: a running advertiser has to be stopped first, and
+// ble_gatt_on_adv_stopped() starts it again
+static void ble_adv_restart(bool running)
+{
+    if (running)
+    {
+        portENTER_CRITICAL(&adv_lock);
+        adv_restart_pending = true;
+        portEXIT_CRITICAL(&adv_lock);
+        ble_transport_adv_stop();
+    }
+    else
+    {
+        ble_adv_start();
+    }
+}
 
-#ifndef CONFIG_BT_LE_SLEEP_ENABLE
-#define CONFIG_BT_LE_SLEEP_ENABLE 0
-#endif
+// The advertiser is left to the BT and notifier tasks
+static void ble_adv_timer_cb(void *arg)
+{
+    atomic_store(&adv_window_ended, true);
+    if (notify_task)
+    {
+        xTaskNotifyGive(notify_task);
+    }
+}
 
-#ifndef CONFIG_BT_LE_USE_WIFI_PWR_CLK_WORKAROUND
-#define CONFIG_BT_LE_USE_WIFI_PWR_CLK_WORKAROUND 0
-#endif
+// Re-arm the policy timer for the link that goes quiet first (notifier task)
+static void ble_arm_conn_policy_timer(uint32_t now_ms)
+{
+    uint32_t next_ms = UINT32_MAX;
+    ble_conn_info_t *conn;
 
-#ifndef CONFIG_BT_LE_LL_SCA
-#define CONFIG_BT_LE_LL_SCA 500
-#endif
+    portENTER_CRITICAL(&policy_lock);
+    CONN_TABLE_FOREACH(&connections, conn)
+    {
+        uint32_t ms = conn_policy_ms_to_idle(&conn->policy, now_ms);
+        if (ms < next_ms)
+        {
+            next_ms = ms;
+        }
+    }
+    portEXIT_CRITICAL(&policy_lock);
 
-#ifndef CONFIG_BT_LE_LP_CLK_ACCURACY_PPM
-#define CONFIG_BT_LE_LP_CLK_ACCURACY_PPM 500
-#endif
+    if (conn_policy_timer)
+    {
+        esp_timer_stop(conn_policy_timer);
+        if (next_ms != UINT32_MAX)
+        {
+            esp_timer_start_once(conn_policy_timer, (uint64_t)next_ms * 1000 + 1000);
+        }
+    }
+}
 
-#ifndef CONFIG_BT_LE_COEX_PHY_CODED_TX_RX_TLIM
-#define CONFIG_BT_LE_COEX_PHY_CODED_TX_RX_TLIM 0
-#endif
+// Ask the central for the parameters this link's activity calls for
+// (notifier task)
+static void ble_apply_conn_policy(ble_conn_info_t *conn)
+{
+    uint32_t now_ms = ble_now_ms();
+    portENTER_CRITICAL(&policy_lock);
+    conn_profile_t profile = conn_policy_evaluate(&conn->policy, conn->history_pending, now_ms);
+    portEXIT_CRITICAL(&policy_lock);
+    if (profile == CONN_PROFILE_NONE)
+    {
+        return;
+    }
 
-#ifndef CONFIG_BT_LE_COEX_PHY_CODED_TX_RX_TLIM_EFF
-#define CONFIG_BT_LE_COEX_PHY_CODED_TX_RX_TLIM_EFF 0
-#endif
+    ESP_LOGI(TAG, "conn_id %d: requesting %s parameters", conn->conn_id, conn_policy_profile_name(profile));
+    ble_transport_update_link(conn->conn_id, conn->remote_bda, conn_policy_params(profile));
 
-#ifndef CONFIG_BT_CTRL_COEX_PHY_CODED_TX_RX_TLIM_EFF
-#define CONFIG_BT_CTRL_COEX_PHY_CODED_TX_RX_TLIM_EFF 0
-#endif
+    if (profile == CONN_PROFILE_ACTIVE)
+    {
+        ble_arm_conn_policy_timer(now_ms);
+    }
+}
 
-#ifndef CONFIG_BT_CTRL_SLEEP_MODE_EFF
-#define CONFIG_BT_CTRL_SLEEP_MODE_EFF 0
-#endif
+// Have the notifier re-evaluate every link
+static void ble_request_policy_check(void)
+{
+    atomic_store(&policy_check, true);
+    if (notify_task)
+    {
+        xTaskNotifyGive(notify_task);
+    }
+}
 
-#ifndef CONFIG_BT_CTRL_SLEEP_CLOCK_EFF
-#define CONFIG_BT_CTRL_SLEEP_CLOCK_EFF 0
-#endif
+static void ble_note_link_activity(ble_conn_info_t *conn)
+{
+    portENTER_CRITICAL(&policy_lock);
+    conn_policy_note_activity(&conn->policy, ble_now_ms());
+    portEXIT_CRITICAL(&policy_lock);
+    ble_request_policy_check();
+}
 
-#ifndef CONFIG_BT_CTRL_HCI_TL_EFF
-#define CONFIG_BT_CTRL_HCI_TL_EFF 1
-#endif
+static void ble_conn_policy_timer_cb(void *arg)
+{
+    ble_request_policy_check();
+}
 
-#ifndef CONFIG_BT_CTRL_AGC_RECORRECT_EN
-#define CONFIG_BT_CTRL_AGC_RECORRECT_EN 0
-#endif
+// Encode the tank data payload in the given wire format from a consistent snapshot
+static size_t ble_encode_tank_data(const tank_snapshot_t *snapshot, uint8_t format, uint8_t *data)
+{
+    uint64_t now_ms = tank_monitor_clock_ms();
+    uint64_t since_change = now_ms - snapshot->last_change_ms;
+
+    tank_payload_fields_t fields = {
+        .raw_mask = snapshot->raw_mask,
+        .grey_enabled = snapshot->grey_enabled,
+        .black_enabled = snapshot->black_enabled,
+        .system_stable = snapshot->system_stable,
+        .grey_stable = snapshot->grey_stable,
+        .black_stable = snapshot->black_stable,
+        .in_motion = snapshot->in_motion,
+        .grey_fault = snapshot->inconsistent_mask & (1u << SENSOR_STATS_TANK_GREY),
+        .black_fault = snapshot->inconsistent_mask & (1u << SENSOR_STATS_TANK_BLACK),
+        .sequence = snapshot->sequence,
+        .ms_since_change = since_change > UINT32_MAX ? UINT32_MAX : (uint32_t)since_change,
+        .ms_until_stable = tank_monitor_snapshot_ms_until_stable(snapshot, now_ms),
+    };
+
+    return tank_payload_encode(format, &fields, data);
+}
 
-#ifndef CONFIG_BT_CTRL_CODED_AGC_RECORRECT_EN
-#define CONFIG_BT_CTRL_CODED_AGC_RECORRECT_EN 0
+// Advertising data: flags and name, plus the tank state in broadcast mode
+static void ble_config_adv_data(void)
+{
+#if BLE_BROADCAST_ENABLE
+    ble_transport_set_adv_data(adv_manufacturer, sizeof(adv_manufacturer));
+#else
+    ble_transport_set_adv_data(NULL, 0);
 #endif
+}
 
-#ifndef CONFIG_BT_CTRL_SCAN_BACKOFF_UPPERLIMITMAX
-#define CONFIG_BT_CTRL_SCAN_BACKOFF_UPPERLIMITMAX 0
+#if BLE_BROADCAST_ENABLE
+// Encode the snapshot into the manufacturer data. Returns true if it changed.
+static bool ble_encode_adv_data(const tank_snapshot_t *snapshot)
+{
+    tank_payload_fields_t fields = {
+        .raw_mask = snapshot->raw_mask,
+        .grey_enabled = snapshot->grey_enabled,
+        .black_enabled = snapshot->black_enabled,
+        .system_stable = snapshot->system_stable,
+        .grey_stable = snapshot->grey_stable,
+        .black_stable = snapshot->black_stable,
+        .in_motion = snapshot->in_motion,
+        .grey_fault = snapshot->inconsistent_mask & (1u << SENSOR_STATS_TANK_GREY),
+        .black_fault = snapshot->inconsistent_mask & (1u << SENSOR_STATS_TANK_BLACK),
+        .sequence = snapshot->sequence,
+    };
+    uint8_t adv[TANK_ADV_LEN];
+
+    tank_payload_encode_adv(&fields, adv);
+    if (memcmp(adv, adv_manufacturer, sizeof(adv)) == 0)
+    {
+        return false;
+    }
+    memcpy(adv_manufacturer, adv, sizeof(adv));
+    return true;
+}
 #endif
 
-#include "ble_gatt.h"
-#include "tank_monitor.h"
-#include "config.h"
-#include "esp_log.h"
-#include "esp_bt.h"
-#include "esp_bt_main.h"
-#include "esp_gap_ble_api.h"
-#include "esp_gatts_api.h"
-#include "esp_gatt_common_api.h"
-#include "esp_mac.h"
-#include "esp_random.h"
-#include <string.h>
-#include <stdio.h>
+// Tank data for a read, from the notifier's cache when it has run
+static size_t ble_read_tank_data(uint8_t format, uint8_t *data)
+{
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+    size_t len = 0;
 
-static const char *TAG = "BLE_GATT";
+    portENTER_CRITICAL(&read_cache_lock);
+    if (read_cache_valid)
+    {
+        len = format == TANK_PAYLOAD_V2 ? sizeof(read_cache_v2) : sizeof(read_cache_v1);
+        memcpy(data, format == TANK_PAYLOAD_V2 ? read_cache_v2 : read_cache_v1, len);
+    }
+    uint32_t cached_ms = read_cache_ms;
+    portEXIT_CRITICAL(&read_cache_lock);
 
-// Static passkey stored for responding to passkey requests
-static uint32_t static_passkey = 0;
+    if (len == 0)
+    {
+        // Nothing published yet (just after boot) - encode directly
+        tank_snapshot_t snapshot;
+        tank_monitor_get_snapshot(&snapshot);
+        return ble_encode_tank_data(&snapshot, format, data);
+    }
 
-// Device name with unique identifier
-static char device_name[32];
+    tank_payload_age(data, len, now_ms - cached_ms);
+    return len;
+}
 
-// GATT profile
-typedef struct
-{
-    esp_gatts_cb_t gatts_cb;
-    uint16_t gatts_if;
-    uint16_t app_id;
-    uint16_t conn_id;
-    uint16_t service_handle;
-    esp_gatt_srvc_id_t service_id;
-    uint16_t char_handle;
-    esp_bt_uuid_t char_uuid;
-    esp_gatt_perm_t perm;
-    esp_gatt_char_prop_t property;
-    uint16_t descr_handle;
-    esp_bt_uuid_t descr_uuid;
-} gatts_profile_inst_t;
+// Whether a diagnostics blob read should take a new sample. A read at offset
+// 0 does, and long-read continuations serve the rest of the same sample. A
+// stack that hides the offset gets a new sample once the last one is stale.
+static bool ble_blob_resample(uint16_t offset, uint32_t *sampled_ms)
+{
+    uint32_t now_ms = ble_now_ms();
 
-// Connection tracking
-static ble_conn_info_t connections[MAX_CONNECTIONS] = {0};
-static uint8_t connected_count = 0;
-// Profile instance
-static gatts_profile_inst_t profile_tab[PROFILE_NUM];
-static uint16_t tank_handle_table[5]; // Increased for PIN change characteristic
-static esp_gatt_if_t gatts_if_global = ESP_GATT_IF_NONE;
+    if (offset == BLE_TRANSPORT_OFFSET_UNKNOWN && *sampled_ms != 0 &&
+        now_ms - *sampled_ms < BLE_BLOB_RESAMPLE_MS)
+    {
+        return false;
+    }
+    if (offset != 0 && offset != BLE_TRANSPORT_OFFSET_UNKNOWN)
+    {
+        return false;
+    }
+    *sampled_ms = now_ms ? now_ms : 1;
+    return true;
+}
 
-static ble_conn_info_t *find_connection(uint16_t conn_id, const uint8_t *bda)
+static void ble_log_connection(const ble_conn_info_t *conn);
+
+// Stack ready and service registered: configure advertising data (the
+// device name was given to the backend at init)
+void ble_gatt_on_ready(void)
+{
+#if BLE_BROADCAST_ENABLE
+    tank_snapshot_t snapshot;
+    tank_monitor_get_snapshot(&snapshot);
+    ble_encode_adv_data(&snapshot);
+#endif
+    ble_config_adv_data();
+}
+
+// Advertising and scan response data are in place: start advertising, fast first
+void ble_gatt_on_adv_ready(void)
+{
+    portENTER_CRITICAL(&adv_lock);
+    adv_schedule_boot(&adv_sched, ble_now_ms());
+    portEXIT_CRITICAL(&adv_lock);
+    ble_adv_start();
+    adv_setup_done = true;
+}
+
+void ble_gatt_on_adv_started(bool success)
 {
-    for (int i = 0; i < connected_count; i++)
+    if (!success)
     {
-        if (connections[i].conn_id == conn_id)
-        {
-            return &connections[i];
-        }
+        ESP_LOGE(TAG, "Advertising start failed");
+        return;
     }
 
-    if (bda)
+    ESP_LOGI(TAG, "Advertising (%s)", adv_schedule_tier_name(adv_sched.tier));
+    if (first_adv_ms == 0)
     {
-        for (int i = 0; i < connected_count; i++)
-        {
-            if (memcmp(connections[i].remote_bda, bda, sizeof(esp_bd_addr_t)) == 0)
-            {
-                ESP_LOGW(TAG, "Connection lookup fallback matched by address for conn_id %d", conn_id);
-                return &connections[i];
-            }
-        }
+        first_adv_ms = ble_now_ms();
+        heap_at_first_adv = esp_get_free_heap_size();
+        ESP_LOGI(TAG, "%s: first advertisement %lu ms after boot, %lu bytes heap free",
+                 ble_transport_name(), (unsigned long)first_adv_ms, (unsigned long)heap_at_first_adv);
     }
-
-    return NULL;
 }
 
-// Forward declarations
-static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
-                                        esp_gatt_if_t gatts_if,
-                                        esp_ble_gatts_cb_param_t *param);
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
-                                esp_ble_gatts_cb_param_t *param);
-
-// GAP event handler
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+// Advertising stopped. Also reported as a failure when the controller had
+// already stopped, e.g. at the end of directed advertising; restart either way.
+void ble_gatt_on_adv_stopped(void)
 {
-    switch (event)
+    portENTER_CRITICAL(&adv_lock);
+    bool restart = adv_restart_pending;
+    if (restart)
     {
-    case ESP_GAP_BLE_SEC_REQ_EVT:
-        // Security request from peer device
-        ESP_LOGI(TAG, "Security request");
-        esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
-        break;
+        adv_restart_pending = false;
+        adv_schedule_advance(&adv_sched, ble_now_ms());
+    }
+    portEXIT_CRITICAL(&adv_lock);
 
-    case ESP_GAP_BLE_PASSKEY_REQ_EVT:
-        // Passkey request event - reply with our static passkey
-        // This shouldn't normally happen with ESP_IO_CAP_OUT, but some Android devices may request it
-        ESP_LOGI(TAG, "Passkey request received - replying with static passkey");
-        esp_ble_passkey_reply(param->ble_security.ble_req.bd_addr, true, static_passkey);
-        break;
+    if (restart && adv_sched.active && connections.count < MAX_CONNECTIONS)
+    {
+        ble_adv_start();
+    }
+}
 
-    case ESP_GAP_BLE_NC_REQ_EVT:
-        // Numeric comparison request - MITM protection
-        ESP_LOGI(TAG, "=========================================");
-        ESP_LOGI(TAG, "BLE PAIRING REQUEST!");
-        ESP_LOGI(TAG, "Verify this code matches your phone:");
-        ESP_LOGI(TAG, "         [ %06d ]", param->ble_security.key_notif.passkey);
-        ESP_LOGI(TAG, "=========================================");
-        ESP_LOGI(TAG, "If codes match, tap 'Pair' on your phone");
-        ESP_LOGI(TAG, "If they don't match, tap 'Cancel' (MITM attack!)");
-
-        // Auto-accept on ESP32 side (user confirms on phone)
-        esp_ble_confirm_reply(param->ble_security.ble_req.bd_addr, true);
-        break;
+void ble_gatt_on_connect(uint16_t conn_id, const uint8_t bda[6], const ble_link_params_t *params)
+{
+    ESP_LOGI(TAG, "Client connected, conn_id %d", conn_id);
 
-    case ESP_GAP_BLE_PASSKEY_NOTIF_EVT:
-        // Passkey notification event
-        ESP_LOGI(TAG, "Passkey notification: %06d", param->ble_security.key_notif.passkey);
-        break;
+    // Start security/encryption process
+    ble_transport_secure(conn_id, bda);
+
+    // Track connection. The notifier must not evaluate the slot before its
+    // policy is set up.
+    portENTER_CRITICAL(&policy_lock);
+    ble_conn_info_t *opened = conn_table_add(&connections, conn_id, bda);
+    if (opened)
+    {
+        // Short interval for discovery and auth, relaxed once the link goes quiet
+        conn_policy_init(&opened->policy, ble_now_ms());
+        conn_policy_set_current(&opened->policy, params->interval, params->latency, params->timeout);
+    }
+    portEXIT_CRITICAL(&policy_lock);
+    if (opened == NULL)
+    {
+        ESP_LOGW(TAG, "No slot for conn_id %d (%d/%d connected), disconnecting",
+                 conn_id, connections.count, MAX_CONNECTIONS);
+        ble_transport_disconnect(conn_id, bda);
+        return;
+    }
+    ble_request_policy_check();
+
+    // Continue advertising until every slot is taken
+    bool keep_advertising = connections.count < MAX_CONNECTIONS;
+    adv_tier_t tier = adv_sched.tier;
+    portENTER_CRITICAL(&adv_lock);
+    bool reconnected = adv_schedule_connected(&adv_sched, bda, keep_advertising, ble_now_ms());
+    bool restart_pending = adv_restart_pending;
+    portEXIT_CRITICAL(&adv_lock);
+    if (reconnected)
+    {
+        ESP_LOGI(TAG, "Peer reconnected in %lu ms (%s advertising)",
+                 (unsigned long)adv_sched.reconnect_last_ms, adv_schedule_tier_name(tier));
+    }
 
-    case ESP_GAP_BLE_AUTH_CMPL_EVT:
-        // Authentication complete
-        if (param->ble_security.auth_cmpl.success)
+    if (keep_advertising)
+    {
+        ESP_LOGI(TAG, "Continuing to advertise, %d/%d connections", connections.count, MAX_CONNECTIONS);
+        // A pending stop restarts advertising when it completes
+        if (!restart_pending)
         {
-            ESP_LOGI(TAG, "Authentication success: %s",
-                     param->ble_security.auth_cmpl.auth_mode == ESP_LE_AUTH_BOND ? "BONDED" : "PAIRED");
-            
-            // Mark connection as encrypted/secured
-            for (int i = 0; i < connected_count; i++)
-            {
-                if (memcmp(connections[i].remote_bda, param->ble_security.auth_cmpl.bd_addr, 6) == 0)
-                {
-                    connections[i].is_encrypted = true;
-                    ESP_LOGI(TAG, "Connection marked as encrypted for conn_id %d", connections[i].conn_id);
-                    break;
-                }
-            }
+            ble_adv_start();
         }
-        else
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Max connections reached (%d), stopping advertising", MAX_CONNECTIONS);
+        if (adv_timer)
         {
-            ESP_LOGE(TAG, "Authentication failed, reason: 0x%x", param->ble_security.auth_cmpl.fail_reason);
-            // Disconnect the peer if authentication fails
-            for (int i = 0; i < connected_count; i++)
-            {
-                if (memcmp(connections[i].remote_bda, param->ble_security.auth_cmpl.bd_addr, 6) == 0)
-                {
-                    esp_ble_gap_disconnect(connections[i].remote_bda);
-                    ESP_LOGI(TAG, "Disconnecting unauthenticated device");
-                    break;
-                }
-            }
+            esp_timer_stop(adv_timer);
         }
-        break;
+    }
+}
 
-    case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-        if (param->adv_data_cmpl.status == ESP_BT_STATUS_SUCCESS)
-        {
-            // Configure scan response data with the device name
-            esp_ble_adv_data_t scan_rsp_data = {
-                .set_scan_rsp = true,
-                .include_name = true,
-                .include_txpower = false,
-                .appearance = 0x00,
-                .manufacturer_len = 0,
-                .p_manufacturer_data = NULL,
-                .service_data_len = 0,
-                .p_service_data = NULL,
-                .service_uuid_len = 0,
-                .p_service_uuid = NULL,
-                .flag = 0,
-            };
-            esp_ble_gap_config_adv_data(&scan_rsp_data);
-        }
-        break;
+void ble_gatt_on_disconnect(uint16_t conn_id, const uint8_t bda[6], uint8_t reason)
+{
+    ESP_LOGI(TAG, "Client disconnected, reason: 0x%x", reason);
 
-    case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
-        if (param->scan_rsp_data_cmpl.status == ESP_BT_STATUS_SUCCESS)
-        {
-            // Start advertising after scan response is configured
-            esp_ble_adv_params_t adv_params = {
-                .adv_int_min = 0x20,
-                .adv_int_max = 0x40,
-                .adv_type = ADV_TYPE_IND,
-                .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
-                .channel_map = ADV_CHNL_ALL,
-                .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
-            };
-            esp_ble_gap_start_advertising(&adv_params);
-        }
-        break;
-    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
-        if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS)
+    // Remove from connections
+    ble_conn_info_t *closed = conn_table_get(&connections, conn_id);
+    if (closed)
+    {
+        ble_log_connection(closed);
+        conn_table_remove(&connections, conn_id);
+    }
+
+    // Restart advertising: directed to a bonded phone that lost the link,
+    // otherwise the fast window. A phone that closed the link itself is
+    // not expected back right away.
+    bool was_advertising = adv_sched.active;
+    bool directed = BLE_ADV_DIRECTED_ENABLE &&
+                    reason != BLE_TRANSPORT_REASON_PEER_USER &&
+                    reason != BLE_TRANSPORT_REASON_LOCAL_HOST &&
+                    ble_transport_find_bonded(bda, &adv_peer_addr_type);
+    portENTER_CRITICAL(&adv_lock);
+    adv_schedule_disconnected(&adv_sched, bda, directed, ble_now_ms());
+    portEXIT_CRITICAL(&adv_lock);
+    ble_adv_restart(was_advertising);
+}
+
+// Pairing finished. Links that fail, or that negotiate down to Just Works,
+// are dropped.
+void ble_gatt_on_encryption(uint16_t conn_id, const uint8_t bda[6], bool success)
+{
+    ble_conn_info_t *conn = conn_id == BLE_TRANSPORT_CONN_UNKNOWN
+                                ? conn_table_find_bda(&connections, bda)
+                                : find_connection(conn_id, bda);
+
+    if (success)
+    {
+        // Mark connection as encrypted/secured
+        if (conn)
         {
-            ESP_LOGE(TAG, "Advertising start failed");
+            conn->is_encrypted = true;
+            ESP_LOGI(TAG, "Connection marked as encrypted for conn_id %d", conn->conn_id);
         }
-        break;
-    default:
-        break;
+    }
+    else if (conn)
+    {
+        // Disconnect the peer if authentication fails
+        ble_transport_disconnect(conn->conn_id, conn->remote_bda);
+        ESP_LOGI(TAG, "Disconnecting unauthenticated device");
     }
 }
 
-// GATTS profile event handler
-static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
-                                        esp_gatt_if_t gatts_if,
-                                        esp_ble_gatts_cb_param_t *param)
+void ble_gatt_on_mtu(uint16_t conn_id, uint16_t mtu)
 {
-    switch (event)
+    BINLOG(BINLOG_GATT_MTU, conn_id, mtu);
+
+    ble_conn_info_t *mtu_connection = find_connection(conn_id, NULL);
+    if (mtu_connection)
     {
-    case ESP_GATTS_REG_EVT:
-        ESP_LOGI(TAG, "REGISTER_APP_EVT, status %d, app_id %d",
-                 param->reg.status, param->reg.app_id);
+        mtu_connection->mtu = mtu;
+        ble_note_link_activity(mtu_connection);
+    }
+}
 
-        gatts_if_global = gatts_if;
+void ble_gatt_on_congest(uint16_t conn_id, bool congested)
+{
+    ESP_LOGD(TAG, "Connection %d %s", conn_id, congested ? "congested" : "uncongested");
 
-        // Configure advertising data (device name already set in ble_gatt_init)
-        esp_ble_adv_data_t adv_data = {
-            .set_scan_rsp = false,
-            .include_name = true,
-            .include_txpower = false,
-            .min_interval = 0x0006,
-            .max_interval = 0x0010,
-            .appearance = 0x00,
-            .manufacturer_len = 0,
-            .p_manufacturer_data = NULL,
-            .service_data_len = 0,
-            .p_service_data = NULL,
-            .service_uuid_len = 0,
-            .p_service_uuid = NULL,
-            .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
-        };
-        esp_ble_gap_config_adv_data(&adv_data);
-
-        // Create service
-        esp_ble_gatts_create_service(gatts_if, &(esp_gatt_srvc_id_t){
-                                                   .is_primary = true,
-                                                   .id = {
-                                                       .inst_id = 0x00,
-                                                       .uuid = {
-                                                           .len = ESP_UUID_LEN_16,
-                                                           .uuid = {.uuid16 = TANK_SERVICE_UUID},
-                                                       },
-                                                   },
-                                               },
-                                     10);
-        break;
+    ble_conn_info_t *congest_connection = find_connection(conn_id, NULL);
+    if (congest_connection)
+    {
+        notify_queue_set_congested(&congest_connection->queue, congested);
+    }
 
-    case ESP_GATTS_CREATE_EVT:
-        ESP_LOGI(TAG, "CREATE_SERVICE_EVT, status %d, service_handle %d",
-                 param->create.status, param->create.service_handle);
+    if (congested)
+    {
+        metrics_inc(METRIC_GATT_CONGEST);
+    }
+    else if (notify_task)
+    {
+        // Link drained - let the notifier flush whatever it held back
+        xTaskNotifyGive(notify_task);
+    }
+}
 
-        profile_tab[PROFILE_APP_ID].service_handle = param->create.service_handle;
+void ble_gatt_on_link_update(uint16_t conn_id, const uint8_t bda[6], bool success, const ble_link_params_t *params)
+{
+    ble_conn_info_t *updated = conn_id == BLE_TRANSPORT_CONN_UNKNOWN
+                                   ? conn_table_find_bda(&connections, bda)
+                                   : find_connection(conn_id, bda);
+    if (updated)
+    {
+        portENTER_CRITICAL(&policy_lock);
+        conn_policy_update_done(&updated->policy, success, params->interval, params->latency, params->timeout);
+        portEXIT_CRITICAL(&policy_lock);
+    }
+    ESP_LOGI(TAG, "Connection parameters %s: interval %d (x1.25 ms), latency %d, timeout %d (x10 ms)",
+             success ? "updated" : "refused", params->interval, params->latency, params->timeout);
+}
 
-        // Add characteristics
-        esp_ble_gatts_start_service(param->create.service_handle);
+// Answer a read with the part of the value at the requested offset, as much
+// as fits in the connection's MTU. Values are only valid until the next read.
+uint8_t ble_gatt_on_read(uint16_t conn_id, tank_attr_t attr, uint16_t offset, const uint8_t **value, uint16_t *len)
+{
+    static uint8_t data[TANK_PAYLOAD_MAX_LEN];
+    static uint16_t data_len;
+    const uint8_t *blob = NULL;
+    uint16_t blob_len = 0;
 
-        // Tank data characteristic - require encryption for read
-        esp_ble_gatts_add_char(param->create.service_handle,
-                               &(esp_bt_uuid_t){
-                                   .len = ESP_UUID_LEN_16,
-                                   .uuid = {.uuid16 = TANK_DATA_CHAR_UUID},
-                               },
-                               ESP_GATT_PERM_READ_ENC_MITM, // Require encrypted connection
-                               ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY,
-                               NULL, NULL);
-        break;
+    BINLOG(BINLOG_GATT_READ, conn_id, attr);
 
-    case ESP_GATTS_ADD_CHAR_EVT:
-        ESP_LOGI(TAG, "ADD_CHAR_EVT, status %d, attr_handle %d",
-                 param->add_char.status, param->add_char.attr_handle);
+    ble_conn_info_t *read_connection = find_connection(conn_id, NULL);
 
-        if (param->add_char.char_uuid.uuid.uuid16 == TANK_DATA_CHAR_UUID)
+    if (attr == TANK_ATTR_DATA)
+    {
+        // Send tank data in the format this connection selected
+        uint8_t format = read_connection ? read_connection->data_format : TANK_PAYLOAD_V1;
+        if (offset == 0 || offset == BLE_TRANSPORT_OFFSET_UNKNOWN)
         {
-            tank_handle_table[1] = param->add_char.attr_handle;
-            ESP_LOGI(TAG, "Tank data characteristic handle set to %d", tank_handle_table[1]);
-
-            // Add auth characteristic - require encryption
-            esp_ble_gatts_add_char(profile_tab[PROFILE_APP_ID].service_handle,
-                                   &(esp_bt_uuid_t){
-                                       .len = ESP_UUID_LEN_16,
-                                       .uuid = {.uuid16 = AUTH_CHAR_UUID},
-                                   },
-                                   ESP_GATT_PERM_WRITE_ENC_MITM,
-                                   ESP_GATT_CHAR_PROP_BIT_WRITE,
-                                   NULL, NULL);
+            data_len = ble_read_tank_data(format, data);
         }
-        else if (param->add_char.char_uuid.uuid.uuid16 == AUTH_CHAR_UUID)
-        {
-            tank_handle_table[2] = param->add_char.attr_handle;
+        blob = data;
+        blob_len = data_len;
+    }
+    else if (attr == TANK_ATTR_METRICS)
+    {
+        static uint8_t metrics_blob[METRICS_BLOB_LEN];
+        static uint32_t metrics_ms;
 
-            // Add config characteristic - require encryption
-            esp_ble_gatts_add_char(profile_tab[PROFILE_APP_ID].service_handle,
-                                   &(esp_bt_uuid_t){
-                                       .len = ESP_UUID_LEN_16,
-                                       .uuid = {.uuid16 = CONFIG_CHAR_UUID},
-                                   },
-                                   ESP_GATT_PERM_WRITE_ENC_MITM,
-                                   ESP_GATT_CHAR_PROP_BIT_WRITE,
-                                   NULL, NULL);
-        }
-        else if (param->add_char.char_uuid.uuid.uuid16 == CONFIG_CHAR_UUID)
+        if (ble_blob_resample(offset, &metrics_ms))
         {
-            tank_handle_table[3] = param->add_char.attr_handle;
-
-            // Add PIN change characteristic - require encryption
-            esp_ble_gatts_add_char(profile_tab[PROFILE_APP_ID].service_handle,
-                                   &(esp_bt_uuid_t){
-                                       .len = ESP_UUID_LEN_16,
-                                       .uuid = {.uuid16 = PIN_CHANGE_CHAR_UUID},
-                                   },
-                                   ESP_GATT_PERM_WRITE_ENC_MITM,
-                                   ESP_GATT_CHAR_PROP_BIT_WRITE,
-                                   NULL, NULL);
+            metrics_report_t report;
+            diagnostics_collect(&report);
+            metrics_encode(&report, metrics_blob, sizeof(metrics_blob));
         }
-        else if (param->add_char.char_uuid.uuid.uuid16 == PIN_CHANGE_CHAR_UUID)
+        blob = metrics_blob;
+        blob_len = sizeof(metrics_blob);
+    }
+    else if (attr == TANK_ATTR_ADV_STATS)
+    {
+        // Advertising diagnostics, sampled the same way as metrics
+        static uint8_t adv_blob[ADV_STATS_LEN];
+        static uint32_t adv_ms;
+
+        if (ble_blob_resample(offset, &adv_ms))
         {
-            tank_handle_table[4] = param->add_char.attr_handle;
-            ESP_LOGI(TAG, "PIN change characteristic added, handle %d", tank_handle_table[4]);
+            adv_schedule_encode(&adv_sched, (uint8_t)ble_transport_bond_count(), ble_now_ms(),
+                                adv_blob, sizeof(adv_blob));
         }
-        break;
-
-    case ESP_GATTS_CONNECT_EVT:
-        ESP_LOGI(TAG, "Client connected, conn_id %d", param->connect.conn_id);
+        blob = adv_blob;
+        blob_len = sizeof(adv_blob);
+    }
+    else if (attr == TANK_ATTR_LINKS)
+    {
+        // Per-client connection parameters, sampled the same way as metrics
+        static uint8_t links_blob[CONN_LINKS_MAX_LEN];
+        static uint16_t links_len;
+        static uint32_t links_ms;
 
-        // Start security/encryption process
-        esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_MITM);
+        if (ble_blob_resample(offset, &links_ms))
+        {
+            uint32_t now_ms = ble_now_ms();
+            portENTER_CRITICAL(&policy_lock);
+            links_len = conn_table_encode_links(&connections, now_ms, links_blob, sizeof(links_blob));
+            portEXIT_CRITICAL(&policy_lock);
+        }
+        blob = links_blob;
+        blob_len = links_len;
+    }
+    else if (attr == TANK_ATTR_SAMPLING)
+    {
+        // Monitor wakeup period, lateness and missed deadlines
+        static uint8_t sampling_blob[SAMPLE_SCHED_STATS_LEN];
+        static uint32_t sampling_ms;
 
-        // Track connection
-        if (connected_count < MAX_CONNECTIONS)
+        if (ble_blob_resample(offset, &sampling_ms))
         {
-            connections[connected_count].conn_id = param->connect.conn_id;
-            memcpy(connections[connected_count].remote_bda, param->connect.remote_bda, 6);
-            connections[connected_count].is_connected = true;
-            connections[connected_count].notifications_enabled = true; // Enable by default
-            connections[connected_count].is_encrypted = false; // Not encrypted until auth completes
-            connections[connected_count].is_authenticated = false; // Require PIN authentication per connection
-            connected_count++;
+            sample_sched_t sched;
+            tank_monitor_get_sample_stats(&sched);
+            sample_sched_encode(&sched, sampling_blob, sizeof(sampling_blob));
+        }
+        blob = sampling_blob;
+        blob_len = sizeof(sampling_blob);
+    }
+    else if (attr == TANK_ATTR_COMMAND)
+    {
+        // Outcome of this connection's last command batch, in full when the
+        // indication could not carry it all
+        static uint8_t command_blob[TANK_COMMAND_RESULT_MAX];
+        static uint16_t command_len;
 
-            // Continue advertising if we haven't reached the hardware limit
-            if (connected_count < CONFIG_BT_LE_MAX_CONNECTIONS)
-            {
-                ESP_LOGI(TAG, "Continuing to advertise, %d/%d connections", connected_count, CONFIG_BT_LE_MAX_CONNECTIONS);
-                // Restart advertising to allow more connections
-                esp_ble_gap_start_advertising(&(esp_ble_adv_params_t){
-                    .adv_int_min = 0x20,
-                    .adv_int_max = 0x40,
-                    .adv_type = ADV_TYPE_IND,
-                    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
-                    .channel_map = ADV_CHNL_ALL,
-                    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
-                });
-            }
-            else
+        if (offset == 0 || offset == BLE_TRANSPORT_OFFSET_UNKNOWN)
+        {
+            command_len = 0;
+            if (read_connection)
             {
-                ESP_LOGI(TAG, "Max connections reached (%d), stopping advertising", CONFIG_BT_LE_MAX_CONNECTIONS);
+                portENTER_CRITICAL(&command_lock);
+                command_len = read_connection->command_result_len;
+                memcpy(command_blob, read_connection->command_result, command_len);
+                portEXIT_CRITICAL(&command_lock);
             }
         }
+        blob = command_blob;
+        blob_len = command_len;
+    }
+    else
+    {
+        return BLE_TRANSPORT_ATT_INVALID_HANDLE;
+    }
 
-        // Don't set attribute value on connection - just rely on read callbacks
-        break;
+    if (offset == BLE_TRANSPORT_OFFSET_UNKNOWN)
+    {
+        // The stack slices long reads itself
+        *value = blob;
+        *len = blob_len;
+        return BLE_TRANSPORT_ATT_OK;
+    }
+    if (offset > blob_len)
+    {
+        return BLE_TRANSPORT_ATT_INVALID_OFFSET;
+    }
 
-    case ESP_GATTS_DISCONNECT_EVT:
-        ESP_LOGI(TAG, "Client disconnected, reason: 0x%x", param->disconnect.reason);
+    uint16_t chunk_max = (read_connection ? read_connection->mtu : BLE_DEFAULT_MTU) - 1;
+    uint16_t remaining = blob_len - offset;
+    *value = blob + offset;
+    *len = remaining < chunk_max ? remaining : chunk_max;
+    return BLE_TRANSPORT_ATT_OK;
+}
 
-        // Remove from connections
-        for (int i = 0; i < connected_count; i++)
+// Write handlers shared by the single-purpose characteristics and the command
+// batch. Lengths and authentication are checked by the caller.
+static uint8_t ble_select_format(ble_conn_info_t *connection, uint16_t conn_id, uint8_t format)
+{
+    if (!tank_payload_version_valid(format))
+    {
+        ESP_LOGW(TAG, "Unsupported tank data format: %d", format);
+        return BLE_TRANSPORT_ATT_OUT_OF_RANGE;
+    }
+    if (connection)
+    {
+        connection->data_format = format;
+        ESP_LOGI(TAG, "Tank data format v%d selected for conn_id %d", connection->data_format, conn_id);
+    }
+    return BLE_TRANSPORT_ATT_OK;
+}
+
+static uint8_t ble_authenticate(ble_conn_info_t *connection, uint16_t conn_id, const uint8_t *pin)
+{
+    // Log what we received for debugging
+    ESP_LOGD(TAG, "Received PIN bytes: %02x %02x %02x %02x %02x %02x",
+             pin[0], pin[1], pin[2], pin[3], pin[4], pin[5]);
+
+    // Compare against the cached PIN - no NVS access on the BT task
+    if (!tank_config_check_pin(pin, 6))
+    {
+        if (connection)
         {
-            if (connections[i].conn_id == param->disconnect.conn_id)
-            {
-                connections[i].is_connected = false;
-                // Shift remaining connections
-                for (int j = i; j < connected_count - 1; j++)
-                {
-                    connections[j] = connections[j + 1];
-                }
-                connected_count--;
-                memset(&connections[connected_count], 0, sizeof(ble_conn_info_t));
-                break;
-            }
+            connection->is_authenticated = false;
         }
+        ESP_LOGW(TAG, "Invalid PIN attempt");
+        return BLE_TRANSPORT_ATT_AUTH_FAIL;
+    }
 
-        // Restart advertising
-        esp_ble_gap_start_advertising(&(esp_ble_adv_params_t){
-            .adv_int_min = 0x20,
-            .adv_int_max = 0x40,
-            .adv_type = ADV_TYPE_IND,
-            .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
-            .channel_map = ADV_CHNL_ALL,
-            .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
-        });
-        break;
+    // Find connection and mark as authenticated
+    if (connection == NULL)
+    {
+        ESP_LOGW(TAG, "Authenticated connection %d not found in tracking table", conn_id);
+        return BLE_TRANSPORT_ATT_INVALID_HANDLE;
+    }
+    connection->is_authenticated = true;
+    ESP_LOGI(TAG, "Client %d authenticated with correct PIN", conn_id);
+    return BLE_TRANSPORT_ATT_OK;
+}
 
-    case ESP_GATTS_READ_EVT:
-        ESP_LOGI(TAG, "READ_EVT, handle %d", param->read.handle);
-
-        if (param->read.handle == tank_handle_table[1])
-        {
-            // Send tank data with all raw sensor values
-            esp_gatt_rsp_t rsp = {0};
-            uint8_t data[9] = {
-                g_tank_data.grey_1_3_raw, // Raw sensor states
-                g_tank_data.grey_2_3_raw,
-                g_tank_data.grey_full_raw,
-                g_tank_data.black_1_3_raw,
-                g_tank_data.black_2_3_raw,
-                g_tank_data.black_full_raw,
-                g_tank_data.grey_enabled, // Enable flags
-                g_tank_data.black_enabled,
-                g_tank_data.system_stable // Stability flag (0=unstable, 1=stable)
-            };
+static void ble_set_config(bool grey_enabled, bool black_enabled)
+{
+    // Update runtime config (wakes the notifier)
+    tank_monitor_set_enabled(grey_enabled, black_enabled);
 
-            rsp.attr_value.handle = param->read.handle;
-            rsp.attr_value.offset = 0;
-            rsp.attr_value.len = 9;
-            rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
-            memcpy(rsp.attr_value.value, data, 9);
+    // Cached immediately, committed to NVS by the background writer
+    tank_config_set_enabled(grey_enabled, black_enabled);
 
-            esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id,
-                                        ESP_GATT_OK, &rsp);
-        }
+    ESP_LOGI(TAG, "Config updated - Grey: %s, Black: %s",
+             grey_enabled ? "ON" : "OFF",
+             black_enabled ? "ON" : "OFF");
+}
+
+// Store timing fields (0 keeps the current value) and apply them live
+static uint8_t ble_set_timing(const tank_timing_t *update)
+{
+    tank_timing_t timing;
+
+    if (!tank_config_set_timing(update, &timing))
+    {
+        ESP_LOGW(TAG, "Invalid timing - period %lu, settle %lu-%lu, debounce %lu ms",
+                 (unsigned long)update->sample_period_ms, (unsigned long)update->settle_min_ms,
+                 (unsigned long)update->settle_max_ms, (unsigned long)update->debounce_ms);
+        return BLE_TRANSPORT_ATT_OUT_OF_RANGE;
+    }
+
+    tank_monitor_set_timing(&timing);
+    ESP_LOGI(TAG, "Timing updated - period %lu, settle %lu-%lu, debounce %lu ms",
+             (unsigned long)timing.sample_period_ms, (unsigned long)timing.settle_min_ms,
+             (unsigned long)timing.settle_max_ms, (unsigned long)timing.debounce_ms);
+    return BLE_TRANSPORT_ATT_OK;
+}
+
+static void ble_change_pin(const uint8_t *pin)
+{
+    // Cached immediately, committed to NVS by the background writer
+    tank_config_set_pin(pin);
+    ESP_LOGI(TAG, "PIN changed successfully");
+}
+
+// Run one operation of a command batch; its value has the length the type
+// calls for. A snapshot fills value with the tank data.
+static uint8_t ble_run_command(ble_conn_info_t *connection, uint16_t conn_id, const tank_command_op_t *op,
+                               uint8_t *value, uint8_t *value_len)
+{
+    switch (op->type)
+    {
+    case TANK_CMD_AUTH:
+        return ble_authenticate(connection, conn_id, op->value);
+    case TANK_CMD_SET_FORMAT:
+        return ble_select_format(connection, conn_id, op->value[0]);
+    case TANK_CMD_SNAPSHOT:
+        *value_len = (uint8_t)ble_read_tank_data(connection->data_format, value);
+        return BLE_TRANSPORT_ATT_OK;
+    default:
         break;
+    }
+
+    // The rest need the PIN, from an earlier batch or earlier in this one
+    if (!connection->is_authenticated)
+    {
+        ESP_LOGW(TAG, "Command 0x%02x denied for conn_id %d - not authenticated", op->type, conn_id);
+        return BLE_TRANSPORT_ATT_INSUF_AUTHORIZATION;
+    }
+
+    switch (op->type)
+    {
+    case TANK_CMD_SET_CONFIG:
+        ble_set_config(op->value[0], op->value[1]);
+        return BLE_TRANSPORT_ATT_OK;
+    case TANK_CMD_CHANGE_PIN:
+        ble_change_pin(op->value);
+        return BLE_TRANSPORT_ATT_OK;
+    case TANK_CMD_SET_SAMPLING:
+    {
+        // Settle window only; stored like a timing write to the config characteristic
+        tank_timing_t update = {
+            .settle_min_ms = get_u32_le(op->value),
+            .settle_max_ms = get_u32_le(op->value + 4),
+        };
+        if (update.settle_min_ms == 0 || update.settle_max_ms == 0)
+        {
+            return BLE_TRANSPORT_ATT_OUT_OF_RANGE;
+        }
+        return ble_set_timing(&update);
+    }
+    default:
+        return BLE_TRANSPORT_ATT_REQ_NOT_SUPPORTED;
+    }
+}
+
+// Run every operation of a command write in order and queue the per-operation
+// results for one indication. A malformed write, including one with more than
+// one PIN guess, runs nothing; a wrong PIN stops the rest of the batch.
+static uint8_t ble_run_command_batch(ble_conn_info_t *connection, uint16_t conn_id, const uint8_t *data, uint16_t len)
+{
+    // BT task only
+    static tank_command_op_t ops[TANK_COMMAND_MAX_OPS];
+    static uint8_t result_buf[TANK_COMMAND_RESULT_MAX];
+
+    if (connection == NULL)
+    {
+        ESP_LOGW(TAG, "Command from untracked conn_id %d", conn_id);
+        return BLE_TRANSPORT_ATT_INVALID_HANDLE;
+    }
 
-    case ESP_GATTS_WRITE_EVT:
-        ESP_LOGI(TAG, "WRITE_EVT, handle %d, value len %d",
-                 param->write.handle, param->write.len);
+    int count = tank_command_parse(data, len, ops, TANK_COMMAND_MAX_OPS);
+    if (count < 0)
+    {
+        ESP_LOGW(TAG, "Malformed command batch from conn_id %d (%d bytes)", conn_id, len);
+        return BLE_TRANSPORT_ATT_INVALID_ATTR_LEN;
+    }
 
-        ble_conn_info_t *connection = find_connection(param->write.conn_id, param->write.bda);
-        bool connection_authenticated = connection && connection->is_authenticated;
-        esp_gatt_status_t write_status = ESP_GATT_OK;
+    tank_command_result_t result;
+    tank_command_result_init(&result, result_buf, sizeof(result_buf));
+    bool auth_failed = false;
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t value[TANK_PAYLOAD_MAX_LEN];
+        uint8_t value_len = 0;
+        uint8_t status;
+        int expected_len = tank_command_value_len(ops[i].type);
 
-        if (param->write.handle == tank_handle_table[2])
+        if (auth_failed)
         {
-            // Auth characteristic - verify 6-digit PIN
-            if (param->write.len == 6)
-            {
-                // Load config to get PIN
-                tank_config_t config;
-                if (tank_config_load(&config))
-                {
-                    // Log what we received for debugging
-                    ESP_LOGI(TAG, "Received PIN bytes: %02x %02x %02x %02x %02x %02x",
-                             param->write.value[0], param->write.value[1], param->write.value[2],
-                             param->write.value[3], param->write.value[4], param->write.value[5]);
-                    ESP_LOGI(TAG, "Expected PIN: %s", config.pin);
-
-                    // Convert received bytes to string for comparison/logging
-                    char received_pin[7];
-                    memcpy(received_pin, param->write.value, 6);
-                    received_pin[6] = '\0';
-
-                    ESP_LOGI(TAG, "Authentication attempt with PIN: %s", received_pin);
-
-                    // Compare PIN strings
-                    if (memcmp(param->write.value, config.pin, 6) == 0)
-                    {
-                        // Find connection and mark as authenticated
-                        if (connection)
-                        {
-                            connection->is_authenticated = true;
-                            connection_authenticated = true;
-                            ESP_LOGI(TAG, "Client %d authenticated with correct PIN", param->write.conn_id);
-                        }
-                        else
-                        {
-                            ESP_LOGW(TAG, "Authenticated connection %d not found in tracking table", param->write.conn_id);
-                            write_status = ESP_GATT_INVALID_HANDLE;
-                        }
-                    }
-                    else
-                    {
-                        if (connection)
-                        {
-                            connection->is_authenticated = false;
-                        }
-                        ESP_LOGW(TAG, "Invalid PIN attempt");
-                        write_status = ESP_GATT_AUTH_FAIL;
-                    }
-                }
-                else
-                {
-                    ESP_LOGE(TAG, "Failed to load config for PIN verification");
-                    write_status = ESP_GATT_ERROR;
-                }
-            }
-            else
-            {
-                ESP_LOGW(TAG, "Invalid PIN length: %d (expected 6)", param->write.len);
-                write_status = ESP_GATT_INVALID_ATTR_LEN;
-            }
+            status = BLE_TRANSPORT_ATT_INSUF_AUTHORIZATION;
         }
-        else if (param->write.handle == tank_handle_table[3])
+        else if (expected_len < 0)
         {
-            if (!connection_authenticated)
-            {
-                ESP_LOGW(TAG, "Config write denied for conn_id %d - not authenticated", param->write.conn_id);
-                write_status = ESP_GATT_INSUF_AUTHORIZATION;
-                goto send_write_response;
-            }
-            // Config characteristic
-            if (param->write.len >= 2)
-            {
-                // Load existing config to preserve PIN
-                tank_config_t config;
-                if (!tank_config_load(&config))
-                {
-                    tank_config_set_defaults(&config);
-                }
-
-                // Update tank enables
-                config.grey_enabled = param->write.value[0];
-                config.black_enabled = param->write.value[1];
-
-                // Update runtime config
-                g_tank_data.grey_enabled = config.grey_enabled;
-                g_tank_data.black_enabled = config.black_enabled;
-
-                // Save to NVS
-                tank_config_save(&config);
-
-                ESP_LOGI(TAG, "Config updated - Grey: %s, Black: %s",
-                         config.grey_enabled ? "ON" : "OFF",
-                         config.black_enabled ? "ON" : "OFF");
-            }
+            status = BLE_TRANSPORT_ATT_REQ_NOT_SUPPORTED;
         }
-        else if (param->write.handle == tank_handle_table[4])
+        else if (ops[i].len != expected_len)
         {
-            if (!connection_authenticated)
-            {
-                ESP_LOGW(TAG, "PIN change denied for conn_id %d - not authenticated", param->write.conn_id);
-                write_status = ESP_GATT_INSUF_AUTHORIZATION;
-                goto send_write_response;
-            }
-            // PIN change characteristic - requires authentication
-            if (param->write.len == 6)
-            {
-                // Load current config
-                tank_config_t config;
-                if (tank_config_load(&config))
-                {
-                    // Update PIN
-                    memcpy(config.pin, param->write.value, 6);
-                    config.pin[6] = '\0'; // Null terminate
-
-                    // Save config with new PIN
-                    if (tank_config_save(&config))
-                    {
-                        ESP_LOGI(TAG, "PIN changed successfully");
-                    }
-                    else
-                    {
-                        ESP_LOGE(TAG, "Failed to save new PIN");
-                    }
-                }
-                else
-                {
-                    // No existing config, create new one
-                    tank_config_t new_config;
-                    tank_config_set_defaults(&new_config);
-                    memcpy(new_config.pin, param->write.value, 6);
-                    new_config.pin[6] = '\0';
-                    tank_config_save(&new_config);
-                    ESP_LOGI(TAG, "PIN set for first time");
-                }
-            }
-            else
-            {
-                ESP_LOGW(TAG, "Invalid new PIN length: %d (expected 6)", param->write.len);
-            }
+            status = BLE_TRANSPORT_ATT_INVALID_ATTR_LEN;
+        }
+        else
+        {
+            status = ble_run_command(connection, conn_id, &ops[i], value, &value_len);
+            auth_failed = ops[i].type == TANK_CMD_AUTH && status != BLE_TRANSPORT_ATT_OK;
         }
 
-send_write_response:
-        if (param->write.need_rsp)
+        if (!tank_command_result_add(&result, ops[i].type, status, value, value_len))
         {
-            esp_gatt_rsp_t rsp = {0};
-            rsp.attr_value.handle = param->write.handle;
-            rsp.attr_value.offset = 0;
-            rsp.attr_value.len = 0;
-            rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
-            esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id,
-                                        write_status, &rsp);
+            // Out of room for the value (too many snapshots); the status always fits
+            tank_command_result_add(&result, ops[i].type, BLE_TRANSPORT_ATT_INSUF_RESOURCES, NULL, 0);
         }
-        break;
+    }
 
-    default:
-        break;
+    portENTER_CRITICAL(&command_lock);
+    memcpy(connection->command_result, result_buf, result.len);
+    connection->command_result_len = result.len;
+    connection->command_pending = true;
+    portEXIT_CRITICAL(&command_lock);
+    ESP_LOGI(TAG, "Command batch of %d ops from conn_id %d", count, conn_id);
+
+    // Indicated from the notifier task, after the write response
+    if (notify_task)
+    {
+        xTaskNotifyGive(notify_task);
     }
+    return BLE_TRANSPORT_ATT_OK;
 }
 
-// Main GATTS event handler
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
-                                esp_ble_gatts_cb_param_t *param)
+uint8_t ble_gatt_on_write(uint16_t conn_id, const uint8_t bda[6], tank_attr_t attr, const uint8_t *data, uint16_t len)
 {
-    if (event == ESP_GATTS_REG_EVT)
+    BINLOG(BINLOG_GATT_WRITE, conn_id, attr, len);
+
+    ble_conn_info_t *connection = find_connection(conn_id, bda);
+    bool connection_authenticated = connection && connection->is_authenticated;
+    if (connection)
     {
-        if (param->reg.status == ESP_GATT_OK)
+        ble_note_link_activity(connection);
+    }
+
+    if (attr == TANK_ATTR_DATA)
+    {
+        // Tank data characteristic - 1-byte wire format selection
+        if (len != 1)
         {
-            profile_tab[param->reg.app_id].gatts_if = gatts_if;
+            ESP_LOGW(TAG, "Invalid format selection length: %d (expected 1)", len);
+            return BLE_TRANSPORT_ATT_INVALID_ATTR_LEN;
         }
-        else
+        return ble_select_format(connection, conn_id, data[0]);
+    }
+    else if (attr == TANK_ATTR_AUTH)
+    {
+        // Auth characteristic - verify 6-digit PIN
+        if (len != 6)
         {
-            ESP_LOGE(TAG, "Reg app failed, app_id %04x, status %d",
-                     param->reg.app_id, param->reg.status);
-            return;
+            ESP_LOGW(TAG, "Invalid PIN length: %d (expected 6)", len);
+            return BLE_TRANSPORT_ATT_INVALID_ATTR_LEN;
         }
+        return ble_authenticate(connection, conn_id, data);
     }
-
-    if (gatts_if == ESP_GATT_IF_NONE ||
-        gatts_if == profile_tab[PROFILE_APP_ID].gatts_if)
+    else if (attr == TANK_ATTR_CONFIG)
     {
-        if (profile_tab[PROFILE_APP_ID].gatts_cb)
+        if (!connection_authenticated)
+        {
+            ESP_LOGW(TAG, "Config write denied for conn_id %d - not authenticated", conn_id);
+            return BLE_TRANSPORT_ATT_INSUF_AUTHORIZATION;
+        }
+        // Config characteristic: enable flags, optionally followed by timing.
+        // Timing is checked first so a rejected write changes nothing.
+        if (len == CONFIG_WRITE_TIMING_LEN)
+        {
+            tank_timing_t update = {
+                .sample_period_ms = get_u32_le(data + 2),
+                .settle_min_ms = get_u32_le(data + 6),
+                .settle_max_ms = get_u32_le(data + 10),
+                .debounce_ms = get_u32_le(data + 14),
+            };
+            uint8_t status = ble_set_timing(&update);
+            if (status != BLE_TRANSPORT_ATT_OK)
+            {
+                return status;
+            }
+        }
+        else if (len != CONFIG_WRITE_LEN)
         {
-            profile_tab[PROFILE_APP_ID].gatts_cb(event, gatts_if, param);
+            ESP_LOGW(TAG, "Invalid config length: %d (expected %d or %d)", len, CONFIG_WRITE_LEN, CONFIG_WRITE_TIMING_LEN);
+            return BLE_TRANSPORT_ATT_INVALID_ATTR_LEN;
         }
+        ble_set_config(data[0], data[1]);
     }
-}
-
-// Public functions
-void ble_gatt_init(void)
-{
-    esp_err_t ret;
-
-    // Initialize BT controller
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    ret = esp_bt_controller_init(&bt_cfg);
-    if (ret)
+    else if (attr == TANK_ATTR_PIN_CHANGE)
     {
-        ESP_LOGE(TAG, "Initialize controller failed: %s", esp_err_to_name(ret));
-        return;
+        if (!connection_authenticated)
+        {
+            ESP_LOGW(TAG, "PIN change denied for conn_id %d - not authenticated", conn_id);
+            return BLE_TRANSPORT_ATT_INSUF_AUTHORIZATION;
+        }
+        // PIN change characteristic - requires authentication
+        if (len == 6)
+        {
+            ble_change_pin(data);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Invalid new PIN length: %d (expected 6)", len);
+        }
     }
-
-    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
-    if (ret)
+    else if (attr == TANK_ATTR_HISTORY)
     {
-        ESP_LOGE(TAG, "Enable controller failed: %s", esp_err_to_name(ret));
-        return;
-    }
+        if (!connection_authenticated)
+        {
+            ESP_LOGW(TAG, "History request denied for conn_id %d - not authenticated", conn_id);
+            return BLE_TRANSPORT_ATT_INSUF_AUTHORIZATION;
+        }
+        // History characteristic - start sequence number (u32 little-endian)
+        if (len != 4)
+        {
+            ESP_LOGW(TAG, "Invalid history request length: %d (expected 4)", len);
+            return BLE_TRANSPORT_ATT_INVALID_ATTR_LEN;
+        }
 
-    ret = esp_bluedroid_init();
-    if (ret)
+        connection->history_cursor = (uint32_t)data[0] |
+                                     ((uint32_t)data[1] << 8) |
+                                     ((uint32_t)data[2] << 16) |
+                                     ((uint32_t)data[3] << 24);
+        connection->history_pending = true;
+        connection->history_start_us = esp_timer_get_time();
+        connection->history_bytes = 0;
+        ESP_LOGI(TAG, "History backfill from seq %lu for conn_id %d",
+                 (unsigned long)connection->history_cursor, conn_id);
+
+        // Chunks are streamed from the notifier task, not the BT task
+        if (notify_task)
+        {
+            xTaskNotifyGive(notify_task);
+        }
+    }
+    else if (attr == TANK_ATTR_COMMAND)
     {
-        ESP_LOGE(TAG, "Init bluedroid failed: %s", esp_err_to_name(ret));
-        return;
+        return ble_run_command_batch(connection, conn_id, data, len);
     }
-
-    ret = esp_bluedroid_enable();
-    if (ret)
+    else
     {
-        ESP_LOGE(TAG, "Enable bluedroid failed: %s", esp_err_to_name(ret));
-        return;
+        return BLE_TRANSPORT_ATT_INVALID_HANDLE;
     }
 
+    return BLE_TRANSPORT_ATT_OK;
+}
+
+// Public functions
+void ble_gatt_init(void)
+{
+    heap_before_init = esp_get_free_heap_size();
+
     // Generate unique device name with random identifier BEFORE registering
     uint32_t device_id = esp_random();
     snprintf(device_name, sizeof(device_name), "RV Tanks %08lX", (unsigned long)device_id);
-    
-    // Set device name BEFORE any registration/advertising
-    esp_ble_gap_set_device_name(device_name);
-    ESP_LOGI(TAG, "Device name set to: %s", device_name);
-    
-    // Enable local privacy - use random resolvable addresses
-    esp_ble_gap_config_local_privacy(true);
-    ESP_LOGI(TAG, "Local privacy enabled - using random resolvable addresses");
-
-    // Register callbacks
-    esp_ble_gatts_register_callback(gatts_event_handler);
-    esp_ble_gap_register_callback(gap_event_handler);
-
-    // Register app
-    profile_tab[PROFILE_APP_ID].gatts_cb = gatts_profile_event_handler;
-    profile_tab[PROFILE_APP_ID].gatts_if = ESP_GATT_IF_NONE;
-    esp_ble_gatts_app_register(PROFILE_APP_ID);
-
-    // Set MTU
-    esp_ble_gatt_set_local_mtu(517);
-
-    // Configure security parameters
-    // Set authentication requirements: Secure Connections + MITM + Bonding
-    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;
-    esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(uint8_t));
-
-    // Only accept connections from devices that can authenticate and reject connections that negotiate down to "Just Works"
-    uint8_t only_accept = ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_ENABLE;
-    esp_ble_gap_set_security_param(ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH, &only_accept, sizeof(uint8_t));
-
-    // Set I/O capabilities - Display only (we show passkey via serial/docs)
-    // Phone will ask user to enter the passkey
-    esp_ble_io_cap_t iocap = ESP_IO_CAP_OUT; // Display only
-    esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
+
+    // Advertising tier timer, started with advertising
+    adv_schedule_init(&adv_sched);
+    const esp_timer_create_args_t adv_timer_args = {
+        .callback = ble_adv_timer_cb,
+        .name = "ble_adv",
+    };
+    esp_timer_create(&adv_timer_args, &adv_timer);
+
+    const esp_timer_create_args_t conn_policy_timer_args = {
+        .callback = ble_conn_policy_timer_cb,
+        .name = "ble_conn_policy",
+    };
+    esp_timer_create(&conn_policy_timer_args, &conn_policy_timer);
 
     // Generate truly random passkey using hardware RNG
     // esp_random() uses hardware RNG which is cryptographically secure
     uint32_t passkey = esp_random() % 900000 + 100000;  // Range: 100000-999999
-    
+
     // This ensures:
     // - Always 6 digits (never starts with 0)
     // - Cryptographically random
     // - Different every time ESP32 boots
     // - Cannot be predicted from MAC address
 
-    // Store passkey globally for responding to PASSKEY_REQ_EVT
-    static_passkey = passkey;
-
-    // Set the static passkey
-    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_STATIC_PASSKEY, &passkey, sizeof(uint32_t));
+    // Controller, host stack, GATT service, security parameters and passkey
+    esp_err_t ret = ble_transport_init(device_name, passkey);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "%s init failed: %s", ble_transport_name(), esp_err_to_name(ret));
+        return;
+    }
+    heap_after_init = esp_get_free_heap_size();
 
     // Log device name and passkey on every boot for documentation
     ESP_LOGI(TAG, "=========================================");
     ESP_LOGI(TAG, "DEVICE NAME: %s", device_name);
-    ESP_LOGI(TAG, "BLE PAIRING PASSKEY: %06d", passkey);
+    ESP_LOGI(TAG, "BLE PAIRING PASSKEY: %06lu", (unsigned long)passkey);
     ESP_LOGI(TAG, "Document these for pairing!");
     ESP_LOGI(TAG, "Users will see the device name in scan");
     ESP_LOGI(TAG, "Users must enter passkey on their phone");
     ESP_LOGI(TAG, "=========================================");
 
-    // Set maximum encryption key size (16 bytes = 128 bits)
-    uint8_t key_size = 16;
-    esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(uint8_t));
+    ESP_LOGI(TAG, "BLE GATT initialized on %s with encryption enabled, %lu bytes heap used",
+             ble_transport_name(), (unsigned long)(heap_before_init - heap_after_init));
+}
+
+// Send the connection's queued tank data value if the link can take it.
+// Returns true if a value is still waiting on an uncongested link.
+static bool ble_flush_connection(ble_conn_info_t *conn)
+{
+    if (!notify_queue_ready(&conn->queue))
+    {
+        return false;
+    }
+
+    TRACE_BEGIN(TRACE_SEND_INDICATE, conn->conn_id);
+    esp_err_t err = ble_transport_notify(conn->conn_id, TANK_ATTR_DATA, conn->queue.data, conn->queue.len);
+    TRACE_END(TRACE_SEND_INDICATE);
 
-    // Set initiator key distribution (what keys we'll distribute)
-    uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
-    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(uint8_t));
+    if (err != ESP_OK)
+    {
+        // Controller buffers full - keep the value and retry on the next pass
+        notify_queue_send_failed(&conn->queue);
+        metrics_inc(METRIC_NOTIFY_DROPPED);
+        return true;
+    }
 
-    // Set responder key distribution
-    uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
-    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
+    notify_queue_sent(&conn->queue, (uint32_t)esp_timer_get_time());
+    metrics_inc(METRIC_NOTIFY_SENT);
 
-    ESP_LOGI(TAG, "BLE GATT initialized with encryption enabled");
+    // A burst of state changes pulls an idle link back to the short interval
+    portENTER_CRITICAL(&policy_lock);
+    conn_policy_note_notify(&conn->policy, ble_now_ms());
+    bool idle = conn->policy.requested == CONN_PROFILE_IDLE;
+    portEXIT_CRITICAL(&policy_lock);
+    if (idle)
+    {
+        ble_apply_conn_policy(conn);
+    }
+    return false;
 }
 
-void ble_gatt_send_notification(const uint8_t *data, uint16_t len)
+void ble_gatt_send_notification(uint8_t format, const uint8_t *data, uint16_t len)
 {
-    if (gatts_if_global == ESP_GATT_IF_NONE)
+    if (!ble_transport_ready())
         return;
 
-    // Send to all connected AND encrypted clients with notifications enabled
-    for (int i = 0; i < connected_count; i++)
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+
+    // Queue for all connected AND encrypted clients with notifications enabled
+    // that selected this wire format. Each connection is flushed on its own,
+    // so a congested client only holds back its own latest value.
+    ble_conn_info_t *conn;
+    CONN_TABLE_FOREACH(&connections, conn)
     {
-        if (connections[i].is_connected && connections[i].notifications_enabled && connections[i].is_encrypted)
+        if (conn->data_format != format)
+        {
+            continue;
+        }
+
+        if (conn->is_connected && conn->notifications_enabled && conn->is_encrypted)
+        {
+            if (conn->queue.pending)
+            {
+                metrics_inc(METRIC_NOTIFY_COALESCED);
+            }
+            notify_queue_put(&conn->queue, data, len, now_us);
+            ble_flush_connection(conn);
+        }
+        else if (conn->is_connected && !conn->is_encrypted)
         {
-            esp_ble_gatts_send_indicate(gatts_if_global, connections[i].conn_id,
-                                        tank_handle_table[1], len, (uint8_t *)data, false);
+            ESP_LOGD(TAG, "Skipping notification for conn_id %d - not encrypted yet", conn->conn_id);
         }
-        else if (connections[i].is_connected && !connections[i].is_encrypted)
+    }
+}
+
+// Retry values held back by a full controller or a congested link.
+// Returns true while a value is waiting on an uncongested link.
+bool ble_gatt_flush_notifications(void)
+{
+    bool pending = false;
+
+    if (!ble_transport_ready())
+        return false;
+
+    ble_conn_info_t *conn;
+    CONN_TABLE_FOREACH(&connections, conn)
+    {
+        if (ble_flush_connection(conn))
         {
-            ESP_LOGD(TAG, "Skipping notification for conn_id %d - not encrypted yet", connections[i].conn_id);
+            pending = true;
         }
     }
+
+    return pending;
 }
 
-void ble_update_tank_data(uint8_t grey_level, uint8_t black_level,
-                          bool grey_enabled, bool black_enabled)
+static bool ble_push_tank_data(bool force)
 {
-    // Only update if handle is valid and service is started
-    if (tank_handle_table[1] == 0)
+    // State bytes of the last v2 payload pushed to clients (version, sensor
+    // bits, flags), used to suppress redundant notifications. Unlike v1 they
+    // include the per-tank stable flags.
+    static uint8_t last_sent[3];
+    static bool have_last_sent = false;
+
+    // Only update once the service is registered
+    if (!ble_transport_ready())
     {
         // Service not ready yet
-        return;
+        return false;
     }
 
     // Send all raw sensor values plus enable flags and stability
-    uint8_t data[9] = {
-        g_tank_data.grey_1_3_raw,
-        g_tank_data.grey_2_3_raw,
-        g_tank_data.grey_full_raw,
-        g_tank_data.black_1_3_raw,
-        g_tank_data.black_2_3_raw,
-        g_tank_data.black_full_raw,
-        grey_enabled,
-        black_enabled,
-        g_tank_data.system_stable};
+    tank_snapshot_t snapshot;
+    uint8_t data_v1[TANK_PAYLOAD_V1_LEN];
+    uint8_t data_v2[TANK_PAYLOAD_V2_LEN];
+
+    tank_monitor_get_snapshot(&snapshot);
+    ble_encode_tank_data(&snapshot, TANK_PAYLOAD_V1, data_v1);
+    ble_encode_tank_data(&snapshot, TANK_PAYLOAD_V2, data_v2);
+
+    portENTER_CRITICAL(&read_cache_lock);
+    memcpy(read_cache_v1, data_v1, sizeof(data_v1));
+    memcpy(read_cache_v2, data_v2, sizeof(data_v2));
+    read_cache_ms = esp_timer_get_time() / 1000;
+    read_cache_valid = true;
+    portEXIT_CRITICAL(&read_cache_lock);
+
+#if BLE_BROADCAST_ENABLE
+    // Rewrite the advertised state once the initial setup chain has run
+    if (adv_setup_done && ble_encode_adv_data(&snapshot))
+    {
+        ble_config_adv_data();
+    }
+#endif
+
+    if (!force && have_last_sent && memcmp(data_v2, last_sent, sizeof(last_sent)) == 0)
+    {
+        return false;
+    }
 
     // Send notification only if connected
-    if (ble_is_connected())
+    if (!ble_is_connected())
     {
-        ble_gatt_send_notification(data, sizeof(data));
+        return false;
     }
+
+    ble_gatt_send_notification(TANK_PAYLOAD_V1, data_v1, sizeof(data_v1));
+    ble_gatt_send_notification(TANK_PAYLOAD_V2, data_v2, sizeof(data_v2));
+    memcpy(last_sent, data_v2, sizeof(last_sent));
+    have_last_sent = true;
+    return true;
+}
+
+bool ble_update_tank_data(bool force)
+{
+    TRACE_BEGIN(TRACE_BLE_UPDATE, force);
+    bool sent = ble_push_tank_data(force);
+    TRACE_END(TRACE_BLE_UPDATE);
+    return sent;
 }
 
 bool ble_is_connected(void)
 {
-    return connected_count > 0;
+    return connections.count > 0;
+}
+
+void ble_gatt_set_notify_task(TaskHandle_t task)
+{
+    notify_task = task;
+}
+
+// Move to the next advertising tier once the current window has ended.
+// Stopping is enough: ble_gatt_on_adv_stopped() starts the next tier. A
+// connection that arrived since the timer fired has already rescheduled
+// advertising, so only act while the window is still over.
+void ble_gatt_update_advertising(void)
+{
+    if (!atomic_exchange(&adv_window_ended, false))
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&adv_lock);
+    bool stop = !adv_restart_pending && adv_schedule_ms_to_next(&adv_sched, ble_now_ms()) == 0;
+    if (stop)
+    {
+        adv_restart_pending = true;
+    }
+    portEXIT_CRITICAL(&adv_lock);
+
+    if (stop)
+    {
+        ble_transport_adv_stop();
+    }
+}
+
+// Re-evaluate every link's parameters after activity or when the policy
+// timer fires, and re-arm the timer for the next link to go quiet
+void ble_gatt_update_link_policy(void)
+{
+    if (!atomic_exchange(&policy_check, false))
+    {
+        return;
+    }
+
+    ble_conn_info_t *conn;
+    CONN_TABLE_FOREACH(&connections, conn)
+    {
+        ble_apply_conn_policy(conn);
+    }
+    ble_arm_conn_policy_timer(ble_now_ms());
+}
+
+// Indicate each connection's latest command result, as much as fits in its
+// MTU; a client that gets a short result reads the characteristic for the
+// rest. Returns true while a result is still waiting for the stack.
+bool ble_gatt_send_command_results(void)
+{
+    uint8_t result[TANK_COMMAND_RESULT_MAX];
+    bool pending = false;
+
+    if (!ble_transport_ready())
+        return false;
+
+    ble_conn_info_t *conn;
+    CONN_TABLE_FOREACH(&connections, conn)
+    {
+        if (!conn->is_connected || !conn->command_pending || conn->queue.congested)
+        {
+            continue;
+        }
+
+        portENTER_CRITICAL(&command_lock);
+        uint16_t len = conn->command_result_len;
+        memcpy(result, conn->command_result, len);
+        conn->command_pending = false;
+        portEXIT_CRITICAL(&command_lock);
+
+        if (len > conn->mtu - 3)
+        {
+            len = conn->mtu - 3;
+        }
+
+        TRACE_BEGIN(TRACE_SEND_INDICATE, conn->conn_id);
+        esp_err_t err = ble_transport_notify(conn->conn_id, TANK_ATTR_COMMAND, result, len);
+        TRACE_END(TRACE_SEND_INDICATE);
+        if (err != ESP_OK)
+        {
+            // Previous indication unconfirmed or buffers full - retry on the
+            // next pass, with the newer result if another batch came in
+            metrics_inc(METRIC_NOTIFY_DROPPED);
+            portENTER_CRITICAL(&command_lock);
+            conn->command_pending = true;
+            portEXIT_CRITICAL(&command_lock);
+            pending = true;
+            continue;
+        }
+        metrics_inc(METRIC_NOTIFY_SENT);
+    }
+
+    return pending;
+}
+
+// Log how fast a finished backfill went out: with full-MTU chunks sent back
+// to back it is the stack's notification throughput on this link
+static void ble_log_history_done(const ble_conn_info_t *conn)
+{
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - conn->history_start_us) / 1000);
+
+    ESP_LOGI(TAG, "History backfill complete for conn_id %d: %lu bytes in %lu ms (%lu B/s, MTU %d)",
+             conn->conn_id, (unsigned long)conn->history_bytes, (unsigned long)elapsed_ms,
+             (unsigned long)(elapsed_ms ? (uint64_t)conn->history_bytes * 1000 / elapsed_ms : 0),
+             conn->mtu);
+}
+
+// Send one history chunk to every connection with a backfill in progress.
+// Each chunk fills the connection's MTU; a chunk with no records marks the end.
+// Returns true while any backfill still has chunks to send.
+bool ble_gatt_pump_history(void)
+{
+    static uint8_t chunk[BLE_HISTORY_CHUNK_MAX];
+    bool pending = false;
+
+    if (!ble_transport_ready())
+        return false;
+
+    ble_conn_info_t *conn;
+    CONN_TABLE_FOREACH(&connections, conn)
+    {
+        if (!conn->is_connected || !conn->history_pending || !conn->is_encrypted)
+        {
+            continue;
+        }
+
+        // Tank data goes first, and a congested link gets nothing until it drains
+        if (conn->queue.congested)
+        {
+            continue;
+        }
+        if (conn->queue.pending)
+        {
+            pending = true;
+            continue;
+        }
+
+        uint16_t payload_max = conn->mtu - 3;
+        if (payload_max > sizeof(chunk))
+        {
+            payload_max = sizeof(chunk);
+        }
+
+        uint32_t next_seq;
+        size_t len = tank_monitor_history_chunk(conn->history_cursor, chunk, payload_max, &next_seq);
+        if (len == 0)
+        {
+            conn->history_pending = false;
+            continue;
+        }
+
+        TRACE_BEGIN(TRACE_SEND_INDICATE, conn->conn_id);
+        esp_err_t err = ble_transport_notify(conn->conn_id, TANK_ATTR_HISTORY, chunk, len);
+        TRACE_END(TRACE_SEND_INDICATE);
+        if (err != ESP_OK)
+        {
+            // Controller buffers full - retry the same chunk on the next pass
+            metrics_inc(METRIC_NOTIFY_DROPPED);
+            pending = true;
+            continue;
+        }
+
+        metrics_inc(METRIC_NOTIFY_SENT);
+        conn->history_cursor = next_seq;
+        conn->history_bytes += len;
+        if (chunk[TANK_HISTORY_CHUNK_COUNT_OFFSET] == 0)
+        {
+            conn->history_pending = false;
+            ble_log_history_done(conn);
+        }
+        else
+        {
+            pending = true;
+        }
+    }
+
+    return pending;
+}
+
+static void ble_log_connection(const ble_conn_info_t *conn)
+{
+    const notify_queue_t *queue = &conn->queue;
+    ESP_LOGI(TAG, "conn_id %d: sent %lu, coalesced %lu, send errors %lu, latency avg %lu us max %lu us%s",
+             conn->conn_id, (unsigned long)queue->sent, (unsigned long)queue->coalesced,
+             (unsigned long)queue->send_errors, (unsigned long)notify_queue_latency_avg_us(queue),
+             (unsigned long)queue->latency_max_us, queue->congested ? ", congested" : "");
+
+    const conn_policy_t *policy = &conn->policy;
+    ESP_LOGI(TAG, "conn_id %d: %s, interval %u.%02u ms, latency %u, timeout %u ms, updates %u, refused %u, quiet %lu ms",
+             conn->conn_id, conn_policy_profile_name(policy->requested),
+             policy->interval * 125 / 100, policy->interval * 125 % 100, policy->latency,
+             policy->timeout * 10, policy->updates, policy->rejects,
+             (unsigned long)(ble_now_ms() - policy->last_activity_ms));
+}
+
+void ble_gatt_log_connections(void)
+{
+    ble_conn_info_t *conn;
+
+    ESP_LOGI(TAG, "%d connection(s)", connections.count);
+    CONN_TABLE_FOREACH(&connections, conn)
+    {
+        ble_log_connection(conn);
+    }
+}
+
+void ble_gatt_log_advertising(void)
+{
+    uint32_t now_ms = ble_now_ms();
+
+    ESP_LOGI(TAG, "Advertising %s, %s tier for %lu ms, %d bonded peer(s)",
+             adv_sched.active ? "on" : "off", adv_schedule_tier_name(adv_sched.tier),
+             (unsigned long)(adv_sched.active ? now_ms - adv_sched.tier_start_ms : 0),
+             ble_transport_bond_count());
+    for (int i = 0; i < ADV_TIER_COUNT; i++)
+    {
+        const adv_tier_stats_t *tier = &adv_sched.tiers[i];
+        uint64_t advertised = tier->advertised_ms;
+        if (adv_sched.active && adv_sched.tier == (adv_tier_t)i)
+        {
+            advertised += now_ms - adv_sched.active_since_ms;
+        }
+        ESP_LOGI(TAG, "  %-8s starts %lu, connects %lu, advertised %llu s",
+                 adv_schedule_tier_name((adv_tier_t)i), (unsigned long)tier->starts,
+                 (unsigned long)tier->connects, (unsigned long long)(advertised / 1000));
+    }
+    ESP_LOGI(TAG, "Reconnects %lu, latency last %lu ms, min %lu ms, max %lu ms, mean %lu ms",
+             (unsigned long)adv_sched.reconnects, (unsigned long)adv_sched.reconnect_last_ms,
+             (unsigned long)adv_sched.reconnect_min_ms, (unsigned long)adv_sched.reconnect_max_ms,
+             (unsigned long)adv_schedule_reconnect_avg_ms(&adv_sched));
+}
+
+void ble_gatt_log_stack(void)
+{
+    ESP_LOGI(TAG, "Host stack %s", ble_transport_name());
+    ESP_LOGI(TAG, "Heap free %lu before init, %lu after init, %lu at first advertisement, %lu now (min %lu)",
+             (unsigned long)heap_before_init, (unsigned long)heap_after_init,
+             (unsigned long)heap_at_first_adv, (unsigned long)esp_get_free_heap_size(),
+             (unsigned long)esp_get_minimum_free_heap_size());
+    ESP_LOGI(TAG, "First advertisement %lu ms after boot", (unsigned long)first_adv_ms);
 }
@@ -3,15 +3,28 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "esp_gatts_api.h"
-#include "esp_gap_ble_api.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "conn_table.h"
 
 // BLE Settings
-#define PROFILE_NUM     1
-#define PROFILE_APP_ID  0
-#define SVC_INST_ID     0
-#define CHAR_DECLARATION_SIZE   (sizeof(uint8_t))
-#define MAX_CONNECTIONS 7
+// MAX_CONNECTIONS and BLE_DEFAULT_MTU are in conn_table.h
+#define BLE_HISTORY_CHUNK_MAX 512   // Largest history notification (MTU 517 minus ATT header)
+#define BLE_BLOB_RESAMPLE_MS  1000  // Diagnostics sample reuse when the stack hides the read offset
+
+// Notifications are sent on state change; an unchanged payload is re-sent
+// at this interval so clients can tell the link is still alive
+#define BLE_HEARTBEAT_INTERVAL_MS 30000
+
+// Broadcast mode: carry sensor bits, stability flags and a rolling counter in
+// the advertising manufacturer data (see tank_payload.h), rewritten on every
+// state change so passive scanners get levels without connecting
+#define BLE_BROADCAST_ENABLE 1
+
+// After a bonded phone loses the link, advertise directed at it for up to
+// 1.28 s before the fast/slow schedule (see adv_schedule.h)
+#define BLE_ADV_DIRECTED_ENABLE 1
 
 // Service UUIDs
 #define TANK_SERVICE_UUID   0x00FF
@@ -19,30 +32,42 @@
 #define AUTH_CHAR_UUID      0xFF02
 #define CONFIG_CHAR_UUID    0xFF03
 #define PIN_CHANGE_CHAR_UUID 0xFF04
+#define HISTORY_CHAR_UUID   0xFF05
+#define METRICS_CHAR_UUID   0xFF06
+#define ADV_STATS_CHAR_UUID 0xFF07
+#define LINKS_CHAR_UUID     0xFF08
+#define COMMAND_CHAR_UUID   0xFF09
+#define SAMPLING_CHAR_UUID  0xFF0A
+
+// Config write lengths: enable flags, optionally followed by the sample
+// period, settle minimum, settle maximum and debounce in ms (u32 LE each)
+#define CONFIG_WRITE_LEN        2
+#define CONFIG_WRITE_TIMING_LEN 18
 
-// Handle table indices
-enum {
-    IDX_SVC,
-    IDX_CHAR_DATA,
-    IDX_CHAR_VAL_DATA,
-    IDX_CHAR_CFG_DATA,
-    HRS_IDX_NB,
-};
-
-// Connection info
-typedef struct {
-    uint16_t conn_id;
-    esp_bd_addr_t remote_bda;
-    bool is_connected;
-    bool notifications_enabled;
-    bool is_encrypted;  // Track if connection is encrypted/authenticated
-    bool is_authenticated; // Application-level PIN authentication state
-} ble_conn_info_t;
+// Controller and host must accept as many links as the table holds
+#if defined(CONFIG_BTDM_CTRL_BLE_MAX_CONN_EFF) && CONFIG_BTDM_CTRL_BLE_MAX_CONN_EFF < MAX_CONNECTIONS
+#error "CONFIG_BTDM_CTRL_BLE_MAX_CONN is below MAX_CONNECTIONS - see sdkconfig.defaults"
+#endif
+#if defined(CONFIG_BT_ACL_CONNECTIONS) && CONFIG_BT_ACL_CONNECTIONS < MAX_CONNECTIONS
+#error "CONFIG_BT_ACL_CONNECTIONS is below MAX_CONNECTIONS - see sdkconfig.defaults"
+#endif
+#if defined(CONFIG_BT_NIMBLE_MAX_CONNECTIONS) && CONFIG_BT_NIMBLE_MAX_CONNECTIONS < MAX_CONNECTIONS
+#error "CONFIG_BT_NIMBLE_MAX_CONNECTIONS is below MAX_CONNECTIONS - see sdkconfig.nimble"
+#endif
 
 // Function prototypes
 void ble_gatt_init(void);
-void ble_gatt_send_notification(const uint8_t *data, uint16_t len);
-void ble_update_tank_data(uint8_t grey_level, uint8_t black_level, bool grey_enabled, bool black_enabled);
+void ble_gatt_send_notification(uint8_t format, const uint8_t *data, uint16_t len);
+bool ble_update_tank_data(bool force);
 bool ble_is_connected(void);
+void ble_gatt_set_notify_task(TaskHandle_t task);
+bool ble_gatt_flush_notifications(void);
+bool ble_gatt_send_command_results(void);
+bool ble_gatt_pump_history(void);
+void ble_gatt_update_advertising(void);
+void ble_gatt_update_link_policy(void);
+void ble_gatt_log_connections(void);
+void ble_gatt_log_advertising(void);
+void ble_gatt_log_stack(void);
 
 #endif // BLE_GATT_H
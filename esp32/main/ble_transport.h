@@ -0,0 +1,106 @@
+#ifndef BLE_TRANSPORT_H
+#define BLE_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "adv_schedule.h"
+#include "conn_policy.h"
+
+// Boundary between the tank service (ble_gatt.c: connections, PIN auth,
+// config, history, advertising and link policy) and the Bluetooth host
+// stack. One backend is built, picked by the host enabled in sdkconfig:
+// ble_transport_bluedroid.c or ble_transport_nimble.c (see main/CMakeLists.txt).
+//
+// Addresses are 6 bytes, most significant first (as printed). Backends
+// report events through the ble_gatt_on_* callbacks below; Bluedroid calls
+// them from its BTC task, NimBLE from its host task.
+
+// Service characteristics, in declaration order
+typedef enum {
+    TANK_ATTR_DATA = 0,
+    TANK_ATTR_AUTH,
+    TANK_ATTR_CONFIG,
+    TANK_ATTR_PIN_CHANGE,
+    TANK_ATTR_HISTORY,
+    TANK_ATTR_METRICS,
+    TANK_ATTR_ADV_STATS,
+    TANK_ATTR_LINKS,
+    TANK_ATTR_COMMAND,
+    TANK_ATTR_SAMPLING,
+    TANK_ATTR_COUNT
+} tank_attr_t;
+
+// Characteristic properties. Every access needs an encrypted, MITM-protected link.
+#define TANK_ATTR_READ      0x01
+#define TANK_ATTR_WRITE     0x02
+#define TANK_ATTR_NOTIFY    0x04
+#define TANK_ATTR_INDICATE  0x08    // ble_transport_notify sends an indication and gets a CCCD
+
+typedef struct {
+    uint16_t uuid;
+    uint8_t flags;
+} tank_attr_def_t;
+
+// ATT status codes returned by the read and write callbacks
+#define BLE_TRANSPORT_ATT_OK                    0x00
+#define BLE_TRANSPORT_ATT_INVALID_HANDLE        0x01
+#define BLE_TRANSPORT_ATT_REQ_NOT_SUPPORTED     0x06
+#define BLE_TRANSPORT_ATT_INVALID_OFFSET        0x07
+#define BLE_TRANSPORT_ATT_INSUF_AUTHORIZATION   0x08
+#define BLE_TRANSPORT_ATT_INVALID_ATTR_LEN      0x0D
+#define BLE_TRANSPORT_ATT_INSUF_RESOURCES       0x11
+#define BLE_TRANSPORT_ATT_AUTH_FAIL             0x89    // Application error (wrong PIN)
+#define BLE_TRANSPORT_ATT_OUT_OF_RANGE          0xFF
+
+// HCI disconnect reasons the service tells apart
+#define BLE_TRANSPORT_REASON_PEER_USER          0x13
+#define BLE_TRANSPORT_REASON_LOCAL_HOST         0x16
+
+// Encryption reported by address only (Bluedroid's auth complete event)
+#define BLE_TRANSPORT_CONN_UNKNOWN              0xFFFF
+
+// Read offset the stack does not expose (NimBLE serves long reads itself)
+#define BLE_TRANSPORT_OFFSET_UNKNOWN            0xFFFF
+
+// Largest write a backend hands to the service
+#define BLE_TRANSPORT_WRITE_MAX                 512
+
+// Connection parameters in controller units (1.25 ms, events, 10 ms)
+typedef struct {
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+} ble_link_params_t;
+
+extern const tank_attr_def_t tank_attr_defs[TANK_ATTR_COUNT];
+
+// Function prototypes - backend
+const char *ble_transport_name(void);
+esp_err_t ble_transport_init(const char *device_name, uint32_t passkey);
+bool ble_transport_ready(void);
+esp_err_t ble_transport_notify(uint16_t conn_id, tank_attr_t attr, const uint8_t *data, uint16_t len);
+void ble_transport_secure(uint16_t conn_id, const uint8_t bda[6]);
+void ble_transport_disconnect(uint16_t conn_id, const uint8_t bda[6]);
+void ble_transport_update_link(uint16_t conn_id, const uint8_t bda[6], const conn_profile_params_t *params);
+void ble_transport_set_adv_data(const uint8_t *manufacturer, uint8_t len);
+void ble_transport_adv_start(const adv_tier_params_t *tier, const uint8_t *peer, uint8_t peer_addr_type);
+void ble_transport_adv_stop(void);
+bool ble_transport_find_bonded(const uint8_t bda[6], uint8_t *addr_type);
+int ble_transport_bond_count(void);
+
+// Function prototypes - service callbacks (ble_gatt.c)
+void ble_gatt_on_ready(void);
+void ble_gatt_on_adv_ready(void);
+void ble_gatt_on_adv_started(bool success);
+void ble_gatt_on_adv_stopped(void);
+void ble_gatt_on_connect(uint16_t conn_id, const uint8_t bda[6], const ble_link_params_t *params);
+void ble_gatt_on_disconnect(uint16_t conn_id, const uint8_t bda[6], uint8_t reason);
+void ble_gatt_on_encryption(uint16_t conn_id, const uint8_t bda[6], bool success);
+void ble_gatt_on_mtu(uint16_t conn_id, uint16_t mtu);
+void ble_gatt_on_congest(uint16_t conn_id, bool congested);
+void ble_gatt_on_link_update(uint16_t conn_id, const uint8_t bda[6], bool success, const ble_link_params_t *params);
+uint8_t ble_gatt_on_read(uint16_t conn_id, tank_attr_t attr, uint16_t offset, const uint8_t **value, uint16_t *len);
+uint8_t ble_gatt_on_write(uint16_t conn_id, const uint8_t bda[6], tank_attr_t attr, const uint8_t *data, uint16_t len);
+
+#endif // BLE_TRANSPORT_H
@@ -0,0 +1,756 @@
+#include "sdkconfig.h"
+
+// Fallback definitions for VS Code IntelliSense
+// These are only used if not already defined in sdkconfig.h
+#ifndef CONFIG_BT_LE_LL_RESOLV_LIST_SIZE
+#define CONFIG_BT_LE_LL_RESOLV_LIST_SIZE 4
+#endif
+
+#ifndef CONFIG_BT_LE_LL_DUP_SCAN_LIST_COUNT
+#define CONFIG_BT_LE_LL_DUP_SCAN_LIST_COUNT 16
+#endif
+
+#ifndef CONFIG_BT_LE_LL_SCAN_DUPL_CACHE_SIZE
+#define CONFIG_BT_LE_LL_SCAN_DUPL_CACHE_SIZE 100
+#endif
+
+#ifndef CONFIG_BT_LE_LL_SCAN_DUPL_CACHE_REFRESH_PERIOD
+#define CONFIG_BT_LE_LL_SCAN_DUPL_CACHE_REFRESH_PERIOD 0
+#endif
+
+#ifndef CONFIG_BT_LE_DFT_TX_POWER_LEVEL_DBM_EFF
+#define CONFIG_BT_LE_DFT_TX_POWER_LEVEL_DBM_EFF 9
+#endif
+
+#ifndef CONFIG_BT_LE_CTRL_DFT_TX_POWER_LEVEL_EFF
+#define CONFIG_BT_LE_CTRL_DFT_TX_POWER_LEVEL_EFF 9
+#endif
+
+#ifndef CONFIG_BT_LE_ENHANCED_CONN_UPDATE
+#define CONFIG_BT_LE_ENHANCED_CONN_UPDATE 1
+#endif
+
+#ifndef CONFIG_BT_LE_CONTROLLER_TASK_STACK_SIZE
+#define CONFIG_BT_LE_CONTROLLER_TASK_STACK_SIZE 4096
+#endif
+
+#ifndef CONFIG_BT_LE_CONTROLLER_TASK_PRIORITY
+#define CONFIG_BT_LE_CONTROLLER_TASK_PRIORITY 25
+#endif
+
+#ifndef CONFIG_BT_LE_MAX_PERIODIC_ADVERTISER_LIST
+#define CONFIG_BT_LE_MAX_PERIODIC_ADVERTISER_LIST 5
+#endif
+
+#ifndef CONFIG_BT_LE_MAX_PERIODIC_SYNCS
+#define CONFIG_BT_LE_MAX_PERIODIC_SYNCS 1
+#endif
+
+#ifndef CONFIG_BT_LE_MAX_EXT_ADV_INSTANCES
+#define CONFIG_BT_LE_MAX_EXT_ADV_INSTANCES 1
+#endif
+
+#ifndef CONFIG_BT_LE_EXT_ADV_MAX_SIZE
+#define CONFIG_BT_LE_EXT_ADV_MAX_SIZE 31
+#endif
+
+#ifndef CONFIG_BT_LE_SCAN_RSP_DATA_MAX_LEN
+#define CONFIG_BT_LE_SCAN_RSP_DATA_MAX_LEN 31
+#endif
+
+#ifndef CONFIG_BT_SMP_MAX_BONDS
+#define CONFIG_BT_SMP_MAX_BONDS 15
+#endif
+
+#ifndef CONFIG_BT_LE_SLEEP_ENABLE
+#define CONFIG_BT_LE_SLEEP_ENABLE 0
+#endif
+
+#ifndef CONFIG_BT_LE_USE_WIFI_PWR_CLK_WORKAROUND
+#define CONFIG_BT_LE_USE_WIFI_PWR_CLK_WORKAROUND 0
+#endif
+
+#ifndef CONFIG_BT_LE_LL_SCA
+#define CONFIG_BT_LE_LL_SCA 500
+#endif
+
+#ifndef CONFIG_BT_LE_LP_CLK_ACCURACY_PPM
+#define CONFIG_BT_LE_LP_CLK_ACCURACY_PPM 500
+#endif
+
+#ifndef CONFIG_BT_LE_COEX_PHY_CODED_TX_RX_TLIM
+#define CONFIG_BT_LE_COEX_PHY_CODED_TX_RX_TLIM 0
+#endif
+
+#ifndef CONFIG_BT_LE_COEX_PHY_CODED_TX_RX_TLIM_EFF
+#define CONFIG_BT_LE_COEX_PHY_CODED_TX_RX_TLIM_EFF 0
+#endif
+
+#ifndef CONFIG_BT_CTRL_COEX_PHY_CODED_TX_RX_TLIM_EFF
+#define CONFIG_BT_CTRL_COEX_PHY_CODED_TX_RX_TLIM_EFF 0
+#endif
+
+#ifndef CONFIG_BT_CTRL_SLEEP_MODE_EFF
+#define CONFIG_BT_CTRL_SLEEP_MODE_EFF 0
+#endif
+
+#ifndef CONFIG_BT_CTRL_SLEEP_CLOCK_EFF
+#define CONFIG_BT_CTRL_SLEEP_CLOCK_EFF 0
+#endif
+
+#ifndef CONFIG_BT_CTRL_HCI_TL_EFF
+#define CONFIG_BT_CTRL_HCI_TL_EFF 1
+#endif
+
+#ifndef CONFIG_BT_CTRL_AGC_RECORRECT_EN
+#define CONFIG_BT_CTRL_AGC_RECORRECT_EN 0
+#endif
+
+#ifndef CONFIG_BT_CTRL_CODED_AGC_RECORRECT_EN
+#define CONFIG_BT_CTRL_CODED_AGC_RECORRECT_EN 0
+#endif
+
+#ifndef CONFIG_BT_CTRL_SCAN_BACKOFF_UPPERLIMITMAX
+#define CONFIG_BT_CTRL_SCAN_BACKOFF_UPPERLIMITMAX 0
+#endif
+
+#include "ble_transport.h"
+#include "ble_gatt.h"
+#include "trace.h"
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "esp_gatt_common_api.h"
+#include <string.h>
+
+// Bluedroid backend for ble_transport.h
+
+static const char *TAG = "BLE_BLUEDROID";
+
+// BLE Settings
+#define PROFILE_NUM     1
+#define PROFILE_APP_ID  0
+
+// Attribute handles reserved for the service: declaration, two per
+// characteristic and a CCCD for the indicating command characteristic
+#define TANK_SERVICE_NUM_HANDLES 22
+
+// Static passkey stored for responding to passkey requests
+static uint32_t static_passkey = 0;
+
+// GATT profile
+typedef struct
+{
+    esp_gatts_cb_t gatts_cb;
+    uint16_t gatts_if;
+    uint16_t app_id;
+    uint16_t conn_id;
+    uint16_t service_handle;
+    esp_gatt_srvc_id_t service_id;
+    uint16_t char_handle;
+    esp_bt_uuid_t char_uuid;
+    esp_gatt_perm_t perm;
+    esp_gatt_char_prop_t property;
+    uint16_t descr_handle;
+    esp_bt_uuid_t descr_uuid;
+} gatts_profile_inst_t;
+
+// Profile instance
+static gatts_profile_inst_t profile_tab[PROFILE_NUM];
+static uint16_t attr_handles[TANK_ATTR_COUNT];
+static esp_gatt_if_t gatts_if_global = ESP_GATT_IF_NONE;
+static bool service_ready = false;
+
+// Scan response configured; later adv data sets come from broadcast updates
+static bool scan_rsp_done = false;
+
+// Add one characteristic of the service. Bluedroid adds them one at a time:
+// each ESP_GATTS_ADD_CHAR_EVT adds the next.
+static void bluedroid_add_char(uint16_t service_handle, tank_attr_t attr)
+{
+    const tank_attr_def_t *def = &tank_attr_defs[attr];
+    esp_gatt_perm_t perm = 0;
+    esp_gatt_char_prop_t property = 0;
+
+    // Require an encrypted, MITM-protected connection
+    if (def->flags & TANK_ATTR_READ)
+    {
+        perm |= ESP_GATT_PERM_READ_ENC_MITM;
+        property |= ESP_GATT_CHAR_PROP_BIT_READ;
+    }
+    if (def->flags & TANK_ATTR_WRITE)
+    {
+        perm |= ESP_GATT_PERM_WRITE_ENC_MITM;
+        property |= ESP_GATT_CHAR_PROP_BIT_WRITE;
+    }
+    if (def->flags & TANK_ATTR_NOTIFY)
+    {
+        property |= ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+    }
+    if (def->flags & TANK_ATTR_INDICATE)
+    {
+        property |= ESP_GATT_CHAR_PROP_BIT_INDICATE;
+    }
+
+    esp_ble_gatts_add_char(service_handle,
+                           &(esp_bt_uuid_t){
+                               .len = ESP_UUID_LEN_16,
+                               .uuid = {.uuid16 = def->uuid},
+                           },
+                           perm, property, NULL, NULL);
+}
+
+// Characteristic attr is in place: give it a CCCD if it indicates (the
+// stack answers reads and writes of it), otherwise move on to the next one
+static void bluedroid_char_added(uint16_t service_handle, tank_attr_t attr, bool descr_added)
+{
+    if (!descr_added && (tank_attr_defs[attr].flags & TANK_ATTR_INDICATE))
+    {
+        static uint8_t cccd_value[2];
+        esp_ble_gatts_add_char_descr(service_handle,
+                                     &(esp_bt_uuid_t){
+                                         .len = ESP_UUID_LEN_16,
+                                         .uuid = {.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG},
+                                     },
+                                     ESP_GATT_PERM_READ_ENC_MITM | ESP_GATT_PERM_WRITE_ENC_MITM,
+                                     &(esp_attr_value_t){
+                                         .attr_max_len = sizeof(cccd_value),
+                                         .attr_len = sizeof(cccd_value),
+                                         .attr_value = cccd_value,
+                                     },
+                                     &(esp_attr_control_t){.auto_rsp = ESP_GATT_AUTO_RSP});
+        return;
+    }
+
+    if (attr + 1 < TANK_ATTR_COUNT)
+    {
+        bluedroid_add_char(service_handle, (tank_attr_t)(attr + 1));
+    }
+    else
+    {
+        service_ready = true;
+    }
+}
+
+static tank_attr_t bluedroid_attr_for_handle(uint16_t handle)
+{
+    for (int i = 0; i < TANK_ATTR_COUNT; i++)
+    {
+        if (attr_handles[i] != 0 && attr_handles[i] == handle)
+        {
+            return (tank_attr_t)i;
+        }
+    }
+    return TANK_ATTR_COUNT;
+}
+
+// GAP event handler
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event)
+    {
+    case ESP_GAP_BLE_SEC_REQ_EVT:
+        // Security request from peer device
+        ESP_LOGI(TAG, "Security request");
+        esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+        break;
+
+    case ESP_GAP_BLE_PASSKEY_REQ_EVT:
+        // Passkey request event - reply with our static passkey
+        // This shouldn't normally happen with ESP_IO_CAP_OUT, but some Android devices may request it
+        ESP_LOGI(TAG, "Passkey request received - replying with static passkey");
+        esp_ble_passkey_reply(param->ble_security.ble_req.bd_addr, true, static_passkey);
+        break;
+
+    case ESP_GAP_BLE_NC_REQ_EVT:
+        // Numeric comparison request - MITM protection
+        ESP_LOGI(TAG, "=========================================");
+        ESP_LOGI(TAG, "BLE PAIRING REQUEST!");
+        ESP_LOGI(TAG, "Verify this code matches your phone:");
+        ESP_LOGI(TAG, "         [ %06d ]", param->ble_security.key_notif.passkey);
+        ESP_LOGI(TAG, "=========================================");
+        ESP_LOGI(TAG, "If codes match, tap 'Pair' on your phone");
+        ESP_LOGI(TAG, "If they don't match, tap 'Cancel' (MITM attack!)");
+
+        // Auto-accept on ESP32 side (user confirms on phone)
+        esp_ble_confirm_reply(param->ble_security.ble_req.bd_addr, true);
+        break;
+
+    case ESP_GAP_BLE_PASSKEY_NOTIF_EVT:
+        // Passkey notification event
+        ESP_LOGI(TAG, "Passkey notification: %06d", param->ble_security.key_notif.passkey);
+        break;
+
+    case ESP_GAP_BLE_AUTH_CMPL_EVT:
+        // Authentication complete
+        if (param->ble_security.auth_cmpl.success)
+        {
+            ESP_LOGI(TAG, "Authentication success: %s",
+                     param->ble_security.auth_cmpl.auth_mode == ESP_LE_AUTH_BOND ? "BONDED" : "PAIRED");
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Authentication failed, reason: 0x%x", param->ble_security.auth_cmpl.fail_reason);
+        }
+        ble_gatt_on_encryption(BLE_TRANSPORT_CONN_UNKNOWN, param->ble_security.auth_cmpl.bd_addr,
+                               param->ble_security.auth_cmpl.success);
+        break;
+
+    case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
+        // Broadcast updates after setup go straight to the running advertiser
+        if (param->adv_data_cmpl.status == ESP_BT_STATUS_SUCCESS && !scan_rsp_done)
+        {
+            // Configure scan response data with the device name
+            esp_ble_adv_data_t scan_rsp_data = {
+                .set_scan_rsp = true,
+                .include_name = true,
+                .include_txpower = false,
+                .appearance = 0x00,
+                .manufacturer_len = 0,
+                .p_manufacturer_data = NULL,
+                .service_data_len = 0,
+                .p_service_data = NULL,
+                .service_uuid_len = 0,
+                .p_service_uuid = NULL,
+                .flag = 0,
+            };
+            esp_ble_gap_config_adv_data(&scan_rsp_data);
+        }
+        break;
+
+    case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
+        if (param->scan_rsp_data_cmpl.status == ESP_BT_STATUS_SUCCESS)
+        {
+            // Start advertising after scan response is configured
+            scan_rsp_done = true;
+            ble_gatt_on_adv_ready();
+        }
+        break;
+
+    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+        ble_gatt_on_adv_started(param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS);
+        break;
+
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+    {
+        ble_link_params_t params = {
+            .interval = param->update_conn_params.conn_int,
+            .latency = param->update_conn_params.latency,
+            .timeout = param->update_conn_params.timeout,
+        };
+        ble_gatt_on_link_update(BLE_TRANSPORT_CONN_UNKNOWN, param->update_conn_params.bda,
+                                param->update_conn_params.status == ESP_BT_STATUS_SUCCESS, &params);
+        break;
+    }
+
+    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+        ble_gatt_on_adv_stopped();
+        break;
+    default:
+        break;
+    }
+}
+
+// GATTS profile event handler
+static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
+                                        esp_gatt_if_t gatts_if,
+                                        esp_ble_gatts_cb_param_t *param)
+{
+    TRACE_BEGIN(TRACE_GATT_EVENT, event);
+
+    switch (event)
+    {
+    case ESP_GATTS_REG_EVT:
+        ESP_LOGI(TAG, "REGISTER_APP_EVT, status %d, app_id %d",
+                 param->reg.status, param->reg.app_id);
+
+        gatts_if_global = gatts_if;
+
+        // Configure advertising data (device name already set in ble_transport_init)
+        ble_gatt_on_ready();
+
+        // Create service
+        esp_ble_gatts_create_service(gatts_if, &(esp_gatt_srvc_id_t){
+                                                   .is_primary = true,
+                                                   .id = {
+                                                       .inst_id = 0x00,
+                                                       .uuid = {
+                                                           .len = ESP_UUID_LEN_16,
+                                                           .uuid = {.uuid16 = TANK_SERVICE_UUID},
+                                                       },
+                                                   },
+                                               },
+                                     TANK_SERVICE_NUM_HANDLES);
+        break;
+
+    case ESP_GATTS_CREATE_EVT:
+        ESP_LOGI(TAG, "CREATE_SERVICE_EVT, status %d, service_handle %d",
+                 param->create.status, param->create.service_handle);
+
+        profile_tab[PROFILE_APP_ID].service_handle = param->create.service_handle;
+
+        // Add characteristics, starting with tank data
+        esp_ble_gatts_start_service(param->create.service_handle);
+        bluedroid_add_char(param->create.service_handle, TANK_ATTR_DATA);
+        break;
+
+    case ESP_GATTS_ADD_CHAR_EVT:
+        ESP_LOGI(TAG, "ADD_CHAR_EVT, status %d, uuid 0x%04x, attr_handle %d",
+                 param->add_char.status, param->add_char.char_uuid.uuid.uuid16, param->add_char.attr_handle);
+
+        for (int i = 0; i < TANK_ATTR_COUNT; i++)
+        {
+            if (tank_attr_defs[i].uuid != param->add_char.char_uuid.uuid.uuid16)
+            {
+                continue;
+            }
+
+            attr_handles[i] = param->add_char.attr_handle;
+            bluedroid_char_added(profile_tab[PROFILE_APP_ID].service_handle, (tank_attr_t)i, false);
+            break;
+        }
+        break;
+
+    case ESP_GATTS_ADD_CHAR_DESCR_EVT:
+        ESP_LOGI(TAG, "ADD_DESCR_EVT, status %d, attr_handle %d",
+                 param->add_char_descr.status, param->add_char_descr.attr_handle);
+
+        // Descriptors follow the characteristic added last
+        for (int i = TANK_ATTR_COUNT - 1; i >= 0; i--)
+        {
+            if (attr_handles[i] != 0)
+            {
+                bluedroid_char_added(profile_tab[PROFILE_APP_ID].service_handle, (tank_attr_t)i, true);
+                break;
+            }
+        }
+        break;
+
+    case ESP_GATTS_CONNECT_EVT:
+    {
+        ble_link_params_t params = {
+            .interval = param->connect.conn_params.interval,
+            .latency = param->connect.conn_params.latency,
+            .timeout = param->connect.conn_params.timeout,
+        };
+        ble_gatt_on_connect(param->connect.conn_id, param->connect.remote_bda, &params);
+
+        // Don't set attribute value on connection - just rely on read callbacks
+        break;
+    }
+
+    case ESP_GATTS_DISCONNECT_EVT:
+        ble_gatt_on_disconnect(param->disconnect.conn_id, param->disconnect.remote_bda,
+                               (uint8_t)param->disconnect.reason);
+        break;
+
+    case ESP_GATTS_MTU_EVT:
+        ble_gatt_on_mtu(param->mtu.conn_id, param->mtu.mtu);
+        break;
+
+    case ESP_GATTS_READ_EVT:
+    {
+        tank_attr_t attr = bluedroid_attr_for_handle(param->read.handle);
+        if (attr == TANK_ATTR_COUNT)
+        {
+            break;
+        }
+
+        esp_gatt_rsp_t rsp = {0};
+        const uint8_t *value = NULL;
+        uint16_t len = 0;
+        esp_gatt_status_t status = ble_gatt_on_read(param->read.conn_id, attr, param->read.offset, &value, &len);
+
+        rsp.attr_value.handle = param->read.handle;
+        rsp.attr_value.offset = param->read.offset;
+        rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+        if (status == ESP_GATT_OK)
+        {
+            rsp.attr_value.len = len < sizeof(rsp.attr_value.value) ? len : sizeof(rsp.attr_value.value);
+            memcpy(rsp.attr_value.value, value, rsp.attr_value.len);
+        }
+
+        esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id,
+                                    status, &rsp);
+        break;
+    }
+
+    case ESP_GATTS_CONGEST_EVT:
+        ble_gatt_on_congest(param->congest.conn_id, param->congest.congested);
+        break;
+
+    case ESP_GATTS_WRITE_EVT:
+    {
+        tank_attr_t attr = bluedroid_attr_for_handle(param->write.handle);
+        esp_gatt_status_t write_status = ESP_GATT_INVALID_HANDLE;
+        if (attr != TANK_ATTR_COUNT)
+        {
+            write_status = ble_gatt_on_write(param->write.conn_id, param->write.bda, attr,
+                                             param->write.value, param->write.len);
+        }
+
+        if (param->write.need_rsp)
+        {
+            esp_gatt_rsp_t rsp = {0};
+            rsp.attr_value.handle = param->write.handle;
+            rsp.attr_value.offset = 0;
+            rsp.attr_value.len = 0;
+            rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+            esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id,
+                                        write_status, &rsp);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    TRACE_END(TRACE_GATT_EVENT);
+}
+
+// Main GATTS event handler
+static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
+                                esp_ble_gatts_cb_param_t *param)
+{
+    if (event == ESP_GATTS_REG_EVT)
+    {
+        if (param->reg.status == ESP_GATT_OK)
+        {
+            profile_tab[param->reg.app_id].gatts_if = gatts_if;
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Reg app failed, app_id %04x, status %d",
+                     param->reg.app_id, param->reg.status);
+            return;
+        }
+    }
+
+    if (gatts_if == ESP_GATT_IF_NONE ||
+        gatts_if == profile_tab[PROFILE_APP_ID].gatts_if)
+    {
+        if (profile_tab[PROFILE_APP_ID].gatts_cb)
+        {
+            profile_tab[PROFILE_APP_ID].gatts_cb(event, gatts_if, param);
+        }
+    }
+}
+
+const char *ble_transport_name(void)
+{
+    return "Bluedroid";
+}
+
+esp_err_t ble_transport_init(const char *device_name, uint32_t passkey)
+{
+    esp_err_t ret;
+
+    // Initialize BT controller
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    ret = esp_bt_controller_init(&bt_cfg);
+    if (ret)
+    {
+        ESP_LOGE(TAG, "Initialize controller failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (ret)
+    {
+        ESP_LOGE(TAG, "Enable controller failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_init();
+    if (ret)
+    {
+        ESP_LOGE(TAG, "Init bluedroid failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_enable();
+    if (ret)
+    {
+        ESP_LOGE(TAG, "Enable bluedroid failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Set device name BEFORE any registration/advertising
+    esp_ble_gap_set_device_name(device_name);
+    ESP_LOGI(TAG, "Device name set to: %s", device_name);
+
+    // Enable local privacy - use random resolvable addresses
+    esp_ble_gap_config_local_privacy(true);
+    ESP_LOGI(TAG, "Local privacy enabled - using random resolvable addresses");
+
+    // Register callbacks
+    esp_ble_gatts_register_callback(gatts_event_handler);
+    esp_ble_gap_register_callback(gap_event_handler);
+
+    // Register app
+    profile_tab[PROFILE_APP_ID].gatts_cb = gatts_profile_event_handler;
+    profile_tab[PROFILE_APP_ID].gatts_if = ESP_GATT_IF_NONE;
+    esp_ble_gatts_app_register(PROFILE_APP_ID);
+
+    // Set MTU
+    esp_ble_gatt_set_local_mtu(517);
+
+    // Configure security parameters
+    // Set authentication requirements: Secure Connections + MITM + Bonding
+    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;
+    esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(uint8_t));
+
+    // Only accept connections from devices that can authenticate and reject connections that negotiate down to "Just Works"
+    uint8_t only_accept = ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_ENABLE;
+    esp_ble_gap_set_security_param(ESP_BLE_SM_ONLY_ACCEPT_SPECIFIED_SEC_AUTH, &only_accept, sizeof(uint8_t));
+
+    // Set I/O capabilities - Display only (we show passkey via serial/docs)
+    // Phone will ask user to enter the passkey
+    esp_ble_io_cap_t iocap = ESP_IO_CAP_OUT; // Display only
+    esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
+
+    // Store passkey globally for responding to PASSKEY_REQ_EVT
+    static_passkey = passkey;
+
+    // Set the static passkey
+    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_STATIC_PASSKEY, &passkey, sizeof(uint32_t));
+
+    // Set maximum encryption key size (16 bytes = 128 bits)
+    uint8_t key_size = 16;
+    esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(uint8_t));
+
+    // Set initiator key distribution (what keys we'll distribute)
+    uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(uint8_t));
+
+    // Set responder key distribution
+    uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
+
+    return ESP_OK;
+}
+
+bool ble_transport_ready(void)
+{
+    return gatts_if_global != ESP_GATT_IF_NONE && service_ready;
+}
+
+esp_err_t ble_transport_notify(uint16_t conn_id, tank_attr_t attr, const uint8_t *data, uint16_t len)
+{
+    bool confirm = (tank_attr_defs[attr].flags & TANK_ATTR_INDICATE) != 0;
+    return esp_ble_gatts_send_indicate(gatts_if_global, conn_id, attr_handles[attr],
+                                       len, (uint8_t *)data, confirm);
+}
+
+void ble_transport_secure(uint16_t conn_id, const uint8_t bda[6])
+{
+    esp_ble_set_encryption((uint8_t *)bda, ESP_BLE_SEC_ENCRYPT_MITM);
+}
+
+void ble_transport_disconnect(uint16_t conn_id, const uint8_t bda[6])
+{
+    esp_ble_gap_disconnect((uint8_t *)bda);
+}
+
+void ble_transport_update_link(uint16_t conn_id, const uint8_t bda[6], const conn_profile_params_t *params)
+{
+    esp_ble_conn_update_params_t update = {
+        .min_int = params->int_min,
+        .max_int = params->int_max,
+        .latency = params->latency,
+        .timeout = params->timeout,
+    };
+    memcpy(update.bda, bda, ESP_BD_ADDR_LEN);
+
+    esp_ble_gap_update_conn_params(&update);
+}
+
+// Advertising data: flags and name, plus the manufacturer data if any. The
+// first set is followed by the scan response (see ADV_DATA_SET_COMPLETE).
+void ble_transport_set_adv_data(const uint8_t *manufacturer, uint8_t len)
+{
+    esp_ble_adv_data_t adv_data = {
+        .set_scan_rsp = false,
+        .include_name = true,
+        .include_txpower = false,
+        .min_interval = 0x0006,
+        .max_interval = 0x0010,
+        .appearance = 0x00,
+        .manufacturer_len = len,
+        .p_manufacturer_data = (uint8_t *)manufacturer,
+        .service_data_len = 0,
+        .p_service_data = NULL,
+        .service_uuid_len = 0,
+        .p_service_uuid = NULL,
+        .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
+    };
+    esp_ble_gap_config_adv_data(&adv_data);
+}
+
+// Open advertising at the tier's interval, or high-duty directed to the
+// peer. ESP_GAP_BLE_ADV_START_COMPLETE_EVT reports the outcome.
+void ble_transport_adv_start(const adv_tier_params_t *tier, const uint8_t *peer, uint8_t peer_addr_type)
+{
+    esp_ble_adv_params_t adv_params = {
+        .adv_int_min = tier->int_min,
+        .adv_int_max = tier->int_max,
+        .adv_type = ADV_TYPE_IND,
+        .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+        .channel_map = ADV_CHNL_ALL,
+        .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+    };
+
+    if (peer)
+    {
+        adv_params.adv_type = ADV_TYPE_DIRECT_IND_HIGH;
+        memcpy(adv_params.peer_addr, peer, ESP_BD_ADDR_LEN);
+        adv_params.peer_addr_type = (esp_ble_addr_type_t)peer_addr_type;
+    }
+
+    esp_ble_gap_start_advertising(&adv_params);
+}
+
+void ble_transport_adv_stop(void)
+{
+    esp_ble_gap_stop_advertising();
+}
+
+// Look the peer up in the bond list. Returns true and its identity address
+// type if the phone has bonded before.
+bool ble_transport_find_bonded(const uint8_t bda[6], uint8_t *addr_type)
+{
+    int count = esp_ble_get_bond_device_num();
+    if (count <= 0)
+    {
+        return false;
+    }
+
+    // Static: the list holds every key and is too big for the BT task stack
+    static esp_ble_bond_dev_t bonded[CONFIG_BT_SMP_MAX_BONDS];
+    if (count > CONFIG_BT_SMP_MAX_BONDS)
+    {
+        count = CONFIG_BT_SMP_MAX_BONDS;
+    }
+    if (esp_ble_get_bond_device_list(&count, bonded) != ESP_OK)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (memcmp(bonded[i].bd_addr, bda, ESP_BD_ADDR_LEN) == 0)
+        {
+            *addr_type = bonded[i].bd_addr_type;
+            return true;
+        }
+    }
+    return false;
+}
+
+int ble_transport_bond_count(void)
+{
+    return esp_ble_get_bond_device_num();
+}
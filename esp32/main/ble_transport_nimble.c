@@ -0,0 +1,555 @@
+#include "sdkconfig.h"
+#include "ble_transport.h"
+#include "ble_gatt.h"
+#include "trace.h"
+#include "esp_log.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#include <string.h>
+
+// NimBLE backend for ble_transport.h. Selected with sdkconfig.nimble; see
+// BLE_STACKS.md for how it compares with Bluedroid.
+//
+// Differences from the Bluedroid backend:
+// - NimBLE addresses are least significant byte first and are reversed at
+//   this boundary.
+// - NimBLE answers long reads itself, calling the access callback for every
+//   part, so reads pass BLE_TRANSPORT_OFFSET_UNKNOWN.
+// - There is no congestion event; a notification refused for lack of
+//   buffers is retried by the notifier like a Bluedroid send error.
+// - Advertising uses the identity address (no resolvable private address).
+
+#ifndef CONFIG_BT_NIMBLE_MAX_BONDS
+#define CONFIG_BT_NIMBLE_MAX_BONDS 3
+#endif
+
+// Provided by the NimBLE NVS store, which has no public header
+void ble_store_config_init(void);
+
+static const char *TAG = "BLE_NIMBLE";
+
+static uint32_t static_passkey = 0;
+static uint8_t own_addr_type;
+static volatile bool host_synced = false;
+
+// Characteristics are declared from tank_attr_defs at init
+static ble_uuid16_t attr_uuids[TANK_ATTR_COUNT];
+static uint16_t attr_handles[TANK_ATTR_COUNT];
+static struct ble_gatt_chr_def chr_defs[TANK_ATTR_COUNT + 1];
+static ble_uuid16_t service_uuid;
+static struct ble_gatt_svc_def svc_defs[2];
+
+// Name and manufacturer data for the advertising packet
+static char adv_name[32];
+static uint8_t adv_manufacturer[31];
+static uint8_t adv_manufacturer_len;
+static bool adv_ready = false;
+
+// Last open advertising parameters, restored after a failed connection
+static struct ble_gap_adv_params adv_params_last;
+
+// Stop completion, reported from the host task like Bluedroid's
+// ADV_STOP_COMPLETE_EVT rather than from the task that asked
+static struct ble_npl_event adv_stop_event;
+
+static int nimble_gap_event(struct ble_gap_event *event, void *arg);
+
+// NimBLE addresses are little-endian, the service's most significant first
+static void nimble_addr_to_bda(const ble_addr_t *addr, uint8_t bda[6])
+{
+    for (int i = 0; i < 6; i++)
+    {
+        bda[i] = addr->val[5 - i];
+    }
+}
+
+static void nimble_bda_to_addr(const uint8_t bda[6], uint8_t type, ble_addr_t *addr)
+{
+    addr->type = type;
+    for (int i = 0; i < 6; i++)
+    {
+        addr->val[i] = bda[5 - i];
+    }
+}
+
+// Peer identity address of a connection. Returns false if it is gone.
+static bool nimble_conn_bda(uint16_t conn_handle, uint8_t bda[6], struct ble_gap_conn_desc *desc)
+{
+    if (ble_gap_conn_find(conn_handle, desc) != 0)
+    {
+        return false;
+    }
+    nimble_addr_to_bda(&desc->peer_id_addr, bda);
+    return true;
+}
+
+static void nimble_link_params(const struct ble_gap_conn_desc *desc, ble_link_params_t *params)
+{
+    params->interval = desc->conn_itvl;
+    params->latency = desc->conn_latency;
+    params->timeout = desc->supervision_timeout;
+}
+
+static int nimble_access(uint16_t conn_handle, uint16_t attr_handle,
+                         struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    tank_attr_t attr = (tank_attr_t)(uintptr_t)arg;
+    int rc = BLE_ATT_ERR_UNLIKELY;
+
+    TRACE_BEGIN(TRACE_GATT_EVENT, ctxt->op);
+
+    if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR)
+    {
+        const uint8_t *value = NULL;
+        uint16_t len = 0;
+        rc = ble_gatt_on_read(conn_handle, attr, BLE_TRANSPORT_OFFSET_UNKNOWN, &value, &len);
+        if (rc == 0 && os_mbuf_append(ctxt->om, value, len) != 0)
+        {
+            rc = BLE_ATT_ERR_INSUFFICIENT_RES;
+        }
+    }
+    else if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR)
+    {
+        // Host task only, so one buffer will do
+        static uint8_t data[BLE_TRANSPORT_WRITE_MAX];
+        struct ble_gap_conn_desc desc;
+        uint8_t bda[6] = {0};
+        uint16_t len = 0;
+
+        nimble_conn_bda(conn_handle, bda, &desc);
+        if (ble_hs_mbuf_to_flat(ctxt->om, data, sizeof(data), &len) != 0)
+        {
+            rc = BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        else
+        {
+            rc = ble_gatt_on_write(conn_handle, bda, attr, data, len);
+        }
+    }
+
+    TRACE_END(TRACE_GATT_EVENT);
+    return rc;
+}
+
+// Build the service definition from tank_attr_defs. Every characteristic
+// needs an encrypted, MITM-protected (authenticated) link.
+static void nimble_build_service(void)
+{
+    memset(chr_defs, 0, sizeof(chr_defs));
+    for (int i = 0; i < TANK_ATTR_COUNT; i++)
+    {
+        const tank_attr_def_t *def = &tank_attr_defs[i];
+        ble_gatt_chr_flags flags = 0;
+
+        if (def->flags & TANK_ATTR_READ)
+        {
+            flags |= BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_READ_ENC | BLE_GATT_CHR_F_READ_AUTHEN;
+        }
+        if (def->flags & TANK_ATTR_WRITE)
+        {
+            flags |= BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC | BLE_GATT_CHR_F_WRITE_AUTHEN;
+        }
+        if (def->flags & TANK_ATTR_NOTIFY)
+        {
+            flags |= BLE_GATT_CHR_F_NOTIFY;
+        }
+        if (def->flags & TANK_ATTR_INDICATE)
+        {
+            flags |= BLE_GATT_CHR_F_INDICATE;
+        }
+
+        attr_uuids[i].u.type = BLE_UUID_TYPE_16;
+        attr_uuids[i].value = def->uuid;
+        chr_defs[i].uuid = &attr_uuids[i].u;
+        chr_defs[i].access_cb = nimble_access;
+        chr_defs[i].arg = (void *)(uintptr_t)i;
+        chr_defs[i].flags = flags;
+        chr_defs[i].val_handle = &attr_handles[i];
+    }
+
+    service_uuid.u.type = BLE_UUID_TYPE_16;
+    service_uuid.value = TANK_SERVICE_UUID;
+    memset(svc_defs, 0, sizeof(svc_defs));
+    svc_defs[0].type = BLE_GATT_SVC_TYPE_PRIMARY;
+    svc_defs[0].uuid = &service_uuid.u;
+    svc_defs[0].characteristics = chr_defs;
+}
+
+// Advertise flags, name and manufacturer data; the scan response repeats the name
+static int nimble_apply_adv_data(void)
+{
+    struct ble_hs_adv_fields fields = {0};
+    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    fields.name = (const uint8_t *)adv_name;
+    fields.name_len = strlen(adv_name);
+    fields.name_is_complete = 1;
+    if (adv_manufacturer_len)
+    {
+        fields.mfg_data = adv_manufacturer;
+        fields.mfg_data_len = adv_manufacturer_len;
+    }
+
+    int rc = ble_gap_adv_set_fields(&fields);
+    if (rc != 0)
+    {
+        ESP_LOGE(TAG, "Setting advertising data failed: %d", rc);
+        return rc;
+    }
+
+    if (!adv_ready)
+    {
+        struct ble_hs_adv_fields rsp_fields = {0};
+        rsp_fields.name = fields.name;
+        rsp_fields.name_len = fields.name_len;
+        rsp_fields.name_is_complete = 1;
+        rc = ble_gap_adv_rsp_set_fields(&rsp_fields);
+        if (rc != 0)
+        {
+            ESP_LOGE(TAG, "Setting scan response failed: %d", rc);
+        }
+    }
+    return rc;
+}
+
+static void nimble_on_sync(void)
+{
+    ble_hs_util_ensure_addr(0);
+    ble_hs_id_infer_auto(0, &own_addr_type);
+    host_synced = true;
+
+    ble_gatt_on_ready();
+}
+
+static void nimble_on_reset(int reason)
+{
+    // Advertising data and scan response are set again on the next sync
+    host_synced = false;
+    adv_ready = false;
+    ESP_LOGE(TAG, "Host reset, reason %d", reason);
+}
+
+static void nimble_adv_stopped(struct ble_npl_event *ev)
+{
+    ble_gatt_on_adv_stopped();
+}
+
+static void nimble_host_task(void *param)
+{
+    // Returns only when nimble_port_stop() is called
+    nimble_port_run();
+    nimble_port_freertos_deinit();
+}
+
+static int nimble_gap_event(struct ble_gap_event *event, void *arg)
+{
+    struct ble_gap_conn_desc desc;
+    ble_link_params_t params;
+    uint8_t bda[6];
+
+    TRACE_BEGIN(TRACE_GATT_EVENT, event->type);
+
+    switch (event->type)
+    {
+    case BLE_GAP_EVENT_CONNECT:
+        if (event->connect.status != 0)
+        {
+            // Connection attempt failed and advertising ended with it
+            ESP_LOGW(TAG, "Connection failed, status %d", event->connect.status);
+            if (adv_params_last.conn_mode == BLE_GAP_CONN_MODE_UND)
+            {
+                ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &adv_params_last, nimble_gap_event, NULL);
+            }
+            break;
+        }
+        if (nimble_conn_bda(event->connect.conn_handle, bda, &desc))
+        {
+            nimble_link_params(&desc, &params);
+            ble_gatt_on_connect(event->connect.conn_handle, bda, &params);
+        }
+        break;
+
+    case BLE_GAP_EVENT_DISCONNECT:
+    {
+        // HCI reasons arrive offset into NimBLE's error space
+        int reason = event->disconnect.reason;
+        if (reason >= BLE_HS_ERR_HCI_BASE && reason < BLE_HS_ERR_HCI_BASE + 0x100)
+        {
+            reason -= BLE_HS_ERR_HCI_BASE;
+        }
+        nimble_addr_to_bda(&event->disconnect.conn.peer_id_addr, bda);
+        ble_gatt_on_disconnect(event->disconnect.conn.conn_handle, bda, (uint8_t)reason);
+        break;
+    }
+
+    case BLE_GAP_EVENT_ENC_CHANGE:
+    {
+        // Reject links that negotiated down to Just Works, as Bluedroid's
+        // ESP_BLE_ONLY_ACCEPT_SPECIFIED_AUTH_ENABLE does
+        bool found = nimble_conn_bda(event->enc_change.conn_handle, bda, &desc);
+        bool secured = found && event->enc_change.status == 0 &&
+                       desc.sec_state.encrypted && desc.sec_state.authenticated;
+        if (secured)
+        {
+            ESP_LOGI(TAG, "Authentication success: %s", desc.sec_state.bonded ? "BONDED" : "PAIRED");
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Authentication failed, status %d", event->enc_change.status);
+        }
+        ble_gatt_on_encryption(event->enc_change.conn_handle, bda, secured);
+        break;
+    }
+
+    case BLE_GAP_EVENT_PASSKEY_ACTION:
+    {
+        struct ble_sm_io io = {0};
+        io.action = event->passkey.params.action;
+        if (io.action == BLE_SM_IOACT_DISP)
+        {
+            // Display only: the phone asks the user for the boot passkey
+            io.passkey = static_passkey;
+            ble_sm_inject_io(event->passkey.conn_handle, &io);
+        }
+        else if (io.action == BLE_SM_IOACT_NUMCMP)
+        {
+            ESP_LOGI(TAG, "Verify this code matches your phone: [ %06lu ]",
+                     (unsigned long)event->passkey.params.numcmp);
+
+            // Auto-accept on ESP32 side (user confirms on phone)
+            io.numcmp_accept = 1;
+            ble_sm_inject_io(event->passkey.conn_handle, &io);
+        }
+        break;
+    }
+
+    case BLE_GAP_EVENT_REPEAT_PAIRING:
+        // The phone lost its keys: forget the old bond and pair again
+        if (ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc) == 0)
+        {
+            ble_store_util_delete_peer(&desc.peer_id_addr);
+        }
+        TRACE_END(TRACE_GATT_EVENT);
+        return BLE_GAP_REPEAT_PAIRING_RETRY;
+
+    case BLE_GAP_EVENT_CONN_UPDATE:
+        if (nimble_conn_bda(event->conn_update.conn_handle, bda, &desc))
+        {
+            nimble_link_params(&desc, &params);
+            ble_gatt_on_link_update(event->conn_update.conn_handle, bda, event->conn_update.status == 0, &params);
+        }
+        break;
+
+    case BLE_GAP_EVENT_MTU:
+        ble_gatt_on_mtu(event->mtu.conn_handle, event->mtu.value);
+        break;
+
+    case BLE_GAP_EVENT_ADV_COMPLETE:
+        // Directed advertising timed out; the tier timer moves on
+        ble_gatt_on_adv_stopped();
+        break;
+
+    default:
+        break;
+    }
+
+    TRACE_END(TRACE_GATT_EVENT);
+    return 0;
+}
+
+const char *ble_transport_name(void)
+{
+    return "NimBLE";
+}
+
+esp_err_t ble_transport_init(const char *device_name, uint32_t passkey)
+{
+    // Controller and host
+    esp_err_t ret = nimble_port_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Init NimBLE failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ble_hs_cfg.sync_cb = nimble_on_sync;
+    ble_hs_cfg.reset_cb = nimble_on_reset;
+    ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
+
+    // Secure Connections + MITM + bonding, display only, passkey from boot
+    ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_DISP_ONLY;
+    ble_hs_cfg.sm_bonding = 1;
+    ble_hs_cfg.sm_mitm = 1;
+    ble_hs_cfg.sm_sc = 1;
+    ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+    ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+    static_passkey = passkey;
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+
+    nimble_build_service();
+    int rc = ble_gatts_count_cfg(svc_defs);
+    if (rc == 0)
+    {
+        rc = ble_gatts_add_svcs(svc_defs);
+    }
+    if (rc != 0)
+    {
+        ESP_LOGE(TAG, "Registering service failed: %d", rc);
+        return ESP_FAIL;
+    }
+
+    strncpy(adv_name, device_name, sizeof(adv_name) - 1);
+    ble_svc_gap_device_name_set(device_name);
+    ESP_LOGI(TAG, "Device name set to: %s", device_name);
+
+    ble_att_set_preferred_mtu(517);
+    ble_store_config_init();
+    ble_npl_event_init(&adv_stop_event, nimble_adv_stopped, NULL);
+
+    // Host task; nimble_on_sync runs on it once the controller is up
+    nimble_port_freertos_init(nimble_host_task);
+    return ESP_OK;
+}
+
+bool ble_transport_ready(void)
+{
+    return host_synced && attr_handles[TANK_ATTR_DATA] != 0;
+}
+
+esp_err_t ble_transport_notify(uint16_t conn_id, tank_attr_t attr, const uint8_t *data, uint16_t len)
+{
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(data, len);
+    if (om == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Both consume om whether or not it is sent
+    int rc = (tank_attr_defs[attr].flags & TANK_ATTR_INDICATE)
+                 ? ble_gatts_indicate_custom(conn_id, attr_handles[attr], om)
+                 : ble_gatts_notify_custom(conn_id, attr_handles[attr], om);
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
+
+void ble_transport_secure(uint16_t conn_id, const uint8_t bda[6])
+{
+    ble_gap_security_initiate(conn_id);
+}
+
+void ble_transport_disconnect(uint16_t conn_id, const uint8_t bda[6])
+{
+    ble_gap_terminate(conn_id, BLE_ERR_REM_USER_CONN_TERM);
+}
+
+void ble_transport_update_link(uint16_t conn_id, const uint8_t bda[6], const conn_profile_params_t *params)
+{
+    struct ble_gap_upd_params update = {
+        .itvl_min = params->int_min,
+        .itvl_max = params->int_max,
+        .latency = params->latency,
+        .supervision_timeout = params->timeout,
+    };
+
+    int rc = ble_gap_update_params(conn_id, &update);
+    if (rc != 0)
+    {
+        // Not sent (e.g. a procedure already running); as with a refusal the
+        // profile is asked for again on the next activity change
+        ESP_LOGW(TAG, "conn_id %d: parameter update not sent: %d", conn_id, rc);
+    }
+}
+
+// NimBLE sets advertising data synchronously, so the first call is followed
+// straight away by ble_gatt_on_adv_ready()
+void ble_transport_set_adv_data(const uint8_t *manufacturer, uint8_t len)
+{
+    if (len > sizeof(adv_manufacturer))
+    {
+        len = sizeof(adv_manufacturer);
+    }
+    if (len)
+    {
+        memcpy(adv_manufacturer, manufacturer, len);
+    }
+    adv_manufacturer_len = len;
+
+    if (nimble_apply_adv_data() == 0 && !adv_ready)
+    {
+        adv_ready = true;
+        ble_gatt_on_adv_ready();
+    }
+}
+
+void ble_transport_adv_start(const adv_tier_params_t *tier, const uint8_t *peer, uint8_t peer_addr_type)
+{
+    struct ble_gap_adv_params adv_params = {0};
+    ble_addr_t peer_addr;
+    int rc;
+
+    if (peer)
+    {
+        // High duty cycle; the controller ends it after 1.28 s
+        adv_params.conn_mode = BLE_GAP_CONN_MODE_DIR;
+        adv_params.disc_mode = BLE_GAP_DISC_MODE_NON;
+        adv_params.high_duty_cycle = 1;
+        nimble_bda_to_addr(peer, peer_addr_type, &peer_addr);
+        rc = ble_gap_adv_start(own_addr_type, &peer_addr, BLE_HS_FOREVER, &adv_params, nimble_gap_event, NULL);
+    }
+    else
+    {
+        adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+        adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+        adv_params.itvl_min = tier->int_min;
+        adv_params.itvl_max = tier->int_max;
+        rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &adv_params, nimble_gap_event, NULL);
+    }
+    adv_params_last = adv_params;
+
+    ble_gatt_on_adv_started(rc == 0);
+}
+
+// Stopping an advertiser the controller already ended is reported the same way
+void ble_transport_adv_stop(void)
+{
+    ble_gap_adv_stop();
+    ble_npl_eventq_put(nimble_port_get_dflt_eventq(), &adv_stop_event);
+}
+
+bool ble_transport_find_bonded(const uint8_t bda[6], uint8_t *addr_type)
+{
+    ble_addr_t peers[CONFIG_BT_NIMBLE_MAX_BONDS];
+    int count = 0;
+
+    if (ble_store_util_bonded_peers(peers, &count, CONFIG_BT_NIMBLE_MAX_BONDS) != 0)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t peer_bda[6];
+        nimble_addr_to_bda(&peers[i], peer_bda);
+        if (memcmp(peer_bda, bda, sizeof(peer_bda)) == 0)
+        {
+            *addr_type = peers[i].type;
+            return true;
+        }
+    }
+    return false;
+}
+
+int ble_transport_bond_count(void)
+{
+    int count = 0;
+
+    if (ble_store_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC, &count) != 0)
+    {
+        return 0;
+    }
+    return count;
+}
@@ -1,37 +1,37 @@
 #include "config.h"
-#include "nvs_flash.h"
-#include "nvs.h"
+#include "hal.h"
+#include "sensor.h"
+#include "tank_monitor.h"
 #include "esp_log.h"
 #include <string.h>
 
 static const char *TAG = "CONFIG";
 
+// Authoritative in-memory copy, guarded by cache_lock (held only for copies)
+static tank_config_t cache;
+static hal_lock_t cache_lock = HAL_LOCK_INITIALIZER;
+static bool cache_dirty = false;
+
+// Background writer state
+static hal_task_t writer_task = NULL;
+static uint32_t pending_updates = 0;
+static uint32_t flash_writes = 0;
+
 void tank_config_init_nvs(void) {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
+    hal_kv_init();
     ESP_LOGI(TAG, "NVS initialized");
 }
 
 bool tank_config_load(tank_config_t *config) {
     if (config == NULL) return false;
     
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGI(TAG, "No saved config found");
-        return false;
-    }
-    
+    // Older firmware wrote a shorter blob; the fields past it stay zero and
+    // version 0 tells tank_config_cache_init() to migrate
     size_t length = sizeof(tank_config_t);
-    err = nvs_get_blob(nvs_handle, NVS_KEY_CONFIG, config, &length);
-    nvs_close(nvs_handle);
-    
-    if (err != ESP_OK || length != sizeof(tank_config_t)) {
-        ESP_LOGI(TAG, "Failed to load config");
+    memset(config, 0, sizeof(tank_config_t));
+    if (!hal_kv_get_blob(NVS_NAMESPACE, NVS_KEY_CONFIG, config, &length) ||
+        (length != sizeof(tank_config_t) && length != TANK_CONFIG_V0_LEN)) {
+        ESP_LOGI(TAG, "No saved config found");
         return false;
     }
     
@@ -45,25 +45,8 @@ bool tank_config_load(tank_config_t *config) {
 bool tank_config_save(const tank_config_t *config) {
     if (config == NULL) return false;
     
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for writing");
-        return false;
-    }
-    
-    err = nvs_set_blob(nvs_handle, NVS_KEY_CONFIG, config, sizeof(tank_config_t));
-    if (err != ESP_OK) {
+    if (!hal_kv_set_blob(NVS_NAMESPACE, NVS_KEY_CONFIG, config, sizeof(tank_config_t))) {
         ESP_LOGE(TAG, "Failed to save config");
-        nvs_close(nvs_handle);
-        return false;
-    }
-    
-    err = nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
-    
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit config");
         return false;
     }
     
@@ -82,16 +65,225 @@ void tank_config_set_defaults(tank_config_t *config) {
     config->black_enabled = true;
     strcpy(config->pin, "000000");  // Default PIN
     config->pin_set = true;
+    config->version = TANK_CONFIG_VERSION;
+    tank_config_timing_defaults(&config->timing);
     ESP_LOGI(TAG, "Config set to defaults with PIN: 000000");
 }
 
 void tank_config_erase(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err == ESP_OK) {
-        nvs_erase_key(nvs_handle, NVS_KEY_CONFIG);
-        nvs_commit(nvs_handle);
-        nvs_close(nvs_handle);
+    if (hal_kv_erase(NVS_NAMESPACE, NVS_KEY_CONFIG)) {
         ESP_LOGI(TAG, "Config erased from NVS");
     }
+}
+
+bool tank_config_flush(void) {
+    tank_config_t snapshot;
+
+    hal_lock(&cache_lock);
+    bool dirty = cache_dirty;
+    uint32_t coalesced = pending_updates;
+    snapshot = cache;
+    cache_dirty = false;
+    pending_updates = 0;
+    hal_unlock(&cache_lock);
+
+    if (!dirty) {
+        return true;
+    }
+
+    if (!tank_config_save(&snapshot)) {
+        // Keep it dirty so the writer retries the commit
+        hal_lock(&cache_lock);
+        cache_dirty = true;
+        hal_unlock(&cache_lock);
+        return false;
+    }
+
+    flash_writes++;
+    ESP_LOGI(TAG, "Config committed - %lu update(s) coalesced, %lu flash write(s) since boot",
+             (unsigned long)coalesced, (unsigned long)flash_writes);
+    return true;
+}
+
+static void tank_config_writer_task(void *pvParameters) {
+    (void)pvParameters;
+
+    while (1) {
+        // Wait for the first mutation, then keep extending the window while
+        // more arrive so a burst costs one commit
+        hal_task_wait(HAL_WAIT_FOREVER);
+        while (hal_task_wait(CONFIG_COMMIT_DELAY_MS)) {
+        }
+
+        // Retry a failed commit until it lands, backing off so a failing
+        // flash is not hammered; a new mutation retries right away
+        uint32_t retry_ms = CONFIG_RETRY_DELAY_MS;
+        while (!tank_config_flush()) {
+            ESP_LOGW(TAG, "Config commit failed, retrying in %lu ms", (unsigned long)retry_ms);
+            hal_task_wait(retry_ms);
+            retry_ms = retry_ms * 2 < CONFIG_RETRY_DELAY_MAX_MS ? retry_ms * 2 : CONFIG_RETRY_DELAY_MAX_MS;
+        }
+    }
+}
+
+// Mark the cache dirty and wake the writer
+static void tank_config_schedule_commit(void) {
+    hal_lock(&cache_lock);
+    cache_dirty = true;
+    pending_updates++;
+    hal_unlock(&cache_lock);
+
+    if (writer_task) {
+        hal_task_notify(writer_task);
+    } else {
+        // No background writer (host build) - commit synchronously
+        tank_config_flush();
+    }
+}
+
+void tank_config_cache_init(void) {
+    tank_config_t loaded;
+
+    if (!tank_config_load(&loaded)) {
+        // No saved config, use defaults
+        tank_config_set_defaults(&loaded);
+        tank_config_save(&loaded);
+        flash_writes++;
+        ESP_LOGI(TAG, "Created default config");
+    } else {
+        bool repaired = false;
+
+        if (loaded.version < TANK_CONFIG_VERSION) {
+            ESP_LOGI(TAG, "Migrating config from version %d", loaded.version);
+            loaded.version = TANK_CONFIG_VERSION;
+            tank_config_timing_defaults(&loaded.timing);
+            repaired = true;
+        }
+        if (strnlen(loaded.pin, sizeof(loaded.pin)) != 6) {
+            ESP_LOGW(TAG, "Invalid PIN in config, resetting to default");
+            strcpy(loaded.pin, "000000");
+            loaded.pin_set = true;
+            repaired = true;
+        }
+        if (!tank_config_timing_valid(&loaded.timing)) {
+            ESP_LOGW(TAG, "Invalid timing in config, resetting to defaults");
+            tank_config_timing_defaults(&loaded.timing);
+            repaired = true;
+        }
+
+        if (repaired) {
+            tank_config_save(&loaded);
+            flash_writes++;
+        }
+    }
+
+    hal_lock(&cache_lock);
+    cache = loaded;
+    cache_dirty = false;
+    pending_updates = 0;
+    hal_unlock(&cache_lock);
+
+    if (!hal_task_create(tank_config_writer_task, "config_writer", 3072, 2, &writer_task)) {
+        writer_task = NULL;
+    }
+}
+
+void tank_config_get(tank_config_t *config) {
+    if (config == NULL) return;
+
+    hal_lock(&cache_lock);
+    *config = cache;
+    hal_unlock(&cache_lock);
+}
+
+bool tank_config_check_pin(const uint8_t *pin, uint16_t len) {
+    if (pin == NULL || len != 6) return false;
+
+    char expected[7];
+    hal_lock(&cache_lock);
+    memcpy(expected, cache.pin, sizeof(expected));
+    hal_unlock(&cache_lock);
+
+    return memcmp(pin, expected, 6) == 0;
+}
+
+void tank_config_set_enabled(bool grey_enabled, bool black_enabled) {
+    hal_lock(&cache_lock);
+    bool changed = cache.grey_enabled != grey_enabled || cache.black_enabled != black_enabled;
+    cache.grey_enabled = grey_enabled;
+    cache.black_enabled = black_enabled;
+    hal_unlock(&cache_lock);
+
+    if (changed) {
+        tank_config_schedule_commit();
+    }
+}
+
+void tank_config_set_pin(const uint8_t *pin) {
+    if (pin == NULL) return;
+
+    hal_lock(&cache_lock);
+    memcpy(cache.pin, pin, 6);
+    cache.pin[6] = '\0';
+    cache.pin_set = true;
+    hal_unlock(&cache_lock);
+
+    tank_config_schedule_commit();
+}
+
+void tank_config_timing_defaults(tank_timing_t *timing) {
+    if (timing == NULL) return;
+
+    timing->sample_period_ms = STABILITY_CHECK_INTERVAL;
+    timing->settle_min_ms = STABILITY_DURATION_MIN;
+    timing->settle_max_ms = STABILITY_DURATION;
+    timing->debounce_ms = DEBOUNCE_DELAY_MS;
+}
+
+bool tank_config_timing_valid(const tank_timing_t *timing) {
+    if (timing == NULL) return false;
+
+    return timing->sample_period_ms >= TANK_CONFIG_SAMPLE_PERIOD_MIN_MS &&
+           timing->sample_period_ms <= TANK_CONFIG_SAMPLE_PERIOD_MAX_MS &&
+           timing->settle_min_ms > 0 &&
+           timing->settle_min_ms <= timing->settle_max_ms &&
+           timing->settle_max_ms <= STABILITY_DURATION_LIMIT &&
+           timing->debounce_ms > 0 &&
+           timing->debounce_ms <= TANK_CONFIG_DEBOUNCE_MAX_MS;
+}
+
+// Merge the non-zero fields of update into the stored timing. The result is
+// checked as a whole, so a new minimum may rely on a maximum sent with it.
+// On success applied gets the merged timing for the monitor.
+bool tank_config_set_timing(const tank_timing_t *update, tank_timing_t *applied) {
+    if (update == NULL) return false;
+
+    hal_lock(&cache_lock);
+    tank_timing_t timing = cache.timing;
+    if (update->sample_period_ms) timing.sample_period_ms = update->sample_period_ms;
+    if (update->settle_min_ms) timing.settle_min_ms = update->settle_min_ms;
+    if (update->settle_max_ms) timing.settle_max_ms = update->settle_max_ms;
+    if (update->debounce_ms) timing.debounce_ms = update->debounce_ms;
+
+    bool valid = tank_config_timing_valid(&timing);
+    bool changed = valid && memcmp(&timing, &cache.timing, sizeof(timing)) != 0;
+    if (changed) {
+        cache.timing = timing;
+    }
+    hal_unlock(&cache_lock);
+
+    if (!valid) {
+        return false;
+    }
+    if (changed) {
+        tank_config_schedule_commit();
+    }
+    if (applied) {
+        *applied = timing;
+    }
+    return true;
+}
+
+uint32_t tank_config_flash_writes(void) {
+    return flash_writes;
 }
\ No newline at end of file
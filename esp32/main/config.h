@@ -7,13 +7,40 @@
 #define NVS_NAMESPACE "tank_monitor"
 #define NVS_KEY_CONFIG "config"
 
+// Mutations arriving within this window are folded into a single NVS commit
+#define CONFIG_COMMIT_DELAY_MS 500
+
+// A failed commit is retried after this delay, doubling up to the maximum
+#define CONFIG_RETRY_DELAY_MS       1000
+#define CONFIG_RETRY_DELAY_MAX_MS   60000
+
+// Schema version stored with the config. Version 0 blobs end after
+// reserved[] and are migrated at boot with the timing defaults.
+#define TANK_CONFIG_VERSION 1
+#define TANK_CONFIG_V0_LEN  16
+
+// Limits for client-written timing
+#define TANK_CONFIG_SAMPLE_PERIOD_MIN_MS    20      // Two FreeRTOS ticks
+#define TANK_CONFIG_SAMPLE_PERIOD_MAX_MS    5000
+#define TANK_CONFIG_DEBOUNCE_MAX_MS         5000
+
+// Sampling and filter timing, applied live by the monitor task
+typedef struct {
+    uint32_t sample_period_ms;  // Polled sample period
+    uint32_t settle_min_ms;     // Settle window with no recent flapping
+    uint32_t settle_max_ms;     // Settle window while sloshing (and at boot)
+    uint32_t debounce_ms;       // Edge-capture quiet time before a level is accepted
+} tank_timing_t;
+
 // Configuration structure
 typedef struct {
     bool grey_enabled;
     bool black_enabled;
     char pin[7];           // 6 digits + null terminator
     bool pin_set;          // Has PIN been configured
-    uint8_t reserved[6];   // Reserved for future use (reduced from 14)
+    uint8_t version;       // TANK_CONFIG_VERSION (0 in blobs from older firmware)
+    uint8_t reserved[5];   // Reserved for future use
+    tank_timing_t timing;  // Version 1
 } tank_config_t;
 
 // Function prototypes
@@ -23,4 +50,16 @@ bool tank_config_save(const tank_config_t *config);
 void tank_config_set_defaults(tank_config_t *config);
 void tank_config_erase(void);
 
+// RAM-resident config - loaded once at boot, written behind to NVS
+void tank_config_cache_init(void);
+void tank_config_get(tank_config_t *config);
+bool tank_config_check_pin(const uint8_t *pin, uint16_t len);
+void tank_config_set_enabled(bool grey_enabled, bool black_enabled);
+void tank_config_set_pin(const uint8_t *pin);
+void tank_config_timing_defaults(tank_timing_t *timing);
+bool tank_config_timing_valid(const tank_timing_t *timing);
+bool tank_config_set_timing(const tank_timing_t *update, tank_timing_t *applied);
+bool tank_config_flush(void);
+uint32_t tank_config_flash_writes(void);
+
 #endif // CONFIG_H
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "conn_policy.h"
+#include <string.h>
+
+static const conn_profile_params_t profile_params[] = {
+    [CONN_PROFILE_NONE] = {0, 0, 0, 0},
+    [CONN_PROFILE_ACTIVE] = {CONN_ACTIVE_INT_MIN, CONN_ACTIVE_INT_MAX, CONN_ACTIVE_LATENCY, CONN_ACTIVE_TIMEOUT},
+    [CONN_PROFILE_IDLE] = {CONN_IDLE_INT_MIN, CONN_IDLE_INT_MAX, CONN_IDLE_LATENCY, CONN_IDLE_TIMEOUT},
+};
+
+static const char *profile_names[] = {
+    [CONN_PROFILE_NONE] = "default",
+    [CONN_PROFILE_ACTIVE] = "active",
+    [CONN_PROFILE_IDLE] = "idle",
+};
+
+// A new link is treated as active: the client is about to discover services
+// and authenticate
+void conn_policy_init(conn_policy_t *policy, uint32_t now_ms) {
+    if (policy == NULL) return;
+
+    memset(policy, 0, sizeof(*policy));
+    policy->last_activity_ms = now_ms;
+    policy->notify_window_ms = now_ms;
+}
+
+const conn_profile_params_t *conn_policy_params(conn_profile_t profile) {
+    return profile <= CONN_PROFILE_IDLE ? &profile_params[profile] : &profile_params[CONN_PROFILE_NONE];
+}
+
+const char *conn_policy_profile_name(conn_profile_t profile) {
+    return profile <= CONN_PROFILE_IDLE ? profile_names[profile] : "unknown";
+}
+
+void conn_policy_note_activity(conn_policy_t *policy, uint32_t now_ms) {
+    if (policy == NULL) return;
+
+    policy->last_activity_ms = now_ms;
+}
+
+// Occasional state changes ride the idle profile; a burst of them (liquid
+// sloshing, a tank filling) keeps the link short so updates stay prompt
+void conn_policy_note_notify(conn_policy_t *policy, uint32_t now_ms) {
+    if (policy == NULL) return;
+
+    if (now_ms - policy->notify_window_ms >= CONN_POLICY_IDLE_MS) {
+        policy->notify_window_ms = now_ms;
+        policy->notify_count = 0;
+    }
+    if (++policy->notify_count >= CONN_POLICY_NOTIFY_BUSY) {
+        policy->last_activity_ms = now_ms;
+    }
+}
+
+// Profile to request now, or CONN_PROFILE_NONE if the current request still
+// fits. busy marks work the policy cannot see from events alone, such as a
+// history backfill in progress, and counts as activity.
+conn_profile_t conn_policy_evaluate(conn_policy_t *policy, bool busy, uint32_t now_ms) {
+    if (policy == NULL) return CONN_PROFILE_NONE;
+
+    if (busy) {
+        policy->last_activity_ms = now_ms;
+    }
+
+    conn_profile_t wanted = now_ms - policy->last_activity_ms >= CONN_POLICY_IDLE_MS ?
+                            CONN_PROFILE_IDLE : CONN_PROFILE_ACTIVE;
+    if (wanted == policy->requested) {
+        return CONN_PROFILE_NONE;
+    }
+
+    policy->requested = wanted;
+    return wanted;
+}
+
+// Time until an active link would be moved to the idle profile, UINT32_MAX
+// if it already is
+uint32_t conn_policy_ms_to_idle(const conn_policy_t *policy, uint32_t now_ms) {
+    if (policy == NULL || policy->requested == CONN_PROFILE_IDLE) return UINT32_MAX;
+
+    uint32_t quiet = now_ms - policy->last_activity_ms;
+    return quiet >= CONN_POLICY_IDLE_MS ? 0 : CONN_POLICY_IDLE_MS - quiet;
+}
+
+// Parameters the link was opened with
+void conn_policy_set_current(conn_policy_t *policy, uint16_t interval, uint16_t latency, uint16_t timeout) {
+    if (policy == NULL) return;
+
+    policy->interval = interval;
+    policy->latency = latency;
+    policy->timeout = timeout;
+}
+
+void conn_policy_update_done(conn_policy_t *policy, bool success, uint16_t interval, uint16_t latency, uint16_t timeout) {
+    if (policy == NULL) return;
+
+    if (!success) {
+        policy->rejects++;
+        return;
+    }
+
+    policy->updates++;
+    conn_policy_set_current(policy, interval, latency, timeout);
+}
@@ -0,0 +1,65 @@
+#ifndef CONN_POLICY_H
+#define CONN_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-connection link parameter policy. A client doing something interactive
+// (service discovery, PIN auth, config writes, history backfill, bursts of
+// notifications) gets a short connection interval; once it has been quiet for
+// CONN_POLICY_IDLE_MS it is moved to a long interval with peripheral latency,
+// which lets the radio sleep through most connection events. Both profiles
+// follow Apple's accessory guidelines so iOS accepts them.
+typedef enum {
+    CONN_PROFILE_NONE = 0,      // Nothing requested yet (central's choice)
+    CONN_PROFILE_ACTIVE,
+    CONN_PROFILE_IDLE,
+} conn_profile_t;
+
+// Interval in 1.25 ms units, timeout in 10 ms units
+#define CONN_ACTIVE_INT_MIN     12      // 15 ms
+#define CONN_ACTIVE_INT_MAX     24      // 30 ms
+#define CONN_ACTIVE_LATENCY     0
+#define CONN_ACTIVE_TIMEOUT     400     // 4 s
+
+#define CONN_IDLE_INT_MIN       240     // 300 ms
+#define CONN_IDLE_INT_MAX       288     // 360 ms
+#define CONN_IDLE_LATENCY       4       // Up to 1.8 s between peripheral replies
+#define CONN_IDLE_TIMEOUT       600     // 6 s
+
+#define CONN_POLICY_IDLE_MS     10000   // Quiet time before moving to the idle profile
+#define CONN_POLICY_NOTIFY_BUSY 5       // Notifications per idle window that count as activity
+
+typedef struct {
+    uint16_t int_min;
+    uint16_t int_max;
+    uint16_t latency;
+    uint16_t timeout;
+} conn_profile_params_t;
+
+typedef struct {
+    conn_profile_t requested;   // Last profile asked for
+    uint32_t last_activity_ms;
+    uint32_t notify_window_ms;  // Start of the current notification count
+    uint16_t notify_count;
+
+    // Parameters in force, as reported by the stack
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+    uint16_t updates;           // Parameter changes applied
+    uint16_t rejects;           // Requests the central refused
+} conn_policy_t;
+
+// Function prototypes
+void conn_policy_init(conn_policy_t *policy, uint32_t now_ms);
+const conn_profile_params_t *conn_policy_params(conn_profile_t profile);
+const char *conn_policy_profile_name(conn_profile_t profile);
+void conn_policy_note_activity(conn_policy_t *policy, uint32_t now_ms);
+void conn_policy_note_notify(conn_policy_t *policy, uint32_t now_ms);
+conn_profile_t conn_policy_evaluate(conn_policy_t *policy, bool busy, uint32_t now_ms);
+uint32_t conn_policy_ms_to_idle(const conn_policy_t *policy, uint32_t now_ms);
+void conn_policy_set_current(conn_policy_t *policy, uint16_t interval, uint16_t latency, uint16_t timeout);
+void conn_policy_update_done(conn_policy_t *policy, bool success, uint16_t interval, uint16_t latency, uint16_t timeout);
+
+#endif // CONN_POLICY_H
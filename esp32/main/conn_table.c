@@ -0,0 +1,132 @@
+#include "conn_table.h"
+#include "tank_payload.h"
+#include <string.h>
+
+void conn_table_init(conn_table_t *table) {
+    if (table == NULL) return;
+
+    memset(table, 0, sizeof(*table));
+    atomic_init(&table->occupied, 0);
+}
+
+// Claim the slot for a new connection. Returns NULL when the conn_id is out
+// of range or MAX_CONNECTIONS clients are already connected.
+ble_conn_info_t *conn_table_add(conn_table_t *table, uint16_t conn_id, const uint8_t bda[6]) {
+    if (table == NULL || conn_id >= CONN_TABLE_SLOTS) return NULL;
+
+    unsigned bit = 1u << conn_id;
+    unsigned occupied = atomic_load_explicit(&table->occupied, memory_order_relaxed);
+    if (!(occupied & bit)) {
+        if (table->count >= MAX_CONNECTIONS) return NULL;
+        table->count++;
+    } else {
+        // A reused conn_id whose disconnect was missed starts over; hide the
+        // slot from new walks before clearing it
+        occupied &= ~bit;
+        atomic_store_explicit(&table->occupied, occupied, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+
+    ble_conn_info_t *conn = &table->slots[conn_id];
+    memset(conn, 0, sizeof(*conn));
+    conn->conn_id = conn_id;
+    if (bda) {
+        memcpy(conn->remote_bda, bda, sizeof(conn->remote_bda));
+    }
+    conn->is_connected = true;
+    conn->notifications_enabled = true; // Enable by default
+    conn->is_encrypted = false;         // Not encrypted until auth completes
+    conn->is_authenticated = false;     // Require PIN authentication per connection
+    conn->mtu = BLE_DEFAULT_MTU;        // Until the client negotiates
+    conn->data_format = TANK_PAYLOAD_V1; // Original layout unless the client asks
+    notify_queue_init(&conn->queue);
+
+    // Publish only once the slot is complete
+    atomic_store_explicit(&table->occupied, occupied | bit, memory_order_release);
+    return conn;
+}
+
+bool conn_table_remove(conn_table_t *table, uint16_t conn_id) {
+    ble_conn_info_t *conn = conn_table_get(table, conn_id);
+    if (conn == NULL) return false;
+
+    atomic_fetch_and_explicit(&table->occupied, ~(1u << conn_id), memory_order_release);
+    table->count--;
+    conn->is_connected = false;
+    return true;
+}
+
+ble_conn_info_t *conn_table_get(conn_table_t *table, uint16_t conn_id) {
+    if (table == NULL || conn_id >= CONN_TABLE_SLOTS ||
+        !(atomic_load_explicit(&table->occupied, memory_order_acquire) & (1u << conn_id))) {
+        return NULL;
+    }
+    return &table->slots[conn_id];
+}
+
+// Address lookup for events that only carry the peer address (security)
+ble_conn_info_t *conn_table_find_bda(conn_table_t *table, const uint8_t bda[6]) {
+    if (table == NULL || bda == NULL) return NULL;
+
+    ble_conn_info_t *conn;
+    CONN_TABLE_FOREACH(table, conn) {
+        if (memcmp(conn->remote_bda, bda, sizeof(conn->remote_bda)) == 0) {
+            return conn;
+        }
+    }
+    return NULL;
+}
+
+// Next occupied conn_id above `after` (-1 to start), or -1 when done
+int conn_table_next(const conn_table_t *table, int after) {
+    if (table == NULL || after >= CONN_TABLE_SLOTS - 1) return -1;
+
+    uint32_t remaining = atomic_load_explicit(&table->occupied, memory_order_acquire);
+    if (after >= 0) {
+        remaining &= ~((2u << after) - 1u);
+    }
+    return remaining ? __builtin_ctz(remaining) : -1;
+}
+
+static uint8_t *put_u16_le(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32_le(uint8_t *p, uint32_t value) {
+    p = put_u16_le(p, (uint16_t)value);
+    return put_u16_le(p, (uint16_t)(value >> 16));
+}
+
+// Blob layout, little-endian:
+//   0  version, connection count N, entry length, reserved (u8 each)
+//   4  N entries: conn_id, requested profile (u8 each), interval (1.25 ms),
+//      latency, timeout (10 ms), parameter updates, refused requests (u16
+//      each), ms since the last activity (u32)
+size_t conn_table_encode_links(const conn_table_t *table, uint32_t now_ms, uint8_t *buf, size_t buf_len) {
+    if (table == NULL || buf == NULL || buf_len < 4 + (size_t)CONN_LINKS_ENTRY_LEN * table->count) return 0;
+
+    uint8_t *p = buf;
+    *p++ = CONN_LINKS_VERSION;
+    *p++ = table->count;
+    *p++ = CONN_LINKS_ENTRY_LEN;
+    *p++ = 0;
+
+    const ble_conn_info_t *conn;
+    CONN_TABLE_FOREACH(table, conn) {
+        const conn_policy_t *policy = &conn->policy;
+        uint32_t quiet = now_ms - policy->last_activity_ms;
+
+        *p++ = (uint8_t)conn->conn_id;
+        *p++ = (uint8_t)policy->requested;
+        p = put_u16_le(p, policy->interval);
+        p = put_u16_le(p, policy->latency);
+        p = put_u16_le(p, policy->timeout);
+        p = put_u16_le(p, policy->updates);
+        p = put_u16_le(p, policy->rejects);
+        p = put_u32_le(p, quiet);
+    }
+
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,71 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "notify_queue.h"
+#include "conn_policy.h"
+#include "tank_command.h"
+
+#define MAX_CONNECTIONS         7       // Simultaneous clients (controller and host limits in sdkconfig.defaults match)
+#define BLE_DEFAULT_MTU         23
+#define CONN_TABLE_SLOTS        16      // conn_id range the table can index
+
+// Link parameter diagnostics (see conn_table_encode_links)
+#define CONN_LINKS_VERSION      1
+#define CONN_LINKS_ENTRY_LEN    16
+#define CONN_LINKS_MAX_LEN      (4 + CONN_LINKS_ENTRY_LEN * MAX_CONNECTIONS)
+
+// Connection info
+typedef struct {
+    uint16_t conn_id;
+    uint8_t remote_bda[6];
+    bool is_connected;
+    bool notifications_enabled;
+    bool is_encrypted;  // Track if connection is encrypted/authenticated
+    bool is_authenticated; // Application-level PIN authentication state
+    uint16_t mtu;           // Negotiated ATT MTU
+    uint8_t data_format;    // Tank data wire format (TANK_PAYLOAD_V1/V2)
+    bool history_pending;   // Backfill in progress on the history characteristic
+    uint32_t history_cursor; // Next history sequence number to send
+    int64_t history_start_us; // Backfill request time, for the throughput log
+    uint32_t history_bytes; // Backfill payload sent so far
+    notify_queue_t queue;   // Latest tank data value awaiting send, plus counters
+    uint8_t command_result[TANK_COMMAND_RESULT_MAX]; // Last command batch outcome (readable)
+    uint16_t command_result_len;
+    bool command_pending;   // Result not yet indicated
+    conn_policy_t policy;   // Connection parameter profile and current values
+} ble_conn_info_t;
+
+// Connections live in the slot named by their conn_id (Bluedroid's link
+// index or NimBLE's connection handle, both small), so lookup is a bounds check and fan-out walks the
+// occupancy bitmap. Slots are never moved: a disconnect clears the bit and
+// leaves the slot alone, so a task walking the table at that moment reads
+// stale but intact data rather than a shifted neighbour. Only the BT task
+// adds and removes; a new slot is filled before its bit is published with
+// release ordering, and iterators load the bitmap with acquire ordering, so
+// other tasks never see a half-initialised connection.
+typedef struct {
+    ble_conn_info_t slots[CONN_TABLE_SLOTS];
+    atomic_uint occupied;   // Bit per conn_id
+    uint8_t count;
+} conn_table_t;
+
+// Function prototypes
+void conn_table_init(conn_table_t *table);
+ble_conn_info_t *conn_table_add(conn_table_t *table, uint16_t conn_id, const uint8_t bda[6]);
+bool conn_table_remove(conn_table_t *table, uint16_t conn_id);
+ble_conn_info_t *conn_table_get(conn_table_t *table, uint16_t conn_id);
+ble_conn_info_t *conn_table_find_bda(conn_table_t *table, const uint8_t bda[6]);
+int conn_table_next(const conn_table_t *table, int after);
+size_t conn_table_encode_links(const conn_table_t *table, uint32_t now_ms, uint8_t *buf, size_t buf_len);
+
+// Visit every connection: CONN_TABLE_FOREACH(&table, conn) { ... }
+#define CONN_TABLE_FOREACH(table, conn) \
+    for (int _slot = conn_table_next((table), -1); \
+         _slot >= 0 && ((conn) = &(table)->slots[_slot], 1); \
+         _slot = conn_table_next((table), _slot))
+
+#endif // CONN_TABLE_H
@@ -0,0 +1,97 @@
+#include "console.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "CONSOLE";
+
+#define CONSOLE_UART_NUM        CONFIG_ESP_CONSOLE_UART_NUM
+#define CONSOLE_RX_BUFFER       256
+
+typedef struct {
+    const char *name;
+    const char *help;
+    console_cmd_fn_t fn;
+} console_cmd_t;
+
+static console_cmd_t commands[CONSOLE_MAX_COMMANDS];
+static int command_count = 0;
+
+bool console_register(const char *name, const char *help, console_cmd_fn_t fn) {
+    if (name == NULL || fn == NULL || command_count >= CONSOLE_MAX_COMMANDS) {
+        return false;
+    }
+
+    commands[command_count++] = (console_cmd_t){ .name = name, .help = help, .fn = fn };
+    return true;
+}
+
+static void console_help(const char *args) {
+    for (int i = 0; i < command_count; i++) {
+        ESP_LOGI(TAG, "%-10s %s", commands[i].name, commands[i].help ? commands[i].help : "");
+    }
+}
+
+static void console_dispatch(char *line) {
+    // Split "name args..." at the first space
+    char *args = strchr(line, ' ');
+    if (args) {
+        *args++ = '\0';
+        args += strspn(args, " ");
+    } else {
+        args = line + strlen(line);
+    }
+
+    if (*line == '\0') return;
+
+    for (int i = 0; i < command_count; i++) {
+        if (strcmp(line, commands[i].name) == 0) {
+            commands[i].fn(args);
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "Unknown command '%s' - try 'help'", line);
+}
+
+static void console_task(void *pvParameters) {
+    char line[CONSOLE_LINE_MAX];
+    size_t len = 0;
+    uint8_t c;
+
+    while (1) {
+        // Blocks (and lets the chip sleep) until a byte arrives
+        if (uart_read_bytes(CONSOLE_UART_NUM, &c, 1, portMAX_DELAY) != 1) {
+            continue;
+        }
+
+        if (c == '\r' || c == '\n') {
+            line[len] = '\0';
+            console_dispatch(line);
+            len = 0;
+        } else if (len < sizeof(line) - 1) {
+            line[len++] = (char)c;
+        }
+    }
+}
+
+void console_start(void) {
+    console_register("help", "List commands", console_help);
+
+    esp_err_t err = uart_driver_install(CONSOLE_UART_NUM, CONSOLE_RX_BUFFER, 0, 0, NULL, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install UART driver: %s", esp_err_to_name(err));
+        return;
+    }
+
+    // Wake from light sleep on RX; the bytes that trigger the wakeup are
+    // lost, so a command typed into a sleeping device may need a retry
+    uart_set_wakeup_threshold(CONSOLE_UART_NUM, 3);
+    esp_sleep_enable_uart_wakeup(CONSOLE_UART_NUM);
+
+    xTaskCreate(console_task, "console", 3072, NULL, 2, NULL);
+    ESP_LOGI(TAG, "Serial console ready - type 'help'");
+}
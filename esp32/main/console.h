@@ -0,0 +1,17 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdbool.h>
+
+// Line-oriented serial console on the ESP-IDF console UART. Type a command
+// name (optionally followed by arguments) and press enter; "help" lists them.
+#define CONSOLE_LINE_MAX        64
+#define CONSOLE_MAX_COMMANDS    12
+
+typedef void (*console_cmd_fn_t)(const char *args);
+
+// Function prototypes
+bool console_register(const char *name, const char *help, console_cmd_fn_t fn);
+void console_start(void);
+
+#endif // CONSOLE_H
@@ -0,0 +1,141 @@
+#include "diagnostics.h"
+#include "config.h"
+#include "console.h"
+#include "tank_monitor.h"
+#include "trace.h"
+#include "binlog.h"
+#include "ble_gatt.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char *TAG = "DIAG";
+
+static TaskHandle_t task_handles[METRIC_TASK_COUNT];
+
+void diagnostics_register_task(metric_task_t task, TaskHandle_t handle) {
+    if (task < METRIC_TASK_COUNT) {
+        task_handles[task] = handle;
+    }
+}
+
+void diagnostics_collect(metrics_report_t *report) {
+    if (report == NULL) return;
+
+    uint64_t uptime_us = esp_timer_get_time();
+
+    report->uptime_s = (uint32_t)(uptime_us / 1000000);
+    report->free_heap = esp_get_free_heap_size();
+    report->min_free_heap = esp_get_minimum_free_heap_size();
+    metrics_read_counters(report->counters);
+    report->nvs_commits = tank_config_flash_writes();
+
+    for (int i = 0; i < METRIC_TASK_COUNT; i++) {
+        metrics_task_t *task = &report->tasks[i];
+        task->cpu_permille = 0;
+        task->stack_free_bytes = 0;
+
+        if (task_handles[i] == NULL) continue;
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        // Run-time counter ticks in esp_timer microseconds, 64-bit so it
+        // spans the whole uptime
+        uint64_t runtime_us = ulTaskGetRunTimeCounter(task_handles[i]);
+        task->cpu_permille = uptime_us ? (uint16_t)(runtime_us * 1000 / uptime_us) : 0;
+#endif
+        task->stack_free_bytes = (uint16_t)uxTaskGetStackHighWaterMark(task_handles[i]);
+    }
+}
+
+void diagnostics_log(void) {
+    metrics_report_t report;
+    diagnostics_collect(&report);
+
+    ESP_LOGI(TAG, "Uptime %lu s, heap %lu free (%lu minimum), %lu NVS commits",
+             (unsigned long)report.uptime_s, (unsigned long)report.free_heap,
+             (unsigned long)report.min_free_heap, (unsigned long)report.nvs_commits);
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        ESP_LOGI(TAG, "  %-15s %lu", metrics_name(i), (unsigned long)report.counters[i]);
+    }
+    for (int i = 0; i < METRIC_TASK_COUNT; i++) {
+        ESP_LOGI(TAG, "  %-12s CPU %u.%u%%, %u bytes stack free", metrics_task_name(i),
+                 report.tasks[i].cpu_permille / 10, report.tasks[i].cpu_permille % 10,
+                 report.tasks[i].stack_free_bytes);
+    }
+}
+
+static void diagnostics_cmd_metrics(const char *args) {
+    diagnostics_log();
+}
+
+static void diagnostics_cmd_sensors(const char *args) {
+    // Reads the monitor's statistics without locking; fine for a snapshot on the console
+    tank_monitor_log_sensor_stats();
+}
+
+static void diagnostics_cmd_sampling(const char *args) {
+    sample_sched_t sched;
+    tank_monitor_get_sample_stats(&sched);
+
+    if (sched.period_us) {
+        ESP_LOGI(TAG, "Polled every %lu us: spacing %lu min, %lu max, %lu mean",
+                 (unsigned long)sched.period_us, (unsigned long)sched.period_min_us,
+                 (unsigned long)sched.period_max_us, (unsigned long)sample_sched_period_avg_us(&sched));
+    } else {
+        ESP_LOGI(TAG, "Edge capture: debounce and stability deadline wakes");
+    }
+    ESP_LOGI(TAG, "%lu wakes, %lu missed, late p50 %lu us, p95 %lu us, p99 %lu us, max %lu us",
+             (unsigned long)sched.wakes, (unsigned long)sched.missed,
+             (unsigned long)sample_sched_late_percentile_us(&sched, 50),
+             (unsigned long)sample_sched_late_percentile_us(&sched, 95),
+             (unsigned long)sample_sched_late_percentile_us(&sched, 99),
+             (unsigned long)sched.late_max_us);
+}
+
+static void diagnostics_cmd_trace(const char *args) {
+    if (strcmp(args, "clear") == 0) {
+        trace_clear();
+        ESP_LOGI(TAG, "Trace ring cleared");
+        return;
+    }
+    trace_dump();
+}
+
+static void diagnostics_cmd_log(const char *args) {
+    if (strcmp(args, "verbose") == 0) {
+        binlog_set_verbose(true);
+    } else if (strcmp(args, "binary") == 0) {
+        binlog_set_verbose(false);
+    } else if (strcmp(args, "clear") == 0) {
+        binlog_clear();
+    } else if (strcmp(args, "dump") == 0) {
+        binlog_dump();
+        return;
+    }
+    ESP_LOGI(TAG, "Log mode %s", binlog_is_verbose() ? "verbose" : "binary");
+}
+
+static void diagnostics_cmd_ble(const char *args) {
+    ble_gatt_log_connections();
+}
+
+static void diagnostics_cmd_adv(const char *args) {
+    ble_gatt_log_advertising();
+}
+
+static void diagnostics_cmd_stack(const char *args) {
+    ble_gatt_log_stack();
+}
+
+void diagnostics_init(void) {
+    console_register("metrics", "Task CPU/stack, heap and event counters", diagnostics_cmd_metrics);
+    console_register("sensors", "Per-sensor transition statistics", diagnostics_cmd_sensors);
+    console_register("sampling", "Monitor wakeup period, lateness percentiles and missed deadlines", diagnostics_cmd_sampling);
+    console_register("ble", "Per-connection notification counters", diagnostics_cmd_ble);
+    console_register("adv", "Advertising tier, time per tier and reconnect latency", diagnostics_cmd_adv);
+    console_register("stack", "Bluetooth host stack, heap used by init and time to first advertisement", diagnostics_cmd_stack);
+    console_register("log", "Log mode: 'log verbose', 'log binary', 'log dump', 'log clear'", diagnostics_cmd_log);
+    console_register("trace", "Dump the trace ring ('trace clear' empties it)", diagnostics_cmd_trace);
+}
@@ -0,0 +1,17 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "metrics.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Gathers runtime metrics (task CPU and stack, heap, event counters) for the
+// metrics characteristic and the "metrics" console command
+
+// Function prototypes
+void diagnostics_init(void);
+void diagnostics_register_task(metric_task_t task, TaskHandle_t handle);
+void diagnostics_collect(metrics_report_t *report);
+void diagnostics_log(void);
+
+#endif // DIAGNOSTICS_H
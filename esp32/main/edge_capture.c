@@ -0,0 +1,100 @@
+#include "edge_capture.h"
+#include <string.h>
+
+void edge_ring_init(edge_ring_t *ring) {
+    if (ring == NULL) return;
+
+    memset(ring->events, 0, sizeof(ring->events));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+}
+
+bool edge_ring_push(edge_ring_t *ring, const sensor_edge_t *edge) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= EDGE_RING_SIZE) {
+        // Full - keep the older edges, the debouncer re-reads state on settle anyway
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring->events[head & (EDGE_RING_SIZE - 1)] = *edge;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool edge_ring_pop(edge_ring_t *ring, sensor_edge_t *edge) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail == head) {
+        return false;
+    }
+
+    *edge = ring->events[tail & (EDGE_RING_SIZE - 1)];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+uint32_t edge_ring_dropped(edge_ring_t *ring) {
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
+
+void edge_debouncer_init(edge_debouncer_t *deb, uint8_t initial_mask, uint32_t debounce_us) {
+    if (deb == NULL) return;
+
+    memset(deb, 0, sizeof(edge_debouncer_t));
+    deb->stable_mask = initial_mask;
+    deb->pending_mask = initial_mask;
+    deb->debounce_us = debounce_us;
+}
+
+void edge_debouncer_feed(edge_debouncer_t *deb, const sensor_edge_t *edge) {
+    if (edge->sensor >= SENSOR_COUNT) return;
+
+    uint8_t bit = (uint8_t)(1u << edge->sensor);
+    if (edge->level) {
+        deb->pending_mask |= bit;
+    } else {
+        deb->pending_mask &= (uint8_t)~bit;
+    }
+
+    // Every edge restarts this sensor's quiet window
+    deb->dirty_mask |= bit;
+    deb->last_edge_us[edge->sensor] = edge->timestamp_us;
+}
+
+bool edge_debouncer_settle(edge_debouncer_t *deb, uint32_t now_us) {
+    uint8_t previous = deb->stable_mask;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        uint8_t bit = (uint8_t)(1u << i);
+        if (!(deb->dirty_mask & bit)) continue;
+
+        // Unsigned subtraction handles 32-bit microsecond wrap-around
+        if (now_us - deb->last_edge_us[i] >= deb->debounce_us) {
+            deb->stable_mask = (uint8_t)((deb->stable_mask & ~bit) | (deb->pending_mask & bit));
+            deb->dirty_mask &= (uint8_t)~bit;
+        }
+    }
+
+    return deb->stable_mask != previous;
+}
+
+uint32_t edge_debouncer_time_to_settle_us(const edge_debouncer_t *deb, uint32_t now_us) {
+    uint32_t earliest = UINT32_MAX;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        if (!(deb->dirty_mask & (1u << i))) continue;
+
+        uint32_t elapsed = now_us - deb->last_edge_us[i];
+        uint32_t remaining = elapsed >= deb->debounce_us ? 0 : deb->debounce_us - elapsed;
+        if (remaining < earliest) {
+            earliest = remaining;
+        }
+    }
+
+    return earliest;
+}
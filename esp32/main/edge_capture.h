@@ -0,0 +1,49 @@
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "sensor_filter.h"
+
+// Ring capacity (must be a power of two)
+#define EDGE_RING_SIZE      64
+
+// One captured edge. Level is logical (1 = triggered), not the raw pin level.
+typedef struct {
+    uint32_t timestamp_us;
+    uint8_t sensor;
+    uint8_t level;
+} sensor_edge_t;
+
+// Single-producer (GPIO ISR) / single-consumer (monitor task) lock-free ring
+typedef struct {
+    sensor_edge_t events[EDGE_RING_SIZE];
+    atomic_uint head;       // Next slot to write, owned by the producer
+    atomic_uint tail;       // Next slot to read, owned by the consumer
+    atomic_uint dropped;    // Edges lost because the ring was full
+} edge_ring_t;
+
+// Per-sensor debouncer fed from the ring. A sensor's state is only accepted
+// once it has been quiet (no further edges) for debounce_us.
+typedef struct {
+    uint8_t stable_mask;    // Debounced states, bit per sensor
+    uint8_t pending_mask;   // Most recent level seen per sensor
+    uint8_t dirty_mask;     // Sensors with edges not yet settled
+    uint32_t last_edge_us[SENSOR_COUNT];
+    uint32_t debounce_us;
+} edge_debouncer_t;
+
+// Ring functions
+void edge_ring_init(edge_ring_t *ring);
+bool edge_ring_push(edge_ring_t *ring, const sensor_edge_t *edge);
+bool edge_ring_pop(edge_ring_t *ring, sensor_edge_t *edge);
+uint32_t edge_ring_dropped(edge_ring_t *ring);
+
+// Debouncer functions
+void edge_debouncer_init(edge_debouncer_t *deb, uint8_t initial_mask, uint32_t debounce_us);
+void edge_debouncer_feed(edge_debouncer_t *deb, const sensor_edge_t *edge);
+bool edge_debouncer_settle(edge_debouncer_t *deb, uint32_t now_us);
+uint32_t edge_debouncer_time_to_settle_us(const edge_debouncer_t *deb, uint32_t now_us);
+
+#endif // EDGE_CAPTURE_H
@@ -0,0 +1,56 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Thin hardware abstraction for the monitor core. hal_esp32.c implements it
+// on ESP-IDF; host/hal_host.c implements it natively with a virtual clock,
+// simulated GPIO and in-memory storage so the core builds on a workstation.
+
+#ifdef HAL_HOST
+#include <stdatomic.h>
+typedef struct { atomic_flag flag; } hal_lock_t;
+#define HAL_LOCK_INITIALIZER { ATOMIC_FLAG_INIT }
+#else
+#include "freertos/FreeRTOS.h"
+typedef portMUX_TYPE hal_lock_t;
+#define HAL_LOCK_INITIALIZER portMUX_INITIALIZER_UNLOCKED
+#endif
+
+typedef void *hal_task_t;
+typedef void (*hal_task_fn_t)(void *arg);
+
+#define HAL_WAIT_FOREVER    UINT32_MAX
+
+// Clock
+uint64_t hal_time_us(void);
+uint32_t hal_time_ms(void);
+
+// Delay and task signalling
+void hal_delay_ms(uint32_t ms);
+bool hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size, unsigned priority, hal_task_t *handle);
+hal_task_t hal_task_current(void);
+const char *hal_task_name(hal_task_t task);
+void hal_task_notify(hal_task_t task);
+bool hal_task_wait(uint32_t timeout_ms);  // True if notified before the timeout
+
+// Critical sections (short copies only)
+void hal_lock(hal_lock_t *lock);
+void hal_unlock(hal_lock_t *lock);
+
+// GPIO
+void hal_gpio_config_input(uint64_t pin_mask, bool pull_up);
+void hal_gpio_config_output(uint64_t pin_mask);
+int hal_gpio_get(int pin);
+void hal_gpio_set(int pin, int level);
+uint64_t hal_gpio_read_inputs(void);  // All pin levels (bit per GPIO) from one instant
+
+// Key-value storage
+bool hal_kv_init(void);
+bool hal_kv_get_blob(const char *ns, const char *key, void *buf, size_t *len);
+bool hal_kv_set_blob(const char *ns, const char *key, const void *buf, size_t len);
+bool hal_kv_erase(const char *ns, const char *key);
+
+#endif // HAL_H
@@ -0,0 +1,168 @@
+#include "hal.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+
+static const char *TAG = "HAL";
+
+uint64_t hal_time_us(void) {
+    return (uint64_t)esp_timer_get_time();
+}
+
+uint32_t hal_time_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void hal_delay_ms(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+bool hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack_size, unsigned priority, hal_task_t *handle) {
+    TaskHandle_t task = NULL;
+    if (xTaskCreate(fn, name, stack_size, NULL, priority, &task) != pdPASS) {
+        return false;
+    }
+    if (handle) {
+        *handle = task;
+    }
+    return true;
+}
+
+hal_task_t hal_task_current(void) {
+    return xTaskGetCurrentTaskHandle();
+}
+
+const char *hal_task_name(hal_task_t task) {
+    return task ? pcTaskGetName((TaskHandle_t)task) : NULL;
+}
+
+void hal_task_notify(hal_task_t task) {
+    if (task) {
+        xTaskNotifyGive((TaskHandle_t)task);
+    }
+}
+
+bool hal_task_wait(uint32_t timeout_ms) {
+    // Round up to whole ticks: pdMS_TO_TICKS truncates, which would end a
+    // deadline wait early and leave the caller spinning until it arrives
+    TickType_t ticks = timeout_ms == HAL_WAIT_FOREVER ? portMAX_DELAY
+                     : (TickType_t)(((uint64_t)timeout_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+    return ulTaskNotifyTake(pdTRUE, ticks) > 0;
+}
+
+void hal_lock(hal_lock_t *lock) {
+    portENTER_CRITICAL(lock);
+}
+
+void hal_unlock(hal_lock_t *lock) {
+    portEXIT_CRITICAL(lock);
+}
+
+void hal_gpio_config_input(uint64_t pin_mask, bool pull_up) {
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = pin_mask,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = pull_up ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+    };
+    gpio_config(&io_conf);
+}
+
+void hal_gpio_config_output(uint64_t pin_mask) {
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+        .pin_bit_mask = pin_mask,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+    };
+    gpio_config(&io_conf);
+}
+
+int hal_gpio_get(int pin) {
+    return gpio_get_level((gpio_num_t)pin);
+}
+
+void hal_gpio_set(int pin, int level) {
+    gpio_set_level((gpio_num_t)pin, level);
+}
+
+uint64_t hal_gpio_read_inputs(void) {
+    uint32_t in_lo, in_hi;
+
+    // Pins span GPIO_IN (0-31) and GPIO_IN1 (32-39). Sample both back to
+    // back and retry if the low word moved under the high read, so the
+    // result describes a single instant.
+    for (int attempt = 0; attempt < 3; attempt++) {
+        in_lo = REG_READ(GPIO_IN_REG);
+        in_hi = REG_READ(GPIO_IN1_REG);
+        if (REG_READ(GPIO_IN_REG) == in_lo) {
+            break;
+        }
+    }
+
+    return ((uint64_t)in_hi << 32) | in_lo;
+}
+
+bool hal_kv_init(void) {
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    return ret == ESP_OK;
+}
+
+bool hal_kv_get_blob(const char *ns, const char *key, void *buf, size_t *len) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(ns, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+
+    esp_err_t err = nvs_get_blob(nvs_handle, key, buf, len);
+    nvs_close(nvs_handle);
+    return err == ESP_OK;
+}
+
+bool hal_kv_set_blob(const char *ns, const char *key, const void *buf, size_t len) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(ns, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS namespace %s: %s", ns, esp_err_to_name(err));
+        return false;
+    }
+
+    err = nvs_set_blob(nvs_handle, key, buf, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write NVS key %s: %s", key, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+bool hal_kv_erase(const char *ns, const char *key) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(ns, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+
+    esp_err_t err = nvs_erase_key(nvs_handle, key);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err == ESP_OK;
+}
@@ -14,26 +14,58 @@
 #include "config.h"
 #include "tank_monitor.h"
 #include "ble_gatt.h"
+#include "power.h"
+#include "diagnostics.h"
+#include "console.h"
+#include "trace.h"
 
 #define MAIN_TAG "MAIN"
 
-// BLE notification task
+// BLE notification task - woken by the tank monitor on state changes
 void ble_notification_task(void *pvParameters) {
     ESP_LOGI(MAIN_TAG, "BLE notification task started");
     
+    tank_monitor_set_listener(xTaskGetCurrentTaskHandle());
+    ble_gatt_set_notify_task(xTaskGetCurrentTaskHandle());
+    TickType_t last_sent = xTaskGetTickCount();
+    bool backlog_pending = false;
+    
     while (1) {
-        // Send tank data via BLE if connected
-        if (ble_is_connected()) {
-            ble_update_tank_data(g_tank_data.grey_level, g_tank_data.black_level,
-                               g_tank_data.grey_enabled, g_tank_data.black_enabled);
+        // Sleep until a change, backfill request or un-congested link is
+        // signalled or the heartbeat is due; while a backfill is streaming or a
+        // send is being retried, only yield for a tick
+        TickType_t elapsed = xTaskGetTickCount() - last_sent;
+        TickType_t heartbeat = pdMS_TO_TICKS(BLE_HEARTBEAT_INTERVAL_MS);
+        TickType_t wait = elapsed >= heartbeat ? 0 : heartbeat - elapsed;
+        bool changed = ulTaskNotifyTake(pdTRUE, backlog_pending ? 1 : wait) > 0;
+        TRACE_INSTANT(TRACE_NOTIFY_WAKE, changed);
+        
+        bool heartbeat_due = xTaskGetTickCount() - last_sent >= heartbeat;
+        power_note_wakeup(changed ? WAKE_SRC_STATE_CHANGE :
+                          backlog_pending ? WAKE_SRC_BACKFILL : WAKE_SRC_HEARTBEAT);
+        
+        // Answer command batches first, then retry held-back tank data, then
+        // stream any history backfill, then catch up on advertising tiers and
+        // link parameters
+        backlog_pending = ble_gatt_send_command_results();
+        backlog_pending |= ble_gatt_flush_notifications();
+        backlog_pending |= ble_gatt_pump_history();
+        ble_gatt_update_advertising();
+        ble_gatt_update_link_policy();
+        
+        if (!changed && !heartbeat_due) {
+            continue;
         }
         
-        // Wait 1 second between updates
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        // Unchanged payloads are suppressed unless the heartbeat is due
+        if (ble_update_tank_data(heartbeat_due) || heartbeat_due) {
+            last_sent = xTaskGetTickCount();
+        }
     }
 }
 
-// PIN reset task - monitors BOOT button for 10 second hold
+// PIN reset task - monitors BOOT button for 10 second hold. Blocks on the
+// button interrupt and only polls while the button is held.
 void pin_reset_task(void *pvParameters) {
     ESP_LOGI(MAIN_TAG, "PIN reset monitoring task started");
     
@@ -43,17 +75,18 @@ void pin_reset_task(void *pvParameters) {
     uint32_t last_blink_time = 0;
     bool led_blink_state = true;
     
+    sensor_boot_button_wait_start(xTaskGetCurrentTaskHandle());
+    
     while (1) {
+        if (!button_pressed) {
+            // Sleep until the button interrupt fires
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            power_note_wakeup(WAKE_SRC_BUTTON);
+        }
+        
         bool current_state = sensor_is_boot_button_pressed();
         uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
         
-        // Debug: Print button state occasionally
-        static uint32_t last_debug_time = 0;
-        if (current_time - last_debug_time >= 5000) { // Every 5 seconds
-            ESP_LOGI(MAIN_TAG, "BOOT button state: %d", current_state ? 1 : 0);
-            last_debug_time = current_time;
-        }
-        
         if (current_state && !button_pressed) {
             // Button just pressed
             button_pressed = true;
@@ -79,19 +112,8 @@ void pin_reset_task(void *pvParameters) {
                 sensor_set_power_led(false);
                 ESP_LOGW(MAIN_TAG, "BOOT button held for 10s - resetting PIN to default");
                 
-                tank_config_t config;
-                if (tank_config_load(&config)) {
-                    strcpy(config.pin, "000000");
-                    config.pin_set = true;
-                    
-                    if (tank_config_save(&config)) {
-                        ESP_LOGI(MAIN_TAG, "PIN successfully reset to default (000000)");
-                    } else {
-                        ESP_LOGE(MAIN_TAG, "Failed to save reset PIN");
-                    }
-                } else {
-                    ESP_LOGE(MAIN_TAG, "Failed to load config for PIN reset");
-                }
+                tank_config_set_pin((const uint8_t *)"000000");
+                ESP_LOGI(MAIN_TAG, "PIN successfully reset to default (000000)");
                 
                 // Turn power LED back on to indicate reset complete
                 sensor_set_power_led(true);
@@ -119,8 +141,15 @@ void pin_reset_task(void *pvParameters) {
             }
         }
         
-        // Check every 50ms for responsive button and LED control
+        if (!button_pressed) {
+            // Released (or a glitch) - wait for the next press
+            sensor_boot_button_rearm();
+            continue;
+        }
+        
+        // Check every 50ms while held for responsive button and LED control
         vTaskDelay(pdMS_TO_TICKS(50));
+        power_note_wakeup(WAKE_SRC_BUTTON_POLL);
     }
 }
 
@@ -130,43 +159,45 @@ void app_main(void) {
     // Initialize NVS
     tank_config_init_nvs();
     
-    // Load configuration
+    // Load configuration into the RAM cache and start the write-behind task
+    tank_config_cache_init();
     tank_config_t config;
-    if (!tank_config_load(&config)) {
-        // No saved config, use defaults
-        tank_config_set_defaults(&config);
-        tank_config_save(&config);
-        ESP_LOGI(MAIN_TAG, "Created default config with PIN: %s", config.pin);
-    } else {
-        // Check if PIN is set
-        if (strlen(config.pin) != 6) {
-            ESP_LOGW(MAIN_TAG, "Invalid PIN in config, resetting to default");
-            strcpy(config.pin, "000000");
-            config.pin_set = true;
-            tank_config_save(&config);
-        }
-        ESP_LOGI(MAIN_TAG, "Loaded config with PIN: %s", config.pin);
-    }
+    tank_config_get(&config);
+    ESP_LOGI(MAIN_TAG, "Loaded config with PIN: %s", config.pin);
     
-    // Initialize tank monitor with loaded config
+    // Initialize tank monitor with loaded config. Timing goes first: the
+    // boot settle window is the stored maximum.
+    tank_monitor_set_timing(&config.timing);
     tank_monitor_init();
-    g_tank_data.grey_enabled = config.grey_enabled;
-    g_tank_data.black_enabled = config.black_enabled;
+    tank_monitor_set_enabled(config.grey_enabled, config.black_enabled);
     
     // Initialize GPIO
     sensor_init_gpio();
     
+    // Enable automatic light sleep before the tasks start blocking
+    power_init();
+    
     // Initialize BLE
     ble_gatt_init();
     
     // Create tank monitoring task
-    xTaskCreate(tank_monitor_task, "tank_monitor", 4096, NULL, 5, NULL);
+    TaskHandle_t handle = NULL;
+    xTaskCreate(tank_monitor_task, "tank_monitor", 4096, NULL, 5, &handle);
+    diagnostics_register_task(METRIC_TASK_MONITOR, handle);
     
-    // Create BLE notification task
-    xTaskCreate(ble_notification_task, "ble_notify", 2048, NULL, 5, NULL);
+    // Create BLE notification task. It logs and calls into the BLE host
+    // stack for notifications, history, link parameters and advertising;
+    // check its headroom with the stack high-water mark in `metrics`.
+    xTaskCreate(ble_notification_task, "ble_notify", 4096, NULL, 5, &handle);
+    diagnostics_register_task(METRIC_TASK_NOTIFY, handle);
     
     // Create PIN reset monitoring task
-    xTaskCreate(pin_reset_task, "pin_reset", 2048, NULL, 3, NULL);
+    xTaskCreate(pin_reset_task, "pin_reset", 2048, NULL, 3, &handle);
+    diagnostics_register_task(METRIC_TASK_PIN_RESET, handle);
+    
+    // Serial console for runtime metrics
+    diagnostics_init();
+    console_start();
     
     ESP_LOGI(MAIN_TAG, "System initialized successfully");
     ESP_LOGI(MAIN_TAG, "Grey tank: %s, Black tank: %s",
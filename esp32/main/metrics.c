@@ -0,0 +1,87 @@
+#include "metrics.h"
+#include <stdatomic.h>
+
+static atomic_uint counters[METRIC_COUNT];
+
+static const char *metric_names[METRIC_COUNT] = {
+    [METRIC_NOTIFY_SENT] = "notify_sent",
+    [METRIC_NOTIFY_DROPPED] = "notify_dropped",
+    [METRIC_GATT_CONGEST] = "gatt_congest",
+    [METRIC_SENSOR_SAMPLES] = "sensor_samples",
+    [METRIC_LEVEL_CHANGES] = "level_changes",
+    [METRIC_NOTIFY_COALESCED] = "notify_coalesced",
+};
+
+static const char *task_names[METRIC_TASK_COUNT] = {
+    [METRIC_TASK_MONITOR] = "tank_monitor",
+    [METRIC_TASK_NOTIFY] = "ble_notify",
+    [METRIC_TASK_PIN_RESET] = "pin_reset",
+};
+
+void metrics_inc(metric_id_t id) {
+    if (id >= METRIC_COUNT) return;
+
+    atomic_fetch_add_explicit(&counters[id], 1, memory_order_relaxed);
+}
+
+uint32_t metrics_get(metric_id_t id) {
+    if (id >= METRIC_COUNT) return 0;
+
+    return atomic_load_explicit(&counters[id], memory_order_relaxed);
+}
+
+void metrics_read_counters(uint32_t values[METRIC_COUNT]) {
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        values[i] = atomic_load_explicit(&counters[i], memory_order_relaxed);
+    }
+}
+
+const char *metrics_name(metric_id_t id) {
+    return id < METRIC_COUNT ? metric_names[id] : "unknown";
+}
+
+const char *metrics_task_name(metric_task_t task) {
+    return task < METRIC_TASK_COUNT ? task_names[task] : "unknown";
+}
+
+static uint8_t *put_u16_le(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32_le(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+    return p + 4;
+}
+
+// Blob layout, little-endian:
+//   0  version, counter count N, task count T, reserved (u8 each)
+//   4  uptime s, free heap, minimum free heap (u32 each)
+//  16  N event counters (u32, metric_id_t order), then NVS commits (u32)
+//  20+4N  T tasks: CPU permille, free stack bytes (u16 each)
+size_t metrics_encode(const metrics_report_t *report, uint8_t *buf, size_t buf_len) {
+    if (report == NULL || buf == NULL || buf_len < METRICS_BLOB_LEN) return 0;
+
+    uint8_t *p = buf;
+    *p++ = METRICS_BLOB_VERSION;
+    *p++ = METRIC_COUNT;
+    *p++ = METRIC_TASK_COUNT;
+    *p++ = 0;
+    p = put_u32_le(p, report->uptime_s);
+    p = put_u32_le(p, report->free_heap);
+    p = put_u32_le(p, report->min_free_heap);
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        p = put_u32_le(p, report->counters[i]);
+    }
+    p = put_u32_le(p, report->nvs_commits);
+    for (int i = 0; i < METRIC_TASK_COUNT; i++) {
+        p = put_u16_le(p, report->tasks[i].cpu_permille);
+        p = put_u16_le(p, report->tasks[i].stack_free_bytes);
+    }
+
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,52 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Event counters bumped from hot paths (relaxed atomic increments)
+typedef enum {
+    METRIC_NOTIFY_SENT = 0,     // Notifications accepted by the BLE stack
+    METRIC_NOTIFY_DROPPED,      // Notifications the stack refused (retried)
+    METRIC_GATT_CONGEST,        // ESP_GATTS_CONGEST_EVT with congested set
+    METRIC_SENSOR_SAMPLES,      // Sensor masks evaluated by the monitor
+    METRIC_LEVEL_CHANGES,       // Tank level changes detected
+    METRIC_NOTIFY_COALESCED,    // Queued values replaced by a newer state before sending
+    METRIC_COUNT
+} metric_id_t;
+
+// Tasks reported individually, in blob order
+typedef enum {
+    METRIC_TASK_MONITOR = 0,    // tank_monitor
+    METRIC_TASK_NOTIFY,         // ble_notify
+    METRIC_TASK_PIN_RESET,      // pin_reset
+    METRIC_TASK_COUNT
+} metric_task_t;
+
+#define METRICS_BLOB_VERSION    1
+#define METRICS_BLOB_LEN        (20 + 4 * METRIC_COUNT + 4 * METRIC_TASK_COUNT)
+
+typedef struct {
+    uint16_t cpu_permille;      // Share of one core since boot
+    uint16_t stack_free_bytes;  // Stack high-water mark (least ever free)
+} metrics_task_t;
+
+// Everything the metrics characteristic and console report
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t counters[METRIC_COUNT];
+    uint32_t nvs_commits;
+    metrics_task_t tasks[METRIC_TASK_COUNT];
+} metrics_report_t;
+
+// Function prototypes
+void metrics_inc(metric_id_t id);
+uint32_t metrics_get(metric_id_t id);
+void metrics_read_counters(uint32_t counters[METRIC_COUNT]);
+const char *metrics_name(metric_id_t id);
+const char *metrics_task_name(metric_task_t task);
+size_t metrics_encode(const metrics_report_t *report, uint8_t *buf, size_t buf_len);
+
+#endif // METRICS_H
@@ -0,0 +1,57 @@
+#include "notify_queue.h"
+#include <string.h>
+
+void notify_queue_init(notify_queue_t *queue) {
+    if (queue == NULL) return;
+
+    memset(queue, 0, sizeof(*queue));
+}
+
+void notify_queue_put(notify_queue_t *queue, const uint8_t *data, uint16_t len, uint32_t now_us) {
+    if (queue == NULL || data == NULL || len > NOTIFY_QUEUE_MAX_LEN) return;
+
+    if (queue->pending) {
+        // Keep the original queue time so latency covers the whole wait
+        queue->coalesced++;
+    } else {
+        queue->queued_us = now_us;
+    }
+
+    memcpy(queue->data, data, len);
+    queue->len = len;
+    queue->pending = true;
+}
+
+bool notify_queue_ready(const notify_queue_t *queue) {
+    return queue && queue->pending && !queue->congested;
+}
+
+void notify_queue_sent(notify_queue_t *queue, uint32_t now_us) {
+    if (queue == NULL || !queue->pending) return;
+
+    uint32_t latency = now_us - queue->queued_us;
+    if (latency > queue->latency_max_us) {
+        queue->latency_max_us = latency;
+    }
+    queue->latency_total_us += latency;
+    queue->sent++;
+    queue->pending = false;
+}
+
+void notify_queue_send_failed(notify_queue_t *queue) {
+    if (queue == NULL) return;
+
+    queue->send_errors++;
+}
+
+void notify_queue_set_congested(notify_queue_t *queue, bool congested) {
+    if (queue == NULL) return;
+
+    queue->congested = congested;
+}
+
+uint32_t notify_queue_latency_avg_us(const notify_queue_t *queue) {
+    if (queue == NULL || queue->sent == 0) return 0;
+
+    return (uint32_t)(queue->latency_total_us / queue->sent);
+}
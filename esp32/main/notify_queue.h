@@ -0,0 +1,37 @@
+#ifndef NOTIFY_QUEUE_H
+#define NOTIFY_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tank_payload.h"
+
+// Per-connection outbound slot for tank data notifications. It holds one
+// value: a newer state replaces an unsent one, because clients only need the
+// latest state. Sending stops while the link is congested and resumes when it
+// clears. History chunks have their own resumable cursor and do not use this.
+#define NOTIFY_QUEUE_MAX_LEN    TANK_PAYLOAD_MAX_LEN
+
+typedef struct {
+    uint8_t data[NOTIFY_QUEUE_MAX_LEN];
+    uint16_t len;
+    bool pending;
+    bool congested;             // Stack reported ESP_GATTS_CONGEST_EVT
+    uint32_t queued_us;         // When the oldest unsent value was queued
+
+    uint32_t sent;
+    uint32_t coalesced;         // Values replaced before they were sent
+    uint32_t send_errors;       // Sends the stack refused (retried later)
+    uint32_t latency_max_us;    // Queue-to-send delay
+    uint64_t latency_total_us;
+} notify_queue_t;
+
+// Function prototypes
+void notify_queue_init(notify_queue_t *queue);
+void notify_queue_put(notify_queue_t *queue, const uint8_t *data, uint16_t len, uint32_t now_us);
+bool notify_queue_ready(const notify_queue_t *queue);
+void notify_queue_sent(notify_queue_t *queue, uint32_t now_us);
+void notify_queue_send_failed(notify_queue_t *queue);
+void notify_queue_set_congested(notify_queue_t *queue, bool congested);
+uint32_t notify_queue_latency_avg_us(const notify_queue_t *queue);
+
+#endif // NOTIFY_QUEUE_H
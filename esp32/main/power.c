@@ -0,0 +1,104 @@
+#include "power.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+
+static const char *TAG = "POWER";
+
+static wake_stats_t wake_stats;
+
+// Counters at the previous report, so each report covers one interval
+static uint32_t last_counts[WAKE_SRC_COUNT];
+static uint64_t last_report_us = 0;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+static configRUN_TIME_COUNTER_TYPE last_idle_time[portNUM_PROCESSORS];
+#endif
+
+static esp_timer_handle_t report_timer = NULL;
+
+static void power_report_timer_cb(void *arg) {
+    power_log_report();
+}
+
+void power_init(void) {
+    wake_stats_init(&wake_stats);
+    last_report_us = esp_timer_get_time();
+
+#if POWER_LIGHT_SLEEP_ENABLE
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = POWER_CPU_FREQ_MAX_MHZ,
+        .min_freq_mhz = POWER_CPU_FREQ_MIN_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure power management: %s", esp_err_to_name(err));
+    } else {
+        // Sensor and button pins are armed as level wakeups by sensor.c
+        esp_sleep_enable_gpio_wakeup();
+        ESP_LOGI(TAG, "Automatic light sleep enabled (%d-%d MHz)",
+                 POWER_CPU_FREQ_MIN_MHZ, POWER_CPU_FREQ_MAX_MHZ);
+    }
+#else
+    ESP_LOGW(TAG, "Light sleep requested but CONFIG_PM_ENABLE is not set");
+#endif
+#endif
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = power_report_timer_cb,
+        .name = "power_report",
+    };
+    if (esp_timer_create(&timer_args, &report_timer) == ESP_OK) {
+        esp_timer_start_periodic(report_timer, (uint64_t)POWER_REPORT_INTERVAL_MS * 1000);
+    }
+}
+
+void power_note_wakeup(wake_source_t source) {
+    wake_stats_note(&wake_stats, source);
+}
+
+void power_log_report(void) {
+    uint64_t now_us = esp_timer_get_time();
+    uint64_t elapsed_us = now_us - last_report_us;
+    uint32_t interval_total = 0;
+
+    ESP_LOGI(TAG, "Wakeups over the last %lu s:", (unsigned long)(elapsed_us / 1000000));
+    for (int i = 0; i < WAKE_SRC_COUNT; i++) {
+        uint32_t count = wake_stats_get(&wake_stats, (wake_source_t)i);
+        uint32_t delta = count - last_counts[i];
+        last_counts[i] = count;
+        interval_total += delta;
+
+        if (delta) {
+            ESP_LOGI(TAG, "  %-13s %6lu (%lu/h)", wake_source_name((wake_source_t)i),
+                     (unsigned long)delta, (unsigned long)wake_stats_per_hour(delta, elapsed_us));
+        }
+    }
+    ESP_LOGI(TAG, "  total         %6lu (%lu/h)", (unsigned long)interval_total,
+             (unsigned long)wake_stats_per_hour(interval_total, elapsed_us));
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // Idle task run time includes time spent in light sleep
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        configRUN_TIME_COUNTER_TYPE idle = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+        configRUN_TIME_COUNTER_TYPE idle_delta = idle - last_idle_time[core];
+        last_idle_time[core] = idle;
+
+        ESP_LOGI(TAG, "  core %d idle   %5.1f%%", core,
+                 elapsed_us ? 100.0 * (double)idle_delta / (double)elapsed_us : 0.0);
+    }
+#endif
+
+#if CONFIG_PM_PROFILING
+    // Time spent in each power mode, including light sleep
+    esp_pm_dump_locks(stdout);
+#endif
+
+    last_report_us = now_us;
+}
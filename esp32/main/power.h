@@ -0,0 +1,24 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include "wake_stats.h"
+
+// Low-power profile: automatic light sleep with tickless idle whenever every
+// task is blocked. Needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE
+// (see sdkconfig.defaults). Sensor and BOOT button pins wake the chip.
+#define POWER_LIGHT_SLEEP_ENABLE    1
+
+// Dynamic frequency scaling range while awake
+#define POWER_CPU_FREQ_MAX_MHZ      160
+#define POWER_CPU_FREQ_MIN_MHZ      40      // XTAL frequency, lowest setting with BLE active
+
+// Wakeup and idle-time report period
+#define POWER_REPORT_INTERVAL_MS    3600000 // 1 hour
+
+// Function prototypes
+void power_init(void);
+void power_note_wakeup(wake_source_t source);
+void power_log_report(void);
+
+#endif // POWER_H
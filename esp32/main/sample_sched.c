@@ -0,0 +1,152 @@
+#include "sample_sched.h"
+#include <string.h>
+
+// Upper bounds of the lateness bins; the last bin is open-ended
+static const uint32_t late_bin_edges_us[SAMPLE_SCHED_LATE_BINS - 1] = {
+    500, 1000, 2000, 5000, 10000, 15000, 20000, 50000, 100000, 200000, 500000,
+};
+
+void sample_sched_init(sample_sched_t *sched, uint32_t period_us, uint64_t now_us) {
+    if (sched == NULL) return;
+
+    memset(sched, 0, sizeof(*sched));
+    sched->period_us = period_us;
+    sched->next_us = now_us;
+}
+
+// Milliseconds until the next grid deadline, rounded up so a wait never ends
+// before it; 0 once due
+uint32_t sample_sched_wait_ms(const sample_sched_t *sched, uint64_t now_us) {
+    if (now_us >= sched->next_us) return 0;
+
+    uint64_t wait_ms = (sched->next_us - now_us + 999) / 1000;
+    return wait_ms > UINT32_MAX - 1 ? UINT32_MAX - 1 : (uint32_t)wait_ms;
+}
+
+static void sample_sched_note_late(sample_sched_t *sched, uint64_t late_us) {
+    uint32_t late = late_us > UINT32_MAX ? UINT32_MAX : (uint32_t)late_us;
+    int bin = 0;
+
+    while (bin < SAMPLE_SCHED_LATE_BINS - 1 && late > late_bin_edges_us[bin]) {
+        bin++;
+    }
+    sched->late_bins[bin]++;
+    if (late > sched->late_max_us) {
+        sched->late_max_us = late;
+    }
+    sched->wakes++;
+}
+
+// A polled sample starts at now_us: record how late it is and the spacing
+// from the previous one, then move to the next grid deadline. Returns the
+// number of deadlines skipped because the sample started after them.
+uint32_t sample_sched_start(sample_sched_t *sched, uint64_t now_us) {
+    sample_sched_note_late(sched, now_us > sched->next_us ? now_us - sched->next_us : 0);
+
+    if (sched->wakes > 1) {
+        uint64_t spacing = now_us - sched->last_start_us;
+        uint32_t spacing_us = spacing > UINT32_MAX ? UINT32_MAX : (uint32_t)spacing;
+        if (sched->wakes == 2 || spacing_us < sched->period_min_us) {
+            sched->period_min_us = spacing_us;
+        }
+        if (spacing_us > sched->period_max_us) {
+            sched->period_max_us = spacing_us;
+        }
+        sched->period_total_us += spacing_us;
+    }
+    sched->last_start_us = now_us;
+
+    if (sched->period_us == 0) {
+        sched->next_us = now_us;
+        return 0;
+    }
+
+    uint32_t skipped = 0;
+    sched->next_us += sched->period_us;
+    if (now_us >= sched->next_us) {
+        uint64_t behind = (now_us - sched->next_us) / sched->period_us + 1;
+        skipped = behind > UINT32_MAX ? UINT32_MAX : (uint32_t)behind;
+        sched->next_us += behind * sched->period_us;
+        sched->missed += skipped;
+    }
+    return skipped;
+}
+
+// Change the grid spacing. The next deadline moves to one new period after
+// the deadline the last sample served, so the change applies from now on.
+void sample_sched_set_period(sample_sched_t *sched, uint32_t period_us) {
+    if (sched->wakes > 0) {
+        sched->next_us = sched->next_us - sched->period_us + period_us;
+    }
+    sched->period_us = period_us;
+}
+
+// Edge-capture mode: a debounce or stability deadline was reached at now_us
+void sample_sched_note_deadline(sample_sched_t *sched, uint64_t deadline_us, uint64_t now_us) {
+    uint64_t late_us = now_us > deadline_us ? now_us - deadline_us : 0;
+
+    sample_sched_note_late(sched, late_us);
+    if (late_us > SAMPLE_SCHED_MISS_SLACK_US) {
+        sched->missed++;
+    }
+}
+
+uint32_t sample_sched_period_avg_us(const sample_sched_t *sched) {
+    return sched->wakes > 1 ? (uint32_t)(sched->period_total_us / (sched->wakes - 1)) : 0;
+}
+
+// Lateness at or below which percent of wakes fell, to bin resolution (the
+// bin's upper edge, or the worst seen for the open-ended bin)
+uint32_t sample_sched_late_percentile_us(const sample_sched_t *sched, unsigned percent) {
+    if (sched->wakes == 0) return 0;
+
+    uint64_t target = ((uint64_t)sched->wakes * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int bin = 0; bin < SAMPLE_SCHED_LATE_BINS - 1; bin++) {
+        seen += sched->late_bins[bin];
+        if (seen >= target && seen > 0) {
+            uint32_t edge = late_bin_edges_us[bin];
+            return edge < sched->late_max_us ? edge : sched->late_max_us;
+        }
+    }
+    return sched->late_max_us;
+}
+
+static uint8_t *put_u32_le(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+    return p + 4;
+}
+
+// Blob layout, little-endian:
+//   0  version, mode (0 polled, 1 edge capture), lateness bin count, reserved (u8 each)
+//   4  target period, wakes, missed deadlines (u32 each; period in us, 0 in edge mode)
+//  16  sample spacing min, max, mean in us (u32 each; 0 in edge mode)
+//  28  lateness p50, p95, p99 and max in us (u32 each)
+//  44  wakes per lateness bin (u32 each)
+size_t sample_sched_encode(const sample_sched_t *sched, uint8_t *buf, size_t buf_len) {
+    if (sched == NULL || buf == NULL || buf_len < SAMPLE_SCHED_STATS_LEN) return 0;
+
+    uint8_t *p = buf;
+    *p++ = SAMPLE_SCHED_STATS_VERSION;
+    *p++ = sched->period_us == 0;
+    *p++ = SAMPLE_SCHED_LATE_BINS;
+    *p++ = 0;
+    p = put_u32_le(p, sched->period_us);
+    p = put_u32_le(p, sched->wakes);
+    p = put_u32_le(p, sched->missed);
+    p = put_u32_le(p, sched->period_min_us);
+    p = put_u32_le(p, sched->period_max_us);
+    p = put_u32_le(p, sample_sched_period_avg_us(sched));
+    p = put_u32_le(p, sample_sched_late_percentile_us(sched, 50));
+    p = put_u32_le(p, sample_sched_late_percentile_us(sched, 95));
+    p = put_u32_le(p, sample_sched_late_percentile_us(sched, 99));
+    p = put_u32_le(p, sched->late_max_us);
+    for (int i = 0; i < SAMPLE_SCHED_LATE_BINS; i++) {
+        p = put_u32_le(p, sched->late_bins[i]);
+    }
+
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,46 @@
+#ifndef SAMPLE_SCHED_H
+#define SAMPLE_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Monitor wakeup scheduling and timing statistics. In polled mode deadlines
+// sit on a fixed grid (start + k * period), so time spent reading sensors or
+// logging never stretches the period. A sample that starts after the
+// following deadline has passed skips ahead to the next grid point, and the
+// skipped deadlines count as missed. In edge-capture mode there is no grid:
+// each debounce or stability deadline is noted as it is reached, and one
+// reached more than SAMPLE_SCHED_MISS_SLACK_US late counts as missed.
+#define SAMPLE_SCHED_MISS_SLACK_US  20000   // Two FreeRTOS ticks at 100 Hz
+#define SAMPLE_SCHED_LATE_BINS      12
+
+// Diagnostics blob (see sample_sched_encode)
+#define SAMPLE_SCHED_STATS_VERSION  1
+#define SAMPLE_SCHED_STATS_LEN      (44 + 4 * SAMPLE_SCHED_LATE_BINS)
+
+typedef struct {
+    uint32_t period_us;         // Grid spacing, 0 in edge-capture mode
+    uint64_t next_us;           // Next grid deadline
+    uint64_t last_start_us;     // When the previous sample started
+
+    uint32_t wakes;             // Deadlines reached (samples in polled mode)
+    uint32_t missed;
+    uint32_t period_min_us;     // Actual sample-to-sample spacing
+    uint32_t period_max_us;
+    uint64_t period_total_us;
+    uint32_t late_max_us;       // Wake time past the deadline
+    uint32_t late_bins[SAMPLE_SCHED_LATE_BINS];
+} sample_sched_t;
+
+// Function prototypes
+void sample_sched_init(sample_sched_t *sched, uint32_t period_us, uint64_t now_us);
+uint32_t sample_sched_wait_ms(const sample_sched_t *sched, uint64_t now_us);
+uint32_t sample_sched_start(sample_sched_t *sched, uint64_t now_us);
+void sample_sched_set_period(sample_sched_t *sched, uint32_t period_us);
+void sample_sched_note_deadline(sample_sched_t *sched, uint64_t deadline_us, uint64_t now_us);
+uint32_t sample_sched_period_avg_us(const sample_sched_t *sched);
+uint32_t sample_sched_late_percentile_us(const sample_sched_t *sched, unsigned percent);
+size_t sample_sched_encode(const sample_sched_t *sched, uint8_t *buf, size_t buf_len);
+
+#endif // SAMPLE_SCHED_H
@@ -3,34 +3,43 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "driver/gpio.h"
+#include "hal.h"
+#include "sensor_filter.h"
+#include "edge_capture.h"
 
 // GPIO Pin definitions
-#define GREY_1_3_PIN    GPIO_NUM_32
-#define GREY_2_3_PIN    GPIO_NUM_33
-#define GREY_FULL_PIN   GPIO_NUM_25
-#define BLACK_1_3_PIN   GPIO_NUM_26
-#define BLACK_2_3_PIN   GPIO_NUM_27
-#define BLACK_FULL_PIN  GPIO_NUM_14
-#define BOOT_BUTTON_PIN GPIO_NUM_0
-#define POWER_LED_PIN   GPIO_NUM_2
+#define GREY_1_3_PIN    32
+#define GREY_2_3_PIN    33
+#define GREY_FULL_PIN   25
+#define BLACK_1_3_PIN   26
+#define BLACK_2_3_PIN   27
+#define BLACK_FULL_PIN  14
+#define BOOT_BUTTON_PIN 0
+#define POWER_LED_PIN   2
 
 // Debounce delay in milliseconds
 #define DEBOUNCE_DELAY_MS 100
 
-// Sensor data structure
-typedef struct {
-    uint8_t grey_1_3;
-    uint8_t grey_2_3;
-    uint8_t grey_full;
-    uint8_t black_1_3;
-    uint8_t black_2_3;
-    uint8_t black_full;
-} sensor_data_t;
+// Capture mode: 1 = GPIO edge interrupts wake the monitor task, 0 = polled reads
+#define SENSOR_USE_EDGE_CAPTURE 1
+
+// Polled mode majority filter: a sensor is active when at least
+// SENSOR_VOTE_THRESHOLD of the last SENSOR_VOTE_WINDOW samples agree
+#define SENSOR_VOTE_THRESHOLD   3
+#define SENSOR_VOTE_WINDOW      5
+
+// Sensor GPIO numbers in sensor_filter.h bit order
+extern const int sensor_pins[SENSOR_COUNT];
 
 // Function prototypes
 void sensor_init_gpio(void);
 void sensor_read_all(sensor_data_t *data);
+uint8_t sensor_read_mask(void);
+void sensor_edge_capture_start(hal_task_t consumer);
+bool sensor_edge_pop(sensor_edge_t *edge);
+uint32_t sensor_edge_dropped(void);
+void sensor_boot_button_wait_start(hal_task_t waiter);
+void sensor_boot_button_rearm(void);
 bool sensor_is_boot_button_pressed(void);
 void sensor_set_power_led(bool on);
 
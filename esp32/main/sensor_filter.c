@@ -0,0 +1,39 @@
+#include "sensor_filter.h"
+#include <string.h>
+
+void sensor_vote_init(sensor_vote_filter_t *filter, uint8_t threshold, uint8_t window, uint8_t initial_mask) {
+    if (filter == NULL) return;
+
+    if (window == 0 || window > SENSOR_VOTE_HISTORY_MAX) {
+        window = SENSOR_VOTE_HISTORY_MAX;
+    }
+    if (threshold == 0 || threshold > window) {
+        threshold = window / 2 + 1;
+    }
+
+    // Seed the whole window so the first samples don't vote against an empty history
+    memset(filter->history, initial_mask, sizeof(filter->history));
+    filter->window = window;
+    filter->threshold = threshold;
+    filter->next = 0;
+    filter->output = initial_mask;
+}
+
+uint8_t sensor_vote_push(sensor_vote_filter_t *filter, uint8_t sample_mask) {
+    filter->history[filter->next] = sample_mask;
+    filter->next = (uint8_t)((filter->next + 1) % filter->window);
+
+    uint8_t voted = 0;
+    for (int sensor = 0; sensor < SENSOR_COUNT; sensor++) {
+        uint8_t votes = 0;
+        for (int i = 0; i < filter->window; i++) {
+            votes += (filter->history[i] >> sensor) & 1u;
+        }
+        if (votes >= filter->threshold) {
+            voted |= (uint8_t)(1u << sensor);
+        }
+    }
+
+    filter->output = voted;
+    return voted;
+}
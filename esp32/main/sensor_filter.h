@@ -0,0 +1,47 @@
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of level sensors
+#define SENSOR_COUNT 6
+
+// Sensor indices, used as bit positions in sensor masks
+enum {
+    SENSOR_GREY_1_3 = 0,
+    SENSOR_GREY_2_3,
+    SENSOR_GREY_FULL,
+    SENSOR_BLACK_1_3,
+    SENSOR_BLACK_2_3,
+    SENSOR_BLACK_FULL,
+};
+
+#define SENSOR_MASK_ALL ((uint8_t)((1u << SENSOR_COUNT) - 1))
+
+// Longest supported vote window
+#define SENSOR_VOTE_HISTORY_MAX 8
+
+// Sensor data - one bit per sensor, 1 = liquid detected
+typedef struct {
+    uint8_t mask;
+} sensor_data_t;
+
+// N-of-M majority vote over the most recent sample masks
+typedef struct {
+    uint8_t history[SENSOR_VOTE_HISTORY_MAX];
+    uint8_t window;         // M - samples considered
+    uint8_t threshold;      // N - votes needed to report a sensor active
+    uint8_t next;           // Next history slot to overwrite
+    uint8_t output;         // Last voted mask
+} sensor_vote_filter_t;
+
+static inline bool sensor_data_get(const sensor_data_t *data, int sensor) {
+    return (data->mask >> sensor) & 1u;
+}
+
+// Function prototypes
+void sensor_vote_init(sensor_vote_filter_t *filter, uint8_t threshold, uint8_t window, uint8_t initial_mask);
+uint8_t sensor_vote_push(sensor_vote_filter_t *filter, uint8_t sample_mask);
+
+#endif // SENSOR_FILTER_H
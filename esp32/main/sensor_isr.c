@@ -0,0 +1,116 @@
+#include "sensor.h"
+#include "power.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// GPIO interrupt side of the sensor module (ESP32 only)
+
+static const char *TAG = "SENSOR";
+
+// Edge capture state shared between the GPIO ISR and the consumer task
+static edge_ring_t edge_ring;
+static TaskHandle_t edge_consumer = NULL;
+
+// Task blocked until the BOOT button is pressed
+static TaskHandle_t button_waiter = NULL;
+
+#if POWER_LIGHT_SLEEP_ENABLE
+// Edge interrupts are not latched while the chip is in light sleep, so each
+// sensor pin waits for the level opposite to its current one instead. That
+// level both wakes the chip and raises the interrupt, and the ISR flips it.
+static void sensor_arm_level(gpio_num_t pin, int level) {
+    gpio_wakeup_enable(pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+}
+#endif
+
+static void sensor_edge_isr(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    int pin_level = gpio_get_level((gpio_num_t)sensor_pins[index]);
+    sensor_edge_t edge = {
+        .timestamp_us = (uint32_t)esp_timer_get_time(),
+        .sensor = (uint8_t)index,
+        .level = pin_level == 0,
+    };
+
+#if POWER_LIGHT_SLEEP_ENABLE
+    sensor_arm_level((gpio_num_t)sensor_pins[index], pin_level);
+#endif
+
+    edge_ring_push(&edge_ring, &edge);
+
+    BaseType_t higher_priority_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(edge_consumer, &higher_priority_woken);
+    if (higher_priority_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void sensor_edge_capture_start(hal_task_t consumer) {
+    edge_ring_init(&edge_ring);
+    edge_consumer = consumer;
+
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(err));
+        return;
+    }
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+#if POWER_LIGHT_SLEEP_ENABLE
+        sensor_arm_level((gpio_num_t)sensor_pins[i], gpio_get_level((gpio_num_t)sensor_pins[i]));
+#else
+        gpio_set_intr_type((gpio_num_t)sensor_pins[i], GPIO_INTR_ANYEDGE);
+#endif
+        gpio_isr_handler_add((gpio_num_t)sensor_pins[i], sensor_edge_isr, (void *)(uintptr_t)i);
+    }
+
+    ESP_LOGI(TAG, "Edge capture armed on %d sensor pins", SENSOR_COUNT);
+}
+
+bool sensor_edge_pop(sensor_edge_t *edge) {
+    return edge_ring_pop(&edge_ring, edge);
+}
+
+uint32_t sensor_edge_dropped(void) {
+    return edge_ring_dropped(&edge_ring);
+}
+
+static void sensor_boot_button_isr(void *arg) {
+    // Level interrupt - mask it until the waiter has seen the release
+    gpio_intr_disable(BOOT_BUTTON_PIN);
+#if POWER_LIGHT_SLEEP_ENABLE
+    gpio_wakeup_disable(BOOT_BUTTON_PIN);
+#endif
+
+    BaseType_t higher_priority_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(button_waiter, &higher_priority_woken);
+    if (higher_priority_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void sensor_boot_button_wait_start(hal_task_t waiter) {
+    button_waiter = waiter;
+
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(err));
+        return;
+    }
+
+    gpio_isr_handler_add(BOOT_BUTTON_PIN, sensor_boot_button_isr, NULL);
+    sensor_boot_button_rearm();
+}
+
+// Re-enable the press interrupt once the button is released
+void sensor_boot_button_rearm(void) {
+#if POWER_LIGHT_SLEEP_ENABLE
+    gpio_wakeup_enable(BOOT_BUTTON_PIN, GPIO_INTR_LOW_LEVEL);
+#else
+    gpio_set_intr_type(BOOT_BUTTON_PIN, GPIO_INTR_LOW_LEVEL);
+#endif
+    gpio_intr_enable(BOOT_BUTTON_PIN);
+}
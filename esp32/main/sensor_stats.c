@@ -0,0 +1,142 @@
+#include "sensor_stats.h"
+#include <string.h>
+
+static const uint32_t dwell_bounds[SENSOR_STATS_DWELL_BINS - 1] = SENSOR_STATS_DWELL_BOUNDS;
+
+void sensor_stats_init(sensor_stats_t *stats, uint8_t mask, uint32_t now_ms) {
+    if (stats == NULL) return;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->mask = mask;
+    stats->bucket_start_ms = now_ms;
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        stats->channels[i].last_change_ms = now_ms;
+    }
+}
+
+// Rotate buckets up to now, clearing the ones that fall out of the window
+static void sensor_stats_advance(sensor_stats_t *stats, uint32_t now_ms) {
+    uint32_t elapsed = now_ms - stats->bucket_start_ms;
+    if (elapsed < SENSOR_STATS_BUCKET_MS) return;
+
+    uint32_t steps = elapsed / SENSOR_STATS_BUCKET_MS;
+    stats->bucket_start_ms += steps * SENSOR_STATS_BUCKET_MS;
+    if (steps > SENSOR_STATS_BUCKETS) {
+        steps = SENSOR_STATS_BUCKETS;
+    }
+
+    while (steps--) {
+        stats->bucket = (stats->bucket + 1) % SENSOR_STATS_BUCKETS;
+        for (int i = 0; i < SENSOR_COUNT; i++) {
+            stats->channels[i].buckets[stats->bucket] = 0;
+        }
+    }
+}
+
+static int sensor_stats_dwell_bin(uint32_t dwell_ms) {
+    for (int bin = 0; bin < SENSOR_STATS_DWELL_BINS - 1; bin++) {
+        if (dwell_ms < dwell_bounds[bin]) {
+            return bin;
+        }
+    }
+    return SENSOR_STATS_DWELL_BINS - 1;
+}
+
+// A tank is consistent when its wet sensors form a run from the bottom:
+// none, 1/3, 1/3+2/3 or all three
+static bool sensor_stats_tank_consistent(uint8_t tank_bits) {
+    return (tank_bits & (tank_bits + 1)) == 0;
+}
+
+uint32_t sensor_stats_recent(const sensor_stats_t *stats, int sensor) {
+    uint32_t total = 0;
+    for (int b = 0; b < SENSOR_STATS_BUCKETS; b++) {
+        total += stats->channels[sensor].buckets[b];
+    }
+    return total;
+}
+
+uint32_t sensor_stats_recent_total(const sensor_stats_t *stats) {
+    uint32_t total = 0;
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        total += sensor_stats_recent(stats, i);
+    }
+    return total;
+}
+
+// Feed one sample (or just the passage of time with an unchanged mask).
+// Returns true if the motion or inconsistency state changed.
+bool sensor_stats_update(sensor_stats_t *stats, uint8_t mask, uint32_t now_ms) {
+    if (stats == NULL) return false;
+
+    bool was_moving = stats->in_motion;
+    uint8_t was_inconsistent = stats->inconsistent_mask;
+
+    sensor_stats_advance(stats, now_ms);
+
+    uint8_t changed = (stats->mask ^ mask) & SENSOR_MASK_ALL;
+    for (int i = 0; changed && i < SENSOR_COUNT; i++) {
+        if (!(changed & (1u << i))) continue;
+
+        sensor_stats_channel_t *ch = &stats->channels[i];
+        ch->dwell[sensor_stats_dwell_bin(now_ms - ch->last_change_ms)]++;
+        ch->last_change_ms = now_ms;
+        ch->transitions++;
+        if (ch->buckets[stats->bucket] < UINT16_MAX) {
+            ch->buckets[stats->bucket]++;
+        }
+    }
+    stats->mask = mask;
+
+    uint32_t recent = sensor_stats_recent_total(stats);
+    if (!stats->in_motion && recent >= SENSOR_STATS_MOTION_ENTER) {
+        stats->in_motion = true;
+    } else if (stats->in_motion && recent <= SENSOR_STATS_MOTION_EXIT) {
+        stats->in_motion = false;
+    }
+
+    for (int tank = 0; tank < 2; tank++) {
+        uint8_t bit = 1u << tank;
+        uint8_t tank_bits = (mask >> (tank * 3)) & 0x07;
+
+        if (sensor_stats_tank_consistent(tank_bits)) {
+            stats->disagree_mask &= ~bit;
+            stats->inconsistent_mask &= ~bit;
+            continue;
+        }
+
+        if (!(stats->disagree_mask & bit)) {
+            stats->disagree_mask |= bit;
+            stats->disagree_since_ms[tank] = now_ms;
+        }
+        if (now_ms - stats->disagree_since_ms[tank] >= SENSOR_STATS_INCONSISTENT_MS) {
+            stats->inconsistent_mask |= bit;
+        }
+    }
+
+    return stats->in_motion != was_moving || stats->inconsistent_mask != was_inconsistent;
+}
+
+// Milliseconds until the derived state can change without a new sample:
+// a bucket rotating out while in motion, or a disagreement becoming a fault
+uint32_t sensor_stats_ms_until_change(const sensor_stats_t *stats, uint32_t now_ms) {
+    uint32_t wait = UINT32_MAX;
+
+    if (stats->in_motion) {
+        uint32_t elapsed = now_ms - stats->bucket_start_ms;
+        wait = elapsed >= SENSOR_STATS_BUCKET_MS ? 0 : SENSOR_STATS_BUCKET_MS - elapsed;
+    }
+
+    for (int tank = 0; tank < 2; tank++) {
+        uint8_t bit = 1u << tank;
+        if (!(stats->disagree_mask & bit) || (stats->inconsistent_mask & bit)) continue;
+
+        uint32_t elapsed = now_ms - stats->disagree_since_ms[tank];
+        uint32_t remaining = elapsed >= SENSOR_STATS_INCONSISTENT_MS ? 0 : SENSOR_STATS_INCONSISTENT_MS - elapsed;
+        if (remaining < wait) {
+            wait = remaining;
+        }
+    }
+
+    return wait;
+}
@@ -0,0 +1,56 @@
+#ifndef SENSOR_STATS_H
+#define SENSOR_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sensor_filter.h"
+
+// Rolling transition counts: SENSOR_STATS_BUCKETS buckets of
+// SENSOR_STATS_BUCKET_MS, so the window covers the last minute
+#define SENSOR_STATS_BUCKET_MS          10000
+#define SENSOR_STATS_BUCKETS            6
+#define SENSOR_STATS_WINDOW_MS          (SENSOR_STATS_BUCKET_MS * SENSOR_STATS_BUCKETS)
+
+// Motion (liquid unsettled) is entered when all sensors together flip at
+// least ENTER times in the window and left once they drop to EXIT or fewer
+#define SENSOR_STATS_MOTION_ENTER       6
+#define SENSOR_STATS_MOTION_EXIT        1
+
+// A tank whose sensors disagree (an upper one wet, a lower one dry) for this
+// long is flagged as inconsistent - a stuck or miswired sensor
+#define SENSOR_STATS_INCONSISTENT_MS    60000
+
+// Dwell-time histogram bin upper bounds (ms); the last bin is open-ended
+#define SENSOR_STATS_DWELL_BINS         6
+#define SENSOR_STATS_DWELL_BOUNDS       { 1000, 5000, 30000, 120000, 900000 }
+
+// Tank indices for inconsistent_mask
+#define SENSOR_STATS_TANK_GREY          0
+#define SENSOR_STATS_TANK_BLACK         1
+
+typedef struct {
+    uint32_t last_change_ms;
+    uint32_t transitions;                       // Since boot
+    uint16_t buckets[SENSOR_STATS_BUCKETS];     // Transitions per bucket
+    uint32_t dwell[SENSOR_STATS_DWELL_BINS];    // Time spent in a state before each flip
+} sensor_stats_channel_t;
+
+typedef struct {
+    sensor_stats_channel_t channels[SENSOR_COUNT];
+    uint32_t bucket_start_ms;   // Start of the current bucket
+    uint8_t bucket;             // Current bucket index
+    uint8_t mask;               // Last sample
+    bool in_motion;
+    uint8_t inconsistent_mask;  // Bit per tank, sustained disagreement
+    uint8_t disagree_mask;      // Bit per tank, disagreeing right now
+    uint32_t disagree_since_ms[2];
+} sensor_stats_t;
+
+// Function prototypes
+void sensor_stats_init(sensor_stats_t *stats, uint8_t mask, uint32_t now_ms);
+bool sensor_stats_update(sensor_stats_t *stats, uint8_t mask, uint32_t now_ms);
+uint32_t sensor_stats_recent(const sensor_stats_t *stats, int sensor);
+uint32_t sensor_stats_recent_total(const sensor_stats_t *stats);
+uint32_t sensor_stats_ms_until_change(const sensor_stats_t *stats, uint32_t now_ms);
+
+#endif // SENSOR_STATS_H
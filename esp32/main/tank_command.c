@@ -0,0 +1,72 @@
+#include "tank_command.h"
+#include <string.h>
+
+// Split a command write into operations. Returns the number of operations,
+// or -1 if the version is unknown, the batch is empty or has more than
+// max_ops entries, carries more than one authenticate, or an entry runs past
+// the end of the write. Nothing in a malformed write is run.
+int tank_command_parse(const uint8_t *data, size_t len, tank_command_op_t *ops, int max_ops) {
+    if (data == NULL || ops == NULL || len < 1 || data[0] != TANK_COMMAND_VERSION) return -1;
+
+    int count = 0;
+    int auths = 0;
+    size_t pos = 1;
+    while (pos < len) {
+        if (count == max_ops || len - pos < 2 || len - pos - 2 < data[pos + 1]) {
+            return -1;
+        }
+        // One PIN guess per write, as on the authentication characteristic
+        if (data[pos] == TANK_CMD_AUTH && ++auths > 1) {
+            return -1;
+        }
+        ops[count].type = data[pos];
+        ops[count].len = data[pos + 1];
+        ops[count].value = data + pos + 2;
+        pos += 2 + ops[count].len;
+        count++;
+    }
+
+    return count > 0 ? count : -1;
+}
+
+// Value length an operation must carry, or -1 for an unknown type
+int tank_command_value_len(uint8_t type) {
+    switch (type) {
+    case TANK_CMD_AUTH:         return 6;
+    case TANK_CMD_SET_CONFIG:   return 2;
+    case TANK_CMD_CHANGE_PIN:   return 6;
+    case TANK_CMD_SET_SAMPLING: return 8;
+    case TANK_CMD_SET_FORMAT:   return 1;
+    case TANK_CMD_SNAPSHOT:     return 0;
+    default:                    return -1;
+    }
+}
+
+void tank_command_result_init(tank_command_result_t *result, uint8_t *buf, size_t cap) {
+    result->buf = buf;
+    result->cap = cap;
+    result->len = 0;
+    if (cap >= 2) {
+        buf[0] = TANK_COMMAND_VERSION;
+        buf[1] = 0;
+        result->len = 2;
+    }
+}
+
+// Append one operation's outcome. Returns false, leaving the result as it
+// was, if the entry does not fit.
+bool tank_command_result_add(tank_command_result_t *result, uint8_t type, uint8_t status,
+                             const uint8_t *value, uint8_t value_len) {
+    if (result->len < 2 || result->cap - result->len < 3u + value_len) return false;
+
+    uint8_t *entry = result->buf + result->len;
+    entry[0] = type;
+    entry[1] = status;
+    entry[2] = value_len;
+    if (value_len > 0) {
+        memcpy(entry + 3, value, value_len);
+    }
+    result->len += 3u + value_len;
+    result->buf[1]++;
+    return true;
+}
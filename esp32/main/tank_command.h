@@ -0,0 +1,47 @@
+#ifndef TANK_COMMAND_H
+#define TANK_COMMAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Command characteristic (0xFF09) framing. A write carries a version byte and
+// a batch of operations, each [type u8][len u8][value]. The result has a
+// version byte and an entry count, then one [type u8][status u8][len u8][value]
+// entry per operation, in the order they ran. Status is an ATT error code
+// (0 = success), so it reads the same as a write to the single-purpose
+// characteristics would have. A batch may authenticate at most once, and a
+// failed authentication ends it: the operations after it are answered with
+// an authorization error without running.
+#define TANK_COMMAND_VERSION        1
+#define TANK_COMMAND_MAX_OPS        8
+#define TANK_COMMAND_RESULT_MAX     64      // Headers for every op plus two v2 snapshots
+
+// Operations
+#define TANK_CMD_AUTH               0x01    // 6-digit PIN, as written to 0xFF02
+#define TANK_CMD_SET_CONFIG         0x02    // Grey and black enabled, as written to 0xFF03
+#define TANK_CMD_CHANGE_PIN         0x03    // New 6-digit PIN, as written to 0xFF04
+#define TANK_CMD_SET_SAMPLING       0x04    // Stability window min and max ms (u32 LE each)
+#define TANK_CMD_SET_FORMAT         0x05    // Tank data wire format, as written to 0xFF01
+#define TANK_CMD_SNAPSHOT           0x06    // No value; the result carries the tank data
+
+typedef struct {
+    uint8_t type;
+    uint8_t len;
+    const uint8_t *value;       // Points into the written data
+} tank_command_op_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+} tank_command_result_t;
+
+// Function prototypes
+int tank_command_parse(const uint8_t *data, size_t len, tank_command_op_t *ops, int max_ops);
+int tank_command_value_len(uint8_t type);
+void tank_command_result_init(tank_command_result_t *result, uint8_t *buf, size_t cap);
+bool tank_command_result_add(tank_command_result_t *result, uint8_t type, uint8_t status,
+                             const uint8_t *value, uint8_t value_len);
+
+#endif // TANK_COMMAND_H
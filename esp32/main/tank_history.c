@@ -0,0 +1,95 @@
+#include "tank_history.h"
+#include <string.h>
+
+static void put_u32_le(uint8_t *buf, uint32_t value) {
+    buf[0] = (uint8_t)value;
+    buf[1] = (uint8_t)(value >> 8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+void tank_history_init(tank_history_t *history) {
+    if (history == NULL) return;
+
+    memset(history, 0, sizeof(tank_history_t));
+}
+
+static void tank_history_append(tank_history_t *history, uint16_t delta_s, uint8_t levels, uint8_t flags) {
+    tank_history_record_t *record = &history->records[history->next_seq % TANK_HISTORY_CAPACITY];
+    record->delta_s = delta_s;
+    record->levels = levels;
+    record->flags = flags;
+    history->next_seq++;
+}
+
+uint32_t tank_history_record(tank_history_t *history, uint32_t now_ms, uint8_t grey_level,
+                             uint8_t black_level, uint8_t flags) {
+    uint8_t levels = (uint8_t)((grey_level & 0x3) | ((black_level & 0x3) << 2));
+
+    if (history->next_seq == 0) {
+        history->last_time_ms = now_ms;
+        tank_history_append(history, 0, levels, flags);
+        return 0;
+    }
+
+    uint32_t delta_s = (now_ms - history->last_time_ms) / 1000;
+
+    // Advance by whole seconds so rounding doesn't accumulate across records
+    history->last_time_ms += delta_s * 1000;
+
+    // Split long quiet periods with filler records repeating the previous state,
+    // so ages summed over the deltas stay exact
+    while (delta_s > 0xFFFF) {
+        const tank_history_record_t *prev = &history->records[(history->next_seq - 1) % TANK_HISTORY_CAPACITY];
+        tank_history_append(history, 0xFFFF, prev->levels, (uint8_t)(prev->flags | TANK_HISTORY_FLAG_GAP));
+        delta_s -= 0xFFFF;
+    }
+
+    tank_history_append(history, (uint16_t)delta_s, levels, flags);
+    return history->next_seq - 1;
+}
+
+uint32_t tank_history_oldest_seq(const tank_history_t *history) {
+    return history->next_seq > TANK_HISTORY_CAPACITY ? history->next_seq - TANK_HISTORY_CAPACITY : 0;
+}
+
+size_t tank_history_encode_chunk(const tank_history_t *history, uint32_t from_seq, uint32_t now_ms,
+                                 uint8_t *buf, size_t buf_len, uint32_t *next_seq) {
+    if (buf_len < TANK_HISTORY_CHUNK_HEADER_LEN) return 0;
+
+    // Clamp the cursor into the retained window; a jump forward tells the
+    // client records were overwritten before it caught up
+    uint32_t oldest = tank_history_oldest_seq(history);
+    uint32_t first = from_seq < oldest ? oldest : from_seq;
+    if (first > history->next_seq) {
+        first = history->next_seq;
+    }
+
+    size_t room = (buf_len - TANK_HISTORY_CHUNK_HEADER_LEN) / sizeof(tank_history_record_t);
+    uint32_t available = history->next_seq - first;
+    uint32_t count = available < room ? available : (uint32_t)room;
+    if (count > 0xFF) {
+        count = 0xFF;
+    }
+
+    // Age of the first record: time since the newest, plus the deltas between them
+    uint32_t age_s = (now_ms - history->last_time_ms) / 1000;
+    for (uint32_t seq = first + 1; seq < history->next_seq; seq++) {
+        age_s += history->records[seq % TANK_HISTORY_CAPACITY].delta_s;
+    }
+
+    put_u32_le(buf + TANK_HISTORY_CHUNK_SEQ_OFFSET, first);
+    buf[TANK_HISTORY_CHUNK_COUNT_OFFSET] = (uint8_t)count;
+    put_u32_le(buf + TANK_HISTORY_CHUNK_AGE_OFFSET, available ? age_s : 0);
+
+    uint8_t *out = buf + TANK_HISTORY_CHUNK_HEADER_LEN;
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(out, &history->records[(first + i) % TANK_HISTORY_CAPACITY], sizeof(tank_history_record_t));
+        out += sizeof(tank_history_record_t);
+    }
+
+    if (next_seq) {
+        *next_seq = first + count;
+    }
+    return TANK_HISTORY_CHUNK_HEADER_LEN + count * sizeof(tank_history_record_t);
+}
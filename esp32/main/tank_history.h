@@ -0,0 +1,46 @@
+#ifndef TANK_HISTORY_H
+#define TANK_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Ring capacity in records (4 bytes each)
+#define TANK_HISTORY_CAPACITY       512
+
+// Record flag bits
+#define TANK_HISTORY_FLAG_GREY_ENABLED   (1u << 0)
+#define TANK_HISTORY_FLAG_BLACK_ENABLED  (1u << 1)
+#define TANK_HISTORY_FLAG_STABLE         (1u << 2)  // Both tanks stable
+#define TANK_HISTORY_FLAG_GREY_STABLE    (1u << 3)
+#define TANK_HISTORY_FLAG_BLACK_STABLE   (1u << 4)
+#define TANK_HISTORY_FLAG_GAP            (1u << 7)  // Filler for gaps longer than 0xFFFF seconds
+
+// Backfill chunk header: first_seq (u32 LE), count (u8), age of first record in seconds (u32 LE)
+#define TANK_HISTORY_CHUNK_HEADER_LEN   9
+#define TANK_HISTORY_CHUNK_SEQ_OFFSET   0
+#define TANK_HISTORY_CHUNK_COUNT_OFFSET 4   // 0 marks the end of a backfill
+#define TANK_HISTORY_CHUNK_AGE_OFFSET   5
+
+// One level-change or stability-transition event
+typedef struct __attribute__((packed)) {
+    uint16_t delta_s;       // Seconds since the previous record
+    uint8_t levels;         // Bits 0-1 grey level, bits 2-3 black level
+    uint8_t flags;          // TANK_HISTORY_FLAG_*
+} tank_history_record_t;
+
+typedef struct {
+    tank_history_record_t records[TANK_HISTORY_CAPACITY];
+    uint32_t next_seq;      // Sequence number the next record will get
+    uint32_t last_time_ms;  // Timestamp of the newest record
+} tank_history_t;
+
+// Function prototypes
+void tank_history_init(tank_history_t *history);
+uint32_t tank_history_record(tank_history_t *history, uint32_t now_ms, uint8_t grey_level,
+                             uint8_t black_level, uint8_t flags);
+uint32_t tank_history_oldest_seq(const tank_history_t *history);
+size_t tank_history_encode_chunk(const tank_history_t *history, uint32_t from_seq, uint32_t now_ms,
+                                 uint8_t *buf, size_t buf_len, uint32_t *next_seq);
+
+#endif // TANK_HISTORY_H
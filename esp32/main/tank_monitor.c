@@ -1,38 +1,333 @@
 #include "tank_monitor.h"
+#include "sensor.h"
+#include "hal.h"
+#include "metrics.h"
+#include "trace.h"
+#include "binlog.h"
 #include "esp_log.h"
-#include "esp_timer.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include <stdatomic.h>
+#include <string.h>
 
 static const char *TAG = "TANK_MONITOR";
 
-// Global tank data
-tank_data_t g_tank_data = {0};
+// Working state, only touched by the monitor task
+static tank_data_t tank_state = {0};
+
+// Seqlock-protected published snapshot. The sequence is odd while a publish
+// is in progress; readers retry until they see the same even value on both
+// sides of their copy.
+static tank_snapshot_t published;
+static atomic_uint published_seq;
+
+// Enable flags requested from other tasks (bit 0 grey, bit 1 black),
+// applied by the monitor task so it stays the only writer
+#define ENABLE_REQ_GREY     (1u << 0)
+#define ENABLE_REQ_BLACK    (1u << 1)
+static atomic_uint enable_request = ENABLE_REQ_GREY | ENABLE_REQ_BLACK;
+
+// Monitor task, woken to apply enable requests
+static hal_task_t monitor_task = NULL;
+
+// Task woken whenever published state changes (BLE notifier)
+static hal_task_t change_listener = NULL;
+
+// Settle window bounds, the compile-time defaults until the stored config, a
+// tuning tool or a BLE client overrides them. Written from other tasks, read
+// by the monitor; the pair is not updated as one, so readers clamp min to max.
+static atomic_uint stability_min_ms = STABILITY_DURATION_MIN;
+static atomic_uint stability_max_ms = STABILITY_DURATION;
+
+// Polled sample period and edge debounce time, picked up by the monitor
+// task loop on its next pass
+static atomic_uint sample_period_ms = STABILITY_CHECK_INTERVAL;
+static atomic_uint debounce_ms = DEBOUNCE_DELAY_MS;
+
+// Per-sensor transition statistics, fed every sample by the monitor task
+static sensor_stats_t sensor_stats;
+
+// Level-change history, appended by the monitor task and read by BLE backfill
+static tank_history_t history;
+static hal_lock_t history_lock = HAL_LOCK_INITIALIZER;
+
+// Stability timing runs on a 64-bit millisecond clock so windows stay correct
+// past the 49.7 day wrap of hal_time_ms()
+uint64_t tank_monitor_clock_ms(void) {
+    return hal_time_us() / 1000;
+}
+
+// Time at which every unstable tank settles if no further change arrives
+static uint64_t tank_monitor_settle_deadline(uint64_t now_ms) {
+    uint32_t remaining = 0;
+    const tank_stability_t *tanks[2] = { &tank_state.grey_stability, &tank_state.black_stability };
+
+    for (int i = 0; i < 2; i++) {
+        if (tanks[i]->stable) continue;
+
+        uint64_t elapsed = now_ms - tanks[i]->last_change_ms;
+        if (elapsed < tanks[i]->settle_ms && tanks[i]->settle_ms - elapsed > remaining) {
+            remaining = tanks[i]->settle_ms - elapsed;
+        }
+    }
+    return now_ms + remaining;
+}
+
+static void tank_monitor_publish(void) {
+    uint64_t now_ms = tank_monitor_clock_ms();
+    unsigned seq = atomic_load_explicit(&published_seq, memory_order_relaxed);
+
+    atomic_store_explicit(&published_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    published.sequence = (seq + 2) / 2;
+    published.last_change_ms = tank_state.last_change_ms;
+    published.settle_deadline_ms = tank_monitor_settle_deadline(now_ms);
+    published.raw_mask = tank_state.raw_mask;
+    published.grey_level = tank_state.grey_level;
+    published.black_level = tank_state.black_level;
+    published.grey_enabled = tank_state.grey_enabled;
+    published.black_enabled = tank_state.black_enabled;
+    published.grey_stable = tank_state.grey_stability.stable;
+    published.black_stable = tank_state.black_stability.stable;
+    published.system_stable = tank_state.system_stable;
+    published.in_motion = sensor_stats.in_motion;
+    published.inconsistent_mask = sensor_stats.inconsistent_mask;
+
+    atomic_store_explicit(&published_seq, seq + 2, memory_order_release);
+
+    hal_task_notify(change_listener);
+}
+
+static void tank_monitor_record_history(uint32_t now_ms) {
+    uint8_t flags = (tank_state.grey_enabled ? TANK_HISTORY_FLAG_GREY_ENABLED : 0) |
+                    (tank_state.black_enabled ? TANK_HISTORY_FLAG_BLACK_ENABLED : 0) |
+                    (tank_state.system_stable ? TANK_HISTORY_FLAG_STABLE : 0) |
+                    (tank_state.grey_stability.stable ? TANK_HISTORY_FLAG_GREY_STABLE : 0) |
+                    (tank_state.black_stability.stable ? TANK_HISTORY_FLAG_BLACK_STABLE : 0);
+
+    hal_lock(&history_lock);
+    tank_history_record(&history, now_ms, tank_state.grey_level, tank_state.black_level, flags);
+    hal_unlock(&history_lock);
+}
+
+size_t tank_monitor_history_chunk(uint32_t from_seq, uint8_t *buf, size_t buf_len, uint32_t *next_seq) {
+    uint32_t now_ms = hal_time_ms();
+
+    hal_lock(&history_lock);
+    size_t len = tank_history_encode_chunk(&history, from_seq, now_ms, buf, buf_len, next_seq);
+    hal_unlock(&history_lock);
+    return len;
+}
+
+void tank_monitor_get_snapshot(tank_snapshot_t *snapshot) {
+    if (snapshot == NULL) return;
+
+    unsigned before, after;
+    do {
+        before = atomic_load_explicit(&published_seq, memory_order_acquire);
+        *snapshot = published;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&published_seq, memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+}
+
+void tank_monitor_set_listener(hal_task_t task) {
+    change_listener = task;
+}
+
+void tank_monitor_set_task(hal_task_t task) {
+    monitor_task = task;
+}
+
+void tank_monitor_set_stability_window(uint32_t min_ms, uint32_t max_ms) {
+    atomic_store_explicit(&stability_max_ms, max_ms, memory_order_relaxed);
+    atomic_store_explicit(&stability_min_ms, min_ms < max_ms ? min_ms : max_ms, memory_order_relaxed);
+}
+
+void tank_monitor_set_timing(const tank_timing_t *timing) {
+    if (timing == NULL) return;
+
+    tank_monitor_set_stability_window(timing->settle_min_ms, timing->settle_max_ms);
+    atomic_store_explicit(&sample_period_ms, timing->sample_period_ms, memory_order_relaxed);
+    atomic_store_explicit(&debounce_ms, timing->debounce_ms, memory_order_relaxed);
+
+    // Wake the monitor so a shorter period or debounce takes effect now
+    hal_task_notify(monitor_task);
+}
+
+uint32_t tank_monitor_sample_period_ms(void) {
+    return atomic_load_explicit(&sample_period_ms, memory_order_relaxed);
+}
+
+uint32_t tank_monitor_debounce_ms(void) {
+    return atomic_load_explicit(&debounce_ms, memory_order_relaxed);
+}
+
+bool tank_monitor_is_stable(void) {
+    return tank_state.system_stable;
+}
+
+void tank_monitor_set_enabled(bool grey_enabled, bool black_enabled) {
+    unsigned request = (grey_enabled ? ENABLE_REQ_GREY : 0) | (black_enabled ? ENABLE_REQ_BLACK : 0);
+    atomic_store_explicit(&enable_request, request, memory_order_release);
+
+    // Safe from any task; the monitor applies and publishes on its next pass
+    hal_task_notify(monitor_task);
+}
+
+static void tank_stability_init(tank_stability_t *st) {
+    memset(st, 0, sizeof(*st));
+    st->last_level = LEVEL_EMPTY;
+    st->last_change_ms = tank_monitor_clock_ms();
+    st->settle_ms = atomic_load_explicit(&stability_max_ms, memory_order_relaxed);
+}
+
+// Take the first sample after boot as the starting level rather than a
+// change, so the boot window keeps its full length
+static void tank_stability_seed(tank_stability_t *st, tank_level_t level) {
+    if (!st->seeded) {
+        st->last_level = level;
+        st->seeded = true;
+    }
+}
+
+// Settle window for a change at now_ms: the minimum when the tank has been
+// quiet, growing with each other change inside the flap look-back, and the
+// maximum while the sensors show the liquid is in motion
+static uint32_t tank_stability_window(const tank_stability_t *st, uint64_t now_ms) {
+    uint32_t recent = 0;
+
+    // Racing a window change can pair the new max with the old min; clamping
+    // keeps that a valid window, and the next change sees both new bounds
+    uint32_t max_ms = atomic_load_explicit(&stability_max_ms, memory_order_relaxed);
+    uint32_t min_ms = atomic_load_explicit(&stability_min_ms, memory_order_relaxed);
+    if (min_ms > max_ms) {
+        min_ms = max_ms;
+    }
+
+    // Sensors are flapping right now - don't trust a lull between waves
+    if (sensor_stats.in_motion) {
+        return max_ms;
+    }
+
+    for (uint8_t i = 0; i < st->change_count; i++) {
+        if (now_ms - st->change_ms[i] < STABILITY_FLAP_WINDOW_MS) {
+            recent++;
+        }
+    }
+
+    return min_ms + (max_ms - min_ms) * recent / STABILITY_FLAP_THRESHOLD;
+}
+
+// Advance one tank's stability state; true if its level or stable flag changed
+static bool tank_stability_update(tank_stability_t *st, tank_level_t level, uint64_t now_ms) {
+    if (level != st->last_level) {
+        st->settle_ms = tank_stability_window(st, now_ms);
+        st->change_ms[st->change_head] = now_ms;
+        st->change_head = (st->change_head + 1) % STABILITY_FLAP_THRESHOLD;
+        if (st->change_count < STABILITY_FLAP_THRESHOLD) {
+            st->change_count++;
+        }
+
+        st->last_level = level;
+        st->last_change_ms = now_ms;
+        st->stable = false;
+        tank_state.last_change_ms = now_ms;
+        return true;
+    }
+
+    if (!st->stable && now_ms - st->last_change_ms >= st->settle_ms) {
+        st->stable = true;
+        return true;
+    }
+
+    return false;
+}
+
+static uint32_t tank_stability_remaining(const tank_stability_t *st, uint64_t now_ms) {
+    if (st->stable) {
+        return UINT32_MAX;
+    }
+
+    uint64_t elapsed = now_ms - st->last_change_ms;
+    return elapsed >= st->settle_ms ? 0 : st->settle_ms - (uint32_t)elapsed;
+}
+
+// A disabled tank keeps its last level. On re-enable, take its level from
+// the latest sample; with edge capture the next one may be hours away.
+static bool tank_monitor_refresh_level(bool is_grey, uint64_t now_ms) {
+    sensor_data_t sensors = { .mask = tank_state.raw_mask };
+    tank_level_t level = tank_monitor_determine_level(&sensors, is_grey);
+    tank_stability_t *st = is_grey ? &tank_state.grey_stability : &tank_state.black_stability;
+
+    if (is_grey) {
+        tank_state.grey_level = level;
+    } else {
+        tank_state.black_level = level;
+    }
+    tank_stability_seed(st, level);
+    return tank_stability_update(st, level, now_ms);
+}
+
+// Pick up enable flags written by other tasks
+void tank_monitor_apply_enable_request(void) {
+    unsigned request = atomic_load_explicit(&enable_request, memory_order_acquire);
+    bool grey_enabled = request & ENABLE_REQ_GREY;
+    bool black_enabled = request & ENABLE_REQ_BLACK;
+
+    if (tank_state.grey_enabled == grey_enabled && tank_state.black_enabled == black_enabled) {
+        return;
+    }
+
+    uint64_t now_ms = tank_monitor_clock_ms();
+    bool levels_changed = false;
+    if (grey_enabled && !tank_state.grey_enabled) {
+        levels_changed |= tank_monitor_refresh_level(true, now_ms);
+    }
+    if (black_enabled && !tank_state.black_enabled) {
+        levels_changed |= tank_monitor_refresh_level(false, now_ms);
+    }
+
+    tank_state.grey_enabled = grey_enabled;
+    tank_state.black_enabled = black_enabled;
+    tank_state.system_stable = tank_state.grey_stability.stable && tank_state.black_stability.stable;
+    tank_monitor_publish();
+
+    if (levels_changed) {
+        tank_monitor_record_history((uint32_t)now_ms);
+    }
+}
 
 void tank_monitor_init(void) {
-    g_tank_data.grey_level = LEVEL_EMPTY;
-    g_tank_data.black_level = LEVEL_EMPTY;
-    g_tank_data.grey_enabled = true;
-    g_tank_data.black_enabled = true;
-    g_tank_data.last_stable_time = 0;
-    g_tank_data.last_grey_level = LEVEL_EMPTY;
-    g_tank_data.last_black_level = LEVEL_EMPTY;
-    g_tank_data.system_stable = 0;  // Start as unstable
+    tank_state.grey_level = LEVEL_EMPTY;
+    tank_state.black_level = LEVEL_EMPTY;
+    tank_state.grey_enabled = true;
+    tank_state.black_enabled = true;
+    tank_state.last_change_ms = tank_monitor_clock_ms();
+    tank_state.raw_mask = 0;
+    tank_state.system_stable = 0;  // Start as unstable
+    
+    // No flap history yet at boot, so both tanks take the full window from
+    // here, whatever level the first sample reads
+    tank_stability_init(&tank_state.grey_stability);
+    tank_stability_init(&tank_state.black_stability);
+    sensor_stats_init(&sensor_stats, 0, hal_time_ms());
+    tank_history_init(&history);
+    tank_monitor_publish();
 }
 
 tank_level_t tank_monitor_determine_level(const sensor_data_t *sensors, bool is_grey) {
     if (sensors == NULL) return LEVEL_EMPTY;
     
-    uint8_t sensor_1_3, sensor_2_3, sensor_full;
+    bool sensor_1_3, sensor_2_3, sensor_full;
     
     if (is_grey) {
-        sensor_1_3 = sensors->grey_1_3;
-        sensor_2_3 = sensors->grey_2_3;
-        sensor_full = sensors->grey_full;
+        sensor_1_3 = sensor_data_get(sensors, SENSOR_GREY_1_3);
+        sensor_2_3 = sensor_data_get(sensors, SENSOR_GREY_2_3);
+        sensor_full = sensor_data_get(sensors, SENSOR_GREY_FULL);
     } else {
-        sensor_1_3 = sensors->black_1_3;
-        sensor_2_3 = sensors->black_2_3;
-        sensor_full = sensors->black_full;
+        sensor_1_3 = sensor_data_get(sensors, SENSOR_BLACK_1_3);
+        sensor_2_3 = sensor_data_get(sensors, SENSOR_BLACK_2_3);
+        sensor_full = sensor_data_get(sensors, SENSOR_BLACK_FULL);
     }
     
     // Determine level based on sensor states
@@ -47,82 +342,134 @@ tank_level_t tank_monitor_determine_level(const sensor_data_t *sensors, bool is_
     }
 }
 
+// Report a motion or sensor-consistency change, with the statistics behind it
+static void tank_monitor_log_conditions(void) {
+    uint8_t faults = sensor_stats.inconsistent_mask;
+
+    if (faults) {
+        ESP_LOGW(TAG, "Sensors inconsistent - Grey: %s, Black: %s",
+                 (faults & (1u << SENSOR_STATS_TANK_GREY)) ? "YES" : "no",
+                 (faults & (1u << SENSOR_STATS_TANK_BLACK)) ? "YES" : "no");
+    }
+    ESP_LOGI(TAG, "Liquid %s (%lu flips in the last %d s)",
+             sensor_stats.in_motion ? "in motion" : "settled",
+             (unsigned long)sensor_stats_recent_total(&sensor_stats), SENSOR_STATS_WINDOW_MS / 1000);
+    tank_monitor_log_sensor_stats();
+}
+
 bool tank_monitor_check_stability(void) {
-    uint32_t current_time = esp_timer_get_time() / 1000;  // Convert to ms
-    
-    // Check if levels have changed
-    if (g_tank_data.grey_level != g_tank_data.last_grey_level ||
-        g_tank_data.black_level != g_tank_data.last_black_level) {
-        
-        // Levels changed, reset stability timer
-        g_tank_data.last_stable_time = current_time;
-        g_tank_data.last_grey_level = g_tank_data.grey_level;
-        g_tank_data.last_black_level = g_tank_data.black_level;
-        g_tank_data.system_stable = 0;  // Mark as unstable
-        
-        ESP_LOGI(TAG, "Levels changed - Grey: %d, Black: %d", 
-                 g_tank_data.grey_level, g_tank_data.black_level);
-        return false;
-    }
-    
-    // Check if enough time has passed for stability
-    uint32_t stable_duration = current_time - g_tank_data.last_stable_time;
-    if (stable_duration >= STABILITY_DURATION) {
-        g_tank_data.system_stable = 1;  // Mark as stable
-        return true;
+    TRACE_BEGIN(TRACE_CHECK_STABILITY, 0);
+    uint64_t current_time = tank_monitor_clock_ms();
+    
+    // Let rolling counts age out even when no new sample arrived
+    bool conditions_changed = sensor_stats_update(&sensor_stats, tank_state.raw_mask, (uint32_t)current_time);
+    
+    bool levels_changed = tank_state.grey_level != tank_state.grey_stability.last_level ||
+                          tank_state.black_level != tank_state.black_stability.last_level;
+    
+    // Each tank runs its own timer, so a grey change leaves black's alone
+    bool grey_changed = tank_stability_update(&tank_state.grey_stability, tank_state.grey_level, current_time);
+    bool black_changed = tank_stability_update(&tank_state.black_stability, tank_state.black_level, current_time);
+    
+    tank_state.system_stable = tank_state.grey_stability.stable && tank_state.black_stability.stable;
+    
+    if (grey_changed || black_changed) {
+        tank_monitor_publish();
+        tank_monitor_record_history((uint32_t)current_time);
+    } else if (conditions_changed) {
+        tank_monitor_publish();
     }
     
-    g_tank_data.system_stable = 0;  // Still unstable
-    return false;
+    if (conditions_changed) {
+        tank_monitor_log_conditions();
+    }
+    
+    if (levels_changed) {
+        metrics_inc(METRIC_LEVEL_CHANGES);
+        BINLOG(BINLOG_LEVELS_CHANGED,
+               tank_state.grey_level, (int32_t)(tank_state.grey_stability.settle_ms / 1000),
+               tank_state.black_level, (int32_t)(tank_state.black_stability.settle_ms / 1000));
+    }
+    
+    TRACE_END(TRACE_CHECK_STABILITY);
+    return tank_state.system_stable;
+}
+
+uint32_t tank_monitor_ms_until_stable(void) {
+    uint64_t current_time = tank_monitor_clock_ms();
+    uint32_t grey = tank_stability_remaining(&tank_state.grey_stability, current_time);
+    uint32_t black = tank_stability_remaining(&tank_state.black_stability, current_time);
+    
+    // Next tank to settle; UINT32_MAX once both are stable
+    return grey < black ? grey : black;
+}
+
+uint32_t tank_monitor_ms_until_next_check(void) {
+    uint32_t stable_ms = tank_monitor_ms_until_stable();
+    uint32_t stats_ms = sensor_stats_ms_until_change(&sensor_stats, hal_time_ms());
+    
+    return stable_ms < stats_ms ? stable_ms : stats_ms;
+}
+
+uint32_t tank_monitor_snapshot_ms_until_stable(const tank_snapshot_t *snapshot, uint64_t now_ms) {
+    if (snapshot == NULL || snapshot->system_stable) {
+        return 0;
+    }
+
+    if (snapshot->settle_deadline_ms <= now_ms) {
+        return 0;
+    }
+
+    uint64_t remaining = snapshot->settle_deadline_ms - now_ms;
+    return remaining > UINT32_MAX ? UINT32_MAX : (uint32_t)remaining;
 }
 
 void tank_monitor_update_levels(const sensor_data_t *sensors) {
     if (sensors == NULL) return;
     
+    TRACE_BEGIN(TRACE_UPDATE_LEVELS, sensors->mask);
+    metrics_inc(METRIC_SENSOR_SAMPLES);
+    bool raw_changed = tank_state.raw_mask != sensors->mask;
+    bool conditions_changed = sensor_stats_update(&sensor_stats, sensors->mask, hal_time_ms());
+    
     // Store raw sensor values
-    g_tank_data.grey_1_3_raw = sensors->grey_1_3;
-    g_tank_data.grey_2_3_raw = sensors->grey_2_3;
-    g_tank_data.grey_full_raw = sensors->grey_full;
-    g_tank_data.black_1_3_raw = sensors->black_1_3;
-    g_tank_data.black_2_3_raw = sensors->black_2_3;
-    g_tank_data.black_full_raw = sensors->black_full;
+    tank_state.raw_mask = sensors->mask;
     
     // Calculate levels
-    if (g_tank_data.grey_enabled) {
-        g_tank_data.grey_level = tank_monitor_determine_level(sensors, true);
-    }
-    
-    if (g_tank_data.black_enabled) {
-        g_tank_data.black_level = tank_monitor_determine_level(sensors, false);
-    }
-}
-
-void tank_monitor_task(void *pvParameters) {
-    sensor_data_t sensors = {0};
-    
-    ESP_LOGI(TAG, "Tank monitoring task started");
-    
-    while (1) {
-        // Read all sensors
-        sensor_read_all(&sensors);
-        
-        // Update tank levels
-        tank_monitor_update_levels(&sensors);
-        
-        // Log raw sensor states
-        ESP_LOGI(TAG, "Sensors - Grey[1/3:%d 2/3:%d F:%d] Black[1/3:%d 2/3:%d F:%d] Levels[G:%d B:%d]",
-                 g_tank_data.grey_1_3_raw, g_tank_data.grey_2_3_raw, g_tank_data.grey_full_raw,
-                 g_tank_data.black_1_3_raw, g_tank_data.black_2_3_raw, g_tank_data.black_full_raw,
-                 g_tank_data.grey_level, g_tank_data.black_level);
-        
-        // Check for stability
-        bool is_stable = tank_monitor_check_stability();
-        
-        if (is_stable) {
-            ESP_LOGI(TAG, "System stable for %d seconds", STABILITY_DURATION / 1000);
-        }
-        
-        
-        vTaskDelay(pdMS_TO_TICKS(STABILITY_CHECK_INTERVAL));
+    if (tank_state.grey_enabled) {
+        tank_state.grey_level = tank_monitor_determine_level(sensors, true);
+        tank_stability_seed(&tank_state.grey_stability, tank_state.grey_level);
+    }
+    
+    if (tank_state.black_enabled) {
+        tank_state.black_level = tank_monitor_determine_level(sensors, false);
+        tank_stability_seed(&tank_state.black_stability, tank_state.black_level);
+    }
+    
+    if (raw_changed || conditions_changed) {
+        tank_monitor_publish();
+    }
+    
+    if (conditions_changed) {
+        tank_monitor_log_conditions();
     }
-}
\ No newline at end of file
+    
+    TRACE_END(TRACE_UPDATE_LEVELS);
+}
+
+void tank_monitor_log_sensors(void) {
+    // Bit order as in sensor_filter.h (bit 0 grey 1/3 .. bit 5 black full)
+    BINLOG(BINLOG_SENSORS, tank_state.raw_mask, tank_state.grey_level, tank_state.black_level);
+}
+
+void tank_monitor_log_sensor_stats(void) {
+    static const char *names[SENSOR_COUNT] = { "G1/3", "G2/3", "GF", "B1/3", "B2/3", "BF" };
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        const sensor_stats_channel_t *ch = &sensor_stats.channels[i];
+        ESP_LOGI(TAG, "%-4s flips %lu/min %lu total, dwell <1s:%lu <5s:%lu <30s:%lu <2m:%lu <15m:%lu more:%lu",
+                 names[i], (unsigned long)sensor_stats_recent(&sensor_stats, i), (unsigned long)ch->transitions,
+                 (unsigned long)ch->dwell[0], (unsigned long)ch->dwell[1], (unsigned long)ch->dwell[2],
+                 (unsigned long)ch->dwell[3], (unsigned long)ch->dwell[4], (unsigned long)ch->dwell[5]);
+    }
+}
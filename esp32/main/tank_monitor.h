@@ -3,12 +3,25 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "sensor.h"
+#include <stddef.h>
+#include "hal.h"
 #include "config.h"
+#include "sensor_filter.h"
+#include "sensor_stats.h"
+#include "tank_history.h"
+#include "sample_sched.h"
 
-// Stability timing (milliseconds)
-#define STABILITY_CHECK_INTERVAL    1000   // Check every 1 second
-#define STABILITY_DURATION          90000   // 90 seconds for stability
+// Stability timing (milliseconds). Each tank settles on its own: a lone
+// level change needs STABILITY_DURATION_MIN, and the window stretches toward
+// STABILITY_DURATION as more changes land within STABILITY_FLAP_WINDOW_MS.
+// The period and both windows are defaults; the stored config (tank_timing_t)
+// overrides them at boot and a client can change them live.
+#define STABILITY_CHECK_INTERVAL    200    // Polled sample period (majority vote runs per sample)
+#define STABILITY_DURATION          90000   // Settle window while sloshing (and at boot)
+#define STABILITY_DURATION_MIN      15000   // Settle window with no recent flapping
+#define STABILITY_FLAP_WINDOW_MS    300000  // Look-back for recent level changes
+#define STABILITY_FLAP_THRESHOLD    3       // Recent changes that select the full window
+#define STABILITY_DURATION_LIMIT    600000  // Longest settle window a client may set
 
 // Tank levels
 typedef enum {
@@ -18,33 +31,72 @@ typedef enum {
     LEVEL_FULL = 3
 } tank_level_t;
 
-// Tank data structure
+// Per-tank stability tracking
+typedef struct {
+    tank_level_t last_level;
+    uint64_t last_change_ms;    // Stability timer start
+    uint32_t settle_ms;         // Window chosen for the current change
+    uint64_t change_ms[STABILITY_FLAP_THRESHOLD];  // Recent change times (ring)
+    uint8_t change_head;
+    uint8_t change_count;
+    bool stable;
+    bool seeded;                // First sample since boot taken
+} tank_stability_t;
+
+// Tank data structure - working state, owned by the monitor task
 typedef struct {
     tank_level_t grey_level;
     tank_level_t black_level;
     bool grey_enabled;
     bool black_enabled;
-    uint32_t last_stable_time;
-    tank_level_t last_grey_level;
-    tank_level_t last_black_level;
-    // Raw sensor states
-    uint8_t grey_1_3_raw;
-    uint8_t grey_2_3_raw;
-    uint8_t grey_full_raw;
-    uint8_t black_1_3_raw;
-    uint8_t black_2_3_raw;
-    uint8_t black_full_raw;
-    uint8_t system_stable;  // 0 = unstable, 1 = stable
+    tank_stability_t grey_stability;
+    tank_stability_t black_stability;
+    uint64_t last_change_ms;    // Most recent level change on either tank
+    uint8_t raw_mask;       // Raw sensor states, bit per sensor (see sensor_filter.h)
+    uint8_t system_stable;  // 1 once both tanks are stable
 } tank_data_t;
 
-// Global tank data
-extern tank_data_t g_tank_data;
+// Published copy of the tank state. Readers on any task or core get all
+// fields from the same sample via tank_monitor_get_snapshot().
+typedef struct {
+    uint32_t sequence;      // Incremented on every publish
+    uint64_t last_change_ms; // Time of the last level change on either tank
+    uint64_t settle_deadline_ms; // When every unstable tank settles if nothing changes
+    uint8_t raw_mask;
+    tank_level_t grey_level;
+    tank_level_t black_level;
+    bool grey_enabled;
+    bool black_enabled;
+    bool grey_stable;
+    bool black_stable;
+    uint8_t system_stable;  // Both tanks stable
+    bool in_motion;         // Sensors flapping - vehicle moving or liquid unsettled
+    uint8_t inconsistent_mask; // Bit per tank (SENSOR_STATS_TANK_*): stuck or inconsistent sensor
+} tank_snapshot_t;
 
 // Function prototypes
 void tank_monitor_init(void);
+uint64_t tank_monitor_clock_ms(void);
 tank_level_t tank_monitor_determine_level(const sensor_data_t *sensors, bool is_grey);
 bool tank_monitor_check_stability(void);
+uint32_t tank_monitor_ms_until_stable(void);
+uint32_t tank_monitor_ms_until_next_check(void);
+uint32_t tank_monitor_snapshot_ms_until_stable(const tank_snapshot_t *snapshot, uint64_t now_ms);
 void tank_monitor_update_levels(const sensor_data_t *sensors);
+void tank_monitor_get_snapshot(tank_snapshot_t *snapshot);
+void tank_monitor_set_enabled(bool grey_enabled, bool black_enabled);
+void tank_monitor_set_listener(hal_task_t task);
+void tank_monitor_set_task(hal_task_t task);
+void tank_monitor_set_stability_window(uint32_t min_ms, uint32_t max_ms);
+void tank_monitor_set_timing(const tank_timing_t *timing);
+uint32_t tank_monitor_sample_period_ms(void);
+uint32_t tank_monitor_debounce_ms(void);
+void tank_monitor_apply_enable_request(void);
+bool tank_monitor_is_stable(void);
+void tank_monitor_log_sensors(void);
+void tank_monitor_log_sensor_stats(void);
+size_t tank_monitor_history_chunk(uint32_t from_seq, uint8_t *buf, size_t buf_len, uint32_t *next_seq);
+void tank_monitor_get_sample_stats(sample_sched_t *out);
 void tank_monitor_task(void *pvParameters);
 
 #endif // TANK_MONITOR_H
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "tank_monitor.h"
+#include "sensor.h"
+#include "power.h"
+#include "hal.h"
+#include "trace.h"
+#include "binlog.h"
+#include "esp_log.h"
+
+// Monitor task loops (ESP32 only). The level and stability logic they drive
+// lives in tank_monitor.c and also builds on the host.
+
+static const char *TAG = "TANK_MONITOR";
+
+// Wakeup timing, updated by the monitor task and copied out for diagnostics
+static sample_sched_t sched;
+static hal_lock_t sched_lock = HAL_LOCK_INITIALIZER;
+
+void tank_monitor_get_sample_stats(sample_sched_t *out) {
+    if (out == NULL) return;
+
+    hal_lock(&sched_lock);
+    *out = sched;
+    hal_unlock(&sched_lock);
+}
+
+#if SENSOR_USE_EDGE_CAPTURE
+// Milliseconds until the next debounce, stability or sensor-statistics
+// deadline, or forever if none is pending
+static uint32_t tank_monitor_next_wait(const edge_debouncer_t *debouncer) {
+    uint32_t wait = HAL_WAIT_FOREVER;
+
+    uint32_t settle_us = edge_debouncer_time_to_settle_us(debouncer, (uint32_t)hal_time_us());
+    if (settle_us != UINT32_MAX) {
+        wait = settle_us / 1000 + 1;
+    }
+
+    uint32_t stable_ms = tank_monitor_ms_until_next_check();
+    if (stable_ms != UINT32_MAX && stable_ms + 1 < wait) {
+        wait = stable_ms + 1;
+    }
+
+    return wait;
+}
+
+// Feed every sensor's current level as a fresh edge, used after ring overflow
+static void tank_monitor_resync_edges(edge_debouncer_t *debouncer) {
+    uint8_t mask = sensor_read_mask();
+    uint32_t now_us = (uint32_t)hal_time_us();
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        sensor_edge_t edge = {
+            .timestamp_us = now_us,
+            .sensor = (uint8_t)i,
+            .level = (mask >> i) & 1,
+        };
+        edge_debouncer_feed(debouncer, &edge);
+    }
+}
+
+void tank_monitor_task(void *pvParameters) {
+    sensor_data_t sensors = {0};
+    edge_debouncer_t debouncer;
+    sensor_edge_t edge;
+
+    ESP_LOGI(TAG, "Tank monitoring task started (edge capture)");
+
+    hal_lock(&sched_lock);
+    sample_sched_init(&sched, 0, hal_time_us());
+    hal_unlock(&sched_lock);
+
+    hal_task_t self = hal_task_current();
+    tank_monitor_set_task(self);
+    tank_monitor_apply_enable_request();
+
+    // Arm interrupts before the baseline read so no edge can fall in between
+    sensor_edge_capture_start(self);
+    sensors.mask = sensor_read_mask();
+    edge_debouncer_init(&debouncer, sensors.mask, tank_monitor_debounce_ms() * 1000);
+
+    tank_monitor_update_levels(&sensors);
+    tank_monitor_log_sensors();
+    tank_monitor_check_stability();
+
+    uint32_t last_dropped = 0;
+
+    while (1) {
+        // Sleep until an edge arrives, an enable request is posted or a
+        // debounce/stability deadline expires
+        uint32_t wait = tank_monitor_next_wait(&debouncer);
+        uint64_t deadline_us = hal_time_us() + (uint64_t)wait * 1000;
+        if (hal_task_wait(wait)) {
+            power_note_wakeup(WAKE_SRC_SENSOR_EVENT);
+        } else {
+            power_note_wakeup(debouncer.dirty_mask ? WAKE_SRC_DEBOUNCE : WAKE_SRC_STABILITY);
+            hal_lock(&sched_lock);
+            sample_sched_note_deadline(&sched, deadline_us, hal_time_us());
+            hal_unlock(&sched_lock);
+        }
+        tank_monitor_apply_enable_request();
+        debouncer.debounce_us = tank_monitor_debounce_ms() * 1000;
+
+        while (sensor_edge_pop(&edge)) {
+            edge_debouncer_feed(&debouncer, &edge);
+        }
+
+        uint32_t dropped = sensor_edge_dropped();
+        if (dropped != last_dropped) {
+            ESP_LOGW(TAG, "Edge ring overflowed (%lu dropped), resyncing", (unsigned long)dropped);
+            last_dropped = dropped;
+            tank_monitor_resync_edges(&debouncer);
+        }
+
+        if (edge_debouncer_settle(&debouncer, (uint32_t)hal_time_us())) {
+            sensors.mask = debouncer.stable_mask;
+            TRACE_INSTANT(TRACE_EDGE_SETTLE, sensors.mask);
+            tank_monitor_update_levels(&sensors);
+            tank_monitor_log_sensors();
+        }
+
+        bool was_stable = tank_monitor_is_stable();
+        if (tank_monitor_check_stability() && !was_stable) {
+            BINLOG(BINLOG_BOTH_STABLE, 0);
+        }
+    }
+}
+#else
+// Pick up enable flags and a new sample period posted by other tasks
+static void tank_monitor_apply_requests(void) {
+    tank_monitor_apply_enable_request();
+
+    uint32_t period_us = tank_monitor_sample_period_ms() * 1000;
+    if (period_us != sched.period_us) {
+        hal_lock(&sched_lock);
+        sample_sched_set_period(&sched, period_us);
+        hal_unlock(&sched_lock);
+        ESP_LOGI(TAG, "Sample period set to %lu ms", (unsigned long)(period_us / 1000));
+    }
+}
+
+void tank_monitor_task(void *pvParameters) {
+    sensor_data_t sensors = {0};
+    uint8_t last_mask = 0xFF;
+    
+    ESP_LOGI(TAG, "Tank monitoring task started (polled, %lu ms period)",
+             (unsigned long)tank_monitor_sample_period_ms());
+    
+    tank_monitor_set_task(hal_task_current());
+    
+    hal_lock(&sched_lock);
+    sample_sched_init(&sched, tank_monitor_sample_period_ms() * 1000, hal_time_us());
+    hal_unlock(&sched_lock);
+    
+    while (1) {
+        tank_monitor_apply_requests();
+        
+        // Samples start on a fixed grid; one that starts after the next
+        // deadline has passed skips ahead rather than firing a burst
+        hal_lock(&sched_lock);
+        uint32_t skipped = sample_sched_start(&sched, hal_time_us());
+        hal_unlock(&sched_lock);
+        if (skipped) {
+            ESP_LOGW(TAG, "Sampling overran, %lu deadline(s) missed", (unsigned long)skipped);
+        }
+        
+        // Take one register snapshot through the majority filter
+        sensor_read_all(&sensors);
+        
+        // Update tank levels
+        tank_monitor_update_levels(&sensors);
+        
+        // Log raw sensor states when the filtered snapshot changes
+        if (sensors.mask != last_mask) {
+            tank_monitor_log_sensors();
+            last_mask = sensors.mask;
+        }
+        
+        // Check for stability
+        bool was_stable = tank_monitor_is_stable();
+        if (tank_monitor_check_stability() && !was_stable) {
+            BINLOG(BINLOG_BOTH_STABLE, 0);
+        }
+        
+        // Wait for the next grid deadline; an enable or period request wakes
+        // the task early and is applied without taking an extra sample
+        uint32_t wait;
+        while ((wait = sample_sched_wait_ms(&sched, hal_time_us())) > 0) {
+            if (hal_task_wait(wait)) {
+                tank_monitor_apply_requests();
+            }
+        }
+        power_note_wakeup(WAKE_SRC_POLL);
+    }
+}
+#endif
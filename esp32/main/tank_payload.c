@@ -0,0 +1,90 @@
+#include "tank_payload.h"
+#include "sensor_filter.h"
+
+static void put_u32_le(uint8_t *buf, uint32_t value) {
+    buf[0] = (uint8_t)value;
+    buf[1] = (uint8_t)(value >> 8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_u32_le(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+bool tank_payload_version_valid(uint8_t version) {
+    return version == TANK_PAYLOAD_V1 || version == TANK_PAYLOAD_V2;
+}
+
+// v1: one byte per sensor, then grey/black enabled and stable (9 bytes)
+static size_t tank_payload_encode_v1(const tank_payload_fields_t *fields, uint8_t *buf) {
+    buf[0] = (fields->raw_mask >> SENSOR_GREY_1_3) & 1;
+    buf[1] = (fields->raw_mask >> SENSOR_GREY_2_3) & 1;
+    buf[2] = (fields->raw_mask >> SENSOR_GREY_FULL) & 1;
+    buf[3] = (fields->raw_mask >> SENSOR_BLACK_1_3) & 1;
+    buf[4] = (fields->raw_mask >> SENSOR_BLACK_2_3) & 1;
+    buf[5] = (fields->raw_mask >> SENSOR_BLACK_FULL) & 1;
+    buf[6] = fields->grey_enabled;
+    buf[7] = fields->black_enabled;
+    buf[8] = fields->system_stable;
+    return TANK_PAYLOAD_V1_LEN;
+}
+
+static uint8_t tank_payload_flags(const tank_payload_fields_t *fields) {
+    return (fields->grey_enabled ? TANK_PAYLOAD_FLAG_GREY_ENABLED : 0) |
+           (fields->black_enabled ? TANK_PAYLOAD_FLAG_BLACK_ENABLED : 0) |
+           (fields->system_stable ? TANK_PAYLOAD_FLAG_STABLE : 0) |
+           (fields->grey_stable ? TANK_PAYLOAD_FLAG_GREY_STABLE : 0) |
+           (fields->black_stable ? TANK_PAYLOAD_FLAG_BLACK_STABLE : 0) |
+           (fields->in_motion ? TANK_PAYLOAD_FLAG_IN_MOTION : 0) |
+           (fields->grey_fault ? TANK_PAYLOAD_FLAG_GREY_FAULT : 0) |
+           (fields->black_fault ? TANK_PAYLOAD_FLAG_BLACK_FAULT : 0);
+}
+
+// v2: version, sensor bits, flag bits, then sequence, ms since change and
+// ms until stable as u32 little-endian (15 bytes)
+static size_t tank_payload_encode_v2(const tank_payload_fields_t *fields, uint8_t *buf) {
+    buf[0] = TANK_PAYLOAD_V2;
+    buf[1] = fields->raw_mask & SENSOR_MASK_ALL;
+    buf[2] = tank_payload_flags(fields);
+    put_u32_le(buf + 3, fields->sequence);
+    put_u32_le(buf + 7, fields->ms_since_change);
+    put_u32_le(buf + 11, fields->ms_until_stable);
+    return TANK_PAYLOAD_V2_LEN;
+}
+
+size_t tank_payload_encode(uint8_t version, const tank_payload_fields_t *fields, uint8_t *buf) {
+    if (fields == NULL || buf == NULL) return 0;
+
+    if (version == TANK_PAYLOAD_V2) {
+        return tank_payload_encode_v2(fields, buf);
+    }
+    return tank_payload_encode_v1(fields, buf);
+}
+
+// Manufacturer-specific advertising field: company ID (u16 LE), version,
+// sensor bits, v2 flag bits and a rolling counter (6 bytes). Timing is left
+// out since a broadcast cannot be aged once it is on the air.
+size_t tank_payload_encode_adv(const tank_payload_fields_t *fields, uint8_t *buf) {
+    if (fields == NULL || buf == NULL) return 0;
+
+    buf[0] = (uint8_t)TANK_ADV_COMPANY_ID;
+    buf[1] = (uint8_t)(TANK_ADV_COMPANY_ID >> 8);
+    buf[2] = TANK_ADV_VERSION;
+    buf[3] = fields->raw_mask & SENSOR_MASK_ALL;
+    buf[4] = tank_payload_flags(fields);
+    buf[5] = (uint8_t)fields->sequence;
+    return TANK_ADV_LEN;
+}
+
+// Bring an encoded payload forward by elapsed_ms without re-reading the
+// monitor: v2's ms-since-change grows and ms-until-stable counts down to 0.
+// v1 carries no timing and is left alone.
+void tank_payload_age(uint8_t *buf, size_t len, uint32_t elapsed_ms) {
+    if (buf == NULL || len < TANK_PAYLOAD_V2_LEN || buf[0] != TANK_PAYLOAD_V2) return;
+
+    uint32_t since = get_u32_le(buf + 7);
+    uint32_t until = get_u32_le(buf + 11);
+    put_u32_le(buf + 7, since > UINT32_MAX - elapsed_ms ? UINT32_MAX : since + elapsed_ms);
+    put_u32_le(buf + 11, until > elapsed_ms ? until - elapsed_ms : 0);
+}
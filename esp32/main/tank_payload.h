@@ -0,0 +1,55 @@
+#ifndef TANK_PAYLOAD_H
+#define TANK_PAYLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Tank data (0xFF01) wire formats. v1 is the original one-byte-per-flag
+// layout and stays the default; v2 is selected per connection.
+#define TANK_PAYLOAD_V1         1
+#define TANK_PAYLOAD_V2         2
+
+#define TANK_PAYLOAD_V1_LEN     9
+#define TANK_PAYLOAD_V2_LEN     15
+#define TANK_PAYLOAD_MAX_LEN    TANK_PAYLOAD_V2_LEN
+
+// Advertising manufacturer data (broadcast mode): company ID, version,
+// sensor bits, v2 flag bits and the low byte of the sequence
+#define TANK_ADV_COMPANY_ID     0xFFFF  // Bluetooth SIG "no company" ID for testing/internal use
+#define TANK_ADV_VERSION        1
+#define TANK_ADV_LEN            6
+
+// v2 flag bits (byte 2)
+#define TANK_PAYLOAD_FLAG_GREY_ENABLED   (1u << 0)
+#define TANK_PAYLOAD_FLAG_BLACK_ENABLED  (1u << 1)
+#define TANK_PAYLOAD_FLAG_STABLE         (1u << 2)  // Both tanks stable
+#define TANK_PAYLOAD_FLAG_GREY_STABLE    (1u << 3)
+#define TANK_PAYLOAD_FLAG_BLACK_STABLE   (1u << 4)
+#define TANK_PAYLOAD_FLAG_IN_MOTION      (1u << 5)  // Sensors flapping, liquid unsettled
+#define TANK_PAYLOAD_FLAG_GREY_FAULT     (1u << 6)  // Grey sensors stuck or inconsistent
+#define TANK_PAYLOAD_FLAG_BLACK_FAULT    (1u << 7)
+
+// Fields carried by the payload, gathered from one tank snapshot
+typedef struct {
+    uint8_t raw_mask;           // Sensor bits (see sensor_filter.h)
+    bool grey_enabled;
+    bool black_enabled;
+    bool system_stable;
+    bool grey_stable;
+    bool black_stable;
+    bool in_motion;
+    bool grey_fault;
+    bool black_fault;
+    uint32_t sequence;          // Bumped each time the payload content changes
+    uint32_t ms_since_change;   // Time since the last level change
+    uint32_t ms_until_stable;   // 0 once both tanks are stable
+} tank_payload_fields_t;
+
+// Function prototypes
+bool tank_payload_version_valid(uint8_t version);
+size_t tank_payload_encode(uint8_t version, const tank_payload_fields_t *fields, uint8_t *buf);
+size_t tank_payload_encode_adv(const tank_payload_fields_t *fields, uint8_t *buf);
+void tank_payload_age(uint8_t *buf, size_t len, uint32_t elapsed_ms);
+
+#endif // TANK_PAYLOAD_H
@@ -0,0 +1,107 @@
+#include "trace.h"
+#include "esp_log.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+static const char *TAG = "TRACE";
+
+// Writers claim a slot with one atomic increment, so trace points from any
+// task (including the BLE stack's) never block. Recording pauses while a
+// snapshot is copied out so the ring does not wrap under the copy. A writer
+// on the other core that got past the pause check just before it may still
+// be filling its slot, so the newest event or two can come out torn.
+static trace_event_t ring[TRACE_RING_SIZE];
+static atomic_uint head;
+static atomic_bool paused;
+
+static const char *trace_names[TRACE_ID_COUNT] = {
+    [TRACE_SENSOR_READ] = "sensor_read",
+    [TRACE_EDGE_SETTLE] = "edge_settle",
+    [TRACE_UPDATE_LEVELS] = "update_levels",
+    [TRACE_CHECK_STABILITY] = "check_stability",
+    [TRACE_NOTIFY_WAKE] = "notify_wake",
+    [TRACE_BLE_UPDATE] = "ble_update",
+    [TRACE_SEND_INDICATE] = "send_indicate",
+    [TRACE_GATT_EVENT] = "gatt_event",
+};
+
+void trace_record(uint8_t phase, trace_id_t id, uint16_t arg) {
+    if (atomic_load_explicit(&paused, memory_order_relaxed)) return;
+
+    unsigned index = atomic_fetch_add_explicit(&head, 1, memory_order_relaxed);
+    trace_event_t *event = &ring[index & (TRACE_RING_SIZE - 1)];
+
+    event->timestamp_us = (uint32_t)hal_time_us();
+    event->task = hal_task_current();
+    event->arg = arg;
+    event->phase = phase;
+    event->id = (uint8_t)id;
+}
+
+// Pause recording and find the newest buffered events, up to max_events.
+// Returns how many; the oldest is at ring index *first.
+static unsigned trace_pause(size_t max_events, unsigned *first) {
+    atomic_store(&paused, true);
+
+    unsigned end = atomic_load(&head);
+    unsigned count = end < TRACE_RING_SIZE ? end : TRACE_RING_SIZE;
+    if (count > max_events) {
+        count = (unsigned)max_events;
+    }
+
+    *first = end - count;
+    return count;
+}
+
+// Copy out the newest buffered events that fit, oldest first. Returns the
+// number copied.
+size_t trace_snapshot(trace_event_t *events, size_t max_events) {
+    if (events == NULL) return 0;
+
+    unsigned first;
+    unsigned count = trace_pause(max_events, &first);
+    for (unsigned i = 0; i < count; i++) {
+        events[i] = ring[(first + i) & (TRACE_RING_SIZE - 1)];
+    }
+
+    atomic_store(&paused, false);
+    return count;
+}
+
+void trace_clear(void) {
+    atomic_store(&head, 0);
+}
+
+const char *trace_name(trace_id_t id) {
+    return id < TRACE_ID_COUNT ? trace_names[id] : "unknown";
+}
+
+// One event per line: "<timestamp_us> <phase> <name> <arg> <task>", the
+// format host/trace/trace_json parses
+int trace_format_event(const trace_event_t *event, char *buf, size_t buf_len) {
+    if (event == NULL || buf == NULL) return 0;
+
+    const char *task = hal_task_name(event->task);
+    return snprintf(buf, buf_len, "%lu %c %s %u %s", (unsigned long)event->timestamp_us,
+                    event->phase, trace_name((trace_id_t)event->id), event->arg,
+                    task ? task : "?");
+}
+
+// Print the ring straight from its slots, paused for the whole dump so the
+// log output itself is not traced over what is being printed
+void trace_dump(void) {
+    char line[64];
+    unsigned first;
+
+    unsigned count = trace_pause(TRACE_RING_SIZE, &first);
+    ESP_LOGI(TAG, "begin %u events", count);
+    for (unsigned i = 0; i < count; i++) {
+        trace_event_t event = ring[(first + i) & (TRACE_RING_SIZE - 1)];
+        trace_format_event(&event, line, sizeof(line));
+        ESP_LOGI(TAG, "%s", line);
+    }
+    ESP_LOGI(TAG, "end");
+
+    atomic_store(&paused, false);
+}
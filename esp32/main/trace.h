@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hal.h"
+
+// Lightweight trace points on the sample-to-air path. Each event is stamped
+// with hal_time_us() and the current task and written into a fixed RAM ring;
+// `trace` on the serial console dumps it and host/trace/trace_json turns the
+// dump into Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+#define TRACE_ENABLE            1       // 0 compiles every trace point out
+#define TRACE_RING_SIZE         512     // Events kept (power of two)
+
+// Event phases, as in the Chrome trace format
+#define TRACE_PH_BEGIN          'B'
+#define TRACE_PH_END            'E'
+#define TRACE_PH_INSTANT        'i'
+
+typedef enum {
+    TRACE_SENSOR_READ = 0,      // sensor_read_all (polled capture)
+    TRACE_EDGE_SETTLE,          // Debouncer settled a new mask (arg: mask)
+    TRACE_UPDATE_LEVELS,        // tank_monitor_update_levels
+    TRACE_CHECK_STABILITY,      // tank_monitor_check_stability
+    TRACE_NOTIFY_WAKE,          // Notifier task woke (arg: 1 if signalled)
+    TRACE_BLE_UPDATE,           // ble_update_tank_data
+    TRACE_SEND_INDICATE,        // esp_ble_gatts_send_indicate (arg: conn_id)
+    TRACE_GATT_EVENT,           // gatts_profile_event_handler (arg: event)
+    TRACE_ID_COUNT
+} trace_id_t;
+
+typedef struct {
+    uint32_t timestamp_us;      // Wraps after ~71 minutes
+    hal_task_t task;
+    uint16_t arg;
+    uint8_t phase;
+    uint8_t id;
+} trace_event_t;
+
+// Function prototypes
+void trace_record(uint8_t phase, trace_id_t id, uint16_t arg);
+size_t trace_snapshot(trace_event_t *events, size_t max_events);
+void trace_clear(void);
+const char *trace_name(trace_id_t id);
+int trace_format_event(const trace_event_t *event, char *buf, size_t buf_len);
+void trace_dump(void);
+
+#if TRACE_ENABLE
+#define TRACE_BEGIN(id, arg)    trace_record(TRACE_PH_BEGIN, (id), (uint16_t)(arg))
+#define TRACE_END(id)           trace_record(TRACE_PH_END, (id), 0)
+#define TRACE_INSTANT(id, arg)  trace_record(TRACE_PH_INSTANT, (id), (uint16_t)(arg))
+#else
+#define TRACE_BEGIN(id, arg)    ((void)0)
+#define TRACE_END(id)           ((void)0)
+#define TRACE_INSTANT(id, arg)  ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,53 @@
+#include "wake_stats.h"
+#include <stddef.h>
+
+static const char *const wake_source_names[WAKE_SRC_COUNT] = {
+    [WAKE_SRC_SENSOR_EVENT] = "sensor_event",
+    [WAKE_SRC_DEBOUNCE] = "debounce",
+    [WAKE_SRC_STABILITY] = "stability",
+    [WAKE_SRC_POLL] = "poll",
+    [WAKE_SRC_STATE_CHANGE] = "state_change",
+    [WAKE_SRC_HEARTBEAT] = "heartbeat",
+    [WAKE_SRC_BACKFILL] = "backfill",
+    [WAKE_SRC_BUTTON] = "button",
+    [WAKE_SRC_BUTTON_POLL] = "button_poll",
+};
+
+void wake_stats_init(wake_stats_t *stats) {
+    if (stats == NULL) return;
+
+    for (int i = 0; i < WAKE_SRC_COUNT; i++) {
+        atomic_init(&stats->counts[i], 0);
+    }
+}
+
+void wake_stats_note(wake_stats_t *stats, wake_source_t source) {
+    if (source >= WAKE_SRC_COUNT) return;
+
+    atomic_fetch_add_explicit(&stats->counts[source], 1, memory_order_relaxed);
+}
+
+uint32_t wake_stats_get(wake_stats_t *stats, wake_source_t source) {
+    if (source >= WAKE_SRC_COUNT) return 0;
+
+    return atomic_load_explicit(&stats->counts[source], memory_order_relaxed);
+}
+
+uint32_t wake_stats_total(wake_stats_t *stats) {
+    uint32_t total = 0;
+
+    for (int i = 0; i < WAKE_SRC_COUNT; i++) {
+        total += atomic_load_explicit(&stats->counts[i], memory_order_relaxed);
+    }
+    return total;
+}
+
+uint32_t wake_stats_per_hour(uint32_t count, uint64_t elapsed_us) {
+    if (elapsed_us == 0) return 0;
+
+    return (uint32_t)(((uint64_t)count * 3600000000ULL) / elapsed_us);
+}
+
+const char *wake_source_name(wake_source_t source) {
+    return source < WAKE_SRC_COUNT ? wake_source_names[source] : "unknown";
+}
@@ -0,0 +1,34 @@
+#ifndef WAKE_STATS_H
+#define WAKE_STATS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Why a task left its blocking wait
+typedef enum {
+    WAKE_SRC_SENSOR_EVENT = 0,  // Edge or enable request notified the monitor
+    WAKE_SRC_DEBOUNCE,          // Debounce deadline expired
+    WAKE_SRC_STABILITY,         // Stability deadline expired
+    WAKE_SRC_POLL,              // Polled-mode sample period
+    WAKE_SRC_STATE_CHANGE,      // Notifier woken by a published change
+    WAKE_SRC_HEARTBEAT,         // Notifier heartbeat timeout
+    WAKE_SRC_BACKFILL,          // Notifier streaming history chunks
+    WAKE_SRC_BUTTON,            // BOOT button interrupt
+    WAKE_SRC_BUTTON_POLL,       // BOOT button hold polling
+    WAKE_SRC_COUNT
+} wake_source_t;
+
+// Per-source wakeup counters, safe to bump from any task
+typedef struct {
+    atomic_uint counts[WAKE_SRC_COUNT];
+} wake_stats_t;
+
+// Function prototypes
+void wake_stats_init(wake_stats_t *stats);
+void wake_stats_note(wake_stats_t *stats, wake_source_t source);
+uint32_t wake_stats_get(wake_stats_t *stats, wake_source_t source);
+uint32_t wake_stats_total(wake_stats_t *stats);
+uint32_t wake_stats_per_hour(uint32_t count, uint64_t elapsed_us);
+const char *wake_source_name(wake_source_t source);
+
+#endif // WAKE_STATS_H
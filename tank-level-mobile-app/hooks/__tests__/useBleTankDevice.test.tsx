@@ -1,4 +1,5 @@
 import React from 'react';
+import { Buffer } from 'buffer';
 import { act, renderHook } from '@testing-library/react-native';
 import { Device } from 'react-native-ble-plx';
 
@@ -18,6 +19,7 @@ const mockStopPolling = jest.fn();
 const mockAuthenticate = jest.fn(async () => true);
 const mockDisconnect = jest.fn();
 const mockWriteCommand = jest.fn();
+const mockRunCommands = jest.fn();
 const mockEnsureDisconnected = jest.fn(async () => {});
 
 jest.mock('@/lib/tankBleClient', () => {
@@ -34,6 +36,7 @@ jest.mock('@/lib/tankBleClient', () => {
       authenticate: mockAuthenticate,
       disconnect: mockDisconnect,
       writeCommand: mockWriteCommand,
+      runCommands: mockRunCommands,
       ensureDisconnected: mockEnsureDisconnected,
       onDisconnected: jest.fn(() => ({ remove: jest.fn() })),
       isPolling: jest.fn(() => false),
@@ -132,6 +135,49 @@ describe('useBleTankDevice', () => {
     expect(mockStartPolling).toHaveBeenCalled();
   });
 
+  it('authenticates with one command batch when the device supports it', async () => {
+    const device: MockDevice = {
+      id: 'device-1',
+      name: 'RV Tanks 1111',
+      readCharacteristicForService: jest.fn().mockResolvedValue({ value: null }),
+    } as any;
+    mockConnect.mockResolvedValue({
+      device,
+      serviceUUID: 'ff00',
+      dataCharacteristicUUID: 'ff01',
+      commandCharacteristicUUID: 'ff09',
+    });
+    // v2 payload: grey 1/3, both tanks enabled and stable
+    const snapshot = Buffer.from([2, 0b000001, 0b00011111, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]).toString('base64');
+    mockRunCommands.mockResolvedValue({
+      truncated: false,
+      outcomes: [
+        { type: 0x01, status: 0, value: '' },
+        { type: 0x05, status: 0, value: '' },
+        { type: 0x06, status: 0, value: snapshot },
+      ],
+    });
+
+    const { result } = setup();
+
+    await act(async () => {
+      await result.current.api.connectToDevice(device);
+    });
+
+    let authResult: unknown;
+    await act(async () => {
+      authResult = await result.current.api.authenticateWithPin(device, '123456');
+    });
+
+    expect(authResult).toEqual({ status: 'success' });
+    expect(mockRunCommands).toHaveBeenCalledWith(
+      expect.objectContaining({ commandCharacteristicUUID: 'ff09' }),
+      [{ type: 'auth', pin: '123456' }, { type: 'setFormat', format: 2 }, { type: 'snapshot' }]
+    );
+    expect(mockAuthenticate).not.toHaveBeenCalled();
+    expect(result.current.context.state.authenticated).toBe(true);
+  });
+
   it('disconnects and resets connection state', async () => {
     const device: MockDevice = {
       id: 'device-1',
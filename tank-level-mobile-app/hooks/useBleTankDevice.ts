@@ -4,8 +4,17 @@ import { Alert, AppState, AppStateStatus } from 'react-native';
 import { Device } from 'react-native-ble-plx';
 
 import { useTankContext } from '../context/TankContext';
-import { buildTankData, decodeTankPayload, resolveAlertMessage, TankKind } from '../lib/tank';
+import {
+  buildTankData,
+  decodeTankPayload,
+  encodeTankConfig,
+  resolveAlertMessage,
+  TANK_PAYLOAD_V2,
+  TankKind,
+  TankTiming,
+} from '../lib/tank';
 import { TankBleClient, TankConnection } from '../lib/tankBleClient';
+import { findTankCommandOutcome, TANK_COMMAND_STATUS } from '../lib/tankCommand';
 import { encodePin, isValidPin } from '../lib/pin';
 import { AuthenticationResult, ChangePinResult } from '@/types/Auth';
 import { TankNotificationApi } from './useTankNotifications';
@@ -34,7 +43,7 @@ export const useBleTankDevice = ({ notifications }: UseBleTankDeviceArgs) => {
   }, [connectedDevice]);
 
   const updateSensorConfig = useCallback(
-    async (flags: { greyEnabled: boolean; blackEnabled: boolean }) => {
+    async (flags: { greyEnabled: boolean; blackEnabled: boolean }, timing?: TankTiming) => {
       if (!authenticated) {
         throw new Error('NOT_AUTHENTICATED');
       }
@@ -44,9 +53,17 @@ export const useBleTankDevice = ({ notifications }: UseBleTankDeviceArgs) => {
         throw new Error('NOT_CONNECTED');
       }
 
-      const payload = Buffer.from([flags.greyEnabled ? 1 : 0, flags.blackEnabled ? 1 : 0]).toString('base64');
+      // The command batch carries flags only; timing goes in the extended config write
+      const connection = connectionRef.current;
+      if (connection?.commandCharacteristicUUID && !timing) {
+        const result = await bleClient.runCommands(connection, [{ type: 'setConfig', ...flags }]);
+        if (findTankCommandOutcome(result, 'setConfig')?.status !== TANK_COMMAND_STATUS.ok) {
+          throw new Error('CONFIG_REJECTED');
+        }
+        return;
+      }
 
-      await bleClient.writeCommand(device, '00ff', 'ff03', payload);
+      await bleClient.writeCommand(device, '00ff', 'ff03', encodeTankConfig(flags, timing));
     },
     [authenticated, bleClient]
   );
@@ -132,14 +149,17 @@ export const useBleTankDevice = ({ notifications }: UseBleTankDeviceArgs) => {
 
       dispatch({ type: 'SET_TANK_DATA', payload: tankData });
 
-      if (!payload.systemStable) {
-        return;
+      if (payload.systemStable) {
+        actions.addTankHistory(tankData);
       }
 
-      actions.addTankHistory(tankData);
-
-      await handleTankAlert('grey', payload.greyEnabled ? payload.greyLevel : 0);
-      await handleTankAlert('black', payload.blackEnabled ? payload.blackLevel : 0);
+      // Each tank alerts as soon as it settles, without waiting for the other
+      if (payload.greyStable) {
+        await handleTankAlert('grey', payload.greyEnabled ? payload.greyLevel : 0);
+      }
+      if (payload.blackStable) {
+        await handleTankAlert('black', payload.blackEnabled ? payload.blackLevel : 0);
+      }
     },
     [actions, dispatch, handleTankAlert]
   );
@@ -206,6 +226,11 @@ export const useBleTankDevice = ({ notifications }: UseBleTankDeviceArgs) => {
           foundDevice = true;
           dispatch({ type: 'UPDATE_DEVICE', payload: device });
         },
+        onBroadcast: (_device, broadcast) => {
+          // Show advertised levels until a connection takes over
+          if (connectedDeviceRef.current) return;
+          dispatch({ type: 'SET_TANK_DATA', payload: buildTankData(broadcast.payload) });
+        },
         onError: (error) => {
           console.error('Scan error:', error);
           dispatch({ type: 'SET_SCANNING', payload: false });
@@ -227,9 +252,51 @@ export const useBleTankDevice = ({ notifications }: UseBleTankDeviceArgs) => {
     }
   }, [bleClient, connected, dispatch, scanning]);
 
+  // Firmware with the command characteristic authenticates, selects the v2
+  // payload and returns the first reading in one round trip. Returns null
+  // when the batch is unavailable or fails, so the caller falls back.
+  const authenticateWithCommands = useCallback(
+    async (device: Device, pin: string): Promise<AuthenticationResult | null> => {
+      const connection = connectionRef.current;
+      if (!connection?.commandCharacteristicUUID || connection.device.id !== device.id) {
+        return null;
+      }
+
+      try {
+        const result = await bleClient.runCommands(connection, [
+          { type: 'auth', pin },
+          { type: 'setFormat', format: TANK_PAYLOAD_V2 },
+          { type: 'snapshot' },
+        ]);
+        const auth = findTankCommandOutcome(result, 'auth');
+        const snapshot = findTankCommandOutcome(result, 'snapshot');
+
+        if (auth?.status === TANK_COMMAND_STATUS.wrongPin) {
+          return { status: 'invalid-pin' };
+        }
+        if (auth?.status !== TANK_COMMAND_STATUS.ok || snapshot?.status !== TANK_COMMAND_STATUS.ok) {
+          return null;
+        }
+
+        await handleTankData(snapshot.value);
+        dispatch({ type: 'SET_AUTHENTICATED', payload: true });
+        return { status: 'success' };
+      } catch (error) {
+        console.log('Command batch failed, using single writes:', error);
+        return null;
+      }
+    },
+    [bleClient, dispatch, handleTankData]
+  );
+
   const authenticateWithPin = useCallback(
     async (device: Device, pin: string): Promise<AuthenticationResult> => {
       try {
+        const batched = await authenticateWithCommands(device, pin);
+        if (batched) {
+          return batched;
+        }
+
         const encodedPin = encodePin(pin);
         const success = await bleClient.authenticate(device, [
           { service: '00ff', characteristic: 'ff02', value: encodedPin },
@@ -246,6 +313,15 @@ export const useBleTankDevice = ({ notifications }: UseBleTankDeviceArgs) => {
 
         let authSucceeded = false;
 
+        // Ask for the v2 payload (sequence + timing); older firmware rejects
+        // the write and keeps sending v1, which the decoder also handles
+        try {
+          const format = Buffer.from([TANK_PAYLOAD_V2]).toString('base64');
+          await bleClient.writeCommand(device, '00ff', 'ff01', format);
+        } catch (error) {
+          console.log('Tank data v2 not supported, using v1');
+        }
+
         try {
           const characteristic = await device.readCharacteristicForService('00ff', 'ff01');
           if (characteristic?.value) {
@@ -272,7 +348,7 @@ export const useBleTankDevice = ({ notifications }: UseBleTankDeviceArgs) => {
         };
       }
     },
-    [bleClient, dispatch, handleTankData]
+    [authenticateWithCommands, bleClient, dispatch, handleTankData]
   );
 
   const changePinOnDevice = useCallback(
@@ -291,8 +367,16 @@ export const useBleTankDevice = ({ notifications }: UseBleTankDeviceArgs) => {
       }
 
       try {
-        const payload = Buffer.from(nextPin).toString('base64');
-        await bleClient.writeCommand(device, '00ff', 'ff04', payload);
+        const connection = connectionRef.current;
+        if (connection?.commandCharacteristicUUID) {
+          const result = await bleClient.runCommands(connection, [{ type: 'changePin', pin: nextPin }]);
+          if (findTankCommandOutcome(result, 'changePin')?.status !== TANK_COMMAND_STATUS.ok) {
+            return { status: 'error', message: 'The device rejected the new PIN.' };
+          }
+        } else {
+          const payload = Buffer.from(nextPin).toString('base64');
+          await bleClient.writeCommand(device, '00ff', 'ff04', payload);
+        }
         dispatch({ type: 'SET_PIN', payload: nextPin });
         return { status: 'success', message: 'PIN updated on the device.' };
       } catch (error) {
@@ -1,4 +1,6 @@
-import { buildTankData, computeTankLevel, decodeTankPayload, resolveAlertMessage } from '../tank';
+import { Buffer } from 'buffer';
+
+import { buildTankData, computeTankLevel, decodeTankPayload, encodeTankConfig, resolveAlertMessage } from '../tank';
 
 const alerts = {
   grey13: true,
@@ -36,9 +38,65 @@ describe('tank helpers', () => {
       expect(payload.greyLevel).toBe(1);
       expect(payload.blackLevel).toBe(2);
       expect(payload.systemStable).toBe(true);
+      expect(payload.greyStable).toBe(true);
+      expect(payload.blackStable).toBe(true);
       expect(payload.greyEnabled).toBe(false);
       expect(payload.blackEnabled).toBe(false);
       expect(payload.raw).toHaveLength(9);
+      expect(payload.version).toBe(1);
+      expect(payload.sequence).toBeUndefined();
+    });
+
+    it('decodes v2 payload with sequence and timing', () => {
+      const bytes = Buffer.alloc(15);
+      bytes[0] = 2;
+      bytes[1] = 0b011001; // grey 1/3, black 1/3 and 2/3
+      bytes[2] = 0b101; // grey enabled, stable
+      bytes.writeUInt32LE(42, 3);
+      bytes.writeUInt32LE(120000, 7);
+      bytes.writeUInt32LE(0, 11);
+
+      const payload = decodeTankPayload(bytes.toString('base64'));
+      expect(payload.version).toBe(2);
+      expect(payload.greySensors).toEqual([1, 0, 0]);
+      expect(payload.blackSensors).toEqual([1, 1, 0]);
+      expect(payload.greyLevel).toBe(1);
+      expect(payload.blackLevel).toBe(2);
+      expect(payload.greyEnabled).toBe(true);
+      expect(payload.blackEnabled).toBe(false);
+      expect(payload.systemStable).toBe(true);
+      expect(payload.sequence).toBe(42);
+      expect(payload.msSinceChange).toBe(120000);
+      expect(payload.msUntilStable).toBe(0);
+    });
+
+    it('decodes per-tank stability from v2 flags', () => {
+      const bytes = Buffer.alloc(15);
+      bytes[0] = 2;
+      bytes[2] = 0b01011; // both enabled, grey stable only
+      bytes.writeUInt32LE(9000, 11);
+
+      const payload = decodeTankPayload(bytes.toString('base64'));
+      expect(payload.systemStable).toBe(false);
+      expect(payload.greyStable).toBe(true);
+      expect(payload.blackStable).toBe(false);
+      expect(buildTankData(payload).greyStable).toBe(true);
+      expect(buildTankData(payload).blackStable).toBe(false);
+    });
+
+    it('decodes motion and sensor fault flags', () => {
+      const bytes = Buffer.alloc(15);
+      bytes[0] = 2;
+      bytes[2] = 0b01100000; // in motion, grey fault
+
+      const payload = decodeTankPayload(bytes.toString('base64'));
+      expect(payload.inMotion).toBe(true);
+      expect(payload.greySensorFault).toBe(true);
+      expect(payload.blackSensorFault).toBe(false);
+
+      const data = buildTankData(payload);
+      expect(data.inMotion).toBe(true);
+      expect(data.greySensorFault).toBe(true);
     });
   });
 
@@ -47,12 +105,46 @@ describe('tank helpers', () => {
       const payload = decodeTankPayload('AQAAAAEAAAAB');
       const data = buildTankData(payload);
       expect(data.greyLevel).toBe(payload.greyLevel);
-      expect(data.greyStable).toBe(payload.systemStable);
+      expect(data.greyStable).toBe(payload.greyStable);
       expect(data.greyEnabled).toBe(payload.greyEnabled);
       expect(data.blackLevel).toBe(payload.blackLevel);
-      expect(data.blackStable).toBe(payload.systemStable);
+      expect(data.blackStable).toBe(payload.blackStable);
       expect(data.blackEnabled).toBe(payload.blackEnabled);
       expect(data.timestamp).toBeInstanceOf(Date);
+      expect(data.sequence).toBeUndefined();
+      expect(data.inMotion).toBeUndefined();
+    });
+
+    it('derives change time from v2 payloads', () => {
+      const bytes = Buffer.alloc(15);
+      bytes[0] = 2;
+      bytes.writeUInt32LE(7, 3);
+      bytes.writeUInt32LE(5000, 7);
+
+      const receivedAt = new Date(1_000_000);
+      const data = buildTankData(decodeTankPayload(bytes.toString('base64')), receivedAt);
+      expect(data.timestamp).toBe(receivedAt);
+      expect(data.sequence).toBe(7);
+      expect(data.changedAt?.getTime()).toBe(995_000);
+    });
+  });
+
+  describe('encodeTankConfig', () => {
+    it('writes the two enable flags alone without timing', () => {
+      expect(Array.from(Buffer.from(encodeTankConfig({ greyEnabled: true, blackEnabled: false }), 'base64'))).toEqual([1, 0]);
+    });
+
+    it('appends timing fields, zero for the ones left out', () => {
+      const bytes = Buffer.from(
+        encodeTankConfig({ greyEnabled: false, blackEnabled: true }, { samplePeriodMs: 500, settleMaxMs: 300000 }),
+        'base64'
+      );
+      expect(bytes).toHaveLength(18);
+      expect([bytes[0], bytes[1]]).toEqual([0, 1]);
+      expect(bytes.readUInt32LE(2)).toBe(500);
+      expect(bytes.readUInt32LE(6)).toBe(0);
+      expect(bytes.readUInt32LE(10)).toBe(300000);
+      expect(bytes.readUInt32LE(14)).toBe(0);
     });
   });
 
@@ -1,4 +1,6 @@
-import { TankBleClient } from '../tankBleClient';
+import { Buffer } from 'buffer';
+
+import { decodeTankBroadcast, TankBleClient } from '../tankBleClient';
 
 describe('TankBleClient', () => {
   const createManager = () => {
@@ -43,6 +45,53 @@ describe('TankBleClient', () => {
     expect(onDevice).toHaveBeenCalledWith(expect.objectContaining({ id: '2', name: 'RV Tanks ABCDEF12' }));
   });
 
+  it('forwards tank state from advertising manufacturer data', () => {
+    const manager = createManager();
+    const client = new TankBleClient({ manager: manager as any, validNamePatterns: [/^RV Tanks/] });
+    const onBroadcast = jest.fn();
+
+    let callback: ((error: unknown, device: any) => void) | undefined;
+    (manager.startDeviceScan as jest.Mock).mockImplementation((_, __, cb) => {
+      callback = cb;
+    });
+
+    client.startScan({ onDevice: jest.fn(), onBroadcast });
+
+    // Grey at 2/3, black full; both enabled and stable; counter 7
+    const manufacturerData = Buffer.from([0xff, 0xff, 1, 0b111011, 0b00011111, 7]).toString('base64');
+    callback?.(null, { id: '1', name: 'RV Tanks ABCDEF12' });
+    callback?.(null, { id: '2', name: 'RV Tanks ABCDEF12', manufacturerData });
+
+    expect(onBroadcast).toHaveBeenCalledTimes(1);
+    const [device, broadcast] = onBroadcast.mock.calls[0];
+    expect(device.id).toBe('2');
+    expect(broadcast.counter).toBe(7);
+    expect(broadcast.payload).toEqual(
+      expect.objectContaining({ greyLevel: 2, blackLevel: 3, greyEnabled: true, blackEnabled: true, systemStable: true })
+    );
+  });
+
+  it('ignores manufacturer data from other companies or versions', () => {
+    expect(decodeTankBroadcast(null)).toBeNull();
+    expect(decodeTankBroadcast(Buffer.from([0x4c, 0x00, 1, 0, 0, 0]).toString('base64'))).toBeNull();
+    expect(decodeTankBroadcast(Buffer.from([0xff, 0xff, 9, 0, 0, 0]).toString('base64'))).toBeNull();
+    expect(decodeTankBroadcast(Buffer.from([0xff, 0xff, 1, 0]).toString('base64'))).toBeNull();
+
+    const broadcast = decodeTankBroadcast(Buffer.from([0xff, 0xff, 1, 0b000001, 0b01100001, 255]).toString('base64'));
+    expect(broadcast?.payload).toEqual(
+      expect.objectContaining({
+        greyLevel: 1,
+        blackLevel: 0,
+        systemStable: false,
+        greyStable: false,
+        inMotion: true,
+        greySensorFault: true,
+        blackSensorFault: false,
+      })
+    );
+    expect(broadcast?.payload.sequence).toBeUndefined();
+  });
+
   it('stops scanning and calls onStop handler', () => {
     jest.useFakeTimers();
     const manager = createManager();
@@ -88,6 +137,98 @@ describe('TankBleClient', () => {
     expect(connection.dataCharacteristicUUID.toLowerCase()).toContain('ff01');
   });
 
+  it('runs command batches over the indicating command characteristic', async () => {
+    const manager = createManager();
+    let indicate: ((error: unknown, characteristic: any) => void) | undefined;
+    const full = Buffer.from([1, 2, 0x01, 0, 0, 0x06, 0, 2, 2, 7]).toString('base64');
+    const mockDevice: any = {
+      id: 'device-id',
+      discoverAllServicesAndCharacteristics: jest.fn(async () => mockDevice),
+      services: jest.fn(async () => [
+        {
+          uuid: '0000ff00-0000-1000-8000-00805f9b34fb',
+          characteristics: async () => [
+            { uuid: '0000ff01-0000-1000-8000-00805f9b34fb' },
+            { uuid: '0000ff09-0000-1000-8000-00805f9b34fb' },
+          ],
+        },
+      ]),
+      monitorCharacteristicForService: jest.fn((_service, _char, listener) => {
+        indicate = listener;
+        return { remove: jest.fn() };
+      }),
+      writeCharacteristicWithResponseForService: jest.fn(async () => {
+        // MTU 23 leaves room for 8 of the 10 result bytes
+        indicate?.(null, { value: Buffer.from([1, 2, 0x01, 0, 0, 0x06, 0, 2]).toString('base64') });
+        return {};
+      }),
+      readCharacteristicForService: jest.fn(async () => ({ value: full })),
+    };
+
+    (manager.connectToDevice as jest.Mock).mockResolvedValue(mockDevice);
+
+    const client = new TankBleClient({ manager: manager as any });
+    const connection = await client.connect('device-id');
+    expect(connection.commandCharacteristicUUID?.toLowerCase()).toContain('ff09');
+
+    const result = await client.runCommands(connection, [{ type: 'auth', pin: '123456' }, { type: 'snapshot' }]);
+
+    expect(mockDevice.writeCharacteristicWithResponseForService).toHaveBeenCalledTimes(1);
+    expect(mockDevice.readCharacteristicForService).toHaveBeenCalledTimes(1);
+    expect(result.truncated).toBe(false);
+    expect(result.outcomes.map((outcome) => outcome.status)).toEqual([0, 0]);
+    expect(Array.from(Buffer.from(result.outcomes[1].value, 'base64'))).toEqual([2, 7]);
+  });
+
+  it('runs one command batch at a time', async () => {
+    const manager = createManager();
+    let indicate: ((error: unknown, characteristic: any) => void) | undefined;
+    const writes: number[] = [];
+    const mockDevice: any = {
+      id: 'device-id',
+      discoverAllServicesAndCharacteristics: jest.fn(async () => mockDevice),
+      services: jest.fn(async () => [
+        {
+          uuid: '0000ff00-0000-1000-8000-00805f9b34fb',
+          characteristics: async () => [
+            { uuid: '0000ff01-0000-1000-8000-00805f9b34fb' },
+            { uuid: '0000ff09-0000-1000-8000-00805f9b34fb' },
+          ],
+        },
+      ]),
+      monitorCharacteristicForService: jest.fn((_service, _char, listener) => {
+        indicate = listener;
+        return { remove: jest.fn() };
+      }),
+      writeCharacteristicWithResponseForService: jest.fn(async () => {
+        // Each batch's result arrives after its write response
+        const batch = writes.length + 1;
+        writes.push(batch);
+        setTimeout(() => {
+          indicate?.(null, { value: Buffer.from([1, 2, 0x01, 0, 0, 0x06, 0, 2, 2, batch]).toString('base64') });
+        }, 0);
+        return {};
+      }),
+      readCharacteristicForService: jest.fn(),
+    };
+
+    (manager.connectToDevice as jest.Mock).mockResolvedValue(mockDevice);
+
+    const client = new TankBleClient({ manager: manager as any });
+    const connection = await client.connect('device-id');
+
+    const first = client.runCommands(connection, [{ type: 'auth', pin: '123456' }, { type: 'snapshot' }]);
+    const second = client.runCommands(connection, [{ type: 'auth', pin: '123456' }, { type: 'snapshot' }]);
+    const results = await Promise.all([first, second]);
+
+    expect(writes).toEqual([1, 2]);
+    expect(mockDevice.readCharacteristicForService).not.toHaveBeenCalled();
+    expect(results.map((result) => Array.from(Buffer.from(result.outcomes[1].value, 'base64')))).toEqual([
+      [2, 1],
+      [2, 2],
+    ]);
+  });
+
   it('throws when expected service cannot be found', async () => {
     const manager = createManager();
     const mockDevice = {
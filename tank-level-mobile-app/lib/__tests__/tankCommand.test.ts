@@ -0,0 +1,64 @@
+import { Buffer } from 'buffer';
+
+import {
+  decodeTankCommandResult,
+  encodeTankCommands,
+  findTankCommandOutcome,
+  TANK_COMMAND_STATUS,
+} from '../tankCommand';
+
+const bytes = (value: string) => Array.from(Buffer.from(value, 'base64'));
+const base64 = (values: number[]) => Buffer.from(values).toString('base64');
+
+describe('tank command batches', () => {
+  describe('encodeTankCommands', () => {
+    it('packs operations as type, length and value after the version', () => {
+      const encoded = encodeTankCommands([
+        { type: 'auth', pin: '123456' },
+        { type: 'setFormat', format: 2 },
+        { type: 'snapshot' },
+      ]);
+
+      expect(bytes(encoded)).toEqual([1, 0x01, 6, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x05, 1, 2, 0x06, 0]);
+    });
+
+    it('encodes config flags and sampling windows', () => {
+      const encoded = encodeTankCommands([
+        { type: 'setConfig', greyEnabled: true, blackEnabled: false },
+        { type: 'setSampling', settleMinMs: 15000, settleMaxMs: 90000 },
+      ]);
+
+      expect(bytes(encoded)).toEqual([1, 0x02, 2, 1, 0, 0x04, 8, 0x98, 0x3a, 0, 0, 0x90, 0x5f, 0x01, 0]);
+    });
+
+    it('rejects empty and oversized batches', () => {
+      expect(() => encodeTankCommands([])).toThrow('INVALID_COMMAND_BATCH');
+      expect(() => encodeTankCommands(Array(9).fill({ type: 'snapshot' }))).toThrow('INVALID_COMMAND_BATCH');
+    });
+  });
+
+  describe('decodeTankCommandResult', () => {
+    it('returns per-operation status and values', () => {
+      const result = decodeTankCommandResult(base64([1, 2, 0x01, 0x89, 0, 0x06, 0, 3, 9, 8, 7]));
+
+      expect(result?.truncated).toBe(false);
+      expect(result?.outcomes).toHaveLength(2);
+      expect(findTankCommandOutcome(result!, 'auth')?.status).toBe(TANK_COMMAND_STATUS.wrongPin);
+      expect(bytes(findTankCommandOutcome(result!, 'snapshot')!.value)).toEqual([9, 8, 7]);
+      expect(findTankCommandOutcome(result!, 'setConfig')).toBeUndefined();
+    });
+
+    it('flags a result cut short at the MTU', () => {
+      const result = decodeTankCommandResult(base64([1, 2, 0x01, 0, 0, 0x06, 0, 15, 2, 0]));
+
+      expect(result?.truncated).toBe(true);
+      expect(result?.outcomes).toHaveLength(1);
+    });
+
+    it('ignores empty values and unknown versions', () => {
+      expect(decodeTankCommandResult(null)).toBeNull();
+      expect(decodeTankCommandResult(base64([1]))).toBeNull();
+      expect(decodeTankCommandResult(base64([2, 0]))).toBeNull();
+    });
+  });
+});
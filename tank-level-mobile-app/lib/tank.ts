@@ -3,19 +3,65 @@ import { Buffer } from 'buffer';
 import Alerts from '@/types/Alerts';
 import TankData from '@/types/TankData';
 
+export const TANK_PAYLOAD_V1 = 1;
+export const TANK_PAYLOAD_V2 = 2;
+const TANK_PAYLOAD_V2_LENGTH = 15;
+
 export interface DecodedTankPayload {
+  version: number;
   greySensors: [number, number, number];
   blackSensors: [number, number, number];
+  /** Both tanks stable */
   systemStable: boolean;
+  /** Per-tank stability; v1 payloads only carry systemStable, so both mirror it */
+  greyStable: boolean;
+  blackStable: boolean;
   greyLevel: number;
   blackLevel: number;
   greyEnabled: boolean;
   blackEnabled: boolean;
+  /** v2 only: increments whenever the device state changes; a jump means a missed update */
+  sequence?: number;
+  /** v2 only: milliseconds since the last level change */
+  msSinceChange?: number;
+  /** v2 only: milliseconds until the reading is considered stable (0 once stable) */
+  msUntilStable?: number;
+  /** v2 only: sensors are flapping - vehicle moving or liquid unsettled */
+  inMotion?: boolean;
+  /** v2 only: a sensor in the tank is stuck or disagrees with the ones below it */
+  greySensorFault?: boolean;
+  blackSensorFault?: boolean;
   raw: number[];
 }
 
 export type TankKind = 'grey' | 'black';
 
+/** Sampling and filter timing stored on the device; a field left out keeps its current value */
+export interface TankTiming {
+  /** Polled sample period (20-5000 ms); unused with edge capture */
+  samplePeriodMs?: number;
+  settleMinMs?: number;
+  /** Up to 600000 ms, and at least settleMinMs */
+  settleMaxMs?: number;
+  /** Edge-capture quiet time (1-5000 ms); unused with polled sampling */
+  debounceMs?: number;
+}
+
+/** Config characteristic (0xFF03) write: the enable flags, then the timing when given */
+export const encodeTankConfig = (
+  flags: { greyEnabled: boolean; blackEnabled: boolean },
+  timing?: TankTiming
+): string => {
+  const bytes = Buffer.alloc(timing ? 18 : 2);
+  bytes[0] = flags.greyEnabled ? 1 : 0;
+  bytes[1] = flags.blackEnabled ? 1 : 0;
+  if (timing) {
+    const fields = [timing.samplePeriodMs, timing.settleMinMs, timing.settleMaxMs, timing.debounceMs];
+    fields.forEach((value, index) => bytes.writeUInt32LE(value ?? 0, 2 + index * 4));
+  }
+  return bytes.toString('base64');
+};
+
 export const computeTankLevel = (
   sensor13: number,
   sensor23: number,
@@ -27,9 +73,54 @@ export const computeTankLevel = (
   return 0;
 };
 
+/**
+ * Decode the sensor and flag bytes of the v2 layout, shared by the v2
+ * payload and the advertising broadcast
+ */
+export const decodeTankStateBits = (
+  sensors: number,
+  flags: number
+): Omit<DecodedTankPayload, 'version' | 'sequence' | 'msSinceChange' | 'msUntilStable' | 'raw'> => {
+  const bit = (value: number, index: number) => (value >> index) & 1;
+
+  const greySensors: [number, number, number] = [bit(sensors, 0), bit(sensors, 1), bit(sensors, 2)];
+  const blackSensors: [number, number, number] = [bit(sensors, 3), bit(sensors, 4), bit(sensors, 5)];
+  const systemStable = bit(flags, 2) === 1;
+
+  return {
+    greySensors,
+    blackSensors,
+    systemStable,
+    // Firmware without per-tank flags only sets the combined bit
+    greyStable: systemStable || bit(flags, 3) === 1,
+    blackStable: systemStable || bit(flags, 4) === 1,
+    greyLevel: computeTankLevel(...greySensors),
+    blackLevel: computeTankLevel(...blackSensors),
+    greyEnabled: bit(flags, 0) === 1,
+    blackEnabled: bit(flags, 1) === 1,
+    inMotion: bit(flags, 5) === 1,
+    greySensorFault: bit(flags, 6) === 1,
+    blackSensorFault: bit(flags, 7) === 1,
+  };
+};
+
+const decodeTankPayloadV2 = (data: Buffer): DecodedTankPayload => ({
+  version: TANK_PAYLOAD_V2,
+  ...decodeTankStateBits(data[1], data[2]),
+  sequence: data.readUInt32LE(3),
+  msSinceChange: data.readUInt32LE(7),
+  msUntilStable: data.readUInt32LE(11),
+  raw: Array.from(data),
+});
+
 export const decodeTankPayload = (value: string): DecodedTankPayload => {
   const data = Buffer.from(value, 'base64');
 
+  // v1 payloads are 9 bytes of 0/1 values, so a leading 2 identifies v2
+  if (data.length >= TANK_PAYLOAD_V2_LENGTH && data[0] === TANK_PAYLOAD_V2) {
+    return decodeTankPayloadV2(data);
+  }
+
   const greyLevel = computeTankLevel(data[0], data[1], data[2]);
   const blackLevel = computeTankLevel(data[3], data[4], data[5]);
   const systemStable = data[8] === 1;
@@ -37,9 +128,12 @@ export const decodeTankPayload = (value: string): DecodedTankPayload => {
   const blackEnabled = data[7] === 1;
 
   return {
+    version: TANK_PAYLOAD_V1,
     greySensors: [data[0], data[1], data[2]],
     blackSensors: [data[3], data[4], data[5]],
     systemStable,
+    greyStable: systemStable,
+    blackStable: systemStable,
     greyLevel,
     blackLevel,
     greyEnabled,
@@ -48,14 +142,21 @@ export const decodeTankPayload = (value: string): DecodedTankPayload => {
   };
 };
 
-export const buildTankData = (payload: DecodedTankPayload): TankData => ({
+export const buildTankData = (payload: DecodedTankPayload, receivedAt: Date = new Date()): TankData => ({
   greyLevel: payload.greyLevel,
-  greyStable: payload.systemStable,
+  greyStable: payload.greyStable,
   greyEnabled: payload.greyEnabled,
   blackLevel: payload.blackLevel,
-  blackStable: payload.systemStable,
+  blackStable: payload.blackStable,
   blackEnabled: payload.blackEnabled,
-  timestamp: new Date(),
+  timestamp: receivedAt,
+  ...(payload.sequence !== undefined && { sequence: payload.sequence }),
+  ...(payload.inMotion !== undefined && { inMotion: payload.inMotion }),
+  ...(payload.greySensorFault !== undefined && { greySensorFault: payload.greySensorFault }),
+  ...(payload.blackSensorFault !== undefined && { blackSensorFault: payload.blackSensorFault }),
+  ...(payload.msSinceChange !== undefined && {
+    changedAt: new Date(receivedAt.getTime() - payload.msSinceChange),
+  }),
 });
 
 export const resolveAlertMessage = (
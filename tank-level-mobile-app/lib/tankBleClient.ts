@@ -7,11 +7,16 @@ import {
   Subscription,
 } from 'react-native-ble-plx';
 import { PermissionsAndroid, Platform } from 'react-native';
+import { Buffer } from 'buffer';
+
+import { DecodedTankPayload, decodeTankStateBits, TANK_PAYLOAD_V2 } from './tank';
+import { decodeTankCommandResult, encodeTankCommands, TankCommand, TankCommandResult } from './tankCommand';
 
 export interface TankBleClientConfig {
   pollIntervalMs?: number;
   scanDurationMs?: number;
   validNamePatterns?: RegExp[];
+  commandTimeoutMs?: number;
   manager?: BleManager;
 }
 
@@ -19,10 +24,20 @@ export interface TankConnection {
   device: Device;
   serviceUUID: string;
   dataCharacteristicUUID: string;
+  /** Batched command characteristic (0xFF09); absent on older firmware */
+  commandCharacteristicUUID?: string;
+}
+
+export interface TankBroadcast {
+  /** Low byte of the device sequence; changes on every state change, wraps at 256 */
+  counter: number;
+  payload: DecodedTankPayload;
 }
 
 export interface ScanOptions {
   onDevice: (device: Device) => void;
+  /** Called for advertisements that carry tank state in their manufacturer data */
+  onBroadcast?: (device: Device, broadcast: TankBroadcast) => void;
   onError?: (error: BleError) => void;
   onStop?: () => void;
   durationMs?: number;
@@ -36,25 +51,56 @@ export interface AuthFormat {
 
 const DEFAULT_POLL_INTERVAL = 2000;
 const DEFAULT_SCAN_DURATION = 10000;
+const DEFAULT_COMMAND_TIMEOUT = 5000;
 const DEFAULT_VALID_PATTERNS = [/^RV Tanks [0-9A-Fa-f]{8}$/, /^RV_Tank_Monitor$/];
 
+// Advertising manufacturer data: company ID (u16 LE), version, then the
+// sensor and flag bytes of the v2 tank payload and a rolling counter
+export const TANK_ADV_COMPANY_ID = 0xffff;
+export const TANK_ADV_VERSION = 1;
+const TANK_ADV_LENGTH = 6;
+
+export const decodeTankBroadcast = (manufacturerData: string | null | undefined): TankBroadcast | null => {
+  if (!manufacturerData) return null;
+
+  const data = Buffer.from(manufacturerData, 'base64');
+  if (data.length < TANK_ADV_LENGTH || data.readUInt16LE(0) !== TANK_ADV_COMPANY_ID || data[2] !== TANK_ADV_VERSION) {
+    return null;
+  }
+
+  return {
+    counter: data[5],
+    payload: {
+      version: TANK_PAYLOAD_V2,
+      ...decodeTankStateBits(data[3], data[4]),
+      raw: Array.from(data),
+    },
+  };
+};
+
 export class TankBleClient {
   private readonly manager: BleManager;
   private readonly pollIntervalMs: number;
   private readonly defaultScanDuration: number;
   private readonly validPatterns: RegExp[];
+  private readonly commandTimeoutMs: number;
 
   private pollTimer: ReturnType<typeof setInterval> | null = null;
   private stateSubscription: Subscription | null = null;
   private disconnectSubscription: Subscription | null = null;
   private scanTimeout: ReturnType<typeof setTimeout> | null = null;
   private scanStopHandler: (() => void) | undefined;
+  private commandSubscription: Subscription | null = null;
+  private commandWaiter: ((value: string | null) => void) | null = null;
+  // Batches share the one command characteristic, so each waits for the last
+  private commandQueue: Promise<unknown> = Promise.resolve();
 
   constructor(config: TankBleClientConfig = {}) {
     this.manager = config.manager ?? new BleManager();
     this.pollIntervalMs = config.pollIntervalMs ?? DEFAULT_POLL_INTERVAL;
     this.defaultScanDuration = config.scanDurationMs ?? DEFAULT_SCAN_DURATION;
     this.validPatterns = config.validNamePatterns ?? DEFAULT_VALID_PATTERNS;
+    this.commandTimeoutMs = config.commandTimeoutMs ?? DEFAULT_COMMAND_TIMEOUT;
   }
 
   async currentState(): Promise<State> {
@@ -76,7 +122,7 @@ export class TankBleClient {
     ]);
   }
 
-  startScan({ onDevice, onError, onStop, durationMs }: ScanOptions): void {
+  startScan({ onDevice, onBroadcast, onError, onStop, durationMs }: ScanOptions): void {
     this.stopScan();
 
     const scanDuration = durationMs ?? this.defaultScanDuration;
@@ -106,6 +152,11 @@ export class TankBleClient {
         }) as Device;
 
         onDevice(normalized);
+
+        if (onBroadcast) {
+          const broadcast = decodeTankBroadcast(device.manufacturerData);
+          if (broadcast) onBroadcast(normalized, broadcast);
+        }
       }
     );
 
@@ -146,10 +197,25 @@ export class TankBleClient {
       throw new Error('TANK_CHARACTERISTIC_NOT_FOUND');
     }
 
+    // Subscribe to command results now so a batch later costs only its write
+    const commandCharacteristic = characteristics.find((char) => char.uuid.toLowerCase().includes('ff09'));
+    if (commandCharacteristic) {
+      this.commandSubscription?.remove();
+      this.commandSubscription = device.monitorCharacteristicForService(
+        tankService.uuid,
+        commandCharacteristic.uuid,
+        (error, characteristic) => {
+          if (error || !characteristic?.value) return;
+          this.commandWaiter?.(characteristic.value);
+        }
+      );
+    }
+
     return {
       device,
       serviceUUID: tankService.uuid,
       dataCharacteristicUUID: dataCharacteristic.uuid,
+      commandCharacteristicUUID: commandCharacteristic?.uuid,
     };
   }
 
@@ -213,12 +279,60 @@ export class TankBleClient {
     await device.writeCharacteristicWithResponseForService(serviceUUID, characteristicUUID, payloadBase64);
   }
 
+  /**
+   * Run a batch of operations in one write and wait for the indicated result.
+   * A result cut short at the MTU, or one that never arrives, is read back instead.
+   * Batches run one at a time, in the order they were started.
+   */
+  runCommands(connection: TankConnection, commands: TankCommand[]): Promise<TankCommandResult> {
+    const run = this.commandQueue.then(() => this.runCommandBatch(connection, commands));
+    // A failed batch must not hold up the next one
+    this.commandQueue = run.catch(() => undefined);
+    return run;
+  }
+
+  private async runCommandBatch(connection: TankConnection, commands: TankCommand[]): Promise<TankCommandResult> {
+    const { device, serviceUUID, commandCharacteristicUUID } = connection;
+    if (!commandCharacteristicUUID) {
+      throw new Error('COMMANDS_NOT_SUPPORTED');
+    }
+
+    let timer: ReturnType<typeof setTimeout> | undefined;
+    const indicated = new Promise<string | null>((resolve) => {
+      this.commandWaiter = resolve;
+      timer = setTimeout(() => resolve(null), this.commandTimeoutMs);
+    });
+
+    try {
+      await device.writeCharacteristicWithResponseForService(
+        serviceUUID,
+        commandCharacteristicUUID,
+        encodeTankCommands(commands)
+      );
+
+      let result = decodeTankCommandResult(await indicated);
+      if (!result || result.truncated) {
+        const characteristic = await device.readCharacteristicForService(serviceUUID, commandCharacteristicUUID);
+        result = decodeTankCommandResult(characteristic?.value);
+      }
+      if (!result) {
+        throw new Error('COMMAND_RESULT_MISSING');
+      }
+      return result;
+    } finally {
+      clearTimeout(timer);
+      this.commandWaiter = null;
+    }
+  }
+
   async disconnect(device: Device): Promise<void> {
     try {
       await this.manager.cancelDeviceConnection(device.id);
     } finally {
       this.disconnectSubscription?.remove();
       this.disconnectSubscription = null;
+      this.commandSubscription?.remove();
+      this.commandSubscription = null;
       this.stopPolling();
     }
   }
@@ -252,6 +366,11 @@ export class TankBleClient {
       this.disconnectSubscription.remove();
       this.disconnectSubscription = null;
     }
+
+    if (this.commandSubscription) {
+      this.commandSubscription.remove();
+      this.commandSubscription = null;
+    }
   }
 
   private actualDeviceName(device: Device | null): string | null {
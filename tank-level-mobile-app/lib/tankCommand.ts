@@ -0,0 +1,115 @@
+import { Buffer } from 'buffer';
+
+// Command characteristic (0xFF09): one write carries a batch of operations as
+// [type][len][value] after a version byte, and the device answers with one
+// indication holding [type][status][len][value] per operation, in order
+export const TANK_COMMAND_VERSION = 1;
+export const TANK_COMMAND_MAX_OPS = 8;
+
+export const TANK_COMMAND_TYPES = {
+  auth: 0x01,
+  setConfig: 0x02,
+  changePin: 0x03,
+  setSampling: 0x04,
+  setFormat: 0x05,
+  snapshot: 0x06,
+} as const;
+
+/** Per-operation status: the ATT error the single-purpose characteristic would have returned */
+export const TANK_COMMAND_STATUS = {
+  ok: 0x00,
+  notSupported: 0x06,
+  notAuthenticated: 0x08,
+  invalidLength: 0x0d,
+  noRoom: 0x11,
+  wrongPin: 0x89,
+  outOfRange: 0xff,
+} as const;
+
+export type TankCommand =
+  | { type: 'auth'; pin: string }
+  | { type: 'setConfig'; greyEnabled: boolean; blackEnabled: boolean }
+  | { type: 'changePin'; pin: string }
+  /** Settle window bounds; applied live and stored, like the timing in a config write */
+  | { type: 'setSampling'; settleMinMs: number; settleMaxMs: number }
+  | { type: 'setFormat'; format: number }
+  | { type: 'snapshot' };
+
+export interface TankCommandOutcome {
+  type: number;
+  status: number;
+  /** Base64, like a characteristic value; a snapshot's tank data payload, otherwise empty */
+  value: string;
+}
+
+export interface TankCommandResult {
+  outcomes: TankCommandOutcome[];
+  /** The indication was cut at the MTU; read the characteristic for the rest */
+  truncated: boolean;
+}
+
+const u32le = (value: number): number[] => {
+  const bytes = Buffer.alloc(4);
+  bytes.writeUInt32LE(value >>> 0);
+  return Array.from(bytes);
+};
+
+const encodeValue = (command: TankCommand): number[] => {
+  switch (command.type) {
+    case 'auth':
+    case 'changePin':
+      return Array.from(Buffer.from(command.pin, 'ascii'));
+    case 'setConfig':
+      return [command.greyEnabled ? 1 : 0, command.blackEnabled ? 1 : 0];
+    case 'setSampling':
+      return [...u32le(command.settleMinMs), ...u32le(command.settleMaxMs)];
+    case 'setFormat':
+      return [command.format];
+    case 'snapshot':
+      return [];
+  }
+};
+
+export const encodeTankCommands = (commands: TankCommand[]): string => {
+  if (commands.length === 0 || commands.length > TANK_COMMAND_MAX_OPS) {
+    throw new Error('INVALID_COMMAND_BATCH');
+  }
+
+  const bytes = [TANK_COMMAND_VERSION];
+  for (const command of commands) {
+    const value = encodeValue(command);
+    bytes.push(TANK_COMMAND_TYPES[command.type], value.length, ...value);
+  }
+  return Buffer.from(bytes).toString('base64');
+};
+
+export const decodeTankCommandResult = (value: string | null | undefined): TankCommandResult | null => {
+  if (!value) return null;
+
+  const data = Buffer.from(value, 'base64');
+  if (data.length < 2 || data[0] !== TANK_COMMAND_VERSION) return null;
+
+  const count = data[1];
+  const outcomes: TankCommandOutcome[] = [];
+  let pos = 2;
+  while (outcomes.length < count) {
+    if (pos + 3 > data.length || pos + 3 + data[pos + 2] > data.length) {
+      return { outcomes, truncated: true };
+    }
+    const len = data[pos + 2];
+    outcomes.push({
+      type: data[pos],
+      status: data[pos + 1],
+      value: data.subarray(pos + 3, pos + 3 + len).toString('base64'),
+    });
+    pos += 3 + len;
+  }
+
+  return { outcomes, truncated: false };
+};
+
+export const findTankCommandOutcome = (
+  result: TankCommandResult,
+  type: TankCommand['type']
+): TankCommandOutcome | undefined =>
+  result.outcomes.find((outcome) => outcome.type === TANK_COMMAND_TYPES[type]);
@@ -6,4 +6,9 @@ export default interface TankData {
   blackStable: boolean;
   blackEnabled: boolean;
   timestamp: Date;
+  sequence?: number;
+  changedAt?: Date;
+  inMotion?: boolean;
+  greySensorFault?: boolean;
+  blackSensorFault?: boolean;
 }